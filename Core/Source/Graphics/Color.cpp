@@ -17,38 +17,38 @@ Color Color::ToSRGB() const {
 	return XMVectorSelect(T, result, g_XMSelect1110);
 }
 
-inline Color Color::FromSRGB() const {
+Color Color::FromSRGB() const {
 	XMVECTOR T = XMVectorSaturate(m_value);
 	XMVECTOR result = XMVectorPow(XMVectorScale(XMVectorAdd(T, XMVectorReplicate(0.055f)), 1.0f / 1.055f), XMVectorReplicate(2.4f));
-	result = XMVectorSelect(result, XMVectorScale(T, 1.0f / 12.92f), XMVectorLess(T, XMVectorReplicate(0.0031308f)));
+	result = XMVectorSelect(result, XMVectorScale(T, 1.0f / 12.92f), XMVectorLess(T, XMVectorReplicate(0.04045f)));
 	return XMVectorSelect(T, result, g_XMSelect1110);
 }
 
-inline Color Color::ToREC709() const {
+Color Color::ToREC709() const {
 	XMVECTOR T = XMVectorSaturate(m_value);
 	XMVECTOR result = XMVectorSubtract(XMVectorScale(XMVectorPow(T, XMVectorReplicate(0.45f)), 1.099f), XMVectorReplicate(0.099f));
 	result = XMVectorSelect(result, XMVectorScale(T, 4.5f), XMVectorLess(T, XMVectorReplicate(0.0018f)));
 	return XMVectorSelect(T, result, g_XMSelect1110);
 }
 
-inline Color Color::FromREC709() const {
+Color Color::FromREC709() const {
 	XMVECTOR T = XMVectorSaturate(m_value);
 	XMVECTOR result = XMVectorPow(XMVectorScale(XMVectorAdd(T, XMVectorReplicate(0.099f)), 1.0f / 1.099f), XMVectorReplicate(1.0f / 0.45f));
-	result = XMVectorSelect(result, XMVectorScale(T, 1.0f / 4.5f), XMVectorLess(T, XMVectorReplicate(0.0081f)));
+	result = XMVectorSelect(result, XMVectorScale(T, 1.0f / 4.5f), XMVectorLess(T, XMVectorReplicate(0.081f)));
 	return XMVectorSelect(T, result, g_XMSelect1110);
 }
 
-inline uint32_t Color::R10G10B10A2() const {
+uint32_t Color::R10G10B10A2() const {
 	XMVECTOR result = XMVectorRound(XMVectorMultiply(XMVectorSaturate(m_value), XMVectorSet(1023.0f, 1023.0f, 1023.0f, 3.0f)));
 	result = _mm_castsi128_ps(_mm_cvttps_epi32(result));
 	uint32_t r = XMVectorGetIntX(result);
 	uint32_t g = XMVectorGetIntY(result);
 	uint32_t b = XMVectorGetIntZ(result);
-	uint32_t a = XMVectorGetIntW(result) >> 8;
+	uint32_t a = XMVectorGetIntW(result);
 	return a << 30 | b << 20 | g << 10 | r;
 }
 
-inline uint32_t Color::R8G8B8A8() const {
+uint32_t Color::R8G8B8A8() const {
 	XMVECTOR result = XMVectorRound(XMVectorMultiply(XMVectorSaturate(m_value), XMVectorReplicate(255.0f)));
 	result = _mm_castsi128_ps(_mm_cvttps_epi32(result));
 	uint32_t r = XMVectorGetIntX(result);
@@ -14,9 +14,8 @@ namespace Graphics {
 extern ID3D12Device* g_Device;
 // Global root signature for generating mips.
 extern RootSignature g_GenerateMipsRS;
-// Global PSO for generating mips.
-extern ComputePSO g_GenerateMipsLinearPSO[];
-extern ComputePSO g_GenerateMipsGammaPSO[];
+// Global PSOs for generating mips, four linear then four gamma, indexed by the non power of two case.
+extern ComputePSO g_GenerateMipsPSO[];
 
 void ColorBuffer::CreateDerivedViews(ID3D12Device* Device, DXGI_FORMAT Format, uint32_t ArraySize, uint32_t NumMips) {
 	ASSERT(ArraySize == 1 || NumMips == 1, "We don't support auto-mips on texture arrays");
@@ -137,6 +136,8 @@ void ColorBuffer::GenerateMipMaps(CommandContext& BaseContext) {
 	if (m_NumMipMaps == 0)
 		return;
 
+	ASSERT(g_GenerateMipsPSO[0].IsReady(), "Mip generation shaders were not set before InitializeCommonState");
+
 	ComputeContext& Context = BaseContext.GetComputeContext();
 	Context.SetRootSignature(g_GenerateMipsRS);
 	Context.TransitionResource(*this, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
@@ -152,9 +153,9 @@ void ColorBuffer::GenerateMipMaps(CommandContext& BaseContext) {
 		// the source width or height is odd.
 		uint32_t NonPowerOfTwo = (SrcWidth & 1) | (SrcHeight & 1) << 1;
 		if (m_Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
-			Context.SetPipelineState(Graphics::g_GenerateMipsGammaPSO[NonPowerOfTwo]);
+			Context.SetPipelineState(Graphics::g_GenerateMipsPSO[4 + NonPowerOfTwo]);
 		else
-			Context.SetPipelineState(Graphics::g_GenerateMipsLinearPSO[NonPowerOfTwo]);
+			Context.SetPipelineState(Graphics::g_GenerateMipsPSO[NonPowerOfTwo]);
 
 		// We can downsample up to four times, but if the ratio between levels is not
 		// exactly 2:1, we have to shift our blend weights, which gets complicated or
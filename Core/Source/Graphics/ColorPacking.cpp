@@ -0,0 +1,397 @@
+//
+// Batch conversion between float RGBA texels and packed color formats.
+//
+
+#include "pch.h"
+#include "ColorPacking.h"
+#include <ppl.h>
+
+namespace Graphics {
+
+using namespace DirectX;
+
+// Texels per task when converting large streams.
+static const size_t kColorPackingChunkSize = 16384;
+
+template <typename SourceType, typename DestType, typename RangeFunc>
+static void ForEachColorChunk(const SourceType* Source, size_t Count, DestType* Dest, RangeFunc Func) {
+	if (Count <= kColorPackingChunkSize) {
+		Func(Source, Count, Dest);
+		return;
+	}
+
+	Concurrency::parallel_for(size_t(0), Math::DivideByMultiple(Count, kColorPackingChunkSize), [&](size_t Chunk) {
+		const size_t Begin = Chunk * kColorPackingChunkSize;
+		const size_t End = Begin + kColorPackingChunkSize < Count ? Begin + kColorPackingChunkSize : Count;
+		Func(Source + Begin, End - Begin, Dest + Begin);
+	});
+}
+
+// Scalar decoders, the reference for the SIMD paths.
+static INLINE float AsFloat(uint32_t Bits) {
+	union { uint32_t u; float f; } Value;
+	Value.u = Bits;
+	return Value.f;
+}
+
+static INLINE XMFLOAT4 DecodeR10G10B10A2(uint32_t Packed) {
+	return XMFLOAT4(float(Packed & 0x3FF) * (1.0f / 1023.0f), float((Packed >> 10) & 0x3FF) * (1.0f / 1023.0f),
+		float((Packed >> 20) & 0x3FF) * (1.0f / 1023.0f), float(Packed >> 30) * (1.0f / 3.0f));
+}
+
+// The exponent and mantissa of a small float are moved to the float32 fields and rebiased by 2^112, which also handles
+// denormals. An all ones exponent stays infinity or NaN.
+static INLINE float DecodeSmallFloat(uint32_t Bits) {
+	if ((Bits & 0x0F800000) == 0x0F800000)
+		return AsFloat(Bits | 0x7F800000);
+	return AsFloat(Bits) * AsFloat(0x77800000);
+}
+
+static INLINE XMFLOAT4 DecodeR11G11B10F(uint32_t Packed) {
+	return XMFLOAT4(DecodeSmallFloat((Packed << 17) & 0x0FFE0000), DecodeSmallFloat((Packed << 6) & 0x0FFE0000),
+		DecodeSmallFloat((Packed >> 4) & 0x0FFC0000), 1.0f);
+}
+
+static INLINE XMFLOAT4 DecodeR9G9B9E5(uint32_t Packed) {
+	// Mantissas are 9 bit integers scaled by 2^(e - 15 - 9).
+	const float Scale = AsFloat(((Packed >> 27) + 103) << 23);
+	return XMFLOAT4(float(Packed & 0x1FF) * Scale, float((Packed >> 9) & 0x1FF) * Scale, float((Packed >> 18) & 0x1FF) * Scale, 1.0f);
+}
+
+#if defined(MATH_BACKEND_AVX2)
+
+// Every vector holds 2 texels with their channels already shifted to disjoint bits, so adding the 4 lanes of a texel
+// is the same as or-ing them. Returns the 8 packed texels in order.
+static INLINE __m256i CombineTexels(__m256i V0, __m256i V1, __m256i V2, __m256i V3) {
+	const __m256i Sum = _mm256_hadd_epi32(_mm256_hadd_epi32(V0, V1), _mm256_hadd_epi32(V2, V3));
+	return _mm256_permutevar8x32_epi32(Sum, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+// Saturate, scale and round to nearest even like XMVectorRound, then shift every channel to its bit offset.
+static INLINE __m256i QuantizeUNorm(const float* Source, __m256 Scale, __m256i Shift) {
+	__m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(Source), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	v = _mm256_round_ps(_mm256_mul_ps(v, Scale), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	return _mm256_sllv_epi32(_mm256_cvttps_epi32(v), Shift);
+}
+
+// Converts the whole batches of 8 texels and returns how many were converted.
+static size_t PackUNormBatches(const XMFLOAT4* Source, size_t Count, uint32_t* Dest, __m256 Scale, __m256i Shift) {
+	size_t i = 0;
+	for (; i + 8 <= Count; i += 8) {
+		const float* p = &Source[i].x;
+		const __m256i Packed = CombineTexels(QuantizeUNorm(p, Scale, Shift), QuantizeUNorm(p + 8, Scale, Shift),
+			QuantizeUNorm(p + 16, Scale, Shift), QuantizeUNorm(p + 24, Scale, Shift));
+		_mm256_storeu_si256((__m256i*)(Dest + i), Packed);
+	}
+	return i;
+}
+
+static void PackR8G8B8A8Range(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	size_t i = PackUNormBatches(Source, Count, Dest, _mm256_set1_ps(255.0f), _mm256_setr_epi32(0, 8, 16, 24, 0, 8, 16, 24));
+	for (; i < Count; ++i)
+		Dest[i] = Color(XMLoadFloat4(&Source[i])).R8G8B8A8();
+}
+
+static void PackR10G10B10A2Range(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	size_t i = PackUNormBatches(Source, Count, Dest, _mm256_setr_ps(1023.0f, 1023.0f, 1023.0f, 3.0f, 1023.0f, 1023.0f, 1023.0f, 3.0f),
+		_mm256_setr_epi32(0, 10, 20, 30, 0, 10, 20, 30));
+	for (; i < Count; ++i)
+		Dest[i] = Color(XMLoadFloat4(&Source[i])).R10G10B10A2();
+}
+
+// Same steps as Color::R11G11B10F on 2 texels, clamp to [0, 2^16], rebias the exponent by 2^-112, round and truncate
+// the mantissas, then move every channel to its bit offset. Alpha lanes are masked out.
+template <bool RoundToEven>
+static INLINE __m256i QuantizeR11G11B10F(const float* Source) {
+	__m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(Source), _mm256_setzero_ps()), _mm256_set1_ps(float(1 << 16)));
+	__m256i u = _mm256_castps_si256(_mm256_mul_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x07800000))));
+
+	if (RoundToEven) {
+		const __m256i Odd = _mm256_and_si256(_mm256_srlv_epi32(u, _mm256_setr_epi32(16, 16, 17, 0, 16, 16, 17, 0)), _mm256_set1_epi32(1));
+		u = _mm256_add_epi32(u, _mm256_add_epi32(Odd, _mm256_setr_epi32(0x0FFFF, 0x0FFFF, 0x1FFFF, 0, 0x0FFFF, 0x0FFFF, 0x1FFFF, 0)));
+	} else {
+		u = _mm256_add_epi32(u, _mm256_setr_epi32(0x10000, 0x10000, 0x20000, 0, 0x10000, 0x10000, 0x20000, 0));
+	}
+
+	u = _mm256_and_si256(u, _mm256_setr_epi32(0x0FFE0000, 0x0FFE0000, 0x0FFC0000, 0, 0x0FFE0000, 0x0FFE0000, 0x0FFC0000, 0));
+	u = _mm256_srlv_epi32(u, _mm256_setr_epi32(17, 6, 0, 0, 17, 6, 0, 0));
+	return _mm256_sllv_epi32(u, _mm256_setr_epi32(0, 0, 4, 0, 0, 0, 4, 0));
+}
+
+template <bool RoundToEven>
+static void PackR11G11B10FRange(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	size_t i = 0;
+	for (; i + 8 <= Count; i += 8) {
+		const float* p = &Source[i].x;
+		const __m256i Packed = CombineTexels(QuantizeR11G11B10F<RoundToEven>(p), QuantizeR11G11B10F<RoundToEven>(p + 8),
+			QuantizeR11G11B10F<RoundToEven>(p + 16), QuantizeR11G11B10F<RoundToEven>(p + 24));
+		_mm256_storeu_si256((__m256i*)(Dest + i), Packed);
+	}
+	for (; i < Count; ++i)
+		Dest[i] = Color(XMLoadFloat4(&Source[i])).R11G11B10F(RoundToEven);
+}
+
+// Loads 8 texels as channel vectors.
+static INLINE void LoadChannels(const XMFLOAT4* Source, __m256& r, __m256& g, __m256& b) {
+	__m128 t0 = _mm_loadu_ps(&Source[0].x), t1 = _mm_loadu_ps(&Source[1].x), t2 = _mm_loadu_ps(&Source[2].x), t3 = _mm_loadu_ps(&Source[3].x);
+	__m128 t4 = _mm_loadu_ps(&Source[4].x), t5 = _mm_loadu_ps(&Source[5].x), t6 = _mm_loadu_ps(&Source[6].x), t7 = _mm_loadu_ps(&Source[7].x);
+	_MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+	_MM_TRANSPOSE4_PS(t4, t5, t6, t7);
+	r = _mm256_insertf128_ps(_mm256_castps128_ps256(t0), t4, 1);
+	g = _mm256_insertf128_ps(_mm256_castps128_ps256(t1), t5, 1);
+	b = _mm256_insertf128_ps(_mm256_castps128_ps256(t2), t6, 1);
+}
+
+// Same steps as Color::R9G9B9E5 on 8 texels.
+static void PackR9G9B9E5Range(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	const __m256 Zero = _mm256_setzero_ps();
+	const __m256 MaxValue = _mm256_set1_ps(float(0x1FF << 7));
+	const __m256 MinValue = _mm256_set1_ps(1.0f / (1 << 16));
+
+	size_t i = 0;
+	for (; i + 8 <= Count; i += 8) {
+		__m256 r, g, b;
+		LoadChannels(Source + i, r, g, b);
+		r = _mm256_min_ps(_mm256_max_ps(r, Zero), MaxValue);
+		g = _mm256_min_ps(_mm256_max_ps(g, Zero), MaxValue);
+		b = _mm256_min_ps(_mm256_max_ps(b, Zero), MaxValue);
+
+		const __m256 MaxChannel = _mm256_max_ps(_mm256_max_ps(r, g), _mm256_max_ps(b, MinValue));
+		const __m256i Bias = _mm256_and_si256(_mm256_add_epi32(_mm256_castps_si256(MaxChannel), _mm256_set1_epi32(0x07804000)),
+			_mm256_set1_epi32(0x7F800000));
+
+		const __m256i R = _mm256_castps_si256(_mm256_add_ps(r, _mm256_castsi256_ps(Bias)));
+		const __m256i G = _mm256_castps_si256(_mm256_add_ps(g, _mm256_castsi256_ps(Bias)));
+		const __m256i B = _mm256_castps_si256(_mm256_add_ps(b, _mm256_castsi256_ps(Bias)));
+		const __m256i Exponent = _mm256_add_epi32(_mm256_slli_epi32(Bias, 4), _mm256_set1_epi32(0x10000000));
+
+		__m256i Packed = _mm256_or_si256(Exponent, _mm256_slli_epi32(B, 18));
+		Packed = _mm256_or_si256(Packed, _mm256_slli_epi32(G, 9));
+		Packed = _mm256_or_si256(Packed, _mm256_and_si256(R, _mm256_set1_epi32(511)));
+		_mm256_storeu_si256((__m256i*)(Dest + i), Packed);
+	}
+	for (; i < Count; ++i)
+		Dest[i] = Color(XMLoadFloat4(&Source[i])).R9G9B9E5();
+}
+
+// Replicates packed texels 0 and 1 over the 4 lanes of the low and high half.
+static INLINE __m256i BroadcastTexelPair(const uint32_t* Source) {
+	const __m256i Pair = _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)Source));
+	return _mm256_permutevar8x32_epi32(Pair, _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1));
+}
+
+static void UnpackR8G8B8A8Range(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	const __m256 Scale = _mm256_set1_ps(1.0f / 255.0f);
+	size_t i = 0;
+	for (; i + 2 <= Count; i += 2) {
+		const __m256i Channels = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(Source + i)));
+		_mm256_storeu_ps(&Dest[i].x, _mm256_mul_ps(_mm256_cvtepi32_ps(Channels), Scale));
+	}
+	if (i < Count)
+		XMStoreFloat4(&Dest[i], Color(Source[i]));
+}
+
+static void UnpackR10G10B10A2Range(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	const __m256i Shift = _mm256_setr_epi32(0, 10, 20, 30, 0, 10, 20, 30);
+	const __m256i Mask = _mm256_setr_epi32(0x3FF, 0x3FF, 0x3FF, 3, 0x3FF, 0x3FF, 0x3FF, 3);
+	const __m256 Scale = _mm256_setr_ps(1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 3.0f,
+		1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 3.0f);
+	size_t i = 0;
+	for (; i + 2 <= Count; i += 2) {
+		const __m256i Channels = _mm256_and_si256(_mm256_srlv_epi32(BroadcastTexelPair(Source + i), Shift), Mask);
+		_mm256_storeu_ps(&Dest[i].x, _mm256_mul_ps(_mm256_cvtepi32_ps(Channels), Scale));
+	}
+	if (i < Count)
+		Dest[i] = DecodeR10G10B10A2(Source[i]);
+}
+
+static void UnpackR11G11B10FRange(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	const __m256i ShiftLeft = _mm256_setr_epi32(17, 6, 0, 0, 17, 6, 0, 0);
+	const __m256i ShiftRight = _mm256_setr_epi32(0, 0, 4, 0, 0, 0, 4, 0);
+	const __m256i Mask = _mm256_setr_epi32(0x0FFE0000, 0x0FFE0000, 0x0FFC0000, 0, 0x0FFE0000, 0x0FFE0000, 0x0FFC0000, 0);
+	const __m256i ExponentMask = _mm256_set1_epi32(0x0F800000);
+	const __m256 Rebias = _mm256_castsi256_ps(_mm256_set1_epi32(0x77800000));
+	size_t i = 0;
+	for (; i + 2 <= Count; i += 2) {
+		__m256i Bits = _mm256_sllv_epi32(BroadcastTexelPair(Source + i), ShiftLeft);
+		Bits = _mm256_and_si256(_mm256_srlv_epi32(Bits, ShiftRight), Mask);
+
+		const __m256 Special = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(Bits, ExponentMask), ExponentMask));
+		const __m256 Infinity = _mm256_castsi256_ps(_mm256_or_si256(Bits, _mm256_set1_epi32(0x7F800000)));
+		__m256 Value = _mm256_blendv_ps(_mm256_mul_ps(_mm256_castsi256_ps(Bits), Rebias), Infinity, Special);
+		Value = _mm256_blend_ps(Value, _mm256_set1_ps(1.0f), 0x88);
+		_mm256_storeu_ps(&Dest[i].x, Value);
+	}
+	if (i < Count)
+		Dest[i] = DecodeR11G11B10F(Source[i]);
+}
+
+static void UnpackR9G9B9E5Range(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	const __m256i Shift = _mm256_setr_epi32(0, 9, 18, 27, 0, 9, 18, 27);
+	const __m256i Mask = _mm256_setr_epi32(0x1FF, 0x1FF, 0x1FF, 0x1F, 0x1FF, 0x1FF, 0x1FF, 0x1F);
+	size_t i = 0;
+	for (; i + 2 <= Count; i += 2) {
+		const __m256i Fields = _mm256_and_si256(_mm256_srlv_epi32(BroadcastTexelPair(Source + i), Shift), Mask);
+		const __m256i Exponent = _mm256_shuffle_epi32(Fields, _MM_SHUFFLE(3, 3, 3, 3));
+		const __m256 Scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(Exponent, _mm256_set1_epi32(103)), 23));
+		const __m256 Value = _mm256_mul_ps(_mm256_cvtepi32_ps(Fields), Scale);
+		_mm256_storeu_ps(&Dest[i].x, _mm256_blend_ps(Value, _mm256_set1_ps(1.0f), 0x88));
+	}
+	if (i < Count)
+		Dest[i] = DecodeR9G9B9E5(Source[i]);
+}
+
+#else
+
+static void PackR8G8B8A8Range(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	for (size_t i = 0; i < Count; ++i)
+		Dest[i] = Color(XMLoadFloat4(&Source[i])).R8G8B8A8();
+}
+
+static void PackR10G10B10A2Range(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	for (size_t i = 0; i < Count; ++i)
+		Dest[i] = Color(XMLoadFloat4(&Source[i])).R10G10B10A2();
+}
+
+template <bool RoundToEven>
+static void PackR11G11B10FRange(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	for (size_t i = 0; i < Count; ++i)
+		Dest[i] = Color(XMLoadFloat4(&Source[i])).R11G11B10F(RoundToEven);
+}
+
+static void PackR9G9B9E5Range(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	for (size_t i = 0; i < Count; ++i)
+		Dest[i] = Color(XMLoadFloat4(&Source[i])).R9G9B9E5();
+}
+
+static void UnpackR8G8B8A8Range(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	for (size_t i = 0; i < Count; ++i)
+		XMStoreFloat4(&Dest[i], Color(Source[i]));
+}
+
+static void UnpackR10G10B10A2Range(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	for (size_t i = 0; i < Count; ++i)
+		Dest[i] = DecodeR10G10B10A2(Source[i]);
+}
+
+static void UnpackR11G11B10FRange(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	for (size_t i = 0; i < Count; ++i)
+		Dest[i] = DecodeR11G11B10F(Source[i]);
+}
+
+static void UnpackR9G9B9E5Range(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	for (size_t i = 0; i < Count; ++i)
+		Dest[i] = DecodeR9G9B9E5(Source[i]);
+}
+
+#endif
+
+void PackR8G8B8A8(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	ForEachColorChunk(Source, Count, Dest, PackR8G8B8A8Range);
+}
+
+void PackR10G10B10A2(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	ForEachColorChunk(Source, Count, Dest, PackR10G10B10A2Range);
+}
+
+void PackR11G11B10F(const XMFLOAT4* Source, size_t Count, uint32_t* Dest, bool RoundToEven) {
+	if (RoundToEven)
+		ForEachColorChunk(Source, Count, Dest, PackR11G11B10FRange<true>);
+	else
+		ForEachColorChunk(Source, Count, Dest, PackR11G11B10FRange<false>);
+}
+
+void PackR9G9B9E5(const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	ForEachColorChunk(Source, Count, Dest, PackR9G9B9E5Range);
+}
+
+void UnpackR8G8B8A8(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	ForEachColorChunk(Source, Count, Dest, UnpackR8G8B8A8Range);
+}
+
+void UnpackR10G10B10A2(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	ForEachColorChunk(Source, Count, Dest, UnpackR10G10B10A2Range);
+}
+
+void UnpackR11G11B10F(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	ForEachColorChunk(Source, Count, Dest, UnpackR11G11B10FRange);
+}
+
+void UnpackR9G9B9E5(const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	ForEachColorChunk(Source, Count, Dest, UnpackR9G9B9E5Range);
+}
+
+//
+// Transfer function tables
+//
+
+// Index count of the encode tables. The steepest part of the sRGB curve is the linear segment, at 12.92 * 255 / 4095
+// = 0.8 steps per entry, so a 12 bit index stays within one step of the exact encoding.
+static const uint32_t kEncodeTableSize = 4096;
+
+struct TransferTables {
+	float Decode[256];
+	uint8_t Encode[kEncodeTableSize];
+
+	template <typename DecodeFunc, typename EncodeFunc>
+	TransferTables(DecodeFunc DecodeValue, EncodeFunc EncodeValue) {
+		for (uint32_t i = 0; i < 256; ++i)
+			Decode[i] = (float)DecodeValue(i / 255.0);
+		for (uint32_t i = 0; i < kEncodeTableSize; ++i)
+			Encode[i] = (uint8_t)(EncodeValue(i / double(kEncodeTableSize - 1)) * 255.0 + 0.5);
+	}
+};
+
+static const TransferTables& GetTransferTables(TransferFunction Function) {
+	static const TransferTables s_SRGB(
+		[](double c) { return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4); },
+		[](double c) { return c < 0.0031308 ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055; });
+	static const TransferTables s_REC709(
+		[](double c) { return c < 0.081 ? c / 4.5 : pow((c + 0.099) / 1.099, 1.0 / 0.45); },
+		[](double c) { return c < 0.018 ? c * 4.5 : 1.099 * pow(c, 0.45) - 0.099; });
+	return Function == TransferFunction::kSRGB ? s_SRGB : s_REC709;
+}
+
+static INLINE XMFLOAT4 DecodeTexel(const float* Table, uint32_t Packed) {
+	return XMFLOAT4(Table[Packed & 0xFF], Table[(Packed >> 8) & 0xFF], Table[(Packed >> 16) & 0xFF], float(Packed >> 24) * (1.0f / 255.0f));
+}
+
+// Color channels index the encode table, alpha is quantized linearly. The indices are computed for all 4 channels at
+// once and the lookups are plain loads, no gathers. The scaled values are in range, so the conversion truncates like
+// cvttps on every backend.
+static INLINE uint32_t EncodeTexel(const uint8_t* Table, FXMVECTOR Linear) {
+	static const XMVECTORF32 kScale = { float(kEncodeTableSize - 1), float(kEncodeTableSize - 1), float(kEncodeTableSize - 1), 255.0f };
+	XMVECTORU32 Index;
+	Index.v = XMConvertVectorFloatToInt(XMVectorMultiplyAdd(XMVectorSaturate(Linear), kScale, g_XMOneHalf), 0);
+	return Index.u[3] << 24 | Table[Index.u[2]] << 16 | Table[Index.u[1]] << 8 | Table[Index.u[0]];
+}
+
+void DecodeR8G8B8A8(TransferFunction Function, const uint32_t* Source, size_t Count, XMFLOAT4* Dest) {
+	const float* Table = GetTransferTables(Function).Decode;
+	ForEachColorChunk(Source, Count, Dest, [Table](const uint32_t* Texels, size_t Num, XMFLOAT4* Out) {
+		for (size_t i = 0; i < Num; ++i)
+			Out[i] = DecodeTexel(Table, Texels[i]);
+	});
+}
+
+void EncodeR8G8B8A8(TransferFunction Function, const XMFLOAT4* Source, size_t Count, uint32_t* Dest) {
+	const uint8_t* Table = GetTransferTables(Function).Encode;
+	ForEachColorChunk(Source, Count, Dest, [Table](const XMFLOAT4* Texels, size_t Num, uint32_t* Out) {
+		for (size_t i = 0; i < Num; ++i)
+			Out[i] = EncodeTexel(Table, XMLoadFloat4(&Texels[i]));
+	});
+}
+
+void PremultiplyAlphaR8G8B8A8(TransferFunction Function, uint32_t* Pixels, size_t Count) {
+	const TransferTables& Tables = GetTransferTables(Function);
+	ForEachColorChunk(Pixels, Count, Pixels, [&Tables](const uint32_t* Texels, size_t Num, uint32_t* Out) {
+		for (size_t i = 0; i < Num; ++i) {
+			const XMFLOAT4 Texel = DecodeTexel(Tables.Decode, Texels[i]);
+			XMVECTOR Linear = XMLoadFloat4(&Texel);
+			Linear = XMVectorSelect(Linear, XMVectorMultiply(Linear, XMVectorSplatW(Linear)), g_XMSelect1110);
+			Out[i] = EncodeTexel(Tables.Encode, Linear);
+		}
+	});
+}
+
+}	// namespace Graphics
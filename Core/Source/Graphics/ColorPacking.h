@@ -0,0 +1,40 @@
+//
+// Batch conversion between float RGBA texels and packed color formats, for bakers and CPU image processing. Packing is
+// bit exact with the matching Color methods. With MATH_BACKEND_AVX2 8 texels are converted per iteration, and large
+// streams are split across threads. Packed texels are little endian with red in the lowest bits.
+//
+
+#pragma once
+
+#include "Color.h"
+
+namespace Graphics {
+
+// Low dynamic range, the values are saturated. Convert to sRGB or Rec709 first when needed.
+void PackR8G8B8A8(const DirectX::XMFLOAT4* Source, size_t Count, uint32_t* Dest);
+void PackR10G10B10A2(const DirectX::XMFLOAT4* Source, size_t Count, uint32_t* Dest);
+
+// High dynamic range, alpha is dropped.
+void PackR11G11B10F(const DirectX::XMFLOAT4* Source, size_t Count, uint32_t* Dest, bool RoundToEven = false);
+void PackR9G9B9E5(const DirectX::XMFLOAT4* Source, size_t Count, uint32_t* Dest);
+
+// Inverse conversions. Alpha is 1 for the formats without it.
+void UnpackR8G8B8A8(const uint32_t* Source, size_t Count, DirectX::XMFLOAT4* Dest);
+void UnpackR10G10B10A2(const uint32_t* Source, size_t Count, DirectX::XMFLOAT4* Dest);
+void UnpackR11G11B10F(const uint32_t* Source, size_t Count, DirectX::XMFLOAT4* Dest);
+void UnpackR9G9B9E5(const uint32_t* Source, size_t Count, DirectX::XMFLOAT4* Dest);
+
+enum class TransferFunction {
+	kSRGB,
+	kREC709,
+};
+
+// Table driven conversion between gamma encoded 8 bit texels and linear float texels, for CPU mip generation and image
+// tools. Decoding is exact, encoding is within one step of Color::ToSRGB and Color::ToREC709. Alpha is always linear.
+void DecodeR8G8B8A8(TransferFunction Function, const uint32_t* Source, size_t Count, DirectX::XMFLOAT4* Dest);
+void EncodeR8G8B8A8(TransferFunction Function, const DirectX::XMFLOAT4* Source, size_t Count, uint32_t* Dest);
+
+// Multiplies the color by alpha in linear space, in place.
+void PremultiplyAlphaR8G8B8A8(TransferFunction Function, uint32_t* Pixels, size_t Count);
+
+}	// namespace Graphics
@@ -8,6 +8,7 @@
 #include "ColorBuffer.h"
 #include "DepthBuffer.h"
 #include "GraphicsCore.h"
+#include "PipelineWarmup.h"
 
 #ifndef RELEASE
 #include <d3d11_2.h>
@@ -531,6 +532,17 @@ void GraphicsContext::SetPipelineState(const GraphicsPSO& PSO) {
 		return;
 	m_CommandList->SetPipelineState(PipelineState);
 	m_CurGraphicsPipelineState = PipelineState;
+	PipelineWarmup::RecordUse(PSO);
+}
+
+bool GraphicsContext::TrySetPipelineState(const GraphicsPSO& PSO, const GraphicsPSO* Fallback) {
+	if (PSO.IsReady())
+		SetPipelineState(PSO);
+	else if (Fallback != nullptr)
+		SetPipelineState(*Fallback);
+	else
+		return false;
+	return true;
 }
 
 void GraphicsContext::SetRenderTargets(UINT NumRTVs, const D3D12_CPU_DESCRIPTOR_HANDLE RTVs[]) {
@@ -793,6 +805,16 @@ void ComputeContext::SetPipelineState(const ComputePSO& PSO) {
 	m_CurComputePipelineState = PipelineState;
 }
 
+bool ComputeContext::TrySetPipelineState(const ComputePSO& PSO, const ComputePSO* Fallback) {
+	if (PSO.IsReady())
+		SetPipelineState(PSO);
+	else if (Fallback != nullptr)
+		SetPipelineState(*Fallback);
+	else
+		return false;
+	return true;
+}
+
 void ComputeContext::SetConstantArray(UINT RootEntry, UINT NumConstants, const void* pConstants) {
 	m_CommandList->SetComputeRoot32BitConstants(RootEntry, NumConstants, pConstants, 0);
 }
@@ -190,7 +190,11 @@ public:
 	void ResolveQueryData(ID3D12QueryHeap* QueryHeap, D3D12_QUERY_TYPE Type, UINT StartIndex, UINT NumQueries, ID3D12Resource* DestinationBuffer, UINT64 DestinationBufferOffset);
 
 	void SetRootSignature(const RootSignature& RootSig);
+	// Waits when PSO is still compiling after FinalizeAsync. First binds are recorded for PipelineWarmup.
 	void SetPipelineState(const GraphicsPSO& PSO);
+	// Binds PSO only when it is ready, otherwise Fallback (waiting for it if needed) when given. Returns false when
+	// nothing was bound and the draw should be skipped. Fallback must use the same root signature as PSO.
+	bool TrySetPipelineState(const GraphicsPSO& PSO, const GraphicsPSO* Fallback = nullptr);
 
 	void SetRenderTargets(UINT NumRTVs, const D3D12_CPU_DESCRIPTOR_HANDLE RTVs[]);
 	void SetRenderTargets(UINT NumRTVs, const D3D12_CPU_DESCRIPTOR_HANDLE RTVs[], D3D12_CPU_DESCRIPTOR_HANDLE DSV);
@@ -255,7 +259,10 @@ public:
 	void ClearUAV(ColorBuffer& Target);
 
 	void SetRootSignature(const RootSignature& RootSig);
+	// Waits when PSO is still compiling after FinalizeAsync.
 	void SetPipelineState(const ComputePSO& PSO);
+	// Binds PSO only when it is ready, otherwise Fallback when given. Returns false when nothing was bound.
+	bool TrySetPipelineState(const ComputePSO& PSO, const ComputePSO* Fallback = nullptr);
 
 	void SetConstantArray(UINT RootIndex, UINT NumConstants, const void* pConstants);
 	void SetConstant(UINT RootIndex, DWParam Val, UINT Offset = 0);
@@ -0,0 +1,130 @@
+//
+// Intrusive stack shared by many threads, for the free lists of GPU object pools.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace Graphics {
+
+// Pushes are a lock-free compare-exchange. Pops hold a short spin lock against each other but not against pushes, so
+// the nodes a pop walks can't be taken and pushed back meanwhile, which makes its compare-exchange safe from ABA
+// without tagged pointers. A pop only takes the nodes it returns; the rest of the stack stays visible to other
+// threads throughout. Nodes are linked through NextMember, which belongs to the stack while they are in it.
+template <typename NodeType, NodeType* NodeType::*NextMember>
+class alignas(64) ConcurrentStack {
+public:
+	ConcurrentStack() : m_Head(nullptr), m_PopLock(false), m_CasRetries(0), m_PopLockWaits(0) {}
+
+	bool IsEmpty() const { return m_Head.load(std::memory_order_relaxed) == nullptr; }
+
+	// Pushes the chain First to Last, already linked through NextMember.
+	void Push(NodeType* First, NodeType* Last) {
+		Last->*NextMember = m_Head.load(std::memory_order_relaxed);
+		while (!m_Head.compare_exchange_weak(Last->*NextMember, First, std::memory_order_release, std::memory_order_relaxed))
+			m_CasRetries.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Push(NodeType* Node) { Push(Node, Node); }
+
+	// Pops up to MaxCount nodes, the most recently pushed first, and returns how many.
+	uint32_t Pop(NodeType** Nodes, uint32_t MaxCount) {
+		if (MaxCount == 0 || IsEmpty())
+			return 0;
+
+		LockPops();
+		NodeType* Head = m_Head.load(std::memory_order_acquire);
+		uint32_t Count;
+		for (;;) {
+			Count = 0;
+			NodeType* Rest = Head;
+			while (Rest != nullptr && Count < MaxCount) {
+				Nodes[Count++] = Rest;
+				Rest = Rest->*NextMember;
+			}
+			if (Count == 0 || m_Head.compare_exchange_weak(Head, Rest, std::memory_order_acquire, std::memory_order_acquire))
+				break;
+			m_CasRetries.fetch_add(1, std::memory_order_relaxed);
+		}
+		UnlockPops();
+		return Count;
+	}
+
+	NodeType* Pop() {
+		NodeType* Node = nullptr;
+		return Pop(&Node, 1) != 0 ? Node : nullptr;
+	}
+
+	// Takes the whole stack as a chain.
+	NodeType* PopAll() {
+		LockPops();
+		NodeType* Head = m_Head.exchange(nullptr, std::memory_order_acquire);
+		UnlockPops();
+		return Head;
+	}
+
+	// Unlinks every node Predicate is true for and returns them as a chain. The other nodes stay in place, so
+	// concurrent pops keep finding them.
+	template <typename PredicateType>
+	NodeType* RemoveIf(const PredicateType& Predicate) {
+		NodeType* Removed = nullptr;
+		if (IsEmpty())
+			return Removed;
+
+		LockPops();
+		NodeType* Prev = nullptr;
+		NodeType* Node = m_Head.load(std::memory_order_acquire);
+		while (Node != nullptr) {
+			NodeType* Next = Node->*NextMember;
+			if (!Predicate(Node)) {
+				Prev = Node;
+				Node = Next;
+				continue;
+			}
+
+			// Pushes only ever change the head, so the links below it belong to the pop lock holder. When a push
+			// lands above the head being removed, start over from the new head.
+			if (Prev != nullptr) {
+				Prev->*NextMember = Next;
+			} else if (!m_Head.compare_exchange_strong(Node, Next, std::memory_order_acquire, std::memory_order_acquire)) {
+				m_CasRetries.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+
+			Node->*NextMember = Removed;
+			Removed = Node;
+			Node = Next;
+		}
+		UnlockPops();
+		return Removed;
+	}
+
+	uint64_t GetCasRetries() const { return m_CasRetries.load(std::memory_order_relaxed); }
+	uint64_t GetPopLockWaits() const { return m_PopLockWaits.load(std::memory_order_relaxed); }
+
+private:
+	void LockPops() {
+		if (!m_PopLock.exchange(true, std::memory_order_acquire))
+			return;
+
+		m_PopLockWaits.fetch_add(1, std::memory_order_relaxed);
+		do {
+			while (m_PopLock.load(std::memory_order_relaxed))
+				std::this_thread::yield();
+		} while (m_PopLock.exchange(true, std::memory_order_acquire));
+	}
+
+	void UnlockPops() {
+		m_PopLock.store(false, std::memory_order_release);
+	}
+
+	std::atomic<NodeType*> m_Head;
+	std::atomic<bool> m_PopLock;
+	std::atomic<uint64_t> m_CasRetries;
+	std::atomic<uint64_t> m_PopLockWaits;
+};
+
+}	// namespace Graphics
@@ -0,0 +1,333 @@
+//
+// CPU prefiltering of environment cubemaps for image based lighting.
+//
+
+#include "pch.h"
+#include "CubemapFilter.h"
+#include "../Core/FileUtility.h"
+#include "DDSTextureLoader.h"
+#include "../Math/CubemapLayout.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <ppl.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace Graphics {
+
+// Approximate number of texel fetches per work item.
+static const uint64_t kFilterWorkItemCost = 1 << 18;
+
+// Float RGBA texels of the 6 faces of one mip level.
+struct CubemapLevel {
+	uint32_t Size;
+	std::vector<XMFLOAT4> Faces[6];
+};
+
+// Light direction in the tangent space of the output texel (normal along z) and the source mip to read it from. The
+// sample is weighted by its z component.
+struct FilterSample {
+	float x, y, z;
+	float Lod;
+};
+
+struct FilterMip {
+	float Roughness;
+	float TotalWeight;
+	std::vector<FilterSample> Samples;
+	CubemapLevel Output;
+};
+
+struct FilterWorkItem {
+	uint32_t Mip;
+	uint32_t Face;
+	uint32_t RowBegin;
+	uint32_t RowEnd;
+	uint64_t Cost;
+};
+
+static bool LoadSourceLevel(const DDSTextureData& Texture, CubemapLevel& Level) {
+	if (!Texture.isCubeMap || Texture.width != Texture.height)
+		return false;
+	if (Texture.format != DXGI_FORMAT_R32G32B32A32_FLOAT && Texture.format != DXGI_FORMAT_R16G16B16A16_FLOAT)
+		return false;
+
+	Level.Size = Texture.width;
+	for (uint32_t Face = 0; Face < 6; ++Face) {
+		const D3D12_SUBRESOURCE_DATA& Subresource = Texture.subresources[Face * Texture.mipCount];
+		std::vector<XMFLOAT4>& Texels = Level.Faces[Face];
+		Texels.resize(size_t(Level.Size) * Level.Size);
+
+		for (uint32_t Row = 0; Row < Level.Size; ++Row) {
+			const uint8_t* RowData = (const uint8_t*)Subresource.pData + Row * Subresource.RowPitch;
+			XMFLOAT4* Dest = &Texels[size_t(Row) * Level.Size];
+			if (Texture.format == DXGI_FORMAT_R16G16B16A16_FLOAT)
+				XMConvertHalfToFloatStream(&Dest->x, sizeof(float), (const HALF*)RowData, sizeof(HALF), Level.Size * 4);
+			else
+				memcpy(Dest, RowData, Level.Size * sizeof(XMFLOAT4));
+		}
+	}
+	return true;
+}
+
+// 2x2 box filter of the previous level.
+static void DownsampleLevel(const CubemapLevel& Source, CubemapLevel& Dest) {
+	Dest.Size = Source.Size > 1 ? Source.Size / 2 : 1;
+	const XMVECTOR Quarter = XMVectorReplicate(0.25f);
+
+	Concurrency::parallel_for(0u, 6u, [&](uint32_t Face) {
+		const XMFLOAT4* Src = Source.Faces[Face].data();
+		std::vector<XMFLOAT4>& Texels = Dest.Faces[Face];
+		Texels.resize(size_t(Dest.Size) * Dest.Size);
+
+		for (uint32_t y = 0; y < Dest.Size; ++y) {
+			const XMFLOAT4* Row0 = Src + size_t(y * 2) * Source.Size;
+			const XMFLOAT4* Row1 = Source.Size > 1 ? Row0 + Source.Size : Row0;
+			for (uint32_t x = 0; x < Dest.Size; ++x) {
+				const uint32_t x0 = x * 2, x1 = Source.Size > 1 ? x * 2 + 1 : x * 2;
+				XMVECTOR Sum = XMLoadFloat4(&Row0[x0]) + XMLoadFloat4(&Row0[x1]) + XMLoadFloat4(&Row1[x0]) + XMLoadFloat4(&Row1[x1]);
+				XMStoreFloat4(&Texels[size_t(y) * Dest.Size + x], Sum * Quarter);
+			}
+		}
+	});
+}
+
+static float RadicalInverse(uint32_t Bits) {
+	Bits = (Bits << 16) | (Bits >> 16);
+	Bits = ((Bits & 0x55555555u) << 1) | ((Bits & 0xAAAAAAAAu) >> 1);
+	Bits = ((Bits & 0x33333333u) << 2) | ((Bits & 0xCCCCCCCCu) >> 2);
+	Bits = ((Bits & 0x0F0F0F0Fu) << 4) | ((Bits & 0xF0F0F0F0u) >> 4);
+	Bits = ((Bits & 0x00FF00FFu) << 8) | ((Bits & 0xFF00FF00u) >> 8);
+	return float(Bits) * 2.3283064365386963e-10f;
+}
+
+// GGX importance samples on a Hammersley set, with the view direction along the normal. Every sample reads the source
+// mip whose texels cover about the solid angle the sample represents (filtered importance sampling), which removes
+// the noise of low sample counts.
+static void BuildSamples(FilterMip& Mip, uint32_t SampleCount, uint32_t SourceSize, uint32_t SourceMipCount) {
+	const float MaxLod = float(SourceMipCount - 1);
+	Mip.Samples.clear();
+
+	if (Mip.Roughness == 0.0f) {
+		const float Lod = std::min(std::max(log2f(float(SourceSize) / float(Mip.Output.Size)), 0.0f), MaxLod);
+		FilterSample Sample = { 0.0f, 0.0f, 1.0f, Lod };
+		Mip.Samples.push_back(Sample);
+		Mip.TotalWeight = 1.0f;
+		return;
+	}
+
+	const float Alpha = Mip.Roughness * Mip.Roughness;
+	const float Alpha2 = Alpha * Alpha;
+	const float TexelSolidAngle = 4.0f * XM_PI / (6.0f * SourceSize * SourceSize);
+
+	Mip.TotalWeight = 0.0f;
+	for (uint32_t i = 0; i < SampleCount; ++i) {
+		const float Phi = XM_2PI * (i + 0.5f) / SampleCount;
+		const float u = RadicalInverse(i);
+		const float CosTheta = sqrtf((1.0f - u) / (1.0f + (Alpha2 - 1.0f) * u));
+		const float SinTheta = sqrtf(1.0f - CosTheta * CosTheta);
+
+		// Reflect the view direction about the half vector.
+		const float Lz = 2.0f * CosTheta * CosTheta - 1.0f;
+		if (Lz <= 0.0f)
+			continue;
+
+		const float d = CosTheta * CosTheta * (Alpha2 - 1.0f) + 1.0f;
+		const float Pdf = Alpha2 / (XM_PI * d * d) * 0.25f;
+		const float SampleSolidAngle = 1.0f / (SampleCount * Pdf);
+		const float Lod = std::min(std::max(0.5f * log2f(SampleSolidAngle / TexelSolidAngle) + 1.0f, 0.0f), MaxLod);
+
+		FilterSample Sample = { 2.0f * CosTheta * SinTheta * cosf(Phi), 2.0f * CosTheta * SinTheta * sinf(Phi), Lz, Lod };
+		Mip.Samples.push_back(Sample);
+		Mip.TotalWeight += Lz;
+	}
+}
+
+static XMVECTOR SampleFace(const CubemapLevel& Level, uint32_t Face, float s, float t) {
+	const uint32_t Size = Level.Size;
+	const float MaxCoord = float(Size - 1);
+	const float u = std::min(std::max((s * 0.5f + 0.5f) * Size - 0.5f, 0.0f), MaxCoord);
+	const float v = std::min(std::max((t * 0.5f + 0.5f) * Size - 0.5f, 0.0f), MaxCoord);
+	const uint32_t x0 = uint32_t(u), y0 = uint32_t(v);
+	const uint32_t x1 = x0 + 1 < Size ? x0 + 1 : x0;
+	const uint32_t y1 = y0 + 1 < Size ? y0 + 1 : y0;
+
+	const XMFLOAT4* Texels = Level.Faces[Face].data();
+	const XMVECTOR Top = XMVectorLerp(XMLoadFloat4(&Texels[y0 * Size + x0]), XMLoadFloat4(&Texels[y0 * Size + x1]), u - x0);
+	const XMVECTOR Bottom = XMVectorLerp(XMLoadFloat4(&Texels[y1 * Size + x0]), XMLoadFloat4(&Texels[y1 * Size + x1]), u - x0);
+	return XMVectorLerp(Top, Bottom, v - y0);
+}
+
+// Trilinear lookup in the source chain. Bilinear filtering is clamped to the edges of each face.
+static XMVECTOR SampleCubemap(const std::vector<CubemapLevel>& Chain, float x, float y, float z, float Lod) {
+	float s, t;
+	const uint32_t Face = Math::GetCubemapFaceCoords(x, y, z, s, t);
+
+	const uint32_t Mip0 = uint32_t(Lod);
+	const float Blend = Lod - Mip0;
+	const XMVECTOR Color = SampleFace(Chain[Mip0], Face, s, t);
+	if (Blend == 0.0f || Mip0 + 1 >= Chain.size())
+		return Color;
+	return XMVectorLerp(Color, SampleFace(Chain[Mip0 + 1], Face, s, t), Blend);
+}
+
+// Filters a range of rows. Normals and tangent frames of 4 texels are built together in SoA form, and every sample
+// direction is rotated into world space for all 4 before the texel fetches.
+static void FilterRows(const std::vector<CubemapLevel>& Chain, FilterMip& Mip, uint32_t FaceIndex, uint32_t RowBegin, uint32_t RowEnd) {
+	const uint32_t Size = Mip.Output.Size;
+	const Math::CubemapFaceWalk Walk(FaceIndex, Size);
+	const XMVECTOR InvTotalWeight = XMVectorReplicate(1.0f / Mip.TotalWeight);
+	XMFLOAT4* Output = Mip.Output.Faces[FaceIndex].data();
+
+	for (uint32_t Row = RowBegin; Row < RowEnd; ++Row) {
+		const XMVECTOR t = Walk.GetRowT(Row);
+
+		for (uint32_t Column = 0; Column < Size; Column += 4) {
+			const uint32_t LaneCount = Size - Column < 4 ? Size - Column : 4;
+			XMVECTOR Nx, Ny, Nz;
+			Walk.GetDirections(Walk.GetColumnS(Column), t, Nx, Ny, Nz);
+			const XMVECTOR InvLength = XMVectorReciprocalSqrt(Nx * Nx + Ny * Ny + Nz * Nz);
+			Nx *= InvLength;
+			Ny *= InvLength;
+			Nz *= InvLength;
+
+			// Tangent = normalize(cross(up, N)), with up = +Z unless the normal is close to it, then +X.
+			const XMVECTOR UseZ = XMVectorLess(XMVectorAbs(Nz), XMVectorReplicate(0.999f));
+			XMVECTOR Tx = XMVectorSelect(XMVectorZero(), XMVectorNegate(Ny), UseZ);
+			XMVECTOR Ty = XMVectorSelect(XMVectorNegate(Nz), Nx, UseZ);
+			XMVECTOR Tz = XMVectorSelect(Ny, XMVectorZero(), UseZ);
+			const XMVECTOR InvTangentLength = XMVectorReciprocalSqrt(Tx * Tx + Ty * Ty + Tz * Tz);
+			Tx *= InvTangentLength;
+			Ty *= InvTangentLength;
+			Tz *= InvTangentLength;
+			const XMVECTOR Bx = Ny * Tz - Nz * Ty;
+			const XMVECTOR By = Nz * Tx - Nx * Tz;
+			const XMVECTOR Bz = Nx * Ty - Ny * Tx;
+
+			XMVECTOR Sum[4] = { XMVectorZero(), XMVectorZero(), XMVectorZero(), XMVectorZero() };
+			for (const FilterSample& Sample : Mip.Samples) {
+				const XMVECTOR Sx = XMVectorReplicate(Sample.x), Sy = XMVectorReplicate(Sample.y), Sz = XMVectorReplicate(Sample.z);
+				XMFLOAT4 Lx, Ly, Lz;
+				XMStoreFloat4(&Lx, Tx * Sx + Bx * Sy + Nx * Sz);
+				XMStoreFloat4(&Ly, Ty * Sx + By * Sy + Ny * Sz);
+				XMStoreFloat4(&Lz, Tz * Sx + Bz * Sy + Nz * Sz);
+
+				for (uint32_t l = 0; l < LaneCount; ++l) {
+					const XMVECTOR Color = SampleCubemap(Chain, (&Lx.x)[l], (&Ly.x)[l], (&Lz.x)[l], Sample.Lod);
+					Sum[l] = XMVectorMultiplyAdd(Color, Sz, Sum[l]);
+				}
+			}
+
+			for (uint32_t l = 0; l < LaneCount; ++l)
+				XMStoreFloat4(&Output[size_t(Row) * Size + Column + l], Sum[l] * InvTotalWeight);
+		}
+	}
+}
+
+static bool WriteOutput(const std::wstring& OutputFile, DXGI_FORMAT Format, const std::vector<FilterMip>& Mips) {
+	const uint32_t MipCount = (uint32_t)Mips.size();
+	const bool IsHalf = Format == DXGI_FORMAT_R16G16B16A16_FLOAT;
+	const size_t TexelBytes = IsHalf ? sizeof(HALF) * 4 : sizeof(XMFLOAT4);
+
+	DDSTextureData Texture;
+	Texture.format = Format;
+	Texture.width = Texture.height = Mips[0].Output.Size;
+	Texture.mipCount = MipCount;
+	Texture.arraySize = 6;
+	Texture.isCubeMap = true;
+	Texture.subresources.resize(6 * MipCount);
+
+	std::vector<std::vector<HALF>> HalfTexels(IsHalf ? 6 * MipCount : 0);
+	for (uint32_t Face = 0; Face < 6; ++Face) {
+		for (uint32_t m = 0; m < MipCount; ++m) {
+			const CubemapLevel& Level = Mips[m].Output;
+			const size_t TexelCount = size_t(Level.Size) * Level.Size;
+			D3D12_SUBRESOURCE_DATA& Subresource = Texture.subresources[Face * MipCount + m];
+			Subresource.pData = Level.Faces[Face].data();
+			Subresource.RowPitch = Level.Size * TexelBytes;
+			Subresource.SlicePitch = TexelCount * TexelBytes;
+
+			if (IsHalf) {
+				std::vector<HALF>& Packed = HalfTexels[Face * MipCount + m];
+				Packed.resize(TexelCount * 4);
+				XMConvertFloatToHalfStream(Packed.data(), sizeof(HALF), &Level.Faces[Face][0].x, sizeof(float), TexelCount * 4);
+				Subresource.pData = Packed.data();
+			}
+		}
+	}
+
+	return SUCCEEDED(SaveDDSTextureToFile(OutputFile.c_str(), Texture));
+}
+
+namespace CubemapFilter {
+
+bool PrefilterSpecular(const void* ddsData, size_t ddsDataSize, const std::wstring& outputFile, const SpecularPrefilterDesc& desc) {
+	DDSTextureData Source;
+	if (FAILED(LoadDDSTextureDataFromMemory((const uint8_t*)ddsData, ddsDataSize, &Source)))
+		return false;
+
+	// The source chain is rebuilt from the top mip so every level is a plain box filter of the radiance.
+	std::vector<CubemapLevel> Chain(1);
+	if (!LoadSourceLevel(Source, Chain[0]))
+		return false;
+	while (Chain.back().Size > 1) {
+		Chain.emplace_back();
+		DownsampleLevel(Chain[Chain.size() - 2], Chain.back());
+	}
+
+	const uint32_t SourceSize = Chain[0].Size;
+	const uint32_t OutputSize = desc.OutputSize ? desc.OutputSize : SourceSize;
+	uint32_t FullMipCount = 1;
+	while ((OutputSize >> FullMipCount) > 0)
+		++FullMipCount;
+	const uint32_t MipCount = desc.MipCount ? std::min(desc.MipCount, FullMipCount) : FullMipCount;
+
+	// Rougher mips have 4x fewer texels each step, so they can afford more samples.
+	std::vector<FilterMip> Mips(MipCount);
+	for (uint32_t m = 0; m < MipCount; ++m) {
+		FilterMip& Mip = Mips[m];
+		Mip.Roughness = MipCount > 1 ? float(m) / float(MipCount - 1) : 0.0f;
+		Mip.Output.Size = std::max(OutputSize >> m, 1u);
+		for (uint32_t Face = 0; Face < 6; ++Face)
+			Mip.Output.Faces[Face].resize(size_t(Mip.Output.Size) * Mip.Output.Size);
+
+		const uint32_t SampleCount = m == 0 ? 1 : std::min(desc.MaxSampleCount, desc.MinSampleCount << std::min(m - 1, 16u));
+		BuildSamples(Mip, std::max(SampleCount, 1u), SourceSize, (uint32_t)Chain.size());
+	}
+
+	// Faces of every mip are split into row ranges of similar cost. The most expensive items are queued first, and
+	// the scheduler steals whole items from busy workers.
+	std::vector<FilterWorkItem> WorkItems;
+	for (uint32_t m = 0; m < MipCount; ++m) {
+		const uint32_t Size = Mips[m].Output.Size;
+		const uint64_t RowCost = uint64_t(Size) * Mips[m].Samples.size();
+		const uint32_t RowsPerItem = (uint32_t)std::max<uint64_t>(1, std::min<uint64_t>(Size, kFilterWorkItemCost / std::max<uint64_t>(RowCost, 1)));
+		for (uint32_t Face = 0; Face < 6; ++Face) {
+			for (uint32_t Row = 0; Row < Size; Row += RowsPerItem) {
+				FilterWorkItem Item = { m, Face, Row, std::min(Row + RowsPerItem, Size), 0 };
+				Item.Cost = RowCost * (Item.RowEnd - Item.RowBegin);
+				WorkItems.push_back(Item);
+			}
+		}
+	}
+	std::sort(WorkItems.begin(), WorkItems.end(), [](const FilterWorkItem& a, const FilterWorkItem& b) { return a.Cost > b.Cost; });
+
+	Concurrency::parallel_for(size_t(0), WorkItems.size(), [&](size_t i) {
+		const FilterWorkItem& Item = WorkItems[i];
+		FilterRows(Chain, Mips[Item.Mip], Item.Face, Item.RowBegin, Item.RowEnd);
+	});
+
+	return WriteOutput(outputFile, Source.format, Mips);
+}
+
+bool PrefilterSpecularFromFile(const std::wstring& inputFile, const std::wstring& outputFile, const SpecularPrefilterDesc& desc) {
+	Core::ByteArray ba = Core::ReadFileSync(inputFile);
+	if (ba->size() == 0)
+		return false;
+	return PrefilterSpecular(ba->data(), ba->size(), outputFile, desc);
+}
+
+}	// namespace CubemapFilter
+
+}	// namespace Graphics
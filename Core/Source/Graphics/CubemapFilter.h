@@ -0,0 +1,31 @@
+//
+// CPU prefiltering of environment cubemaps for image based lighting.
+//
+
+#pragma once
+
+namespace Graphics {
+
+struct SpecularPrefilterDesc {
+	SpecularPrefilterDesc() : OutputSize(0), MipCount(0), MinSampleCount(32), MaxSampleCount(1024) {}
+
+	uint32_t OutputSize;		// face size of the top mip, 0 keeps the size of the source
+	uint32_t MipCount;			// 0 generates the full chain down to 1x1
+	uint32_t MinSampleCount;	// samples per texel for the first filtered mip, doubled for every following mip
+	uint32_t MaxSampleCount;
+};
+
+namespace CubemapFilter {
+
+// Generates a specular mip chain from a float RGBA cubemap (R32G32B32A32_FLOAT or R16G16B16A16_FLOAT) and writes it as a
+// DDS file in the same format. Mip m is convolved with the GGX lobe of roughness m / (MipCount - 1), using importance
+// sampling with samples read from a mip of the source chosen by their solid angle. Returns false when the source is
+// not a supported cubemap or the output cannot be written.
+bool PrefilterSpecular(const void* ddsData, size_t ddsDataSize, const std::wstring& outputFile,
+	const SpecularPrefilterDesc& desc = SpecularPrefilterDesc());
+bool PrefilterSpecularFromFile(const std::wstring& inputFile, const std::wstring& outputFile,
+	const SpecularPrefilterDesc& desc = SpecularPrefilterDesc());
+
+}	// namespace CubemapFilter
+
+}	// namespace Graphics
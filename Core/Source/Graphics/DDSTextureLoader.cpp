@@ -1180,3 +1180,199 @@ HRESULT CreateDDSTextureFromFile(
 
 	return hr;
 }
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT LoadDDSTextureDataFromMemory(
+	const uint8_t* ddsData,
+	size_t ddsDataSize,
+	DDSTextureData* textureData) {
+	if (!ddsData || !textureData) {
+		return E_INVALIDARG;
+	}
+
+	// Validate DDS file in memory
+	if (ddsDataSize < (sizeof(uint32_t) + sizeof(DirectX::DDS_HEADER))) {
+		return E_FAIL;
+	}
+
+	uint32_t dwMagicNumber = *(const uint32_t*)(ddsData);
+	if (dwMagicNumber != DirectX::DDS_MAGIC) {
+		return E_FAIL;
+	}
+
+	auto header = reinterpret_cast<const DirectX::DDS_HEADER*>(ddsData + sizeof(uint32_t));
+	if (header->size != sizeof(DirectX::DDS_HEADER) ||
+		header->ddspf.size != sizeof(DirectX::DDS_PIXELFORMAT)) {
+		return E_FAIL;
+	}
+
+	size_t offset = sizeof(DirectX::DDS_HEADER) + sizeof(uint32_t);
+
+	UINT arraySize = 1;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	bool isCubeMap = false;
+
+	if ((header->ddspf.flags & DDS_FOURCC) && (MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC)) {
+		offset += sizeof(DirectX::DDS_HEADER_DXT10);
+		if (ddsDataSize < offset) {
+			return E_FAIL;
+		}
+
+		auto d3d10ext = reinterpret_cast<const DirectX::DDS_HEADER_DXT10*>((const char*)header + sizeof(DirectX::DDS_HEADER));
+		if (d3d10ext->resourceDimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D) {
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+
+		arraySize = d3d10ext->arraySize;
+		if (arraySize == 0) {
+			return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+		}
+
+		if (d3d10ext->miscFlag & DirectX::DDS_RESOURCE_MISC_TEXTURECUBE) {
+			arraySize *= 6;
+			isCubeMap = true;
+		}
+
+		format = d3d10ext->dxgiFormat;
+	} else {
+		if (header->flags & DDS_HEADER_FLAGS_VOLUME) {
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+
+		format = GetDXGIFormat(header->ddspf);
+
+		if (header->caps2 & DDS_CUBEMAP) {
+			// We require all six faces to be defined
+			if ((header->caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES) {
+				return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+			}
+
+			arraySize = 6;
+			isCubeMap = true;
+		}
+	}
+
+	if (BitsPerPixel(format) == 0) {
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	size_t mipCount = header->mipMapCount;
+	if (0 == mipCount) {
+		mipCount = 1;
+	}
+
+	if (mipCount > D3D12_REQ_MIP_LEVELS ||
+		arraySize > D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION ||
+		header->width > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+		header->height > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION) {
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	textureData->format = format;
+	textureData->width = header->width;
+	textureData->height = header->height;
+	textureData->mipCount = static_cast<uint32_t>(mipCount);
+	textureData->arraySize = arraySize;
+	textureData->isCubeMap = isCubeMap;
+	textureData->subresources.resize(mipCount * arraySize);
+
+	size_t skipMip = 0;
+	size_t twidth = 0;
+	size_t theight = 0;
+	size_t tdepth = 0;
+	return FillInitData(header->width, header->height, 1, mipCount, arraySize, format, 0,
+		ddsDataSize - offset, ddsData + offset,
+		twidth, theight, tdepth, skipMip, textureData->subresources.data());
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT SaveDDSTextureToFile(
+	const wchar_t* fileName,
+	const DDSTextureData& textureData) {
+	if (!fileName || textureData.subresources.size() != size_t(textureData.mipCount) * textureData.arraySize) {
+		return E_INVALIDARG;
+	}
+
+	if (textureData.isCubeMap && (textureData.arraySize % 6) != 0) {
+		return E_INVALIDARG;
+	}
+
+	uint8_t fileHeader[sizeof(uint32_t) + sizeof(DirectX::DDS_HEADER) + sizeof(DirectX::DDS_HEADER_DXT10)] = {};
+	*reinterpret_cast<uint32_t*>(fileHeader) = DirectX::DDS_MAGIC;
+
+	size_t rowBytes = 0;
+	GetSurfaceInfo(textureData.width, textureData.height, textureData.format, nullptr, &rowBytes, nullptr);
+
+	auto header = reinterpret_cast<DirectX::DDS_HEADER*>(fileHeader + sizeof(uint32_t));
+	header->size = sizeof(DirectX::DDS_HEADER);
+	header->flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP | DDS_HEADER_FLAGS_PITCH;
+	header->height = textureData.height;
+	header->width = textureData.width;
+	header->pitchOrLinearSize = static_cast<uint32_t>(rowBytes);
+	header->mipMapCount = textureData.mipCount;
+	header->ddspf = DirectX::DDSPF_DX10;
+	header->caps = DDS_SURFACE_FLAGS_TEXTURE | DDS_SURFACE_FLAGS_MIPMAP;
+	if (textureData.isCubeMap) {
+		header->caps |= DDS_SURFACE_FLAGS_CUBEMAP;
+		header->caps2 = DDS_CUBEMAP_ALLFACES;
+	}
+
+	auto d3d10ext = reinterpret_cast<DirectX::DDS_HEADER_DXT10*>(fileHeader + sizeof(uint32_t) + sizeof(DirectX::DDS_HEADER));
+	d3d10ext->dxgiFormat = textureData.format;
+	d3d10ext->resourceDimension = DirectX::DDS_DIMENSION_TEXTURE2D;
+	d3d10ext->miscFlag = textureData.isCubeMap ? DirectX::DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+	d3d10ext->arraySize = textureData.isCubeMap ? textureData.arraySize / 6 : textureData.arraySize;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+	ScopedHandle hFile(safe_handle(CreateFile2(fileName,
+		GENERIC_WRITE,
+		0,
+		CREATE_ALWAYS,
+		nullptr)));
+#else
+	ScopedHandle hFile(safe_handle(CreateFileW(fileName,
+		GENERIC_WRITE,
+		0,
+		nullptr,
+		CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr)));
+#endif
+
+	if (!hFile) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	DWORD bytesWritten = 0;
+	if (!WriteFile(hFile.get(), fileHeader, sizeof(fileHeader), &bytesWritten, nullptr) || bytesWritten != sizeof(fileHeader)) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	size_t index = 0;
+	for (size_t j = 0; j < textureData.arraySize; j++) {
+		size_t w = textureData.width;
+		size_t h = textureData.height;
+		for (size_t i = 0; i < textureData.mipCount; i++) {
+			size_t numRows = 0;
+			GetSurfaceInfo(w, h, textureData.format, nullptr, &rowBytes, &numRows);
+
+			const D3D12_SUBRESOURCE_DATA& subresource = textureData.subresources[index++];
+			auto pSrcBits = reinterpret_cast<const uint8_t*>(subresource.pData);
+			for (size_t row = 0; row < numRows; row++) {
+				if (!WriteFile(hFile.get(), pSrcBits + row * subresource.RowPitch, static_cast<DWORD>(rowBytes), &bytesWritten, nullptr) ||
+					bytesWritten != rowBytes) {
+					return HRESULT_FROM_WIN32(GetLastError());
+				}
+			}
+
+			w = std::max<size_t>(1, w >> 1);
+			h = std::max<size_t>(1, h >> 1);
+		}
+	}
+
+	return S_OK;
+}
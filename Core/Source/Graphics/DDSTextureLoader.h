@@ -27,6 +27,8 @@
 #include <stdint.h>
 #pragma warning(pop)
 
+#include <vector>
+
 enum DDS_ALPHA_MODE {
 	DDS_ALPHA_MODE_UNKNOWN = 0,
 	DDS_ALPHA_MODE_STRAIGHT = 1,
@@ -54,4 +56,27 @@ HRESULT __cdecl CreateDDSTextureFromFile(_In_ ID3D12Device* d3dDevice,
 	_Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 );
 
-size_t BitsPerPixel(_In_ DXGI_FORMAT fmt);
\ No newline at end of file
+size_t BitsPerPixel(_In_ DXGI_FORMAT fmt);
+
+// CPU side view of the texel data of a 2D texture or cubemap in a DDS file. Subresources are ordered by array slice,
+// then mip level. Cubemaps store 6 slices per cube in D3D face order (+X, -X, +Y, -Y, +Z, -Z). When loaded, the
+// subresources point into the DDS data, which must outlive them.
+struct DDSTextureData {
+	DXGI_FORMAT format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipCount;
+	uint32_t arraySize;
+	bool isCubeMap;
+	std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+};
+
+HRESULT __cdecl LoadDDSTextureDataFromMemory(_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+	_In_ size_t ddsDataSize,
+	_Out_ DDSTextureData* textureData
+);
+
+// Writes the subresources with a DX10 extended header. Rows are written tightly packed.
+HRESULT __cdecl SaveDDSTextureToFile(_In_z_ const wchar_t* szFileName,
+	_In_ const DDSTextureData& textureData
+);
@@ -76,6 +76,7 @@ DescriptorHandle UserDescriptorHeap::Alloc(uint32_t Count) {
 	ASSERT(HasAvailableSpace(Count), "Descriptor Heap out of space.  Increase heap size.");
 	DescriptorHandle ret = m_NextFreeHandle;
 	m_NextFreeHandle += Count * m_DescriptorSize;
+	m_NumFreeDescriptors -= Count;
 	return ret;
 }
 
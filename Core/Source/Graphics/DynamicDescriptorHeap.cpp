@@ -6,6 +6,8 @@
 #include "DynamicDescriptorHeap.h"
 #include "CommandListManager.h"
 #include "CommandContext.h"
+#include "../Core/SystemTime.h"
+#include <algorithm>
 
 namespace Graphics {
 
@@ -22,6 +24,7 @@ std::mutex DynamicDescriptorHeap::sm_Mutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap::sm_DescriptorHeapPool[2];
 std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::sm_RetiredDescriptorHeaps[2];
 std::queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_AvailableDescriptorHeaps[2];
+PoolHighWaterMark DynamicDescriptorHeap::sm_HighWaterMark[2];
 
 DynamicDescriptorHeap::DynamicDescriptorHeap(CommandContext& OwningContext, D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
 	: m_OwningContext(OwningContext), m_DescriptorType(HeapType) {
@@ -55,10 +58,7 @@ D3D12_GPU_DESCRIPTOR_HANDLE DynamicDescriptorHeap::UploadDirect(D3D12_CPU_DESCRI
 ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType) {
 	std::lock_guard<std::mutex> LockGuard(sm_Mutex);
 	uint32_t idx = HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
-	while (!sm_RetiredDescriptorHeaps[idx].empty() && g_CommandManager.IsFenceComplete(sm_RetiredDescriptorHeaps[idx].front().first)) {
-		sm_AvailableDescriptorHeaps[idx].push(sm_RetiredDescriptorHeaps[idx].front().second);
-		sm_RetiredDescriptorHeaps[idx].pop();
-	}
+	ReclaimRetiredHeaps(idx);
 
 	if (!sm_AvailableDescriptorHeaps[idx].empty()) {
 		ID3D12DescriptorHeap* HeapPtr = sm_AvailableDescriptorHeaps[idx].front();
@@ -82,6 +82,48 @@ void DynamicDescriptorHeap::DiscardDescriptorHeaps(D3D12_DESCRIPTOR_HEAP_TYPE He
 	std::lock_guard<std::mutex> LockGuard(sm_Mutex);
 	for (auto iter = UsedHeaps.begin(); iter != UsedHeaps.end(); ++iter)
 		sm_RetiredDescriptorHeaps[idx].push(std::make_pair(FenceValue, *iter));
+
+	const int64_t Now = Core::SystemTime::GetCurrentTick();
+	if (sm_HighWaterMark[idx].IsSampleDue(Now))
+		TrimHeapPool(idx, Now);
+}
+
+void DynamicDescriptorHeap::ReclaimRetiredHeaps(uint32_t idx) {
+	while (!sm_RetiredDescriptorHeaps[idx].empty() && g_CommandManager.IsFenceComplete(sm_RetiredDescriptorHeaps[idx].front().first)) {
+		sm_AvailableDescriptorHeaps[idx].push(sm_RetiredDescriptorHeaps[idx].front().second);
+		sm_RetiredDescriptorHeaps[idx].pop();
+	}
+}
+
+void DynamicDescriptorHeap::TrimHeapPool(uint32_t idx, int64_t Now) {
+	ReclaimRetiredHeaps(idx);
+
+	const uint32_t Pooled = (uint32_t)sm_DescriptorHeapPool[idx].size();
+	const uint32_t Idle = (uint32_t)sm_AvailableDescriptorHeaps[idx].size();
+	uint32_t Release = sm_HighWaterMark[idx].Update(Now, Pooled - Idle, Pooled);
+	if (Release == 0)
+		return;
+
+	// Only heaps in the available queue are idle; dropping their ComPtr releases them.
+	std::vector<ID3D12DescriptorHeap*> Released;
+	Released.reserve(Release);
+	while (Release-- > 0 && !sm_AvailableDescriptorHeaps[idx].empty()) {
+		Released.push_back(sm_AvailableDescriptorHeaps[idx].front());
+		sm_AvailableDescriptorHeaps[idx].pop();
+	}
+	std::sort(Released.begin(), Released.end());
+
+	auto& Pool = sm_DescriptorHeapPool[idx];
+	Pool.erase(std::remove_if(Pool.begin(), Pool.end(), [&Released](const Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& Heap) {
+		return std::binary_search(Released.begin(), Released.end(), Heap.Get());
+	}), Pool.end());
+}
+
+void DynamicDescriptorHeap::PrintPoolHistory() {
+	const size_t ViewHeapSize = (size_t)g_Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV) * kNumDescriptorsPerHeap;
+	const size_t SamplerHeapSize = (size_t)g_Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER) * kNumDescriptorsPerHeap;
+	sm_HighWaterMark[0].PrintHistory("CBV/SRV/UAV descriptor heap", ViewHeapSize);
+	sm_HighWaterMark[1].PrintHistory("Sampler descriptor heap", SamplerHeapSize);
 }
 
 void DynamicDescriptorHeap::RetireCurrentHeap() {
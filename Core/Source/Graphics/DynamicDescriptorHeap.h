@@ -44,6 +44,7 @@
 
 #include "DescriptorHeap.h"
 #include "RootSignature.h"
+#include "PoolRetention.h"
 #include <vector>
 #include <queue>
 
@@ -62,9 +63,23 @@ public:
 	~DynamicDescriptorHeap();
 
 	static void DestroyAll() {
-		sm_DescriptorHeapPool[0].clear();
-		sm_DescriptorHeapPool[1].clear();
+		for (uint32_t i = 0; i < 2; ++i) {
+			sm_RetiredDescriptorHeaps[i] = std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>>();
+			sm_AvailableDescriptorHeaps[i] = std::queue<ID3D12DescriptorHeap*>();
+			sm_DescriptorHeapPool[i].clear();
+			sm_HighWaterMark[i].Reset();
+		}
+	}
+
+	// Idle shader-visible heaps above the decayed high-water mark of the heaps in use are released, sampled as heaps
+	// are discarded. Index 0 covers CBV/SRV/UAV heaps, 1 sampler heaps.
+	static void SetRetentionPolicy(D3D12_DESCRIPTOR_HEAP_TYPE HeapType, const PoolRetentionPolicy& Policy) {
+		sm_HighWaterMark[HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0].SetPolicy(Policy);
+	}
+	static void GetPoolHistory(D3D12_DESCRIPTOR_HEAP_TYPE HeapType, std::vector<PoolSizeSample>& History) {
+		sm_HighWaterMark[HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0].GetHistory(History);
 	}
+	static void PrintPoolHistory();
 
 	void CleanupUsedHeaps(uint64_t fenceValue);
 
@@ -104,10 +119,14 @@ private:
 	static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool[2];
 	static std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> sm_RetiredDescriptorHeaps[2];
 	static std::queue<ID3D12DescriptorHeap*> sm_AvailableDescriptorHeaps[2];
+	static PoolHighWaterMark sm_HighWaterMark[2];
 
 	// Static methods
 	static ID3D12DescriptorHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
 	static void DiscardDescriptorHeaps(D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValueForReset, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps);
+	// Both expect sm_Mutex to be held.
+	static void ReclaimRetiredHeaps(uint32_t idx);
+	static void TrimHeapPool(uint32_t idx, int64_t Now);
 
 	// Non-static members
 	CommandContext& m_OwningContext;
@@ -25,16 +25,8 @@ void GpuBuffer::Create(const std::wstring& name, uint32_t NumElements, uint32_t
 
 	D3D12_RESOURCE_DESC ResourceDesc = DescribeBuffer();
 
-	D3D12_HEAP_PROPERTIES HeapProps;
-	HeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-	HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	HeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	HeapProps.CreationNodeMask = 1;
-	HeapProps.VisibleNodeMask = 1;
-
-	ASSERT_SUCCEEDED(
-		g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE,
-			&ResourceDesc, m_UsageState, nullptr, MY_IID_PPV_ARGS(&m_pResource)));
+	ASSERT_SUCCEEDED(GpuHeapAllocator::CreateResource(D3D12_HEAP_TYPE_DEFAULT, ResourceDesc, m_UsageState, nullptr,
+		m_HeapAllocation, &m_pResource));
 
 	m_GpuVirtualAddress = m_pResource->GetGPUVirtualAddress();
 
@@ -0,0 +1,336 @@
+//
+// Places resources in large heaps shared by many of them.
+//
+
+#include "pch.h"
+#include "GpuHeapAllocator.h"
+#include "CommandListManager.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace Graphics {
+
+using namespace std;
+
+// Global ID3D12Device.
+extern ID3D12Device* g_Device;
+// Global command manager.
+extern CommandListManager g_CommandManager;
+
+namespace GpuHeapAllocator {
+
+// Default, upload and readback heaps, in the order of D3D12_HEAP_TYPE.
+static const uint32_t kNumHeapTypes = 3;
+
+struct PooledHeap {
+	Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+	TLSFAllocator Allocator;
+};
+
+// An allocation freed on the CPU, whose range command lists submitted before may still use. It goes back to its heap
+// once the last fence of every queue at the time of the free has passed.
+struct RetiredAllocation {
+	GpuHeapAllocation Allocation;
+	uint64_t FenceValues[3];
+};
+
+struct HeapPool {
+	HeapPool() : CommittedFallbacks(0) {}
+
+	mutex Mutex;
+	// Released heaps leave an empty slot, so the index in the allocations of the others stays valid.
+	vector<unique_ptr<PooledHeap>> Heaps;
+	// In the order they were freed, so their fence values only grow.
+	deque<RetiredAllocation> Retired;
+	uint64_t CommittedFallbacks;
+};
+
+static HeapPool s_Pools[kNumHeapTypes * (uint32_t)GpuHeapCategory::kNumCategories];
+static atomic<uint64_t> s_HeapSize(64ull << 20);
+
+static GpuHeapCategory GetCategory(const D3D12_RESOURCE_DESC& Desc) {
+	if (Desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		return GpuHeapCategory::kBuffers;
+	if (Desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		return GpuHeapCategory::kRenderTargets;
+	return GpuHeapCategory::kTextures;
+}
+
+static D3D12_HEAP_FLAGS GetHeapFlags(GpuHeapCategory Category) {
+	switch (Category) {
+	case GpuHeapCategory::kBuffers:
+		return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+	case GpuHeapCategory::kTextures:
+		return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+	default:
+		return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+	}
+}
+
+static D3D12_HEAP_PROPERTIES DescribeHeap(D3D12_HEAP_TYPE HeapType) {
+	D3D12_HEAP_PROPERTIES HeapProps;
+	HeapProps.Type = HeapType;
+	HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	HeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	HeapProps.CreationNodeMask = 1;
+	HeapProps.VisibleNodeMask = 1;
+	return HeapProps;
+}
+
+static PooledHeap* CreateHeap(D3D12_HEAP_TYPE HeapType, GpuHeapCategory Category) {
+	D3D12_HEAP_DESC HeapDesc;
+	HeapDesc.SizeInBytes = s_HeapSize;
+	HeapDesc.Properties = DescribeHeap(HeapType);
+	HeapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	HeapDesc.Flags = GetHeapFlags(Category);
+
+	ID3D12Heap* Heap;
+	if (FAILED(g_Device->CreateHeap(&HeapDesc, MY_IID_PPV_ARGS(&Heap))))
+		return nullptr;
+
+#ifndef RELEASE
+	Heap->SetName(L"GpuHeapAllocator Heap");
+#endif
+
+	PooledHeap* Pooled = new PooledHeap;
+	Pooled->Heap.Attach(Heap);
+
+	// Small textures can be placed at 4KB, everything else at 64KB.
+	Pooled->Allocator.Create(HeapDesc.SizeInBytes, Category == GpuHeapCategory::kTextures ?
+		D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+	return Pooled;
+}
+
+// Returns the range to its heap right away, and releases the heap once empty unless it is the last one of its pool.
+// The pool mutex must be held.
+static void ReleaseRange(HeapPool& Pool, const GpuHeapAllocation& Allocation) {
+	unique_ptr<PooledHeap>& Heap = Pool.Heaps[Allocation.HeapIndex];
+	Heap->Allocator.Free(Allocation.Block);
+
+	// The last heap of a pool stays even when empty, so a pool going back and forth around one resource doesn't thrash.
+	if (Heap->Allocator.IsEmpty()) {
+		uint32_t LiveHeaps = 0;
+		for (const auto& Other : Pool.Heaps)
+			LiveHeaps += Other != nullptr ? 1 : 0;
+		if (LiveHeaps > 1)
+			Heap.reset();
+	}
+}
+
+static bool AreFencesComplete(const RetiredAllocation& Retired) {
+	for (uint64_t FenceValue : Retired.FenceValues) {
+		if (!g_CommandManager.IsFenceComplete(FenceValue))
+			return false;
+	}
+	return true;
+}
+
+// Returns the retired ranges the GPU is done with. The pool mutex must be held.
+static void ReleaseCompletedRanges(HeapPool& Pool) {
+	while (!Pool.Retired.empty() && AreFencesComplete(Pool.Retired.front())) {
+		ReleaseRange(Pool, Pool.Retired.front().Allocation);
+		Pool.Retired.pop_front();
+	}
+}
+
+// Finds room in the heaps of the pool, adding a heap when none has enough.
+static bool AllocateFromPool(uint32_t PoolIndex, D3D12_HEAP_TYPE HeapType, GpuHeapCategory Category,
+	const D3D12_RESOURCE_ALLOCATION_INFO& Info, GpuHeapAllocation& Allocation) {
+	HeapPool& Pool = s_Pools[PoolIndex];
+	lock_guard<mutex> LockGuard(Pool.Mutex);
+	ReleaseCompletedRanges(Pool);
+
+	uint32_t FreeSlot = (uint32_t)Pool.Heaps.size();
+	for (uint32_t i = 0; i < (uint32_t)Pool.Heaps.size(); ++i) {
+		if (Pool.Heaps[i] == nullptr) {
+			FreeSlot = min(FreeSlot, i);
+			continue;
+		}
+
+		uint64_t Offset;
+		const uint32_t Block = Pool.Heaps[i]->Allocator.Allocate(Info.SizeInBytes, Info.Alignment, Offset);
+		if (Block != TLSFAllocator::kInvalidBlock) {
+			Allocation.Heap = Pool.Heaps[i]->Heap.Get();
+			Allocation.Offset = Offset;
+			Allocation.Pool = PoolIndex;
+			Allocation.HeapIndex = i;
+			Allocation.Block = Block;
+			return true;
+		}
+	}
+
+	PooledHeap* NewHeap = CreateHeap(HeapType, Category);
+	if (NewHeap == nullptr)
+		return false;
+
+	if (FreeSlot == Pool.Heaps.size())
+		Pool.Heaps.emplace_back(NewHeap);
+	else
+		Pool.Heaps[FreeSlot].reset(NewHeap);
+
+	uint64_t Offset;
+	const uint32_t Block = NewHeap->Allocator.Allocate(Info.SizeInBytes, Info.Alignment, Offset);
+	ASSERT(Block != TLSFAllocator::kInvalidBlock);
+
+	Allocation.Heap = NewHeap->Heap.Get();
+	Allocation.Offset = Offset;
+	Allocation.Pool = PoolIndex;
+	Allocation.HeapIndex = FreeSlot;
+	Allocation.Block = Block;
+	return true;
+}
+
+void SetHeapSize(uint64_t SizeInBytes) {
+	s_HeapSize = Math::AlignUp(SizeInBytes, (uint64_t)D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+}
+
+HRESULT CreateResource(D3D12_HEAP_TYPE HeapType, const D3D12_RESOURCE_DESC& Desc, D3D12_RESOURCE_STATES InitialState,
+	const D3D12_CLEAR_VALUE* ClearValue, GpuHeapAllocation& Allocation, ID3D12Resource** Resource) {
+	ASSERT(!Allocation.IsValid(), "Free the previous allocation of a resource before creating it again");
+
+	const GpuHeapCategory Category = GetCategory(Desc);
+	const bool KnownHeapType = HeapType >= D3D12_HEAP_TYPE_DEFAULT && HeapType <= D3D12_HEAP_TYPE_READBACK;
+	const uint32_t PoolIndex = KnownHeapType ?
+		((uint32_t)HeapType - D3D12_HEAP_TYPE_DEFAULT) * (uint32_t)GpuHeapCategory::kNumCategories + (uint32_t)Category : 0;
+
+	// Upload and readback heaps only hold buffers, and multisampled textures need heaps aligned to 4MB.
+	bool Placeable = KnownHeapType && (HeapType == D3D12_HEAP_TYPE_DEFAULT || Category == GpuHeapCategory::kBuffers) &&
+		Desc.SampleDesc.Count <= 1;
+
+	D3D12_RESOURCE_DESC PlacedDesc = Desc;
+	D3D12_RESOURCE_ALLOCATION_INFO Info = {};
+
+	if (Placeable) {
+		// The device answers with a 64KB alignment when the texture is too big for 4KB.
+		if (Category == GpuHeapCategory::kTextures)
+			PlacedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+
+		Info = g_Device->GetResourceAllocationInfo(0, 1, &PlacedDesc);
+		if (Info.Alignment != PlacedDesc.Alignment && PlacedDesc.Alignment != 0) {
+			PlacedDesc.Alignment = 0;
+			Info = g_Device->GetResourceAllocationInfo(0, 1, &PlacedDesc);
+		}
+
+		Placeable = Info.SizeInBytes != UINT64_MAX && Info.SizeInBytes <= s_HeapSize / 2;
+	}
+
+	if (Placeable && AllocateFromPool(PoolIndex, HeapType, Category, Info, Allocation)) {
+		HRESULT hr = g_Device->CreatePlacedResource(Allocation.Heap, Allocation.Offset, &PlacedDesc, InitialState,
+			ClearValue, MY_IID_PPV_ARGS(Resource));
+		if (SUCCEEDED(hr))
+			return hr;
+
+		// Nothing was ever placed there, so the range can go back at once.
+		HeapPool& Pool = s_Pools[PoolIndex];
+		{
+			lock_guard<mutex> LockGuard(Pool.Mutex);
+			ReleaseRange(Pool, Allocation);
+		}
+		Allocation = GpuHeapAllocation();
+	}
+
+	if (KnownHeapType) {
+		HeapPool& Pool = s_Pools[PoolIndex];
+		lock_guard<mutex> LockGuard(Pool.Mutex);
+		++Pool.CommittedFallbacks;
+	}
+
+	const D3D12_HEAP_PROPERTIES HeapProps = DescribeHeap(HeapType);
+	return g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE, &Desc, InitialState, ClearValue,
+		MY_IID_PPV_ARGS(Resource));
+}
+
+void Free(GpuHeapAllocation& Allocation) {
+	if (!Allocation.IsValid())
+		return;
+
+	HeapPool& Pool = s_Pools[Allocation.Pool];
+	lock_guard<mutex> LockGuard(Pool.Mutex);
+
+	// Allocations outliving DestroyAll, such as those of global buffers destroyed at exit, are just dropped.
+	if (Allocation.HeapIndex >= Pool.Heaps.size() || Pool.Heaps[Allocation.HeapIndex] == nullptr ||
+		Pool.Heaps[Allocation.HeapIndex]->Heap.Get() != Allocation.Heap) {
+		Allocation = GpuHeapAllocation();
+		return;
+	}
+
+	// Without command queues nothing can be in flight.
+	if (!g_CommandManager.GetGraphicsQueue().IsReady()) {
+		ReleaseRange(Pool, Allocation);
+		Allocation = GpuHeapAllocation();
+		return;
+	}
+
+	// A placed resource created next could land on these bytes while earlier command lists still use them.
+	RetiredAllocation Retired;
+	Retired.Allocation = Allocation;
+	Retired.FenceValues[0] = g_CommandManager.GetGraphicsQueue().GetNextFenceValue() - 1;
+	Retired.FenceValues[1] = g_CommandManager.GetComputeQueue().GetNextFenceValue() - 1;
+	Retired.FenceValues[2] = g_CommandManager.GetCopyQueue().GetNextFenceValue() - 1;
+	Pool.Retired.push_back(Retired);
+
+	ReleaseCompletedRanges(Pool);
+	Allocation = GpuHeapAllocation();
+}
+
+GpuHeapPoolStats GetStats(D3D12_HEAP_TYPE HeapType, GpuHeapCategory Category) {
+	ASSERT(HeapType >= D3D12_HEAP_TYPE_DEFAULT && HeapType <= D3D12_HEAP_TYPE_READBACK);
+	HeapPool& Pool = s_Pools[((uint32_t)HeapType - D3D12_HEAP_TYPE_DEFAULT) * (uint32_t)GpuHeapCategory::kNumCategories + (uint32_t)Category];
+	lock_guard<mutex> LockGuard(Pool.Mutex);
+	ReleaseCompletedRanges(Pool);
+
+	GpuHeapPoolStats Stats = {};
+	uint64_t FreeBytes = 0;
+	for (const auto& Heap : Pool.Heaps) {
+		if (Heap == nullptr)
+			continue;
+
+		const TLSFStats HeapStats = Heap->Allocator.GetStats();
+		++Stats.Heaps;
+		Stats.HeapBytes += HeapStats.Capacity;
+		Stats.UsedBytes += HeapStats.UsedBytes;
+		Stats.LargestFreeBlock = max(Stats.LargestFreeBlock, HeapStats.LargestFreeBlock);
+		Stats.Allocations += HeapStats.Allocations;
+		Stats.FreeBlocks += HeapStats.FreeBlocks;
+		FreeBytes += HeapStats.FreeBytes;
+	}
+
+	Stats.Fragmentation = FreeBytes == 0 ? 0.0f : 1.0f - (float)((double)Stats.LargestFreeBlock / FreeBytes);
+	Stats.RetiredAllocations = (uint32_t)Pool.Retired.size();
+	Stats.CommittedFallbacks = Pool.CommittedFallbacks;
+	return Stats;
+}
+
+void PrintStats() {
+	static const char* kHeapTypeNames[] = { "default", "upload", "readback" };
+	static const char* kCategoryNames[] = { "buffers", "textures", "render targets" };
+
+	for (uint32_t Type = 0; Type < kNumHeapTypes; ++Type) {
+		for (uint32_t Category = 0; Category < (uint32_t)GpuHeapCategory::kNumCategories; ++Category) {
+			const GpuHeapPoolStats Stats = GetStats((D3D12_HEAP_TYPE)(D3D12_HEAP_TYPE_DEFAULT + Type), (GpuHeapCategory)Category);
+			if (Stats.Heaps == 0 && Stats.CommittedFallbacks == 0)
+				continue;
+
+			Core::Printf("GPU heaps, %s %s: %u heaps, %.1f of %.1f MB used by %u resources\n", kHeapTypeNames[Type],
+				kCategoryNames[Category], Stats.Heaps, Stats.UsedBytes / 1048576.0, Stats.HeapBytes / 1048576.0, Stats.Allocations);
+			Core::Printf("  %u free blocks, largest %.1f MB, fragmentation %.2f, %u waiting on the GPU, %llu committed fallbacks\n",
+				Stats.FreeBlocks, Stats.LargestFreeBlock / 1048576.0, Stats.Fragmentation, Stats.RetiredAllocations,
+				Stats.CommittedFallbacks);
+		}
+	}
+}
+
+void DestroyAll() {
+	for (HeapPool& Pool : s_Pools) {
+		lock_guard<mutex> LockGuard(Pool.Mutex);
+		Pool.Retired.clear();
+		Pool.Heaps.clear();
+		Pool.CommittedFallbacks = 0;
+	}
+}
+
+}	// namespace GpuHeapAllocator
+
+}	// namespace Graphics
@@ -0,0 +1,70 @@
+//
+// Places resources in large heaps shared by many of them, instead of giving each one its own committed heap.
+//
+
+#pragma once
+
+#include "TLSFAllocator.h"
+
+namespace Graphics {
+
+// Heaps of resource tier 1 hardware can only hold one of these categories.
+enum class GpuHeapCategory {
+	kBuffers,
+	kTextures,			// textures that aren't render targets or depth stencils
+	kRenderTargets,		// render target and depth stencil textures
+	kNumCategories
+};
+
+// Where a placed resource lives. Resources that didn't fit a pool have no heap.
+struct GpuHeapAllocation {
+	GpuHeapAllocation() : Heap(nullptr), Offset(0), Pool(0), HeapIndex(0), Block(TLSFAllocator::kInvalidBlock) {}
+
+	bool IsValid() const { return Block != TLSFAllocator::kInvalidBlock; }
+
+	ID3D12Heap* Heap;
+	uint64_t Offset;
+	uint32_t Pool;
+	uint32_t HeapIndex;
+	uint32_t Block;
+};
+
+struct GpuHeapPoolStats {
+	uint32_t Heaps;
+	uint64_t HeapBytes;
+	uint64_t UsedBytes;
+	uint64_t LargestFreeBlock;		// in any one heap
+	uint32_t Allocations;			// including the retired ones
+	uint32_t RetiredAllocations;	// freed, waiting for the GPU to be done with them
+	uint32_t FreeBlocks;
+	float Fragmentation;			// 1 - LargestFreeBlock / free bytes, over all the heaps of the pool
+	uint64_t CommittedFallbacks;	// resources created committed because they didn't fit in a heap
+};
+
+// There is one pool per heap type and category, each a list of heaps carved by a TLSFAllocator. Buffers are placed at
+// 64KB, small textures at 4KB when the device allows it. Resources bigger than half a heap, multisampled textures and
+// categories a heap type can't hold get a committed resource as before.
+namespace GpuHeapAllocator {
+
+	// Size of the heaps created from then on. 64MB by default.
+	void SetHeapSize(uint64_t SizeInBytes);
+
+	// Creates a placed resource in the pool for HeapType and the kind of Desc, or a committed one when it doesn't fit.
+	// Allocation must be freed with Free once the resource is released, unless it isn't valid.
+	HRESULT CreateResource(D3D12_HEAP_TYPE HeapType, const D3D12_RESOURCE_DESC& Desc, D3D12_RESOURCE_STATES InitialState,
+		const D3D12_CLEAR_VALUE* ClearValue, GpuHeapAllocation& Allocation, ID3D12Resource** Resource);
+
+	// Returns the range to its heap once the commands submitted so far on every queue have completed, and releases the
+	// heap once empty unless it is the last one of its pool. The allocation is reset right away.
+	void Free(GpuHeapAllocation& Allocation);
+
+	GpuHeapPoolStats GetStats(D3D12_HEAP_TYPE HeapType, GpuHeapCategory Category);
+	void PrintStats();
+
+	// Releases every heap, including the ranges still waiting on fences, so the GPU must be idle. Resources placed in
+	// them must have been released, and freeing their allocations afterwards does nothing.
+	void DestroyAll();
+
+}	// namespace GpuHeapAllocator
+
+}	// namespace Graphics
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "pch.h"
+#include "GpuHeapAllocator.h"
 
 namespace Graphics
 {
@@ -30,10 +31,15 @@ namespace Graphics
 			m_TransitioningState((D3D12_RESOURCE_STATES)-1)
 		{}
 
+		// A copy would share the heap allocation and free it a second time on Destroy.
+		GpuResource(const GpuResource&) = delete;
+		GpuResource& operator=(const GpuResource&) = delete;
+
 		virtual void Destroy()
 		{
 			m_pResource = nullptr;
 			m_GpuVirtualAddress = D3D12_GPU_VIRTUAL_ADDRESS_NULL;
+			GpuHeapAllocator::Free(m_HeapAllocation);
 			if (m_UserAllocatedMemory != nullptr)
 			{
 				VirtualFree(m_UserAllocatedMemory, 0, MEM_RELEASE);
@@ -58,6 +64,9 @@ namespace Graphics
 		// When using VirtualAlloc() to allocate memory directly, record the allocation here so that it can be freed. 
 		// The GpuVirtualAddress may be offset from the true allocation start.
 		void* m_UserAllocatedMemory;
+
+		// Range of a shared heap holding the resource, when it was created through GpuHeapAllocator.
+		GpuHeapAllocation m_HeapAllocation;
 	};
 
 }	// namespace Graphics
\ No newline at end of file
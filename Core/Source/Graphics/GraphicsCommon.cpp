@@ -1,13 +1,23 @@
 //
-// Provide common sampler, rasterizer state, blend mode, depth state and command signature.
+// Provide common sampler, rasterizer state, blend mode, depth state, command signature and PSO.
 //
 
 #include "pch.h"
 #include "GraphicsCommon.h"
 #include "SamplerManager.h"
 #include "CommandSignature.h"
+#include "PipelineState.h"
+#include "PipelineCache.h"
+#include "PipelineWarmup.h"
 
 namespace Graphics {
+
+// Global ID3D12Device.
+extern ID3D12Device* g_Device;
+
+// Written next to the executable on shutdown, read back by the next launch.
+static const wchar_t* kPipelineCachePath = L"PipelineCache.bin";
+static const wchar_t* kPipelineWarmupPath = L"PipelineWarmup.bin";
 	
 SamplerDesc SamplerLinearWrapDesc;
 SamplerDesc SamplerAnisoWrapDesc;
@@ -53,8 +63,25 @@ D3D12_DEPTH_STENCIL_DESC DepthStateTestEqual;
 CommandSignature DispatchIndirectCommandSignature(1);
 CommandSignature DrawIndirectCommandSignature(1);
 
+D3D12_SHADER_BYTECODE GenerateMipsCS[8];
+
+RootSignature g_GenerateMipsRS;
+ComputePSO g_GenerateMipsPSO[8];
+
+static bool HasBytecode(const D3D12_SHADER_BYTECODE* Shaders, size_t Count) {
+	for (size_t i = 0; i < Count; ++i) {
+		if (Shaders[i].pShaderBytecode == nullptr || Shaders[i].BytecodeLength == 0)
+			return false;
+	}
+	return true;
+}
+
 void InitializeCommonState() {
 	
+	// Before anything below compiles a root signature or PSO, or registers one for warm-up.
+	PipelineCache::Load(kPipelineCachePath, PipelineCache::GetDeviceFingerprint(g_Device));
+	PipelineWarmup::Load(kPipelineWarmupPath);
+
 	//
 	// Create samplers
 	//
@@ -202,11 +229,41 @@ void InitializeCommonState() {
 	DrawIndirectCommandSignature[0].Draw();
 	DrawIndirectCommandSignature.Finalize();
 
+	//
+	// Create PSOs
+	//
+
+	g_GenerateMipsRS.Reset(3, 1);
+	g_GenerateMipsRS[0].InitAsConstants(0, 4);
+	g_GenerateMipsRS[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 1);
+	g_GenerateMipsRS[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 4);
+	g_GenerateMipsRS.InitStaticSampler(0, SamplerLinearClampDesc);
+	g_GenerateMipsRS.Finalize(L"Generate Mips");
+
+	// Compiled together on the worker pool rather than one after another, and waited for, so the first frame finds
+	// them ready. Common PSOs added later go into this batch too.
+	if (HasBytecode(GenerateMipsCS, _countof(GenerateMipsCS))) {
+		for (size_t i = 0; i < _countof(g_GenerateMipsPSO); ++i) {
+			g_GenerateMipsPSO[i].SetRootSignature(g_GenerateMipsRS);
+			g_GenerateMipsPSO[i].SetComputeShader(GenerateMipsCS[i]);
+		}
+		ComputePSO::FinalizeAll(g_GenerateMipsPSO, _countof(g_GenerateMipsPSO), true);
+	}
+
 	// ToDo: Initialize BitonicSort
 	//BitonicSort::Initialize();
 }
 
 void DestroyCommonState() {
+	const PipelineWarmupStats WarmupStats = PipelineWarmup::GetStats();
+	Core::Printf("PSO warm-up: %u of %u scheduled PSOs compiled ahead, %u first-use compilations avoided, %u PSOs recorded\n",
+		WarmupStats.WarmedPSOs, WarmupStats.ScheduledPSOs, WarmupStats.AvoidedCompiles, WarmupStats.RecordedPSOs);
+
+	// Stops the warm-up before the PSOs it compiles are destroyed.
+	PipelineWarmup::Save(kPipelineWarmupPath);
+	PipelineWarmup::Shutdown();
+	PipelineCache::Save(kPipelineCachePath);
+
 	DispatchIndirectCommandSignature.Destroy();
 	DrawIndirectCommandSignature.Destroy();
 
@@ -1,5 +1,5 @@
 //
-// Provide common sampler, rasterizer state, blend mode, depth state and command signature.
+// Provide common sampler, rasterizer state, blend mode, depth state, command signature and PSO.
 //
 
 #pragma once
@@ -60,6 +60,12 @@ extern D3D12_DEPTH_STENCIL_DESC DepthStateTestEqual;
 extern CommandSignature DispatchIndirectCommandSignature;
 extern CommandSignature DrawIndirectCommandSignature;
 
+// Compute shaders of the mip generation PSOs used by ColorBuffer::GenerateMipMaps, four linear then four gamma, one
+// per non power of two case. The engine has no shader build of its own, so the application sets these from its
+// compiled shaders before InitializeCommonState. The PSOs are only created when all of them are set.
+extern D3D12_SHADER_BYTECODE GenerateMipsCS[8];
+
+// Compiles every common PSO in one parallel batch and returns once all of them are ready.
 void InitializeCommonState();
 void DestroyCommonState();
 
@@ -4,6 +4,12 @@
 
 #include "pch.h"
 #include "GraphicsCore.h"
+#include "GraphicsCommon.h"
+#include "GpuHeapAllocator.h"
+#include "PipelineState.h"
+#include "PipelineWarmup.h"
+#include "SamplerManager.h"
+#include "TextureManager.h"
 
 namespace Graphics {
 	
@@ -20,4 +26,25 @@ DescriptorAllocator g_DescriptorAllocator[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES]
 	D3D12_DESCRIPTOR_HEAP_TYPE_DSV,
 };
 
+void BeginFrame() {
+	PipelineWarmup::BeginFrame();
+}
+
+void Shutdown() {
+	g_CommandManager.IdleGPU();
+
+	CommandContext::DestroyAllContexts();
+	g_CommandManager.Shutdown();
+
+	DestroyCommonState();
+	PSO::DestroyAll();
+	RootSignature::DestroyAll();
+	SamplerDesc::DestroyAll();
+	DescriptorAllocator::DestroyAll();
+	TextureManager::Shutdown();
+
+	// Last, once the resources placed in the heaps are gone. Those destroyed later only drop their allocation.
+	GpuHeapAllocator::DestroyAll();
+}
+
 }	// namespace Graphics
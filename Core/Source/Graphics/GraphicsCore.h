@@ -20,4 +20,11 @@ inline D3D12_CPU_DESCRIPTOR_HANDLE AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE
 	return g_DescriptorAllocator[Type].Allocate(Count);
 }
 
+// Call at the start of every frame, before recording any command list.
+void BeginFrame();
+
+// Waits for the GPU, then releases the command queues, the cached pipeline objects and descriptor heaps, the common
+// state and the shared resource heaps, in that order. Call before releasing g_Device.
+void Shutdown();
+
 }	// namespace Graphics.
\ No newline at end of file
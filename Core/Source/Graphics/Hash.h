@@ -5,51 +5,138 @@
 #pragma once
 
 #include "Math/Common.h"
+#include <cstring>
+#include <vector>
 
-// This requires SSE4.2 which is present on Intel Nehalem (Nov. 2008)
-// and AMD Bulldozer (Oct. 2011) processors. Old machines will not be supported.
-#ifdef _M_X64
-#define ENABLE_SSE_CRC32 1
-#else
-#define ENABLE_SSE_CRC32 0
-#endif
-
-#if ENABLE_SSE_CRC32
-#pragma intrinsic(_mm_crc32_u32)
-#pragma intrinsic(_mm_crc32_u64)
+#if defined(_M_X64)
+#pragma intrinsic(_umul128)
 #endif
 
 namespace Graphics
 {
-	inline size_t HashRange(const uint32_t* const Begin, const uint32_t* const End, size_t Hash)
+	// Multiplies to 128 bits and folds the halves, the mixing step of wyhash.
+	inline uint64_t HashMultiplyFold(uint64_t A, uint64_t B)
+	{
+#if defined(_M_X64)
+		uint64_t High;
+		const uint64_t Low = _umul128(A, B, &High);
+		return Low ^ High;
+#elif defined(__SIZEOF_INT128__)
+		const unsigned __int128 Product = (unsigned __int128)A * B;
+		return (uint64_t)Product ^ (uint64_t)(Product >> 64);
+#else
+		const uint64_t ALow = (uint32_t)A, AHigh = A >> 32, BLow = (uint32_t)B, BHigh = B >> 32;
+		const uint64_t LowLow = ALow * BLow, LowHigh = ALow * BHigh, HighLow = AHigh * BLow, HighHigh = AHigh * BHigh;
+		const uint64_t Middle = (LowLow >> 32) + (uint32_t)LowHigh + (uint32_t)HighLow;
+		const uint64_t Low = (Middle << 32) | (uint32_t)LowLow;
+		const uint64_t High = HighHigh + (LowHigh >> 32) + (HighLow >> 32) + (Middle >> 32);
+		return Low ^ High;
+#endif
+	}
+
+	inline uint64_t HashRead64(const uint32_t* Words)
 	{
-#if ENABLE_SSE_CRC32
-		const uint64_t* Iter64 = (const uint64_t*)Math::AlignUp(Begin, 8);
-		const uint64_t* const End64 = (const uint64_t* const)Math::AlignDown(End, 8);
+		uint64_t Value;
+		memcpy(&Value, Words, sizeof(Value));
+		return Value;
+	}
 
-		// If not 64-bit aligned, start with a single u32
-		if ((uint32_t*)Iter64 > Begin)
-			Hash = _mm_crc32_u32((uint32_t)Hash, *Begin);
+	// 64 bit wyhash style hash of whole words. Two independent lanes consume 32 bytes per iteration, so a state desc of
+	// a few hundred bytes is hashed in tens of cycles, and unlike the SSE4.2 CRC32 this replaces, all 64 bits of the
+	// result carry state.
+	inline uint64_t HashRange(const uint32_t* const Begin, const uint32_t* const End, uint64_t Hash)
+	{
+		static const uint64_t kSecret0 = 0xA0761D6478BD642Full;
+		static const uint64_t kSecret1 = 0xE7037ED1A0B428DBull;
+		static const uint64_t kSecret2 = 0x8EBC6AF09C88C6E3ull;
+		static const uint64_t kSecret3 = 0x589965CC75374CC3ull;
 
-		// Iterate over consecutive u64 values
-		while (Iter64 < End64)
-			Hash = _mm_crc32_u64((uint64_t)Hash, *Iter64++);
+		const uint32_t* Iter = Begin;
+		size_t WordCount = End - Begin;
+		Hash ^= HashMultiplyFold(Hash ^ kSecret0, kSecret1);
 
-		// If there is a 32-bit remainder, accumulate that
-		if ((uint32_t*)Iter64 < End)
-			Hash = _mm_crc32_u32((uint32_t)Hash, *(uint32_t*)Iter64);
-#else
-		// An inexpensive hash for CPUs lacking SSE4.2
-		for (const uint32_t* Iter = Begin; Iter < End; ++Iter)
-			Hash = 16777619U * Hash ^ *Iter;
-#endif
-		return Hash;
+		if (WordCount > 8)
+		{
+			uint64_t Lane = Hash;
+			do
+			{
+				Hash = HashMultiplyFold(HashRead64(Iter) ^ kSecret1, HashRead64(Iter + 2) ^ Hash);
+				Lane = HashMultiplyFold(HashRead64(Iter + 4) ^ kSecret2, HashRead64(Iter + 6) ^ Lane);
+				Iter += 8;
+				WordCount -= 8;
+			} while (WordCount > 8);
+			Hash ^= Lane;
+		}
+
+		while (WordCount > 4)
+		{
+			Hash = HashMultiplyFold(HashRead64(Iter) ^ kSecret1, HashRead64(Iter + 2) ^ Hash);
+			Iter += 4;
+			WordCount -= 4;
+		}
+
+		// The last 1 to 4 words, overlapping with the previous ones when there are fewer than 4 left.
+		uint64_t A = 0, B = 0;
+		if (WordCount >= 2)
+		{
+			A = HashRead64(Iter);
+			B = HashRead64(Iter + WordCount - 2);
+		}
+		else if (WordCount == 1)
+		{
+			A = *Iter;
+		}
+
+		const uint64_t ByteCount = (uint64_t)(End - Begin) * sizeof(uint32_t);
+		return HashMultiplyFold(kSecret3 ^ ByteCount, HashMultiplyFold(A ^ kSecret1, B ^ Hash));
 	}
 
-	template <typename T> size_t HashState(const T* StateDesc, size_t Count = 1, size_t Hash = 2166136261U)
+	template <typename T> uint64_t HashState(const T* StateDesc, size_t Count = 1, uint64_t Hash = 2166136261U)
 	{
 		static_assert((sizeof(T) & 3) == 0 && alignof(T) >= 4, "State object is not word-aligned");
 		return HashRange((uint32_t*)StateDesc, (uint32_t*)(StateDesc + Count), Hash);
 	}
 
+	// Hash of an unaligned byte range such as shader bytecode or a cached blob. The trailing bytes are packed into one
+	// more word, and the size is mixed in so ranges that differ only by trailing zeros don't collide.
+	inline uint64_t HashBytes(const void* Data, size_t Size, uint64_t Hash = 2166136261U)
+	{
+		const size_t WordCount = Size / sizeof(uint32_t);
+		uint32_t Tail[2] = { 0, (uint32_t)Size };
+		memcpy(Tail, (const uint8_t*)Data + WordCount * sizeof(uint32_t), Size & 3);
+
+		// HashRange reads through memcpy, so the words don't need to be aligned.
+		if (WordCount > 0)
+			Hash = HashRange((const uint32_t*)Data, (const uint32_t*)Data + WordCount, Hash);
+		return HashRange(Tail, Tail + 2, Hash);
+	}
+
+	// The full contents of a state description, hashed as it is appended. State caches key on it rather than on the
+	// hash alone, so two descriptions only match when every word is equal and a hash collision can never return the
+	// wrong object.
+	class StateKey
+	{
+	public:
+		StateKey() : m_Hash(2166136261U) {}
+
+		template <typename T> void Append(const T* StateDesc, size_t Count = 1)
+		{
+			m_Hash = HashState(StateDesc, Count, m_Hash);
+			m_Words.insert(m_Words.end(), (const uint32_t*)StateDesc, (const uint32_t*)(StateDesc + Count));
+		}
+
+		uint64_t GetHash() const { return m_Hash; }
+
+		bool operator==(const StateKey& rhs) const { return m_Hash == rhs.m_Hash && m_Words == rhs.m_Words; }
+
+	private:
+		uint64_t m_Hash;
+		std::vector<uint32_t> m_Words;
+	};
+
+	struct StateKeyHasher
+	{
+		size_t operator()(const StateKey& Key) const { return (size_t)Key.GetHash(); }
+	};
+
 }	// namespace Graphics
@@ -5,6 +5,8 @@
 #include "pch.h"
 #include "LinearAllocator.h"
 #include "CommandListManager.h"
+#include "../Core/SystemTime.h"
+#include <algorithm>
 #include <thread>
 
 namespace Graphics {
@@ -22,52 +24,425 @@ extern ID3D12Device* g_Device;
 //
 
 LinearAllocatorType LinearAllocatorPageManager::sm_AutoType = LinearAllocatorType::kGpuExclusive;
+float LinearAllocatorPageManager::sm_LargePageIdleSeconds = 5.0f;
+
+// Free pages a thread took from the global list, for each allocator type. Only the owning thread fills the slots, but
+// any thread may empty them, so the manager can take back the pages of a thread that went idle. They go back to the
+// global list when the thread exits.
+struct LinearAllocatorPageManager::ThreadPageCache {
+	ThreadPageCache() : Owner(nullptr), LastRequestTick(0) {
+		for (uint32_t i = 0; i < kRefillBatchSize; ++i)
+			Pages[i] = nullptr;
+	}
+
+	~ThreadPageCache() {
+		if (Owner != nullptr)
+			Owner->ReleaseThreadCache(*this);
+	}
+
+	LinearAllocationPage* Take() {
+		for (uint32_t i = kRefillBatchSize; i-- > 0; ) {
+			if (Pages[i].load(memory_order_relaxed) == nullptr)
+				continue;
+			LinearAllocationPage* Page = Pages[i].exchange(nullptr, memory_order_acquire);
+			if (Page != nullptr)
+				return Page;
+		}
+		return nullptr;
+	}
+
+	LinearAllocatorPageManager* Owner;
+	atomic<int64_t> LastRequestTick;
+	atomic<LinearAllocationPage*> Pages[kRefillBatchSize];
+};
 
-LinearAllocatorPageManager::LinearAllocatorPageManager() {
+thread_local LinearAllocatorPageManager::ThreadPageCache LinearAllocatorPageManager::sm_ThreadCaches[(int)LinearAllocatorType::kNumAllocatorTypes];
+
+LinearAllocatorPageManager::LinearAllocatorPageManager()
+	: m_LastTrimTick(0), m_FreePageCount(0),
+	m_PooledPages(0), m_ThreadCacheHits(0), m_BatchRefills(0), m_FlushedPages(0), m_ReclaimSkips(0), m_CreateLockWaits(0),
+	m_LargePageHits(0), m_LargePageMisses(0), m_LargePagesTrimmed(0), m_LargePoolBytes(0), m_TrimmedPages(0) {
 	m_AllocationType = sm_AutoType;
 	sm_AutoType = (LinearAllocatorType)((int)sm_AutoType + 1);
 	ASSERT(sm_AutoType <= LinearAllocatorType::kNumAllocatorTypes);
 }
 
+LinearAllocatorPageManager::ThreadPageCache& LinearAllocatorPageManager::GetThreadCache() {
+	ThreadPageCache& Cache = sm_ThreadCaches[(int)m_AllocationType];
+	if (Cache.Owner != this) {
+		lock_guard<mutex> Registry(m_ThreadCacheMutex);
+		Cache.Owner = this;
+		m_ThreadCaches.push_back(&Cache);
+	}
+	return Cache;
+}
+
+void LinearAllocatorPageManager::ReleaseThreadCache(ThreadPageCache& Cache) {
+	lock_guard<mutex> Registry(m_ThreadCacheMutex);
+	m_ThreadCaches.erase(remove(m_ThreadCaches.begin(), m_ThreadCaches.end(), &Cache), m_ThreadCaches.end());
+
+	for (uint32_t i = 0; i < kRefillBatchSize; ++i) {
+		LinearAllocationPage* Page = Cache.Pages[i].exchange(nullptr, memory_order_acquire);
+		if (Page != nullptr) {
+			m_FreePages.Push(Page);
+			m_FreePageCount.fetch_add(1, memory_order_relaxed);
+		}
+	}
+}
+
+void LinearAllocatorPageManager::FlushIdleThreadCaches(int64_t Now) {
+	// A thread that went a whole sample without a request is unlikely to need its pages soon.
+	const float MinIdleSeconds = m_HighWaterMark.GetPolicy().SampleSeconds;
+	LinearAllocationPage* Flushed = nullptr;
+	LinearAllocationPage* FlushedLast = nullptr;
+	uint32_t FlushedCount = 0;
+
+	lock_guard<mutex> Registry(m_ThreadCacheMutex);
+	for (ThreadPageCache* Cache : m_ThreadCaches) {
+		if (Core::SystemTime::TimeBetweenTicks(Cache->LastRequestTick.load(memory_order_relaxed), Now) < MinIdleSeconds)
+			continue;
+
+		for (uint32_t i = 0; i < kRefillBatchSize; ++i) {
+			LinearAllocationPage* Page = Cache->Pages[i].exchange(nullptr, memory_order_acquire);
+			if (Page == nullptr)
+				continue;
+			Page->m_NextPage = Flushed;
+			Flushed = Page;
+			if (FlushedLast == nullptr)
+				FlushedLast = Page;
+			++FlushedCount;
+		}
+	}
+
+	if (Flushed != nullptr) {
+		m_FreePages.Push(Flushed, FlushedLast);
+		m_FreePageCount.fetch_add(FlushedCount, memory_order_relaxed);
+		m_FlushedPages.fetch_add(FlushedCount, memory_order_relaxed);
+	}
+}
+
+// Called with an empty cache. Only takes the pages it keeps, so other threads refilling meanwhile still find the rest.
+bool LinearAllocatorPageManager::RefillThreadCache(ThreadPageCache& Cache) {
+	LinearAllocationPage* Pages[kRefillBatchSize];
+	const uint32_t Count = m_FreePages.Pop(Pages, kRefillBatchSize);
+	if (Count == 0)
+		return false;
+
+	m_FreePageCount.fetch_sub(Count, memory_order_relaxed);
+	for (uint32_t i = 0; i < Count; ++i)
+		Cache.Pages[i].store(Pages[i], memory_order_release);
+
+	m_BatchRefills.fetch_add(1, memory_order_relaxed);
+	return true;
+}
+
+// Returns false without polling when another thread already is.
+bool LinearAllocatorPageManager::ReclaimPages() {
+	unique_lock<mutex> Polling(m_ReclaimMutex, try_to_lock);
+	if (!Polling.owns_lock()) {
+		m_ReclaimSkips.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+
+	// Fence values of different queues don't order, so every page is checked rather than stopping at the first one
+	// still in flight.
+	LinearAllocationPage* Retired = m_RetiredPages.PopAll();
+	LinearAllocationPage* Pending = nullptr;
+	LinearAllocationPage* PendingLast = nullptr;
+	LinearAllocationPage* Free = nullptr;
+	LinearAllocationPage* FreeLast = nullptr;
+	uint32_t FreeCount = 0;
+
+	while (Retired != nullptr) {
+		LinearAllocationPage* Page = Retired;
+		Retired = Page->m_NextPage;
+
+		if (Graphics::g_CommandManager.IsFenceComplete(Page->m_FenceValue)) {
+			++FreeCount;
+			Page->m_NextPage = Free;
+			Free = Page;
+			if (FreeLast == nullptr)
+				FreeLast = Page;
+		} else {
+			Page->m_NextPage = Pending;
+			Pending = Page;
+			if (PendingLast == nullptr)
+				PendingLast = Page;
+		}
+	}
+
+	if (Free != nullptr) {
+		m_FreePages.Push(Free, FreeLast);
+		m_FreePageCount.fetch_add(FreeCount, memory_order_relaxed);
+	}
+	if (Pending != nullptr)
+		m_RetiredPages.Push(Pending, PendingLast);
+
+	const int64_t Now = Core::SystemTime::GetCurrentTick();
+	if (m_HighWaterMark.IsSampleDue(Now))
+		TrimPagePool(Now);
+
+	LinearAllocationPage* RetiredLarge = m_RetiredLargePages.PopAll();
+	Pending = nullptr;
+	PendingLast = nullptr;
+
+	while (RetiredLarge != nullptr) {
+		LinearAllocationPage* Page = RetiredLarge;
+		RetiredLarge = Page->m_NextPage;
+
+		if (!Graphics::g_CommandManager.IsFenceComplete(Page->m_FenceValue)) {
+			Page->m_NextPage = Pending;
+			Pending = Page;
+			if (PendingLast == nullptr)
+				PendingLast = Page;
+		} else if (Page->m_SizeClass == ~0u) {
+			DeleteLargePage(Page);
+		} else {
+			Page->m_IdleSinceTick = Now;
+			m_FreeLargePages[Page->m_SizeClass].Push(Page);
+		}
+	}
+
+	if (Pending != nullptr)
+		m_RetiredLargePages.Push(Pending, PendingLast);
+
+	// Idle pages are looked for a few times per idle period rather than on every pass.
+	if (Core::SystemTime::TimeBetweenTicks(m_LastTrimTick, Now) >= sm_LargePageIdleSeconds * 0.25f) {
+		m_LastTrimTick = Now;
+		TrimIdleLargePages(Now, sm_LargePageIdleSeconds);
+	}
+	return true;
+}
+
+void LinearAllocatorPageManager::TrimPagePool(int64_t Now) {
+	// Pages stranded in the caches of idle threads go back first, so they count as idle rather than holding the mark
+	// up forever. The caches of active threads count as in use, since their threads take them soon.
+	FlushIdleThreadCaches(Now);
+
+	const uint32_t Pooled = (uint32_t)m_PooledPages.load();
+	const uint32_t Idle = min(m_FreePageCount.load(), Pooled);
+	const uint32_t Release = m_HighWaterMark.Update(Now, Pooled - Idle, Pooled);
+	if (Release == 0)
+		return;
+
+	// Only the pages released leave the free list, so threads refilling meanwhile still find the others.
+	vector<LinearAllocationPage*> Released(Release);
+	Released.resize(m_FreePages.Pop(Released.data(), Release));
+	if (Released.empty())
+		return;
+
+	m_FreePageCount.fetch_sub((uint32_t)Released.size(), memory_order_relaxed);
+	sort(Released.begin(), Released.end());
+
+	lock_guard<mutex> LockGuard(m_PoolMutex);
+	auto Removed = remove_if(m_PagePool.begin(), m_PagePool.end(), [&Released](const unique_ptr<LinearAllocationPage>& Page) {
+		return binary_search(Released.begin(), Released.end(), Page.get());
+	});
+	m_PagePool.erase(Removed, m_PagePool.end());
+
+	m_PooledPages.fetch_sub(Released.size(), memory_order_relaxed);
+	m_TrimmedPages.fetch_add(Released.size(), memory_order_relaxed);
+}
+
+void LinearAllocatorPageManager::TrimIdleLargePages(int64_t Now, float MinIdleSeconds) {
+	for (uint32_t Class = 0; Class < kNumLargePageClasses; ++Class) {
+		// The pages kept stay in the list, so large allocations meanwhile still find them.
+		LinearAllocationPage* Idle = m_FreeLargePages[Class].RemoveIf([Now, MinIdleSeconds](const LinearAllocationPage* Page) {
+			return Core::SystemTime::TimeBetweenTicks(Page->m_IdleSinceTick, Now) >= MinIdleSeconds;
+		});
+
+		while (Idle != nullptr) {
+			LinearAllocationPage* Page = Idle;
+			Idle = Page->m_NextPage;
+			DeleteLargePage(Page);
+			m_LargePagesTrimmed.fetch_add(1, memory_order_relaxed);
+		}
+	}
+}
+
+void LinearAllocatorPageManager::TrimLargePages(float MinIdleSeconds) {
+	// Recycles the pages whose fence has passed first, so they count as idle from now.
+	ReclaimPages();
+
+	lock_guard<mutex> Polling(m_ReclaimMutex);
+	TrimIdleLargePages(Core::SystemTime::GetCurrentTick(), MinIdleSeconds);
+}
+
+void LinearAllocatorPageManager::DeleteLargePage(LinearAllocationPage* Page) {
+	m_LargePoolBytes.fetch_sub((*Page)->GetDesc().Width, memory_order_relaxed);
+	delete Page;
+}
+
+size_t LinearAllocatorPageManager::GetPageSize() const {
+	return (size_t)(m_AllocationType == LinearAllocatorType::kGpuExclusive ?
+		LinearAllocatorPageSize::kGpuAllocatorPageSize : LinearAllocatorPageSize::kCpuAllocatorPageSize);
+}
+
+uint32_t LinearAllocatorPageManager::GetLargePageClass(size_t SizeInBytes, size_t& ClassSize) const {
+	const size_t PageSize = GetPageSize();
+	ASSERT(SizeInBytes > PageSize);
+
+	// Sizes in (PageSize << Octave, PageSize << (Octave + 1)] split in four steps.
+	uint32_t Octave = 0;
+	while (Octave < kLargePageOctaves && (PageSize << (Octave + 1)) < SizeInBytes)
+		++Octave;
+
+	if (Octave == kLargePageOctaves) {
+		ClassSize = SizeInBytes;
+		return ~0u;
+	}
+
+	const size_t Base = PageSize << Octave;
+	const size_t Step = Base / 4;
+	const size_t Steps = (SizeInBytes - Base + Step - 1) / Step;
+	ClassSize = Base + Steps * Step;
+	return Octave * 4 + (uint32_t)Steps - 1;
+}
+
+LinearAllocationPage* LinearAllocatorPageManager::RequestLargePage(size_t SizeInBytes) {
+	size_t ClassSize;
+	const uint32_t Class = GetLargePageClass(SizeInBytes, ClassSize);
+
+	if (Class != ~0u) {
+		LinearAllocationPage* Page = m_FreeLargePages[Class].Pop();
+		if (Page == nullptr && !m_RetiredLargePages.IsEmpty()) {
+			ReclaimPages();
+			Page = m_FreeLargePages[Class].Pop();
+		}
+		if (Page != nullptr) {
+			m_LargePageHits.fetch_add(1, memory_order_relaxed);
+			return Page;
+		}
+	}
+
+	m_LargePageMisses.fetch_add(1, memory_order_relaxed);
+	m_LargePoolBytes.fetch_add(ClassSize, memory_order_relaxed);
+
+	LinearAllocationPage* Page = CreateNewPage(ClassSize);
+	Page->m_SizeClass = Class;
+	return Page;
+}
+
 LinearAllocationPage* LinearAllocatorPageManager::RequestPage() {
-	lock_guard<mutex> LockGuard(m_Mutex);
+	ThreadPageCache& Cache = GetThreadCache();
+	Cache.LastRequestTick.store(Core::SystemTime::GetCurrentTick(), memory_order_relaxed);
 
-	while (!m_RetiredPages.empty() && Graphics::g_CommandManager.IsFenceComplete(m_RetiredPages.front().first)) {
-		m_AvailablePages.push(m_RetiredPages.front().second);
-		m_RetiredPages.pop();
+	LinearAllocationPage* Page = Cache.Take();
+	if (Page != nullptr) {
+		m_ThreadCacheHits.fetch_add(1, memory_order_relaxed);
+		return Page;
 	}
 
-	LinearAllocationPage* PagePtr = nullptr;
+	if (!RefillThreadCache(Cache)) {
+		// The pages another thread is reclaiming are the ones this one is after, so wait for it and look at the free
+		// list once more rather than grow the pool.
+		if (!ReclaimPages()) {
+			lock_guard<mutex> Polled(m_ReclaimMutex);
+		}
+		RefillThreadCache(Cache);
+	}
 
-	if (!m_AvailablePages.empty()) {
-		PagePtr = m_AvailablePages.front();
-		m_AvailablePages.pop();
-	} else {
-		PagePtr = CreateNewPage();
-		m_PagePool.emplace_back(PagePtr);
+	Page = Cache.Take();
+	if (Page != nullptr)
+		return Page;
+
+	LinearAllocationPage* PagePtr = CreateNewPage();
+
+	unique_lock<mutex> LockGuard(m_PoolMutex, try_to_lock);
+	if (!LockGuard.owns_lock()) {
+		m_CreateLockWaits.fetch_add(1, memory_order_relaxed);
+		LockGuard.lock();
 	}
+	m_PagePool.emplace_back(PagePtr);
+	m_PooledPages.fetch_add(1, memory_order_relaxed);
 
 	return PagePtr;
 }
 
 void LinearAllocatorPageManager::DiscardPages(uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages) {
-	lock_guard<mutex> LockGuard(m_Mutex);
-	for (auto iter = UsedPages.begin(); iter != UsedPages.end(); ++iter)
-		m_RetiredPages.push(make_pair(FenceValue, *iter));
+	if (UsedPages.empty())
+		return;
+
+	for (size_t i = 0; i < UsedPages.size(); ++i) {
+		UsedPages[i]->m_FenceValue = FenceValue;
+		UsedPages[i]->m_NextPage = i + 1 < UsedPages.size() ? UsedPages[i + 1] : nullptr;
+	}
+	m_RetiredPages.Push(UsedPages.front(), UsedPages.back());
+
+	// Without this, a pool that never runs dry would never be sampled nor trimmed.
+	if (m_HighWaterMark.IsSampleDue(Core::SystemTime::GetCurrentTick()))
+		ReclaimPages();
 }
 
 void LinearAllocatorPageManager::FreeLargePages(uint64_t FenceValue, const vector<LinearAllocationPage*>& LargePages) {
-	lock_guard<mutex> LockGuard(m_Mutex);
+	if (!LargePages.empty()) {
+		for (size_t i = 0; i < LargePages.size(); ++i) {
+			// Pages with a size class stay mapped for their next use.
+			if (LargePages[i]->m_SizeClass == ~0u)
+				LargePages[i]->Unmap();
+			LargePages[i]->m_FenceValue = FenceValue;
+			LargePages[i]->m_NextPage = i + 1 < LargePages.size() ? LargePages[i + 1] : nullptr;
+		}
+		m_RetiredLargePages.Push(LargePages.front(), LargePages.back());
+	}
+
+	if (!m_RetiredLargePages.IsEmpty()) {
+		ReclaimPages();
+	} else if (m_LargePoolBytes.load(memory_order_relaxed) != 0 &&
+		Core::SystemTime::TimeBetweenTicks(m_LastTrimTick, Core::SystemTime::GetCurrentTick()) >= sm_LargePageIdleSeconds * 0.25f) {
+		ReclaimPages();
+	}
+}
+
+void LinearAllocatorPageManager::Destroy() {
+	lock_guard<mutex> LockGuard(m_PoolMutex);
 
-	while (!m_DeletionQueue.empty() && Graphics::g_CommandManager.IsFenceComplete(m_DeletionQueue.front().first)) {
-		delete m_DeletionQueue.front().second;
-		m_DeletionQueue.pop();
+	{
+		lock_guard<mutex> Registry(m_ThreadCacheMutex);
+		for (ThreadPageCache* Cache : m_ThreadCaches) {
+			for (uint32_t i = 0; i < kRefillBatchSize; ++i)
+				Cache->Pages[i] = nullptr;
+		}
 	}
 
-	for (auto iter = LargePages.begin(); iter != LargePages.end(); ++iter) {
-		(*iter)->Unmap();
-		m_DeletionQueue.push(make_pair(FenceValue, *iter));
+	m_FreePages.PopAll();
+	m_RetiredPages.PopAll();
+
+	for (uint32_t i = 0; i <= kNumLargePageClasses; ++i) {
+		LinearAllocationPage* Deleted = (i < kNumLargePageClasses ? m_FreeLargePages[i] : m_RetiredLargePages).PopAll();
+		while (Deleted != nullptr) {
+			LinearAllocationPage* Next = Deleted->m_NextPage;
+			DeleteLargePage(Deleted);
+			Deleted = Next;
+		}
+	}
+
+	m_PagePool.clear();
+	m_PooledPages = 0;
+	m_FreePageCount = 0;
+	m_HighWaterMark.Reset();
+}
+
+LinearAllocatorStats LinearAllocatorPageManager::GetStats() const {
+	LinearAllocatorStats Stats;
+	Stats.PooledPages = m_PooledPages.load();
+	Stats.ThreadCacheHits = m_ThreadCacheHits.load();
+	Stats.BatchRefills = m_BatchRefills.load();
+	Stats.CasRetries = m_FreePages.GetCasRetries() + m_RetiredPages.GetCasRetries() + m_RetiredLargePages.GetCasRetries();
+	Stats.PopLockWaits = m_FreePages.GetPopLockWaits() + m_RetiredPages.GetPopLockWaits() + m_RetiredLargePages.GetPopLockWaits();
+	for (const PageStack& FreeLargePages : m_FreeLargePages) {
+		Stats.CasRetries += FreeLargePages.GetCasRetries();
+		Stats.PopLockWaits += FreeLargePages.GetPopLockWaits();
 	}
+	Stats.FlushedPages = m_FlushedPages.load();
+	Stats.ReclaimSkips = m_ReclaimSkips.load();
+	Stats.CreateLockWaits = m_CreateLockWaits.load();
+	Stats.LargePageHits = m_LargePageHits.load();
+	Stats.LargePageMisses = m_LargePageMisses.load();
+	Stats.LargePagesTrimmed = m_LargePagesTrimmed.load();
+	Stats.LargePoolBytes = m_LargePoolBytes.load();
+	Stats.TrimmedPages = m_TrimmedPages.load();
+	return Stats;
 }
 
 LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage(size_t PageSize) {
@@ -133,12 +508,12 @@ void LinearAllocator::CleanupUsedPages(uint64_t FenceID) {
 }
 
 DynAlloc LinearAllocator::AllocateLargePage(size_t SizeInBytes) {
-	LinearAllocationPage* OneOff = sm_PageManager[(int)m_AllocationType].CreateNewPage(SizeInBytes);
-	m_LargePageList.push_back(OneOff);
+	LinearAllocationPage* LargePage = sm_PageManager[(int)m_AllocationType].RequestLargePage(SizeInBytes);
+	m_LargePageList.push_back(LargePage);
 
-	DynAlloc ret(*OneOff, 0, SizeInBytes);
-	ret.DataPtr = OneOff->m_CpuVirtualAddress;
-	ret.GpuAddress = OneOff->m_GpuVirtualAddress;
+	DynAlloc ret(*LargePage, 0, SizeInBytes);
+	ret.DataPtr = LargePage->m_CpuVirtualAddress;
+	ret.GpuAddress = LargePage->m_GpuVirtualAddress;
 
 	return ret;
 }
@@ -2,7 +2,8 @@
 // This is a dynamic graphics memory allocator for DX12. It's designed to work in concert with the CommandContext class
 // and to do so in a thread-safe manner. There may be many command contexts, each with its own linear allocators.
 // They act as windows into a global memory pool by reserving a context-local memory page.
-// Requesting a new page is done in a thread-safe manner by guarding accesses with a mutex lock.
+// Pages are requested from a small per-thread cache, refilled in batches from a global free list, so recording
+// threads don't serialize on a lock. Only creating a new page takes one.
 //
 // When a command context is finished, it will receive a fence ID that indicates when it's safe to reclaim used resources.
 // The CleanupUsedPages() method must be invoked at this time so that the used pages can be scheduled for reuse after 
@@ -12,8 +13,10 @@
 #pragma once
 
 #include "GpuResource.h"
+#include "ConcurrentStack.h"
+#include "PoolRetention.h"
 #include <vector>
-#include <queue>
+#include <atomic>
 #include <mutex>
 
 // Constant blocks must be multiples of 16 constants @ 16 bytes each
@@ -36,7 +39,8 @@ struct DynAlloc {
 // Single page for linear allocator.
 class LinearAllocationPage : public GpuResource {
 public:
-	LinearAllocationPage(ID3D12Resource* pResource, D3D12_RESOURCE_STATES Usage) : GpuResource() {
+	LinearAllocationPage(ID3D12Resource* pResource, D3D12_RESOURCE_STATES Usage)
+		: GpuResource(), m_NextPage(nullptr), m_FenceValue(0), m_SizeClass(~0u), m_IdleSinceTick(0) {
 		m_pResource.Attach(pResource);
 		m_UsageState = Usage;
 		m_GpuVirtualAddress = m_pResource->GetGPUVirtualAddress();
@@ -62,6 +66,14 @@ public:
 
 	void* m_CpuVirtualAddress;
 	D3D12_GPU_VIRTUAL_ADDRESS m_GpuVirtualAddress;
+
+	// Link and retirement fence while the page sits in one of the page manager lists.
+	LinearAllocationPage* m_NextPage;
+	uint64_t m_FenceValue;
+
+	// Large page size class, or ~0u for fixed size pages and large pages too big for any class.
+	uint32_t m_SizeClass;
+	int64_t m_IdleSinceTick;
 };
 
 enum class LinearAllocatorType {
@@ -76,30 +88,118 @@ enum class LinearAllocatorPageSize {
 	kCpuAllocatorPageSize = 0x200000	// 2MB
 };
 
-// Linear page resource management.
+struct LinearAllocatorStats {
+	uint64_t PooledPages;		// fixed size pages created, in use or not
+	uint64_t ThreadCacheHits;	// pages handed out from the requesting thread's cache
+	uint64_t BatchRefills;		// thread caches refilled from the global free list
+	uint64_t CasRetries;		// failed compare-exchanges on the global lists
+	uint64_t PopLockWaits;		// pops from a global list that waited for another one
+	uint64_t FlushedPages;		// pages taken back from the caches of idle threads
+	uint64_t ReclaimSkips;		// fence polls skipped because another thread was already polling
+	uint64_t CreateLockWaits;	// page creations that found the pool lock taken
+	uint64_t LargePageHits;		// large allocations served by a recycled page
+	uint64_t LargePageMisses;	// large allocations that created a page
+	uint64_t LargePagesTrimmed;	// recycled large pages released after sitting idle
+	uint64_t LargePoolBytes;	// bytes of large pages alive, in use or not
+	uint64_t TrimmedPages;		// fixed size pages released above the high-water mark
+};
+
+// Linear page resource management. Free and retired pages of all sizes are kept in intrusive stacks, see
+// ConcurrentStack, so a pop never hides the pages it doesn't take from other threads. Fences are polled by one thread
+// at a time; a thread finding another one polling waits for it before creating a page.
+// Pages stranded in the cache of a thread that stopped requesting them go back to the free list at the next sample.
+//
+// Fixed size pages beyond a decaying high-water mark of their use are released once their fence has passed, checked
+// every PoolRetentionPolicy::SampleSeconds.
+//
+// Large pages are rounded up to one of four size classes per power of two above the page size, so at most a quarter
+// is wasted, and recycled through a free list per class once their fence has passed. Recycled pages left unused for
+// sm_LargePageIdleSeconds are released.
 class LinearAllocatorPageManager {
 public:
+	// Pages moved from the global free list to a thread cache at once.
+	static const uint32_t kRefillBatchSize = 4;
+
+	// Large page classes cover sizes up to 4096 times the page size. Bigger ones are created for a single use.
+	static const uint32_t kLargePageOctaves = 12;
+	static const uint32_t kNumLargePageClasses = kLargePageOctaves * 4;
+
+	// Seconds a recycled large page may stay unused before it is released.
+	static float sm_LargePageIdleSeconds;
+
 	LinearAllocatorPageManager();
+	~LinearAllocatorPageManager() { Destroy(); }
+
 	LinearAllocationPage* RequestPage();
 	LinearAllocationPage* CreateNewPage(size_t PageSize = 0);
 
 	// Discarded pages will get recycled. This is for fixed size pages.
 	void DiscardPages(uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages);
 
-	// Freed pages will be destroyed once their fence has passed. This is for single-use, "large" pages.
+	// Large pages are at least SizeInBytes, which must exceed the page size.
+	LinearAllocationPage* RequestLargePage(size_t SizeInBytes);
+
+	// Freed large pages are recycled once their fence has passed, or destroyed when they have no size class.
 	void FreeLargePages(uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages);
 
-	void Destroy() { m_PagePool.clear(); }
+	// Releases recycled large pages unused for at least MinIdleSeconds, such as after a level load.
+	void TrimLargePages(float MinIdleSeconds);
+
+	// Must not race with other calls. Empties the thread caches too.
+	void Destroy();
+
+	LinearAllocatorStats GetStats() const;
+
+	void SetRetentionPolicy(const PoolRetentionPolicy& Policy) { m_HighWaterMark.SetPolicy(Policy); }
+	const PoolHighWaterMark& GetHighWaterMark() const { return m_HighWaterMark; }
+	size_t GetPageSize() const;
 
 private:
+	struct ThreadPageCache;
+	typedef ConcurrentStack<LinearAllocationPage, &LinearAllocationPage::m_NextPage> PageStack;
+
+	ThreadPageCache& GetThreadCache();
+	bool RefillThreadCache(ThreadPageCache& Cache);
+	void FlushIdleThreadCaches(int64_t Now);
+	void ReleaseThreadCache(ThreadPageCache& Cache);
+	bool ReclaimPages();
+	uint32_t GetLargePageClass(size_t SizeInBytes, size_t& ClassSize) const;
+	void TrimIdleLargePages(int64_t Now, float MinIdleSeconds);
+	void DeleteLargePage(LinearAllocationPage* Page);
+	void TrimPagePool(int64_t Now);
+
 	static LinearAllocatorType sm_AutoType;
+	static thread_local ThreadPageCache sm_ThreadCaches[(int)LinearAllocatorType::kNumAllocatorTypes];
 
 	LinearAllocatorType m_AllocationType;
+
+	PageStack m_FreePages;
+	PageStack m_RetiredPages;
+	PageStack m_RetiredLargePages;
+	PageStack m_FreeLargePages[kNumLargePageClasses];
+	std::atomic<int64_t> m_LastTrimTick;
+	std::mutex m_ReclaimMutex;
+
+	// Caches of the threads that requested pages, so idle ones can be flushed.
+	std::vector<ThreadPageCache*> m_ThreadCaches;
+	std::mutex m_ThreadCacheMutex;
+
 	std::vector<std::unique_ptr<LinearAllocationPage>> m_PagePool;
-	std::queue<std::pair<uint64_t, LinearAllocationPage*>> m_RetiredPages;
-	std::queue<std::pair<uint64_t, LinearAllocationPage*>> m_DeletionQueue;
-	std::queue<LinearAllocationPage*> m_AvailablePages;
-	std::mutex m_Mutex;
+	std::mutex m_PoolMutex;
+	std::atomic<uint32_t> m_FreePageCount;
+	PoolHighWaterMark m_HighWaterMark;
+
+	std::atomic<uint64_t> m_PooledPages;
+	std::atomic<uint64_t> m_ThreadCacheHits;
+	std::atomic<uint64_t> m_BatchRefills;
+	std::atomic<uint64_t> m_FlushedPages;
+	std::atomic<uint64_t> m_ReclaimSkips;
+	std::atomic<uint64_t> m_CreateLockWaits;
+	std::atomic<uint64_t> m_LargePageHits;
+	std::atomic<uint64_t> m_LargePageMisses;
+	std::atomic<uint64_t> m_LargePagesTrimmed;
+	std::atomic<uint64_t> m_LargePoolBytes;
+	std::atomic<uint64_t> m_TrimmedPages;
 };
 
 // Linear allocation for efficient memory management.
@@ -119,6 +219,29 @@ public:
 		sm_PageManager[1].Destroy();
 	}
 
+	static LinearAllocatorStats GetStats(LinearAllocatorType Type) {
+		return sm_PageManager[(int)Type].GetStats();
+	}
+
+	static void SetRetentionPolicy(LinearAllocatorType Type, const PoolRetentionPolicy& Policy) {
+		sm_PageManager[(int)Type].SetRetentionPolicy(Policy);
+	}
+
+	// Pool size over time, to tune the page sizes.
+	static void GetPoolHistory(LinearAllocatorType Type, std::vector<PoolSizeSample>& History) {
+		sm_PageManager[(int)Type].GetHighWaterMark().GetHistory(History);
+	}
+
+	static void PrintPoolHistory() {
+		sm_PageManager[0].GetHighWaterMark().PrintHistory("GPU linear allocator page", sm_PageManager[0].GetPageSize());
+		sm_PageManager[1].GetHighWaterMark().PrintHistory("CPU linear allocator page", sm_PageManager[1].GetPageSize());
+	}
+
+	static void TrimLargePages(float MinIdleSeconds = 0.0f) {
+		sm_PageManager[0].TrimLargePages(MinIdleSeconds);
+		sm_PageManager[1].TrimLargePages(MinIdleSeconds);
+	}
+
 private:
 	DynAlloc AllocateLargePage(size_t SizeInBytes);
 
@@ -0,0 +1,467 @@
+//
+// Persistent cache of serialized root signatures and compiled PSO blobs.
+//
+
+#include "pch.h"
+#include "PipelineCache.h"
+#include "Hash.h"
+#include "../Core/FileUtility.h"
+#include <dxgi1_4.h>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <ppl.h>
+
+namespace Graphics {
+
+// Global ID3D12Device.
+extern ID3D12Device* g_Device;
+
+using Microsoft::WRL::ComPtr;
+using namespace std;
+
+namespace PipelineCache {
+
+// "SPSC", bumped whenever the file layout or the key derivation changes.
+static const uint32_t kFileMagic = 0x43535053;
+static const uint32_t kFileVersion = 3;
+
+enum class EntryType : uint32_t {
+	kRootSignature,
+	kGraphicsPSO,
+	kComputePSO,
+};
+
+struct FileHeader {
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Fingerprint;
+	uint32_t EntryCount;
+	uint32_t Reserved;
+};
+
+// Followed by Size bytes of blob, padded to 8 bytes.
+struct EntryHeader {
+	uint64_t Key;
+	uint64_t Checksum;
+	uint32_t Size;
+	uint32_t Reserved;
+};
+
+typedef shared_ptr<const vector<uint8_t>> CachedBlob;
+
+class D3D12PipelineStateDevice : public PipelineStateDevice {
+public:
+	HRESULT CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PipelineState) override {
+		return g_Device->CreateGraphicsPipelineState(&Desc, MY_IID_PPV_ARGS(PipelineState));
+	}
+
+	HRESULT CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PipelineState) override {
+		return g_Device->CreateComputePipelineState(&Desc, MY_IID_PPV_ARGS(PipelineState));
+	}
+
+	HRESULT CreateRootSignature(const void* Blob, size_t BlobSize, ID3D12RootSignature** Signature) override {
+		return g_Device->CreateRootSignature(1, Blob, BlobSize, MY_IID_PPV_ARGS(Signature));
+	}
+};
+
+static D3D12PipelineStateDevice s_DefaultDevice;
+
+// Read by the PSO compiles on the worker pool.
+static atomic<PipelineStateDevice*> s_Device(&s_DefaultDevice);
+static atomic<bool> s_Enabled(false);
+
+static mutex s_BlobMutex;
+static unordered_map<uint64_t, CachedBlob> s_Blobs;
+static uint64_t s_Fingerprint = 0;
+
+static atomic<uint32_t> s_LoadedEntries(0);
+static atomic<uint32_t> s_DiscardedEntries(0);
+static atomic<uint32_t> s_Hits(0);
+static atomic<uint32_t> s_Misses(0);
+
+static uint64_t GetEntryKey(EntryType Type, uint64_t Hash) {
+	return HashState(&Type, 1, Hash);
+}
+
+static uint64_t HashShader(const D3D12_SHADER_BYTECODE& Shader, uint64_t Hash) {
+	return HashBytes(Shader.pShaderBytecode, Shader.BytecodeLength, Hash);
+}
+
+// Collects the members of a description one word each. Hashing the structs whole would take in their padding, which
+// holds whatever was on the stack when they were built, and pointers, which change from launch to launch.
+class KeyWords {
+public:
+	template <typename T> void Add(T Value) {
+		static_assert(sizeof(T) <= sizeof(uint32_t), "Add members of at most one word");
+		uint32_t Word = 0;
+		memcpy(&Word, &Value, sizeof(Value));
+		m_Words.push_back(Word);
+	}
+
+	void AddString(const char* String) {
+		// Gaps in a stream output declaration have no semantic.
+		const uint32_t Length = String != nullptr ? (uint32_t)strlen(String) : ~0u;
+		Add(Length);
+		for (uint32_t i = 0; String != nullptr && i < Length; ++i)
+			Add(String[i]);
+	}
+
+	uint64_t Hash(uint64_t Seed) const {
+		return m_Words.empty() ? Seed : HashRange(m_Words.data(), m_Words.data() + m_Words.size(), Seed);
+	}
+
+private:
+	vector<uint32_t> m_Words;
+};
+
+static void AddBlendState(KeyWords& Words, const D3D12_BLEND_DESC& Blend) {
+	Words.Add(Blend.AlphaToCoverageEnable);
+	Words.Add(Blend.IndependentBlendEnable);
+	for (const D3D12_RENDER_TARGET_BLEND_DESC& Target : Blend.RenderTarget) {
+		Words.Add(Target.BlendEnable);
+		Words.Add(Target.LogicOpEnable);
+		Words.Add(Target.SrcBlend);
+		Words.Add(Target.DestBlend);
+		Words.Add(Target.BlendOp);
+		Words.Add(Target.SrcBlendAlpha);
+		Words.Add(Target.DestBlendAlpha);
+		Words.Add(Target.BlendOpAlpha);
+		Words.Add(Target.LogicOp);
+		Words.Add(Target.RenderTargetWriteMask);
+	}
+}
+
+static void AddRasterizerState(KeyWords& Words, const D3D12_RASTERIZER_DESC& Rasterizer) {
+	Words.Add(Rasterizer.FillMode);
+	Words.Add(Rasterizer.CullMode);
+	Words.Add(Rasterizer.FrontCounterClockwise);
+	Words.Add(Rasterizer.DepthBias);
+	Words.Add(Rasterizer.DepthBiasClamp);
+	Words.Add(Rasterizer.SlopeScaledDepthBias);
+	Words.Add(Rasterizer.DepthClipEnable);
+	Words.Add(Rasterizer.MultisampleEnable);
+	Words.Add(Rasterizer.AntialiasedLineEnable);
+	Words.Add(Rasterizer.ForcedSampleCount);
+	Words.Add(Rasterizer.ConservativeRaster);
+}
+
+static void AddStencilOps(KeyWords& Words, const D3D12_DEPTH_STENCILOP_DESC& Ops) {
+	Words.Add(Ops.StencilFailOp);
+	Words.Add(Ops.StencilDepthFailOp);
+	Words.Add(Ops.StencilPassOp);
+	Words.Add(Ops.StencilFunc);
+}
+
+static void AddDepthStencilState(KeyWords& Words, const D3D12_DEPTH_STENCIL_DESC& DepthStencil) {
+	Words.Add(DepthStencil.DepthEnable);
+	Words.Add(DepthStencil.DepthWriteMask);
+	Words.Add(DepthStencil.DepthFunc);
+	Words.Add(DepthStencil.StencilEnable);
+	Words.Add(DepthStencil.StencilReadMask);
+	Words.Add(DepthStencil.StencilWriteMask);
+	AddStencilOps(Words, DepthStencil.FrontFace);
+	AddStencilOps(Words, DepthStencil.BackFace);
+}
+
+static void AddInputLayout(KeyWords& Words, const D3D12_INPUT_LAYOUT_DESC& InputLayout) {
+	Words.Add(InputLayout.NumElements);
+	for (UINT i = 0; i < InputLayout.NumElements; ++i) {
+		const D3D12_INPUT_ELEMENT_DESC& Element = InputLayout.pInputElementDescs[i];
+		Words.AddString(Element.SemanticName);
+		Words.Add(Element.SemanticIndex);
+		Words.Add(Element.Format);
+		Words.Add(Element.InputSlot);
+		Words.Add(Element.AlignedByteOffset);
+		Words.Add(Element.InputSlotClass);
+		Words.Add(Element.InstanceDataStepRate);
+	}
+}
+
+static void AddStreamOutput(KeyWords& Words, const D3D12_STREAM_OUTPUT_DESC& StreamOutput) {
+	Words.Add(StreamOutput.NumEntries);
+	for (UINT i = 0; i < StreamOutput.NumEntries; ++i) {
+		const D3D12_SO_DECLARATION_ENTRY& Entry = StreamOutput.pSODeclaration[i];
+		Words.Add(Entry.Stream);
+		Words.AddString(Entry.SemanticName);
+		Words.Add(Entry.SemanticIndex);
+		Words.Add(Entry.StartComponent);
+		Words.Add(Entry.ComponentCount);
+		Words.Add(Entry.OutputSlot);
+	}
+	Words.Add(StreamOutput.NumStrides);
+	for (UINT i = 0; i < StreamOutput.NumStrides; ++i)
+		Words.Add(StreamOutput.pBufferStrides[i]);
+	Words.Add(StreamOutput.RasterizedStream);
+}
+
+// Every member but the root signature, which RootSignatureHash stands for, and the cached blob.
+uint64_t GetGraphicsPipelineKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureHash) {
+	KeyWords Words;
+	AddStreamOutput(Words, Desc.StreamOutput);
+	AddBlendState(Words, Desc.BlendState);
+	Words.Add(Desc.SampleMask);
+	AddRasterizerState(Words, Desc.RasterizerState);
+	AddDepthStencilState(Words, Desc.DepthStencilState);
+	AddInputLayout(Words, Desc.InputLayout);
+	Words.Add(Desc.IBStripCutValue);
+	Words.Add(Desc.PrimitiveTopologyType);
+	Words.Add(Desc.NumRenderTargets);
+	for (DXGI_FORMAT Format : Desc.RTVFormats)
+		Words.Add(Format);
+	Words.Add(Desc.DSVFormat);
+	Words.Add(Desc.SampleDesc.Count);
+	Words.Add(Desc.SampleDesc.Quality);
+	Words.Add(Desc.NodeMask);
+	Words.Add(Desc.Flags);
+
+	uint64_t Hash = Words.Hash(RootSignatureHash);
+	Hash = HashShader(Desc.VS, Hash);
+	Hash = HashShader(Desc.PS, Hash);
+	Hash = HashShader(Desc.DS, Hash);
+	Hash = HashShader(Desc.HS, Hash);
+	Hash = HashShader(Desc.GS, Hash);
+	return GetEntryKey(EntryType::kGraphicsPSO, Hash);
+}
+
+uint64_t GetComputePipelineKey(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureHash) {
+	KeyWords Words;
+	Words.Add(Desc.NodeMask);
+	Words.Add(Desc.Flags);
+
+	uint64_t Hash = Words.Hash(RootSignatureHash);
+	Hash = HashShader(Desc.CS, Hash);
+	return GetEntryKey(EntryType::kComputePSO, Hash);
+}
+
+static CachedBlob FindBlob(uint64_t Key) {
+	lock_guard<mutex> CS(s_BlobMutex);
+	auto iter = s_Blobs.find(Key);
+	return iter != s_Blobs.end() ? iter->second : nullptr;
+}
+
+static void DiscardBlob(uint64_t Key) {
+	lock_guard<mutex> CS(s_BlobMutex);
+	s_Blobs.erase(Key);
+	++s_DiscardedEntries;
+}
+
+static void StoreBlob(uint64_t Key, const void* Data, size_t Size) {
+	CachedBlob Blob = make_shared<const vector<uint8_t>>((const uint8_t*)Data, (const uint8_t*)Data + Size);
+	lock_guard<mutex> CS(s_BlobMutex);
+	s_Blobs[Key] = Blob;
+}
+
+static void StorePipelineBlob(uint64_t Key, ID3D12PipelineState* PipelineState) {
+	ComPtr<ID3DBlob> Blob;
+	if (SUCCEEDED(PipelineState->GetCachedBlob(Blob.GetAddressOf())))
+		StoreBlob(Key, Blob->GetBufferPointer(), Blob->GetBufferSize());
+}
+
+uint64_t GetDeviceFingerprint(ID3D12Device* Device) {
+	struct Fingerprint {
+		uint32_t FileVersion;
+		UINT VendorId;
+		UINT DeviceId;
+		UINT SubSysId;
+		UINT Revision;
+		uint32_t Padding;
+		LARGE_INTEGER DriverVersion;
+	} Identity = {};
+	Identity.FileVersion = kFileVersion;
+
+	ComPtr<IDXGIFactory4> Factory;
+	ComPtr<IDXGIAdapter> Adapter;
+	DXGI_ADAPTER_DESC AdapterDesc;
+	if (SUCCEEDED(CreateDXGIFactory1(MY_IID_PPV_ARGS(&Factory))) &&
+		SUCCEEDED(Factory->EnumAdapterByLuid(Device->GetAdapterLuid(), MY_IID_PPV_ARGS(&Adapter))) &&
+		SUCCEEDED(Adapter->GetDesc(&AdapterDesc))) {
+		Identity.VendorId = AdapterDesc.VendorId;
+		Identity.DeviceId = AdapterDesc.DeviceId;
+		Identity.SubSysId = AdapterDesc.SubSysId;
+		Identity.Revision = AdapterDesc.Revision;
+		Adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &Identity.DriverVersion);
+	}
+	return HashState(&Identity);
+}
+
+void Load(const wstring& FilePath, uint64_t Fingerprint) {
+	Clear();
+	s_Fingerprint = Fingerprint;
+	s_Enabled = true;
+
+	Core::ByteArray File = Core::ReadFileSync(FilePath);
+	const uint8_t* const Begin = (const uint8_t*)File->data();
+	const uint8_t* const End = Begin + File->size();
+	if (File->size() < sizeof(FileHeader))
+		return;
+
+	const FileHeader& Header = *(const FileHeader*)Begin;
+	if (Header.Magic != kFileMagic || Header.Version != kFileVersion || Header.Fingerprint != Fingerprint) {
+		s_DiscardedEntries = Header.EntryCount;
+		return;
+	}
+
+	// Walk the entry table, stopping at the first entry that runs past the end of the file. The count comes from the
+	// file, so it is capped by the number of entry headers that fit before reserving.
+	vector<const EntryHeader*> Entries;
+	Entries.reserve(min<size_t>(Header.EntryCount, (File->size() - sizeof(FileHeader)) / sizeof(EntryHeader)));
+	const uint8_t* Iter = Begin + sizeof(FileHeader);
+	for (uint32_t i = 0; i < Header.EntryCount; ++i) {
+		const EntryHeader* Entry = (const EntryHeader*)Iter;
+		if (End - Iter < (ptrdiff_t)sizeof(EntryHeader) || End - Iter - sizeof(EntryHeader) < Entry->Size)
+			break;
+		Entries.push_back(Entry);
+		Iter += sizeof(EntryHeader) + Math::AlignUp(Entry->Size, 8);
+	}
+
+	vector<uint8_t> Valid(Entries.size());
+	Concurrency::parallel_for(size_t(0), Entries.size(), [&](size_t i) {
+		const EntryHeader& Entry = *Entries[i];
+		Valid[i] = HashBytes(&Entry + 1, Entry.Size, Entry.Key) == Entry.Checksum;
+	});
+
+	lock_guard<mutex> CS(s_BlobMutex);
+	for (size_t i = 0; i < Entries.size(); ++i) {
+		if (!Valid[i])
+			continue;
+		const uint8_t* Data = (const uint8_t*)(Entries[i] + 1);
+		s_Blobs[Entries[i]->Key] = make_shared<const vector<uint8_t>>(Data, Data + Entries[i]->Size);
+		++s_LoadedEntries;
+	}
+	s_DiscardedEntries = Header.EntryCount - s_LoadedEntries;
+}
+
+bool Save(const wstring& FilePath) {
+	if (!s_Enabled)
+		return false;
+
+	ofstream File(FilePath, ios::out | ios::binary | ios::trunc);
+	if (!File)
+		return false;
+
+	lock_guard<mutex> CS(s_BlobMutex);
+
+	FileHeader Header = {};
+	Header.Magic = kFileMagic;
+	Header.Version = kFileVersion;
+	Header.Fingerprint = s_Fingerprint;
+	Header.EntryCount = (uint32_t)s_Blobs.size();
+	File.write((const char*)&Header, sizeof(Header));
+
+	static const uint8_t kPadding[8] = {};
+	for (const auto& Blob : s_Blobs) {
+		EntryHeader Entry = {};
+		Entry.Key = Blob.first;
+		Entry.Size = (uint32_t)Blob.second->size();
+		Entry.Checksum = HashBytes(Blob.second->data(), Entry.Size, Entry.Key);
+		File.write((const char*)&Entry, sizeof(Entry));
+		File.write((const char*)Blob.second->data(), Entry.Size);
+		File.write((const char*)kPadding, Math::AlignUp(Entry.Size, 8) - Entry.Size);
+	}
+	return File.good();
+}
+
+void Clear() {
+	lock_guard<mutex> CS(s_BlobMutex);
+	s_Blobs.clear();
+	s_Enabled = false;
+	s_LoadedEntries = s_DiscardedEntries = s_Hits = s_Misses = 0;
+}
+
+void SetDevice(PipelineStateDevice* Device) {
+	s_Device = Device != nullptr ? Device : &s_DefaultDevice;
+}
+
+PipelineCacheStats GetStats() {
+	PipelineCacheStats Stats;
+	Stats.LoadedEntries = s_LoadedEntries;
+	Stats.DiscardedEntries = s_DiscardedEntries;
+	Stats.Hits = s_Hits;
+	Stats.Misses = s_Misses;
+	return Stats;
+}
+
+ID3D12RootSignature* CreateRootSignature(const D3D12_ROOT_SIGNATURE_DESC& Desc, uint64_t DescHash) {
+	ID3D12RootSignature* Signature = nullptr;
+	const uint64_t Key = GetEntryKey(EntryType::kRootSignature, DescHash);
+
+	if (s_Enabled) {
+		CachedBlob Blob = FindBlob(Key);
+		if (Blob != nullptr) {
+			if (SUCCEEDED(s_Device.load()->CreateRootSignature(Blob->data(), Blob->size(), &Signature))) {
+				++s_Hits;
+				return Signature;
+			}
+			DiscardBlob(Key);
+		}
+		++s_Misses;
+	}
+
+	ComPtr<ID3DBlob> pOutBlob, pErrorBlob;
+	ASSERT_SUCCEEDED(D3D12SerializeRootSignature(&Desc, D3D_ROOT_SIGNATURE_VERSION_1,
+		pOutBlob.GetAddressOf(), pErrorBlob.GetAddressOf()));
+
+	ASSERT_SUCCEEDED(s_Device.load()->CreateRootSignature(pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), &Signature));
+
+	if (s_Enabled)
+		StoreBlob(Key, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize());
+	return Signature;
+}
+
+ID3D12PipelineState* CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureHash) {
+	ID3D12PipelineState* PipelineState = nullptr;
+	if (!s_Enabled) {
+		ASSERT_SUCCEEDED(s_Device.load()->CreateGraphicsPipelineState(Desc, &PipelineState));
+		return PipelineState;
+	}
+
+	const uint64_t Key = GetGraphicsPipelineKey(Desc, RootSignatureHash);
+	CachedBlob Blob = FindBlob(Key);
+	if (Blob != nullptr) {
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC CachedDesc = Desc;
+		CachedDesc.CachedPSO.pCachedBlob = Blob->data();
+		CachedDesc.CachedPSO.CachedBlobSizeInBytes = Blob->size();
+		if (SUCCEEDED(s_Device.load()->CreateGraphicsPipelineState(CachedDesc, &PipelineState))) {
+			++s_Hits;
+			return PipelineState;
+		}
+		DiscardBlob(Key);
+	}
+
+	++s_Misses;
+	ASSERT_SUCCEEDED(s_Device.load()->CreateGraphicsPipelineState(Desc, &PipelineState));
+	StorePipelineBlob(Key, PipelineState);
+	return PipelineState;
+}
+
+ID3D12PipelineState* CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureHash) {
+	ID3D12PipelineState* PipelineState = nullptr;
+	if (!s_Enabled) {
+		ASSERT_SUCCEEDED(s_Device.load()->CreateComputePipelineState(Desc, &PipelineState));
+		return PipelineState;
+	}
+
+	const uint64_t Key = GetComputePipelineKey(Desc, RootSignatureHash);
+	CachedBlob Blob = FindBlob(Key);
+	if (Blob != nullptr) {
+		D3D12_COMPUTE_PIPELINE_STATE_DESC CachedDesc = Desc;
+		CachedDesc.CachedPSO.pCachedBlob = Blob->data();
+		CachedDesc.CachedPSO.CachedBlobSizeInBytes = Blob->size();
+		if (SUCCEEDED(s_Device.load()->CreateComputePipelineState(CachedDesc, &PipelineState))) {
+			++s_Hits;
+			return PipelineState;
+		}
+		DiscardBlob(Key);
+	}
+
+	++s_Misses;
+	ASSERT_SUCCEEDED(s_Device.load()->CreateComputePipelineState(Desc, &PipelineState));
+	StorePipelineBlob(Key, PipelineState);
+	return PipelineState;
+}
+
+}	// namespace PipelineCache
+
+}	// namespace Graphics
@@ -0,0 +1,61 @@
+//
+// Persistent cache of serialized root signatures and compiled PSO blobs, so later launches skip most of the driver
+// compile work. Entries are keyed by a hash of the description contents (shader bytecode, input layout semantics and
+// the root signature layout rather than pointers), and the whole file by a fingerprint of the adapter and driver.
+//
+
+#pragma once
+
+namespace Graphics {
+
+// The device calls made on a cache miss or hit. The default forwards to g_Device; a stand-in that records the calls
+// can be installed with PipelineCache::SetDevice to check hit rates without a GPU.
+class PipelineStateDevice {
+public:
+	virtual ~PipelineStateDevice() {}
+
+	virtual HRESULT CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PipelineState) = 0;
+	virtual HRESULT CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PipelineState) = 0;
+	virtual HRESULT CreateRootSignature(const void* Blob, size_t BlobSize, ID3D12RootSignature** Signature) = 0;
+};
+
+struct PipelineCacheStats {
+	uint32_t LoadedEntries;		// valid entries read by Load
+	uint32_t DiscardedEntries;	// entries dropped by Load or rejected by the driver
+	uint32_t Hits;				// objects created from a cached blob
+	uint32_t Misses;			// objects compiled from scratch
+};
+
+namespace PipelineCache {
+
+	// Hash of the adapter identity and user mode driver version. Cached blobs are only valid for the same fingerprint.
+	uint64_t GetDeviceFingerprint(ID3D12Device* Device);
+
+	// Reads a cache file written by Save. Entries are validated in parallel. A missing file, a fingerprint mismatch or
+	// a corrupt header leaves the cache empty. Caching is off until Load is called.
+	void Load(const std::wstring& FilePath, uint64_t Fingerprint);
+
+	// Writes every valid entry, including the ones compiled since Load.
+	bool Save(const std::wstring& FilePath);
+
+	// Drops all entries and turns caching off.
+	void Clear();
+
+	// nullptr restores the default device.
+	void SetDevice(PipelineStateDevice* Device);
+
+	PipelineCacheStats GetStats();
+
+	// Key of a PSO description that is stable across launches. The input layout pointer must be set.
+	uint64_t GetGraphicsPipelineKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureHash);
+	uint64_t GetComputePipelineKey(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureHash);
+
+	// Used by RootSignature and the PSO classes. They try the cached blob first, fall back to a full compile when the
+	// driver rejects it, and record the blob of every new object.
+	ID3D12RootSignature* CreateRootSignature(const D3D12_ROOT_SIGNATURE_DESC& Desc, uint64_t DescHash);
+	ID3D12PipelineState* CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureHash);
+	ID3D12PipelineState* CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, uint64_t RootSignatureHash);
+
+}	// namespace PipelineCache
+
+}	// namespace Graphics
@@ -4,10 +4,8 @@
 
 #include "pch.h"
 #include "PipelineState.h"
-#include "Hash.h"
-#include <map>
-#include <thread>
-#include <mutex>
+#include "StateObjectCache.h"
+#include "PipelineCache.h"
 
 namespace Graphics {
 	
@@ -17,16 +15,26 @@ extern ID3D12Device* g_Device;
 using Microsoft::WRL::ComPtr;
 using namespace std;
 
-static map<size_t, ComPtr<ID3D12PipelineState>> s_GraphicsPSOHashMap;
-static map<size_t, ComPtr<ID3D12PipelineState>> s_ComputePSOHashMap;
+static StateObjectCache<ID3D12PipelineState> s_GraphicsPSOCache;
+static StateObjectCache<ID3D12PipelineState> s_ComputePSOCache;
+static StateObjectCache<ID3D12PipelineState, StaticStateKey, StaticStateKeyHasher> s_StaticGraphicsPSOCache;
 
 //
 // PSO implementation
 //
 
 void PSO::DestroyAll() {
-	s_GraphicsPSOHashMap.clear();
-	s_ComputePSOHashMap.clear();
+	s_GraphicsPSOCache.Clear();
+	s_ComputePSOCache.Clear();
+	s_StaticGraphicsPSOCache.Clear();
+}
+
+StateCacheStats PSO::GetGraphicsCacheStats() {
+	return s_GraphicsPSOCache.GetStats();
+}
+
+StateCacheStats PSO::GetComputeCacheStats() {
+	return s_ComputePSOCache.GetStats();
 }
 
 //
@@ -93,41 +101,76 @@ void GraphicsPSO::SetInputLayout(UINT NumElements, const D3D12_INPUT_ELEMENT_DES
 		m_InputLayouts = nullptr;
 }
 
-void GraphicsPSO::Finalize() {
+StateKey GraphicsPSO::GetStateKey() {
 	// Make sure the root signature is finalized first
 	m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
 	ASSERT(m_PSODesc.pRootSignature != nullptr);
 
 	m_PSODesc.InputLayout.pInputElementDescs = nullptr;
-	size_t HashCode = HashState(&m_PSODesc);
-	HashCode = HashState(m_InputLayouts.get(), m_PSODesc.InputLayout.NumElements, HashCode);
+	StateKey Key;
+	Key.Append(&m_PSODesc);
+	Key.Append(m_InputLayouts.get(), m_PSODesc.InputLayout.NumElements);
 	m_PSODesc.InputLayout.pInputElementDescs = m_InputLayouts.get();
+	return Key;
+}
 
-	ID3D12PipelineState** PSORef = nullptr;
-	bool firstCompile = false;
-	{
-		static mutex s_HashMapMutex;
-		lock_guard<mutex> CS(s_HashMapMutex);
-		auto iter = s_GraphicsPSOHashMap.find(HashCode);
-
-		// Reserve space so the next inquiry will find that someone got here first.
-		if (iter == s_GraphicsPSOHashMap.end()) {
-			firstCompile = true;
-			PSORef = s_GraphicsPSOHashMap[HashCode].GetAddressOf();
-		} else
-			PSORef = iter->second.GetAddressOf();
-	}
+void GraphicsPSO::Finalize() {
+	StateKey Key = GetStateKey();
+
+	m_PSO = s_GraphicsPSOCache.GetOrCreate(move(Key), [this]() {
+		return PipelineCache::CreateGraphicsPipelineState(m_PSODesc, m_RootSignature->GetDescHash());
+	});
+	m_PendingPSO = nullptr;
+	m_RecordedSession.Value = 0;
+}
+
+void GraphicsPSO::FinalizeStatic(StaticStateKey&& Key) {
+	// Make sure the root signature is finalized first
+	m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
+	ASSERT(m_PSODesc.pRootSignature != nullptr);
+
+	const uint64_t RootSignatureHash = m_RootSignature->GetDescHash();
+	Key.BindContext(m_PSODesc.pRootSignature, RootSignatureHash);
+
+	m_PSO = s_StaticGraphicsPSOCache.GetOrCreate(move(Key), [this, RootSignatureHash]() {
+		return PipelineCache::CreateGraphicsPipelineState(m_PSODesc, RootSignatureHash);
+	});
+	m_PendingPSO = nullptr;
+	m_RecordedSession.Value = 0;
+}
+
+shared_future<ID3D12PipelineState*> GraphicsPSO::FinalizeAsync() {
+	StateKey Key = GetStateKey();
 
-	if (firstCompile) {
-		ASSERT_SUCCEEDED(g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)));
-		s_GraphicsPSOHashMap[HashCode].Attach(m_PSO);
-	} else {
-		while (*PSORef == nullptr)
-			this_thread::yield();
-		m_PSO = *PSORef;
+	// The task owns a copy of the description and a reference to the input layout.
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = m_PSODesc;
+	const shared_ptr<const D3D12_INPUT_ELEMENT_DESC> InputLayouts = m_InputLayouts;
+	const uint64_t RootSignatureHash = m_RootSignature->GetDescHash();
+
+	m_PSO = nullptr;
+	m_RecordedSession.Value = 0;
+	m_PendingPSO = &s_GraphicsPSOCache.GetOrCreateAsync(move(Key), [Desc, InputLayouts, RootSignatureHash]() {
+		return PipelineCache::CreateGraphicsPipelineState(Desc, RootSignatureHash);
+	});
+	return m_PendingPSO->GetFuture();
+}
+
+void GraphicsPSO::FinalizeAll(GraphicsPSO* PSOs, size_t Count, bool Wait) {
+	for (size_t i = 0; i < Count; ++i)
+		PSOs[i].FinalizeAsync();
+
+	if (Wait) {
+		for (size_t i = 0; i < Count; ++i)
+			PSOs[i].m_PSO = PSOs[i].GetPipelineStateObject();
 	}
 }
 
+uint64_t GraphicsPSO::GetPersistentKey() const {
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = m_PSODesc;
+	Desc.InputLayout.pInputElementDescs = m_InputLayouts.get();
+	return PipelineCache::GetGraphicsPipelineKey(Desc, m_RootSignature->GetDescHash());
+}
+
 //
 // ComputePSO implementation
 //
@@ -137,35 +180,46 @@ ComputePSO::ComputePSO() {
 	m_PSODesc.NodeMask = 1;
 }
 
-void ComputePSO::Finalize() {
+StateKey ComputePSO::GetStateKey() {
 	// Make sure the root signature is finalized first
 	m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
 	ASSERT(m_PSODesc.pRootSignature != nullptr);
 
-	size_t HashCode = HashState(&m_PSODesc);
-
-	ID3D12PipelineState** PSORef = nullptr;
-	bool firstCompile = false;
-	{
-		static mutex s_HashMapMutex;
-		lock_guard<mutex> CS(s_HashMapMutex);
-		auto iter = s_ComputePSOHashMap.find(HashCode);
-
-		// Reserve space so the next inquiry will find that someone got here first.
-		if (iter == s_ComputePSOHashMap.end()) {
-			firstCompile = true;
-			PSORef = s_ComputePSOHashMap[HashCode].GetAddressOf();
-		} else
-			PSORef = iter->second.GetAddressOf();
-	}
+	StateKey Key;
+	Key.Append(&m_PSODesc);
+	return Key;
+}
+
+void ComputePSO::Finalize() {
+	StateKey Key = GetStateKey();
+
+	m_PSO = s_ComputePSOCache.GetOrCreate(move(Key), [this]() {
+		return PipelineCache::CreateComputePipelineState(m_PSODesc, m_RootSignature->GetDescHash());
+	});
+	m_PendingPSO = nullptr;
+}
+
+shared_future<ID3D12PipelineState*> ComputePSO::FinalizeAsync() {
+	StateKey Key = GetStateKey();
+
+	// The task owns a copy of the description.
+	const D3D12_COMPUTE_PIPELINE_STATE_DESC Desc = m_PSODesc;
+	const uint64_t RootSignatureHash = m_RootSignature->GetDescHash();
+
+	m_PSO = nullptr;
+	m_PendingPSO = &s_ComputePSOCache.GetOrCreateAsync(move(Key), [Desc, RootSignatureHash]() {
+		return PipelineCache::CreateComputePipelineState(Desc, RootSignatureHash);
+	});
+	return m_PendingPSO->GetFuture();
+}
+
+void ComputePSO::FinalizeAll(ComputePSO* PSOs, size_t Count, bool Wait) {
+	for (size_t i = 0; i < Count; ++i)
+		PSOs[i].FinalizeAsync();
 
-	if (firstCompile) {
-		ASSERT_SUCCEEDED(g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)));
-		s_ComputePSOHashMap[HashCode].Attach(m_PSO);
-	} else {
-		while (*PSORef == nullptr)
-			this_thread::yield();
-		m_PSO = *PSORef;
+	if (Wait) {
+		for (size_t i = 0; i < Count; ++i)
+			PSOs[i].m_PSO = PSOs[i].GetPipelineStateObject();
 	}
 }
 
@@ -10,10 +10,14 @@ namespace Graphics {
 
 class PSO {
 public:
-	PSO() : m_RootSignature(nullptr), m_PSO(nullptr) {}
+	PSO() : m_RootSignature(nullptr), m_PSO(nullptr), m_PendingPSO(nullptr) {}
 
 	static void DestroyAll();
 
+	// Lookups of the PSO caches shared by all instances.
+	static StateCacheStats GetGraphicsCacheStats();
+	static StateCacheStats GetComputeCacheStats();
+
 	void SetRootSignature(const RootSignature& BindMappings) {
 		m_RootSignature = &BindMappings;
 	}
@@ -21,11 +25,23 @@ public:
 		ASSERT(m_RootSignature != nullptr);
 		return *m_RootSignature;
 	}
-	ID3D12PipelineState* GetPipelineStateObject() const { return m_PSO; }
+
+	// Blocks while FinalizeAsync is still compiling.
+	ID3D12PipelineState* GetPipelineStateObject() const {
+		return (m_PSO != nullptr || m_PendingPSO == nullptr) ? m_PSO : m_PendingPSO->Get();
+	}
+
+	// False before finalization and while FinalizeAsync is still compiling.
+	bool IsReady() const {
+		return m_PSO != nullptr || (m_PendingPSO != nullptr && m_PendingPSO->IsReady());
+	}
 
 protected:
+	typedef StateObjectCache<ID3D12PipelineState>::Entry PendingPSO;
+
 	const RootSignature* m_RootSignature;
 	ID3D12PipelineState* m_PSO;
+	const PendingPSO* m_PendingPSO;
 };
 
 class GraphicsPSO : public PSO {
@@ -61,9 +77,50 @@ public:
 	// Perform validation and compute a hash value for fast state block comparisons.
 	void Finalize();
 
+	// Like Finalize, but compiles on the worker pool and returns immediately. Later changes to this object do not
+	// affect the compile, but shader bytecode and input layout semantic names must stay valid until it completes.
+	std::shared_future<ID3D12PipelineState*> FinalizeAsync();
+
+	// Compiles a set of PSOs in parallel, blocking until all of them are ready when Wait is set.
+	static void FinalizeAll(GraphicsPSO* PSOs, size_t Count, bool Wait = true);
+
+	// Takes every state but the root signature from a description built at compile time, whose input layout is used
+	// in place. Its hash is precomputed, so after the first call this is a cache lookup that neither allocates nor
+	// hashes the description. Desc must have static storage.
+	template <size_t NumElements>
+	void Finalize(const StaticGraphicsPSODesc<NumElements>& Desc) {
+		Desc.FillDesc(m_PSODesc);
+		m_InputLayouts = std::shared_ptr<const D3D12_INPUT_ELEMENT_DESC>(std::shared_ptr<const D3D12_INPUT_ELEMENT_DESC>(), Desc.GetInputLayout());
+		FinalizeStatic(StaticStateKey(Desc));
+	}
+
+	// Hash of the description that is stable across launches. The root signature must be finalized.
+	uint64_t GetPersistentKey() const;
+
+	// Used by PipelineWarmup::RecordUse on every bind. True only for the first call with a given warm-up session since
+	// this PSO was created, copied or finalized, without taking a lock.
+	bool MarkRecorded(uint32_t Session) const {
+		if (m_RecordedSession.Value.load(std::memory_order_relaxed) == Session)
+			return false;
+		return m_RecordedSession.Value.exchange(Session, std::memory_order_relaxed) != Session;
+	}
+
 private:
+	// Copies start unrecorded, so GraphicsPSO stays copyable.
+	struct RecordedSession {
+		RecordedSession() : Value(0) {}
+		RecordedSession(const RecordedSession&) : Value(0) {}
+		RecordedSession& operator=(const RecordedSession&) { Value = 0; return *this; }
+
+		std::atomic<uint32_t> Value;
+	};
+
+	StateKey GetStateKey();
+	void FinalizeStatic(StaticStateKey&& Key);
+
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC m_PSODesc;
 	std::shared_ptr<const D3D12_INPUT_ELEMENT_DESC> m_InputLayouts;
+	mutable RecordedSession m_RecordedSession;
 };
 
 class ComputePSO : public PSO {
@@ -78,7 +135,15 @@ public:
 	// Perform validation and compute a hash value for fast state block comparisons.
 	void Finalize();
 
+	// Like Finalize, but compiles on the worker pool and returns immediately. Shader bytecode must stay valid until
+	// the compile completes.
+	std::shared_future<ID3D12PipelineState*> FinalizeAsync();
+
+	static void FinalizeAll(ComputePSO* PSOs, size_t Count, bool Wait = true);
+
 private:
+	StateKey GetStateKey();
+
 	D3D12_COMPUTE_PIPELINE_STATE_DESC m_PSODesc;
 };
 
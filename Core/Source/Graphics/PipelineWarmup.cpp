@@ -0,0 +1,233 @@
+//
+// Records the order in which graphics PSOs are first bound, and compiles them in that order ahead of time on the next
+// launch.
+//
+
+#include "pch.h"
+#include "PipelineWarmup.h"
+#include "../Core/FileUtility.h"
+#include "../Core/SystemTime.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Graphics {
+
+using namespace std;
+
+namespace PipelineWarmup {
+
+// "SPSW"
+static const uint32_t kFileMagic = 0x57535053;
+static const uint32_t kFileVersion = 1;
+
+struct FileHeader {
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t EntryCount;
+	uint32_t Reserved;
+};
+
+struct UsageRecord {
+	uint64_t Key;
+	uint32_t FirstUseFrame;
+	uint32_t Reserved;
+};
+
+struct PendingWarmup {
+	uint64_t Key;
+	GraphicsPSO PSO;
+};
+
+static mutex s_Mutex;
+static atomic<bool> s_Recording(false);
+static atomic<uint32_t> s_FrameIndex(0);
+
+// Bumped by every Load, so the recorded marks PSOs keep from an earlier session no longer match.
+static atomic<uint32_t> s_Session(0);
+static atomic<float> s_FrameBudget(2.0f);
+
+// First use frame by persistent PSO key, of the previous session and of this one.
+static unordered_map<uint64_t, uint32_t> s_PreviousUses;
+static unordered_map<uint64_t, uint32_t> s_Uses;
+
+// Registered PSOs the previous session bound, by first use frame.
+static multimap<uint32_t, PendingWarmup> s_Pending;
+static unordered_set<uint64_t> s_ScheduledKeys;
+static unordered_set<uint64_t> s_WarmedKeys;
+static uint32_t s_AvoidedCompiles = 0;
+
+static atomic<bool> s_Busy(false);
+static Concurrency::task<void> s_WarmupTask;
+
+static void CompileSlice(double BudgetMilliseconds) {
+	const int64_t StartTick = Core::SystemTime::GetCurrentTick();
+
+	do {
+		PendingWarmup Next;
+		{
+			lock_guard<mutex> CS(s_Mutex);
+			if (s_Pending.empty())
+				break;
+			Next = s_Pending.begin()->second;
+			s_Pending.erase(s_Pending.begin());
+
+			// Bound before its turn came, so it was already compiled lazily.
+			if (s_Uses.count(Next.Key) != 0)
+				continue;
+		}
+
+		Next.PSO.Finalize();
+
+		lock_guard<mutex> CS(s_Mutex);
+		s_WarmedKeys.insert(Next.Key);
+	} while (Core::SystemTime::TicksToMillisecs(Core::SystemTime::GetCurrentTick() - StartTick) < BudgetMilliseconds);
+
+	s_Busy = false;
+}
+
+void Load(const wstring& FilePath) {
+	Shutdown();
+	++s_Session;
+	s_Recording = true;
+
+	Core::ByteArray File = Core::ReadFileSync(FilePath);
+	if (File->size() < sizeof(FileHeader))
+		return;
+
+	const FileHeader& Header = *(const FileHeader*)File->data();
+	if (Header.Magic != kFileMagic || Header.Version != kFileVersion ||
+		File->size() < sizeof(FileHeader) + (size_t)Header.EntryCount * sizeof(UsageRecord))
+		return;
+
+	const UsageRecord* Records = (const UsageRecord*)(&Header + 1);
+	lock_guard<mutex> CS(s_Mutex);
+	for (uint32_t i = 0; i < Header.EntryCount; ++i)
+		s_PreviousUses.emplace(Records[i].Key, Records[i].FirstUseFrame);
+}
+
+bool Save(const wstring& FilePath) {
+	if (!s_Recording)
+		return false;
+
+	vector<UsageRecord> Records;
+	{
+		lock_guard<mutex> CS(s_Mutex);
+		Records.reserve(s_Uses.size() + s_PreviousUses.size());
+
+		UsageRecord Record = {};
+		for (const auto& Use : s_Uses) {
+			Record.Key = Use.first;
+			Record.FirstUseFrame = Use.second;
+			Records.push_back(Record);
+		}
+		for (const auto& Use : s_PreviousUses) {
+			if (s_Uses.count(Use.first) != 0)
+				continue;
+			Record.Key = Use.first;
+			Record.FirstUseFrame = Use.second;
+			Records.push_back(Record);
+		}
+	}
+
+	sort(Records.begin(), Records.end(), [](const UsageRecord& a, const UsageRecord& b) {
+		return a.FirstUseFrame < b.FirstUseFrame;
+	});
+
+	ofstream File(FilePath, ios::out | ios::binary | ios::trunc);
+	if (!File)
+		return false;
+
+	FileHeader Header = {};
+	Header.Magic = kFileMagic;
+	Header.Version = kFileVersion;
+	Header.EntryCount = (uint32_t)Records.size();
+	File.write((const char*)&Header, sizeof(Header));
+	File.write((const char*)Records.data(), Records.size() * sizeof(UsageRecord));
+	return File.good();
+}
+
+void Shutdown() {
+	s_Recording = false;
+	{
+		lock_guard<mutex> CS(s_Mutex);
+		s_Pending.clear();
+	}
+	if (s_Busy)
+		s_WarmupTask.wait();
+
+	lock_guard<mutex> CS(s_Mutex);
+	s_PreviousUses.clear();
+	s_Uses.clear();
+	s_ScheduledKeys.clear();
+	s_WarmedKeys.clear();
+	s_AvoidedCompiles = 0;
+	s_FrameIndex = 0;
+}
+
+void Register(const GraphicsPSO& PSO) {
+	if (!s_Recording)
+		return;
+
+	const uint64_t Key = PSO.GetPersistentKey();
+
+	lock_guard<mutex> CS(s_Mutex);
+	auto iter = s_PreviousUses.find(Key);
+	if (iter == s_PreviousUses.end() || !s_ScheduledKeys.insert(Key).second)
+		return;
+
+	PendingWarmup Warmup;
+	Warmup.Key = Key;
+	Warmup.PSO = PSO;
+	s_Pending.emplace(iter->second, Warmup);
+}
+
+void SetFrameBudget(float Milliseconds) {
+	s_FrameBudget = Milliseconds;
+}
+
+void BeginFrame() {
+	++s_FrameIndex;
+	if (!s_Recording || s_Busy)
+		return;
+
+	{
+		lock_guard<mutex> CS(s_Mutex);
+		if (s_Pending.empty())
+			return;
+	}
+
+	const double Budget = s_FrameBudget;
+	s_Busy = true;
+	s_WarmupTask = Concurrency::create_task([Budget]() { CompileSlice(Budget); });
+}
+
+void RecordUse(const GraphicsPSO& PSO) {
+	if (!s_Recording || !PSO.MarkRecorded(s_Session.load(memory_order_relaxed)))
+		return;
+
+	// Hashes the shader bytecode, so it runs before taking the lock.
+	const uint64_t Key = PSO.GetPersistentKey();
+
+	lock_guard<mutex> CS(s_Mutex);
+	if (s_Uses.emplace(Key, s_FrameIndex.load()).second && s_WarmedKeys.count(Key) != 0)
+		++s_AvoidedCompiles;
+}
+
+PipelineWarmupStats GetStats() {
+	lock_guard<mutex> CS(s_Mutex);
+	PipelineWarmupStats Stats;
+	Stats.RecordedPSOs = (uint32_t)s_Uses.size();
+	Stats.ScheduledPSOs = (uint32_t)s_ScheduledKeys.size();
+	Stats.WarmedPSOs = (uint32_t)s_WarmedKeys.size();
+	Stats.AvoidedCompiles = s_AvoidedCompiles;
+	return Stats;
+}
+
+}	// namespace PipelineWarmup
+
+}	// namespace Graphics
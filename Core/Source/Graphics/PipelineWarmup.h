@@ -0,0 +1,52 @@
+//
+// Records the order in which graphics PSOs are first bound, and compiles them in that order ahead of time on the next
+// launch, so a material appearing on screen doesn't stall on a lazy Finalize.
+//
+
+#pragma once
+
+#include "PipelineState.h"
+
+namespace Graphics {
+
+struct PipelineWarmupStats {
+	uint32_t RecordedPSOs;		// distinct PSOs bound this session
+	uint32_t ScheduledPSOs;		// registered PSOs found in the usage log of the previous session
+	uint32_t WarmedPSOs;		// scheduled PSOs compiled by the warm-up so far
+	uint32_t AvoidedCompiles;	// first binds of a PSO the warm-up had already compiled
+};
+
+namespace PipelineWarmup {
+
+	// Reads the usage log of the previous session and starts recording this one. A missing or mismatched file only
+	// starts recording. Nothing is recorded or warmed up until Load is called.
+	void Load(const std::wstring& FilePath);
+
+	// Writes the first use frame of every PSO bound this session, merged with the ones of the previous log that
+	// weren't bound this time.
+	bool Save(const std::wstring& FilePath);
+
+	// Stops the warm-up, waits for the compile in flight and drops the log.
+	void Shutdown();
+
+	// Hands over a PSO that is fully configured but not finalized yet. Its root signature must be finalized, and the
+	// shader bytecode must stay valid until the warm-up is done with it. When the previous session bound it, a copy is
+	// finalized in the background in first use order, and the Finalize of the original becomes a cache lookup.
+	void Register(const GraphicsPSO& PSO);
+
+	// Milliseconds of compile work started per frame, checked between compiles. 2 by default.
+	void SetFrameBudget(float Milliseconds);
+
+	// Call once per frame. Advances the frame counter used for recording, and starts the next slice of compiles on
+	// the worker pool unless the previous one is still running.
+	void BeginFrame();
+
+	// Called by GraphicsContext::SetPipelineState whenever the bound PSO changes. Only the first bind of each PSO in a
+	// session hashes it and takes a lock; later binds are a single atomic load.
+	void RecordUse(const GraphicsPSO& PSO);
+
+	PipelineWarmupStats GetStats();
+
+}	// namespace PipelineWarmup
+
+}	// namespace Graphics
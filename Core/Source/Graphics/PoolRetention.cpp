@@ -0,0 +1,90 @@
+//
+// Decaying high-water mark deciding how much of a pool to keep around.
+//
+
+#include "pch.h"
+#include "PoolRetention.h"
+#include "../Core/SystemTime.h"
+
+namespace Graphics {
+
+using namespace std;
+
+void PoolHighWaterMark::SetPolicy(const PoolRetentionPolicy& Policy) {
+	ASSERT(Policy.SampleSeconds >= 0.0f && Policy.HalfLifeSeconds > 0.0f && Policy.Headroom >= 0.0f);
+	lock_guard<mutex> LockGuard(m_Mutex);
+	m_Policy = Policy;
+	m_SampleSeconds = Policy.SampleSeconds;
+}
+
+PoolRetentionPolicy PoolHighWaterMark::GetPolicy() const {
+	lock_guard<mutex> LockGuard(m_Mutex);
+	return m_Policy;
+}
+
+bool PoolHighWaterMark::IsSampleDue(int64_t Now) const {
+	const int64_t LastTick = m_LastTick.load(memory_order_relaxed);
+	return LastTick == 0 || Core::SystemTime::TimeBetweenTicks(LastTick, Now) >= m_SampleSeconds.load(memory_order_relaxed);
+}
+
+uint32_t PoolHighWaterMark::Update(int64_t Now, uint32_t InUse, uint32_t Pooled) {
+	lock_guard<mutex> LockGuard(m_Mutex);
+
+	if (m_LastTick == 0) {
+		m_FirstTick = Now;
+		m_HighWaterMark = (float)InUse;
+	} else {
+		const double Elapsed = Core::SystemTime::TimeBetweenTicks(m_LastTick, Now);
+		m_HighWaterMark = DecayHighWaterMark(m_HighWaterMark, Elapsed, m_Policy.HalfLifeSeconds, InUse);
+	}
+	m_LastTick = Now;
+
+	const uint32_t Release = GetReleaseCount(m_Policy, m_HighWaterMark, InUse, Pooled);
+
+	PoolSizeSample Sample;
+	Sample.Seconds = (float)Core::SystemTime::TimeBetweenTicks(m_FirstTick, Now);
+	Sample.Pooled = Pooled - Release;
+	Sample.InUse = InUse;
+	Sample.HighWaterMark = m_HighWaterMark;
+
+	if (m_History.size() < kHistorySize)
+		m_History.push_back(Sample);
+	else
+		m_History[m_NextSample] = Sample;
+	m_NextSample = (m_NextSample + 1) % kHistorySize;
+
+	return Release;
+}
+
+void PoolHighWaterMark::GetHistory(vector<PoolSizeSample>& History) const {
+	lock_guard<mutex> LockGuard(m_Mutex);
+	History.clear();
+	History.reserve(m_History.size());
+
+	// Once the ring is full, the next sample to overwrite is the oldest.
+	const size_t First = m_History.size() < kHistorySize ? 0 : m_NextSample;
+	for (size_t i = 0; i < m_History.size(); ++i)
+		History.push_back(m_History[(First + i) % m_History.size()]);
+}
+
+void PoolHighWaterMark::PrintHistory(const char* PoolName, size_t ObjectSize) const {
+	vector<PoolSizeSample> History;
+	GetHistory(History);
+
+	Core::Printf("%s pool, %zu samples:\n", PoolName, History.size());
+	for (const PoolSizeSample& Sample : History) {
+		Core::Printf("  %8.1fs: %u pooled (%.1f MB), %u in use, high-water mark %.1f\n", Sample.Seconds, Sample.Pooled,
+			(double)Sample.Pooled * ObjectSize / 1048576.0, Sample.InUse, Sample.HighWaterMark);
+	}
+}
+
+void PoolHighWaterMark::Reset() {
+	lock_guard<mutex> LockGuard(m_Mutex);
+	m_HighWaterMark = 0.0f;
+	m_FirstTick = 0;
+	m_LastTick = 0;
+	m_History.clear();
+	m_NextSample = 0;
+}
+
+}	// namespace Graphics
@@ -0,0 +1,81 @@
+//
+// Decaying high-water mark deciding how much of a pool of recycled GPU objects to keep around.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Graphics {
+
+struct PoolRetentionPolicy {
+	PoolRetentionPolicy() : SampleSeconds(0.5f), HalfLifeSeconds(10.0f), Headroom(0.25f), MinRetained(4) {}
+
+	float SampleSeconds;	// how often use is sampled and the pool trimmed
+	float HalfLifeSeconds;	// time for the high-water mark to fall halfway back to the current use
+	float Headroom;			// fraction kept above the decayed high-water mark
+	uint32_t MinRetained;	// objects never released
+};
+
+struct PoolSizeSample {
+	float Seconds;			// since the first sample
+	uint32_t Pooled;		// objects alive after trimming
+	uint32_t InUse;			// objects handed out or waiting on a fence
+	float HighWaterMark;
+};
+
+// The high-water mark jumps to any higher use and decays exponentially otherwise, so one spike is forgotten after a few
+// half-lives while a use that keeps coming back stays covered. Callers sample at most once per SampleSeconds, under
+// their own pool lock, and release what Update says is above the retained count.
+class PoolHighWaterMark {
+public:
+	static const uint32_t kHistorySize = 256;
+
+	PoolHighWaterMark() : m_SampleSeconds(m_Policy.SampleSeconds), m_LastTick(0), m_HighWaterMark(0.0f), m_FirstTick(0),
+		m_NextSample(0) {}
+
+	void SetPolicy(const PoolRetentionPolicy& Policy);
+	PoolRetentionPolicy GetPolicy() const;
+
+	// Doesn't lock, so it can be checked on every discard.
+	bool IsSampleDue(int64_t Now) const;
+
+	// Records the use of the pool and returns how many idle objects to release. Pooled counts all objects alive.
+	uint32_t Update(int64_t Now, uint32_t InUse, uint32_t Pooled);
+
+	// The maths of Update, apart from the clock and the history. The mark ElapsedSeconds after the last sample:
+	static float DecayHighWaterMark(float HighWaterMark, double ElapsedSeconds, float HalfLifeSeconds, uint32_t InUse) {
+		const float Decayed = HighWaterMark * (float)std::pow(0.5, ElapsedSeconds / HalfLifeSeconds);
+		return std::max(Decayed, (float)InUse);
+	}
+
+	// And the idle objects above what the policy retains for that mark. Objects in use are never released.
+	static uint32_t GetReleaseCount(const PoolRetentionPolicy& Policy, float HighWaterMark, uint32_t InUse, uint32_t Pooled) {
+		const uint32_t Retained = std::max(Policy.MinRetained, (uint32_t)std::ceil(HighWaterMark * (1.0f + Policy.Headroom)));
+		const uint32_t Kept = std::max(Retained, InUse);
+		return Pooled > Kept ? Pooled - Kept : 0;
+	}
+
+	// Oldest sample first, up to kHistorySize of them.
+	void GetHistory(std::vector<PoolSizeSample>& History) const;
+	void PrintHistory(const char* PoolName, size_t ObjectSize) const;
+
+	void Reset();
+
+private:
+	mutable std::mutex m_Mutex;
+	PoolRetentionPolicy m_Policy;
+	std::atomic<float> m_SampleSeconds;
+	std::atomic<int64_t> m_LastTick;
+	float m_HighWaterMark;
+	int64_t m_FirstTick;
+	std::vector<PoolSizeSample> m_History;
+	size_t m_NextSample;
+};
+
+}	// namespace Graphics
@@ -19,12 +19,6 @@ void ReadbackBuffer::Create(const std::wstring& name, uint32_t NumElements, uint
 	m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
 
 	// Create a readback buffer large enough to hold all texel data
-	D3D12_HEAP_PROPERTIES HeapProps;
-	HeapProps.Type = D3D12_HEAP_TYPE_READBACK;
-	HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	HeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	HeapProps.CreationNodeMask = 1;
-	HeapProps.VisibleNodeMask = 1;
 
 	// Readback buffers must be 1-dimensional, i.e. "buffer" not "texture2d"
 	D3D12_RESOURCE_DESC ResourceDesc = {};
@@ -39,8 +33,8 @@ void ReadbackBuffer::Create(const std::wstring& name, uint32_t NumElements, uint
 	ResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 	ResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-	ASSERT_SUCCEEDED(g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE, &ResourceDesc,
-		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, MY_IID_PPV_ARGS(&m_pResource)));
+	ASSERT_SUCCEEDED(GpuHeapAllocator::CreateResource(D3D12_HEAP_TYPE_READBACK, ResourceDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, m_HeapAllocation, &m_pResource));
 
 	m_GpuVirtualAddress = m_pResource->GetGPUVirtualAddress();
 
@@ -4,10 +4,8 @@
 
 #include "pch.h"
 #include "RootSignature.h"
-#include "Hash.h"
-#include <map>
-#include <thread>
-#include <mutex>
+#include "StateObjectCache.h"
+#include "PipelineCache.h"
 
 namespace Graphics {
 
@@ -18,11 +16,17 @@ using Microsoft::WRL::ComPtr;
 extern ID3D12Device* g_Device;
 
 // Store all RootSignatures.
-static std::map<size_t, ComPtr<ID3D12RootSignature>> s_RootSignatureHashMap;
+static StateObjectCache<ID3D12RootSignature> s_RootSignatureCache;
+static StateObjectCache<ID3D12RootSignature, StaticStateKey, StaticStateKeyHasher> s_StaticRootSignatureCache;
 
 
 void RootSignature::DestroyAll() {
-	s_RootSignatureHashMap.clear();
+	s_RootSignatureCache.Clear();
+	s_StaticRootSignatureCache.Clear();
+}
+
+StateCacheStats RootSignature::GetCacheStats() {
+	return s_RootSignatureCache.GetStats();
 }
 
 void RootSignature::InitStaticSampler(UINT Register, const D3D12_SAMPLER_DESC& NonStaticSamplerDesc,
@@ -91,18 +95,26 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
 	m_DescriptorTableBitMap = 0;
 	m_SamplerTableBitMap = 0;
 
-	size_t HashCode = HashState(&RootDesc.Flags);
-	HashCode = HashState(RootDesc.pStaticSamplers, m_NumSamplers, HashCode);
+	// The counts keep descriptions with the same words split differently apart.
+	StateKey Key;
+	Key.Append(&RootDesc.NumParameters);
+	Key.Append(&RootDesc.NumStaticSamplers);
+	Key.Append(&RootDesc.Flags);
+	Key.Append(RootDesc.pStaticSamplers, m_NumSamplers);
 
 	for (UINT Param = 0; Param < m_NumParameters; ++Param) {
 		const D3D12_ROOT_PARAMETER& RootParam = RootDesc.pParameters[Param];
 		m_DescriptorTableSize[Param] = 0;
 
+		// Only the members in use, the padding and the rest of the union aren't stable across launches.
+		Key.Append(&RootParam.ParameterType);
+		Key.Append(&RootParam.ShaderVisibility);
+
 		if (RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE) {
 			ASSERT(RootParam.DescriptorTable.pDescriptorRanges != nullptr);
 
-			HashCode = HashState(RootParam.DescriptorTable.pDescriptorRanges,
-				RootParam.DescriptorTable.NumDescriptorRanges, HashCode);
+			Key.Append(&RootParam.DescriptorTable.NumDescriptorRanges);
+			Key.Append(RootParam.DescriptorTable.pDescriptorRanges, RootParam.DescriptorTable.NumDescriptorRanges);
 
 			// We keep track of sampler descriptor tables separately from CBV_SRV_UAV descriptor tables
 			if (RootParam.DescriptorTable.pDescriptorRanges->RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
@@ -112,43 +124,67 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
 
 			for (UINT TableRange = 0; TableRange < RootParam.DescriptorTable.NumDescriptorRanges; ++TableRange)
 				m_DescriptorTableSize[Param] += RootParam.DescriptorTable.pDescriptorRanges[TableRange].NumDescriptors;
-		} else
-			HashCode = HashState(&RootParam, 1, HashCode);
-	}
-
-	ID3D12RootSignature** RSRef = nullptr;
-	bool firstCompile = false;
-	{
-		static mutex s_HashMapMutex;
-		lock_guard<mutex> CS(s_HashMapMutex);
-		auto iter = s_RootSignatureHashMap.find(HashCode);
-
-		// Reserve space so the next inquiry will find that someone got here first.
-		if (iter == s_RootSignatureHashMap.end()) {
-			RSRef = s_RootSignatureHashMap[HashCode].GetAddressOf();
-			firstCompile = true;
-		} else
-			RSRef = iter->second.GetAddressOf();
+		} else if (RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+			Key.Append(&RootParam.Constants);
+		else
+			Key.Append(&RootParam.Descriptor);
 	}
 
-	if (firstCompile) {
-		ComPtr<ID3DBlob> pOutBlob, pErrorBlob;
+	m_DescHash = Key.GetHash();
+	m_Signature = s_RootSignatureCache.GetOrCreate(move(Key), [&]() {
+		ID3D12RootSignature* Signature = PipelineCache::CreateRootSignature(RootDesc, m_DescHash);
+		Signature->SetName(name.c_str());
+		return Signature;
+	});
 
-		ASSERT_SUCCEEDED(D3D12SerializeRootSignature(&RootDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-			pOutBlob.GetAddressOf(), pErrorBlob.GetAddressOf()));
-
-		ASSERT_SUCCEEDED(Graphics::g_Device->CreateRootSignature(1, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(),
-			MY_IID_PPV_ARGS(&m_Signature)));
+	m_Finalized = TRUE;
+}
 
-		m_Signature->SetName(name.c_str());
+void RootSignature::FinalizeStatic(StaticStateKey&& Key, const StaticRootSignatureView& View, const wchar_t* Name) {
+	if (m_Finalized)
+		return;
 
-		s_RootSignatureHashMap[HashCode].Attach(m_Signature);
-		ASSERT(*RSRef == m_Signature);
-	} else {
-		while (*RSRef == nullptr)
-			this_thread::yield();
-		m_Signature = *RSRef;
-	}
+	m_ParamArray = nullptr;
+	m_SamplerArray = nullptr;
+	m_NumParameters = View.NumParameters;
+	m_NumSamplers = m_NumInitializedStaticSamplers = View.NumSamplers;
+	m_DescriptorTableBitMap = View.DescriptorTableBitMap;
+	m_SamplerTableBitMap = View.SamplerTableBitMap;
+	memcpy(m_DescriptorTableSize, View.DescriptorTableSize, sizeof(m_DescriptorTableSize));
+	m_DescHash = View.Hash;
+
+	m_Signature = s_StaticRootSignatureCache.GetOrCreate(move(Key), [&]() {
+		vector<D3D12_ROOT_PARAMETER> Parameters(View.NumParameters);
+		for (UINT Param = 0; Param < View.NumParameters; ++Param) {
+			const StaticRootParameter& Source = View.Parameters[Param];
+			D3D12_ROOT_PARAMETER& RootParam = Parameters[Param];
+			RootParam.ParameterType = Source.Type;
+			RootParam.ShaderVisibility = Source.Visibility;
+
+			if (Source.Type == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE) {
+				RootParam.DescriptorTable.NumDescriptorRanges = Source.Count;
+				RootParam.DescriptorTable.pDescriptorRanges = View.Ranges + Source.FirstRange;
+			} else if (Source.Type == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS) {
+				RootParam.Constants.ShaderRegister = Source.Register;
+				RootParam.Constants.RegisterSpace = 0;
+				RootParam.Constants.Num32BitValues = Source.Count;
+			} else {
+				RootParam.Descriptor.ShaderRegister = Source.Register;
+				RootParam.Descriptor.RegisterSpace = 0;
+			}
+		}
+
+		D3D12_ROOT_SIGNATURE_DESC RootDesc;
+		RootDesc.NumParameters = View.NumParameters;
+		RootDesc.pParameters = Parameters.data();
+		RootDesc.NumStaticSamplers = View.NumSamplers;
+		RootDesc.pStaticSamplers = View.Samplers;
+		RootDesc.Flags = View.Flags;
+
+		ID3D12RootSignature* Signature = PipelineCache::CreateRootSignature(RootDesc, View.Hash);
+		Signature->SetName(Name);
+		return Signature;
+	});
 
 	m_Finalized = TRUE;
 }
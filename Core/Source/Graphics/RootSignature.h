@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include "StateObjectCache.h"
+#include "StaticState.h"
+
 namespace Graphics {
 
 // Wrapper class for root parameter.
@@ -86,7 +89,7 @@ class RootSignature {
 	friend class DynamicDescriptorHeap;
 
 public:
-	RootSignature(UINT NumRootParams = 0, UINT NumStaticSamplers = 0) : m_Finalized(FALSE), m_NumParameters(NumRootParams) {
+	RootSignature(UINT NumRootParams = 0, UINT NumStaticSamplers = 0) : m_Finalized(FALSE), m_NumParameters(NumRootParams), m_DescHash(0) {
 		Reset(NumRootParams, NumStaticSamplers);
 	}
 
@@ -94,6 +97,9 @@ public:
 
 	static void DestroyAll();
 
+	// Lookups of the root signature cache shared by all instances.
+	static StateCacheStats GetCacheStats();
+
 	void Reset(UINT NumRootParams, UINT NumStaticSamplers = 0) {
 		if (NumRootParams > 0)
 			m_ParamArray.reset(new RootParameter[NumRootParams]);
@@ -123,9 +129,22 @@ public:
 
 	void Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAGS Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE);
 
+	// Finalizes from a description built at compile time, replacing the parameters set so far. Its hash and table
+	// layout are precomputed, so after the first call this is a cache lookup that neither allocates nor hashes. Desc
+	// must have static storage.
+	template <size_t NumParameters, size_t NumRanges, size_t NumSamplers>
+	void Finalize(const StaticRootSignatureDesc<NumParameters, NumRanges, NumSamplers>& Desc, const wchar_t* Name) {
+		FinalizeStatic(StaticStateKey(Desc), Desc.GetView(), Name);
+	}
+
 	ID3D12RootSignature* GetSignature() const { return m_Signature; }
 
+	// Hash of the description contents, stable across launches. Seeds the persistent keys of the PSOs using it.
+	uint64_t GetDescHash() const { return m_DescHash; }
+
 protected:
+	void FinalizeStatic(StaticStateKey&& Key, const StaticRootSignatureView& View, const wchar_t* Name);
+
 	BOOL m_Finalized;
 	UINT m_NumParameters;
 	UINT m_NumSamplers;
@@ -136,6 +155,7 @@ protected:
 	std::unique_ptr<RootParameter[]> m_ParamArray;
 	std::unique_ptr<D3D12_STATIC_SAMPLER_DESC[]> m_SamplerArray;
 	ID3D12RootSignature* m_Signature;
+	uint64_t m_DescHash;
 };
 
 }	// namespace Graphics
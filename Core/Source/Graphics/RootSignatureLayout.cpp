@@ -0,0 +1,263 @@
+//
+// Root signature layout chosen from how often each binding changes.
+//
+
+#include "pch.h"
+#include "RootSignatureLayout.h"
+#include <algorithm>
+#include <map>
+
+namespace Graphics {
+
+using namespace std;
+
+float RootSignatureLayout::sm_DescriptorCopyCost = 4.0f;
+float RootSignatureLayout::sm_ChangesPerDraw[(uint32_t)RootBindingFrequency::kCount] = { 0.001f, 0.01f, 0.25f, 1.0f };
+
+// RootSignature tracks descriptor table sizes for this many parameters.
+static const UINT kMaxParameters = 16;
+
+struct LayoutCost {
+	UINT DWORDs;
+	UINT Parameters;
+	float DWORDChanges;
+	float DescriptorCopies;
+	float UploadDWORDs;
+	float Cost;
+};
+
+static bool IsFormAllowed(RootBindingType Type, RootBindingForm Form) {
+	switch (Type) {
+	case RootBindingType::kConstants:
+		return Form != RootBindingForm::kTable;
+	case RootBindingType::kBufferSRV:
+	case RootBindingType::kBufferUAV:
+		return Form != RootBindingForm::kRootConstants;
+	default:
+		return Form == RootBindingForm::kTable;
+	}
+}
+
+static D3D12_DESCRIPTOR_RANGE_TYPE GetRangeType(RootBindingType Type) {
+	switch (Type) {
+	case RootBindingType::kBufferUAV:
+	case RootBindingType::kTextureUAV:
+		return D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+	case RootBindingType::kSampler:
+		return D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+	default:
+		return D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+	}
+}
+
+// Bindings can share a table when they change together, live in the same heap and have the same visibility.
+static uint32_t GetTableGroup(const RootBindingDesc& Binding) {
+	const uint32_t IsSampler = Binding.Type == RootBindingType::kSampler ? 1 : 0;
+	return ((uint32_t)Binding.Frequency << 8) | (IsSampler << 7) | (uint32_t)Binding.Visibility;
+}
+
+static LayoutCost EvaluateLayout(const vector<RootBindingDesc>& Bindings, const vector<RootBindingForm>& Forms, bool ShareTables) {
+	LayoutCost Cost = {};
+	map<uint32_t, UINT> Tables;
+
+	for (size_t i = 0; i < Bindings.size(); ++i) {
+		const RootBindingDesc& Binding = Bindings[i];
+		const float Changes = RootSignatureLayout::sm_ChangesPerDraw[(uint32_t)Binding.Frequency];
+
+		switch (Forms[i]) {
+		case RootBindingForm::kRootConstants:
+			Cost.DWORDs += Binding.Count;
+			Cost.Parameters += 1;
+			Cost.DWORDChanges += Changes * Binding.Count;
+			break;
+
+		case RootBindingForm::kRootDescriptor:
+			Cost.DWORDs += 2;
+			Cost.Parameters += 1;
+			Cost.DWORDChanges += Changes * 2;
+			if (Binding.Type == RootBindingType::kConstants)
+				Cost.UploadDWORDs += Changes * Binding.Count;
+			break;
+
+		case RootBindingForm::kTable:
+			if (ShareTables) {
+				Tables[GetTableGroup(Binding)] += Binding.Count;
+			} else {
+				Cost.DWORDs += 1;
+				Cost.Parameters += 1;
+				Cost.DWORDChanges += Changes;
+				Cost.DescriptorCopies += Changes * Binding.Count;
+			}
+			break;
+		}
+	}
+
+	// DynamicDescriptorHeap copies a whole table whenever any descriptor in it changes.
+	for (const auto& Table : Tables) {
+		const float Changes = RootSignatureLayout::sm_ChangesPerDraw[Table.first >> 8];
+		Cost.DWORDs += 1;
+		Cost.Parameters += 1;
+		Cost.DWORDChanges += Changes;
+		Cost.DescriptorCopies += Changes * Table.second;
+	}
+
+	Cost.Cost = Cost.DWORDChanges + Cost.UploadDWORDs + RootSignatureLayout::sm_DescriptorCopyCost * Cost.DescriptorCopies;
+	return Cost;
+}
+
+void RootSignatureLayout::Optimize(const RootBindingDesc* Bindings, UINT BindingCount, UINT MaxDWORDs) {
+	ASSERT(BindingCount > 0 && Bindings != nullptr);
+	m_Bindings.assign(Bindings, Bindings + BindingCount);
+
+	// Start from the fewest DWORDs.
+	vector<RootBindingForm> Forms(BindingCount);
+	for (UINT i = 0; i < BindingCount; ++i) {
+		ASSERT(Bindings[i].Count > 0);
+		if (Bindings[i].Type == RootBindingType::kConstants)
+			Forms[i] = Bindings[i].Count == 1 ? RootBindingForm::kRootConstants : RootBindingForm::kRootDescriptor;
+		else
+			Forms[i] = RootBindingForm::kTable;
+	}
+
+	LayoutCost Current = EvaluateLayout(m_Bindings, Forms, true);
+	ASSERT(Current.DWORDs <= MaxDWORDs && Current.Parameters <= kMaxParameters,
+		"Bindings don't fit in a root signature even in their smallest forms");
+
+	static const RootBindingForm kForms[] = { RootBindingForm::kRootConstants, RootBindingForm::kRootDescriptor, RootBindingForm::kTable };
+
+	for (;;) {
+		float BestScore = 0.0f;
+		UINT BestBinding = BindingCount;
+		RootBindingForm BestForm = RootBindingForm::kTable;
+
+		for (UINT i = 0; i < BindingCount; ++i) {
+			const RootBindingForm Previous = Forms[i];
+			for (RootBindingForm Form : kForms) {
+				if (Form == Previous || !IsFormAllowed(m_Bindings[i].Type, Form))
+					continue;
+
+				Forms[i] = Form;
+				const LayoutCost Trial = EvaluateLayout(m_Bindings, Forms, true);
+				if (Trial.DWORDs > MaxDWORDs || Trial.Parameters > kMaxParameters || Trial.Cost >= Current.Cost)
+					continue;
+
+				// Changes that don't take more space are ranked as if they took half a DWORD.
+				const int ExtraDWORDs = (int)Trial.DWORDs - (int)Current.DWORDs;
+				const float Score = (Current.Cost - Trial.Cost) / max((float)ExtraDWORDs, 0.5f);
+				if (Score > BestScore) {
+					BestScore = Score;
+					BestBinding = i;
+					BestForm = Form;
+				}
+			}
+			Forms[i] = Previous;
+		}
+
+		if (BestBinding == BindingCount)
+			break;
+		Forms[BestBinding] = BestForm;
+		Current = EvaluateLayout(m_Bindings, Forms, true);
+	}
+
+	// One parameter per root binding, one per table group.
+	m_Parameters.clear();
+	map<uint32_t, size_t> TableParameters;
+	for (UINT i = 0; i < BindingCount; ++i) {
+		const RootBindingDesc& Binding = m_Bindings[i];
+		size_t Index = m_Parameters.size();
+
+		if (Forms[i] == RootBindingForm::kTable) {
+			auto iter = TableParameters.find(GetTableGroup(Binding));
+			if (iter != TableParameters.end()) {
+				m_Parameters[iter->second].Bindings.push_back(i);
+				continue;
+			}
+			TableParameters.emplace(GetTableGroup(Binding), Index);
+		}
+
+		LayoutParameter Parameter;
+		Parameter.Form = Forms[i];
+		Parameter.Frequency = Binding.Frequency;
+		Parameter.Visibility = Binding.Visibility;
+		Parameter.Bindings.push_back(i);
+		m_Parameters.push_back(move(Parameter));
+	}
+
+	stable_sort(m_Parameters.begin(), m_Parameters.end(), [](const LayoutParameter& a, const LayoutParameter& b) {
+		if (a.Frequency != b.Frequency)
+			return a.Frequency > b.Frequency;
+		return a.Form < b.Form;
+	});
+
+	m_Locations.resize(BindingCount);
+	for (UINT Param = 0; Param < (UINT)m_Parameters.size(); ++Param) {
+		UINT TableOffset = 0;
+		for (UINT Binding : m_Parameters[Param].Bindings) {
+			m_Locations[Binding].Form = m_Parameters[Param].Form;
+			m_Locations[Binding].RootIndex = Param;
+			m_Locations[Binding].TableOffset = TableOffset;
+			TableOffset += m_Bindings[Binding].Count;
+		}
+	}
+
+	vector<RootBindingForm> Baseline(BindingCount);
+	for (UINT i = 0; i < BindingCount; ++i)
+		Baseline[i] = m_Bindings[i].Type == RootBindingType::kConstants ? RootBindingForm::kRootDescriptor : RootBindingForm::kTable;
+
+	m_Report.RootDWORDs = Current.DWORDs;
+	m_Report.RootParameters = (UINT)m_Parameters.size();
+	m_Report.DWORDChangesPerDraw = Current.DWORDChanges;
+	m_Report.DescriptorCopiesPerDraw = Current.DescriptorCopies;
+	m_Report.UploadDWORDsPerDraw = Current.UploadDWORDs;
+	m_Report.CostPerDraw = Current.Cost;
+	m_Report.BaselineCostPerDraw = EvaluateLayout(m_Bindings, Baseline, false).Cost;
+}
+
+void RootSignatureLayout::InitRootSignature(RootSignature& Signature, UINT NumStaticSamplers) const {
+	Signature.Reset((UINT)m_Parameters.size(), NumStaticSamplers);
+
+	for (UINT Param = 0; Param < (UINT)m_Parameters.size(); ++Param) {
+		const LayoutParameter& Parameter = m_Parameters[Param];
+		const RootBindingDesc& First = m_Bindings[Parameter.Bindings[0]];
+		RootParameter& Root = Signature[Param];
+
+		switch (Parameter.Form) {
+		case RootBindingForm::kRootConstants:
+			Root.InitAsConstants(First.Register, First.Count, Parameter.Visibility);
+			break;
+
+		case RootBindingForm::kRootDescriptor:
+			if (First.Type == RootBindingType::kConstants)
+				Root.InitAsConstantBuffer(First.Register, Parameter.Visibility);
+			else if (First.Type == RootBindingType::kBufferSRV)
+				Root.InitAsBufferSRV(First.Register, Parameter.Visibility);
+			else
+				Root.InitAsBufferUAV(First.Register, Parameter.Visibility);
+			break;
+
+		case RootBindingForm::kTable:
+			Root.InitAsDescriptorTable((UINT)Parameter.Bindings.size(), Parameter.Visibility);
+			for (UINT Range = 0; Range < (UINT)Parameter.Bindings.size(); ++Range) {
+				const RootBindingDesc& Binding = m_Bindings[Parameter.Bindings[Range]];
+				Root.SetTableRange(Range, GetRangeType(Binding.Type), Binding.Register, Binding.Count);
+			}
+			break;
+		}
+	}
+}
+
+void RootSignatureLayout::PrintReport() const {
+	static const char* kFormNames[] = { "constants", "root descriptor", "table" };
+
+	Core::Printf("Root layout: %u DWORDs in %u parameters\n", m_Report.RootDWORDs, m_Report.RootParameters);
+	for (UINT Binding = 0; Binding < (UINT)m_Bindings.size(); ++Binding) {
+		const RootBindingLocation& Location = m_Locations[Binding];
+		Core::Printf("  binding %u: %s at root index %u, offset %u\n", Binding, kFormNames[(uint32_t)Location.Form],
+			Location.RootIndex, Location.TableOffset);
+	}
+	Core::Printf("  per draw: %.3f DWORD changes, %.3f descriptor copies, %.3f uploaded DWORDs\n",
+		m_Report.DWORDChangesPerDraw, m_Report.DescriptorCopiesPerDraw, m_Report.UploadDWORDsPerDraw);
+	Core::Printf("  cost per draw: %.3f, baseline %.3f\n", m_Report.CostPerDraw, m_Report.BaselineCostPerDraw);
+}
+
+}	// namespace Graphics
@@ -0,0 +1,129 @@
+//
+// Root signature layout chosen from how often each binding changes.
+//
+
+#pragma once
+
+#include "RootSignature.h"
+#include "GpuBuffer.h"
+
+namespace Graphics {
+
+// From least to most frequently changed.
+enum class RootBindingFrequency : uint32_t {
+	kPerFrame,
+	kPerPass,
+	kPerMaterial,
+	kPerDraw,
+	kCount
+};
+
+enum class RootBindingType : uint32_t {
+	kConstants,		// Count 32 bit values written from the CPU
+	kBufferSRV,		// raw or structured buffer
+	kBufferUAV,		// raw or structured buffer
+	kTextureSRV,	// Count descriptors, only through a table
+	kTextureUAV,	// Count descriptors, only through a table
+	kSampler,		// Count samplers, only through a table
+};
+
+struct RootBindingDesc {
+	RootBindingType Type;
+	RootBindingFrequency Frequency;
+	UINT Register;
+	UINT Count;
+	D3D12_SHADER_VISIBILITY Visibility;
+};
+
+enum class RootBindingForm : uint32_t {
+	kRootConstants,
+	kRootDescriptor,	// buffers, and constants uploaded as a dynamic constant buffer
+	kTable,
+};
+
+struct RootBindingLocation {
+	RootBindingForm Form;
+	UINT RootIndex;
+	UINT TableOffset;	// first descriptor of the binding in its table
+};
+
+// Per draw figures are the sum over parameters of their change cost, weighted by sm_ChangesPerDraw.
+struct RootLayoutReport {
+	UINT RootDWORDs;
+	UINT RootParameters;
+	float DWORDChangesPerDraw;		// root DWORDs rewritten
+	float DescriptorCopiesPerDraw;	// descriptors copied by DynamicDescriptorHeap
+	float UploadDWORDsPerDraw;		// constants written to dynamic constant buffers
+	float CostPerDraw;				// in root DWORD writes, copies weighted by sm_DescriptorCopyCost
+	float BaselineCostPerDraw;		// a table or root CBV per binding, in declaration order
+};
+
+// Picks the cheapest form for every binding: root constants, a root descriptor, or a range in a table shared with the
+// other bindings of the same frequency, heap type and visibility. Starting from the layout using the fewest DWORDs, it
+// greedily applies the change saving the most cost per extra DWORD until nothing fits the budget. Parameters are then
+// ordered from the most frequently changed to the least, since hardware keeps the first ones in faster storage.
+class RootSignatureLayout {
+public:
+	// Cost of copying one descriptor, relative to writing one root DWORD.
+	static float sm_DescriptorCopyCost;
+
+	// Expected changes per draw of each frequency.
+	static float sm_ChangesPerDraw[(uint32_t)RootBindingFrequency::kCount];
+
+	RootSignatureLayout() {}
+
+	void Optimize(const RootBindingDesc* Bindings, UINT BindingCount, UINT MaxDWORDs = 64);
+
+	// Resets Signature to the optimized parameters. Static samplers are left to the caller.
+	void InitRootSignature(RootSignature& Signature, UINT NumStaticSamplers = 0) const;
+
+	const RootBindingLocation& GetLocation(UINT Binding) const { return m_Locations[Binding]; }
+	const RootLayoutReport& GetReport() const { return m_Report; }
+	void PrintReport() const;
+
+	// Binding updates through whichever form was chosen, for GraphicsContext and ComputeContext.
+	template <typename ContextType> void SetConstants(ContextType& Context, UINT Binding, const void* Data) const {
+		const RootBindingLocation& Location = m_Locations[Binding];
+		ASSERT(m_Bindings[Binding].Type == RootBindingType::kConstants);
+		if (Location.Form == RootBindingForm::kRootConstants)
+			Context.SetConstantArray(Location.RootIndex, m_Bindings[Binding].Count, Data);
+		else
+			Context.SetDynamicConstantBufferView(Location.RootIndex, m_Bindings[Binding].Count * sizeof(uint32_t), Data);
+	}
+
+	template <typename ContextType> void SetBuffer(ContextType& Context, UINT Binding, const GpuBuffer& Buffer) const {
+		const RootBindingLocation& Location = m_Locations[Binding];
+		const bool IsUAV = m_Bindings[Binding].Type == RootBindingType::kBufferUAV;
+		ASSERT(IsUAV || m_Bindings[Binding].Type == RootBindingType::kBufferSRV);
+		if (Location.Form == RootBindingForm::kTable)
+			Context.SetDynamicDescriptor(Location.RootIndex, Location.TableOffset, IsUAV ? Buffer.GetUAV() : Buffer.GetSRV());
+		else if (IsUAV)
+			Context.SetBufferUAV(Location.RootIndex, Buffer);
+		else
+			Context.SetBufferSRV(Location.RootIndex, Buffer);
+	}
+
+	template <typename ContextType> void SetDescriptors(ContextType& Context, UINT Binding, UINT Count, const D3D12_CPU_DESCRIPTOR_HANDLE Handles[]) const {
+		const RootBindingLocation& Location = m_Locations[Binding];
+		ASSERT(Location.Form == RootBindingForm::kTable && Count <= m_Bindings[Binding].Count);
+		if (m_Bindings[Binding].Type == RootBindingType::kSampler)
+			Context.SetDynamicSamplers(Location.RootIndex, Location.TableOffset, Count, Handles);
+		else
+			Context.SetDynamicDescriptors(Location.RootIndex, Location.TableOffset, Count, Handles);
+	}
+
+private:
+	struct LayoutParameter {
+		RootBindingForm Form;
+		RootBindingFrequency Frequency;
+		D3D12_SHADER_VISIBILITY Visibility;
+		std::vector<UINT> Bindings;		// one, or the ranges of a table in order
+	};
+
+	std::vector<RootBindingDesc> m_Bindings;
+	std::vector<RootBindingLocation> m_Locations;
+	std::vector<LayoutParameter> m_Parameters;
+	RootLayoutReport m_Report;
+};
+
+}	// namespace Graphics
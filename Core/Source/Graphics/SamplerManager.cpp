@@ -6,29 +6,108 @@
 #include "SamplerManager.h"
 #include "GraphicsCore.h"
 #include "Hash.h"
-#include <map>
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
 
 namespace Graphics {
 	
 // Global ID3D12Device.
 extern ID3D12Device* g_Device;
 
-std::map<size_t, D3D12_CPU_DESCRIPTOR_HANDLE> s_SamplerCache;
+using namespace std;
 
-D3D12_CPU_DESCRIPTOR_HANDLE SamplerDesc::CreateDescriptor() {
-	size_t hashValue = HashState(this);
-	auto iter = s_SamplerCache.find(hashValue);
+struct CachedSampler {
+	D3D12_CPU_DESCRIPTOR_HANDLE Handle;
+	uint32_t Index;
+};
+
+// Lookups share the lock, only the first creation of a description takes it exclusively.
+static shared_timed_mutex s_SamplerMutex;
+static unordered_map<StateKey, CachedSampler, StateKeyHasher> s_SamplerCache;
+static UserDescriptorHeap s_ShaderVisibleHeap(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE);
+static atomic<uint64_t> s_Hits(0);
+static atomic<uint64_t> s_Misses(0);
+static atomic<uint32_t> s_Overflows(0);
+
+static const CachedSampler& FindOrCreateSampler(const D3D12_SAMPLER_DESC& Desc) {
+	StateKey Key;
+	Key.Append(&Desc);
+
+	{
+		shared_lock<shared_timed_mutex> SharedCS(s_SamplerMutex);
+		auto iter = s_SamplerCache.find(Key);
+		if (iter != s_SamplerCache.end()) {
+			++s_Hits;
+			return iter->second;
+		}
+	}
+
+	lock_guard<shared_timed_mutex> CS(s_SamplerMutex);
+
+	// Another thread may have created it between the two locks.
+	auto iter = s_SamplerCache.find(Key);
 	if (iter != s_SamplerCache.end()) {
+		++s_Hits;
 		return iter->second;
 	}
 
-	D3D12_CPU_DESCRIPTOR_HANDLE Handle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
-	g_Device->CreateSampler(this, Handle);
-	return Handle;
+	if (s_ShaderVisibleHeap.GetHeapPointer() == nullptr)
+		s_ShaderVisibleHeap.Create(L"Sampler Cache Heap");
+
+	CachedSampler Sampler;
+	Sampler.Handle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
+	Sampler.Index = SamplerDesc::kInvalidIndex;
+	g_Device->CreateSampler(&Desc, Sampler.Handle);
+
+	// Checked in every build: writing past the heap would corrupt whatever follows it.
+	const bool HeapFull = !s_ShaderVisibleHeap.HasAvailableSpace(1);
+	WARN_ONCE_IF(HeapFull, "Sampler cache exceeds the shader visible sampler heap size");
+	if (!HeapFull) {
+		Sampler.Index = (uint32_t)s_SamplerCache.size();
+		s_ShaderVisibleHeap.Alloc(1);
+		g_Device->CreateSampler(&Desc, s_ShaderVisibleHeap.GetHandleAtOffset(Sampler.Index).GetCpuHandle());
+	} else {
+		++s_Overflows;
+	}
+
+	++s_Misses;
+	return s_SamplerCache.emplace(move(Key), Sampler).first->second;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE SamplerDesc::CreateDescriptor() {
+	return FindOrCreateSampler(*this).Handle;
 }
 
 void SamplerDesc::CreateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE& Handle) {
 	g_Device->CreateSampler(this, Handle);
 }
 
-}	// namespace Graphics
\ No newline at end of file
+uint32_t SamplerDesc::GetIndex() {
+	return FindOrCreateSampler(*this).Index;
+}
+
+ID3D12DescriptorHeap* SamplerDesc::GetShaderVisibleHeap() {
+	shared_lock<shared_timed_mutex> SharedCS(s_SamplerMutex);
+	return s_ShaderVisibleHeap.GetHeapPointer();
+}
+
+SamplerCacheStats SamplerDesc::GetCacheStats() {
+	shared_lock<shared_timed_mutex> SharedCS(s_SamplerMutex);
+	SamplerCacheStats Stats;
+	Stats.Hits = s_Hits;
+	Stats.Misses = s_Misses;
+	Stats.UniqueSamplers = (uint32_t)s_SamplerCache.size();
+	Stats.Overflows = s_Overflows;
+	return Stats;
+}
+
+void SamplerDesc::DestroyAll() {
+	lock_guard<shared_timed_mutex> CS(s_SamplerMutex);
+	s_SamplerCache.clear();
+	s_ShaderVisibleHeap = UserDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE);
+	s_Hits = s_Misses = 0;
+	s_Overflows = 0;
+}
+
+}	// namespace Graphics
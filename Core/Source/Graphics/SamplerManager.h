@@ -7,9 +7,19 @@
 #include "Color.h"
 
 namespace Graphics {
-	
+
+struct SamplerCacheStats {
+	uint64_t Hits;				// lookups that found an existing sampler
+	uint64_t Misses;			// lookups that created a sampler
+	uint32_t UniqueSamplers;	// samplers in the cache
+	uint32_t Overflows;			// samplers cached without a slot in the shader visible heap
+};
+
 class SamplerDesc : public D3D12_SAMPLER_DESC {
 public:
+	// GetIndex of a sampler that didn't fit in the shader visible heap.
+	static const uint32_t kInvalidIndex = ~0u;
+
 	// These defaults match the default values for HLSL-defined root
 	// signature static samplers. So not overriding them here means
 	// you can safely not define them in HLSL.
@@ -47,6 +57,18 @@ public:
 
 	// Create descriptor in place (no deduplication)
 	void CreateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE& Handle);
+
+	// Deduplicated like CreateDescriptor, and returns the slot of this sampler in the shader visible heap. Equal
+	// descriptions always get the same index until DestroyAll. Once the heap is full, new descriptions still get a
+	// CPU descriptor but their index is kInvalidIndex.
+	uint32_t GetIndex();
+
+	// Holds every cached sampler at its stable index, for shaders that index samplers directly.
+	static ID3D12DescriptorHeap* GetShaderVisibleHeap();
+
+	static SamplerCacheStats GetCacheStats();
+
+	static void DestroyAll();
 };
 
 }	// namespace Graphics.
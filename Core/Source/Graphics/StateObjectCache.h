@@ -0,0 +1,154 @@
+//
+// Thread safe cache of device state objects (PSOs, root signatures) keyed by their full description.
+//
+
+#pragma once
+
+#include "Hash.h"
+#include "../Core/SystemTime.h"
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <ppltasks.h>
+#include <tuple>
+#include <unordered_map>
+
+namespace Graphics {
+
+struct StateCacheStats {
+	uint64_t Hits;				// lookups that found an object, including the ones that waited
+	uint64_t Misses;			// lookups that created the object
+	uint64_t Waits;				// hits that blocked until another thread finished creating the object
+	double WaitMilliseconds;	// total time spent blocked
+};
+
+template <typename ObjectType, typename KeyType = StateKey, typename KeyHasher = StateKeyHasher>
+class StateObjectCache;
+
+// Completion state of one cached object. Entries keep their address until the cache is cleared.
+template <typename ObjectType>
+class StateObjectEntry {
+	template <typename, typename, typename> friend class StateObjectCache;
+
+public:
+	StateObjectEntry() : m_Published(nullptr) { m_Ready = m_Created.get_future().share(); }
+
+	bool IsReady() const { return m_Published.load(std::memory_order_acquire) != nullptr; }
+
+	// Blocks until the object is created.
+	ObjectType* Get() const {
+		ObjectType* Object = m_Published.load(std::memory_order_acquire);
+		return Object != nullptr ? Object : m_Ready.get();
+	}
+
+	const std::shared_future<ObjectType*>& GetFuture() const { return m_Ready; }
+
+private:
+	void Publish(ObjectType* Object) {
+		m_Object.Attach(Object);
+		m_Published.store(Object, std::memory_order_release);
+		m_Created.set_value(Object);
+	}
+
+	Microsoft::WRL::ComPtr<ObjectType> m_Object;
+	std::atomic<ObjectType*> m_Published;
+	std::promise<ObjectType*> m_Created;
+	std::shared_future<ObjectType*> m_Ready;
+};
+
+// The table is split into shards with their own lock, picked by the top bits of the key hash, so threads finalizing
+// different states rarely contend. The first thread to look up a key creates the object outside of any lock, or hands
+// the creation to the PPL worker pool. Threads asking for the same key meanwhile block on that entry's future instead
+// of spinning. KeyType needs GetHash and operator==, see StateKey and StaticStateKey.
+template <typename ObjectType, typename KeyType, typename KeyHasher>
+class StateObjectCache {
+public:
+	typedef StateObjectEntry<ObjectType> Entry;
+
+	StateObjectCache() : m_Hits(0), m_Misses(0), m_Waits(0), m_WaitTicks(0) {}
+
+	// Returns the object for Key. On a miss, Create() is called on this thread and must return a new reference, which
+	// the cache takes ownership of.
+	template <typename CreateFunc>
+	ObjectType* GetOrCreate(KeyType&& Key, CreateFunc Create) {
+		bool firstCompile = false;
+		Entry& KeyEntry = FindOrReserve(std::move(Key), firstCompile);
+
+		if (firstCompile) {
+			KeyEntry.Publish(Create());
+			return KeyEntry.m_Object.Get();
+		}
+
+		if (!KeyEntry.IsReady()) {
+			const int64_t StartTick = Core::SystemTime::GetCurrentTick();
+			KeyEntry.m_Ready.wait();
+			m_WaitTicks += Core::SystemTime::GetCurrentTick() - StartTick;
+			++m_Waits;
+		}
+		return KeyEntry.Get();
+	}
+
+	// Like GetOrCreate, but on a miss Create() runs on a worker thread and this returns immediately. Whatever Create()
+	// reads must stay valid until the entry is ready.
+	template <typename CreateFunc>
+	const Entry& GetOrCreateAsync(KeyType&& Key, CreateFunc Create) {
+		bool firstCompile = false;
+		Entry& KeyEntry = FindOrReserve(std::move(Key), firstCompile);
+
+		if (firstCompile) {
+			Entry* NewEntry = &KeyEntry;
+			Concurrency::create_task([NewEntry, Create]() { NewEntry->Publish(Create()); });
+		}
+		return KeyEntry;
+	}
+
+	StateCacheStats GetStats() const {
+		StateCacheStats Stats;
+		Stats.Hits = m_Hits;
+		Stats.Misses = m_Misses;
+		Stats.Waits = m_Waits;
+		Stats.WaitMilliseconds = Core::SystemTime::TicksToMillisecs(m_WaitTicks);
+		return Stats;
+	}
+
+	// Not thread safe, only call when no thread is finalizing states and no creation is pending.
+	void Clear() {
+		for (Shard& s : m_Shards)
+			s.Entries.clear();
+		m_Hits = m_Misses = m_Waits = 0;
+		m_WaitTicks = 0;
+	}
+
+private:
+	static const uint32_t kShardBits = 4;
+
+	Entry& FindOrReserve(KeyType&& Key, bool& firstCompile) {
+		Shard& KeyShard = m_Shards[Key.GetHash() >> (64 - kShardBits)];
+		std::lock_guard<std::mutex> CS(KeyShard.Mutex);
+		auto iter = KeyShard.Entries.find(Key);
+
+		// Reserve the entry so the next inquiry will find that someone got here first.
+		if (iter == KeyShard.Entries.end()) {
+			iter = KeyShard.Entries.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(Key)), std::forward_as_tuple()).first;
+			firstCompile = true;
+			++m_Misses;
+		} else {
+			++m_Hits;
+		}
+		return iter->second;
+	}
+
+	struct alignas(64) Shard {
+		std::mutex Mutex;
+		std::unordered_map<KeyType, Entry, KeyHasher> Entries;
+	};
+
+	Shard m_Shards[1 << kShardBits];
+
+	std::atomic<uint64_t> m_Hits;
+	std::atomic<uint64_t> m_Misses;
+	std::atomic<uint64_t> m_Waits;
+	std::atomic<int64_t> m_WaitTicks;
+};
+
+}	// namespace Graphics
@@ -0,0 +1,498 @@
+//
+// Root signature and PSO descriptions built at compile time, with their hashes precomputed.
+//
+
+#pragma once
+
+#include <array>
+#include <cstring>
+
+namespace Graphics {
+
+// Bit pattern of a float in a constant expression, where it can't be read through memory. Exact for finite values,
+// since scaling by powers of two doesn't round. Negative zero hashes like zero.
+constexpr uint32_t ConstexprFloatBits(float Value) {
+	if (Value == 0.0f)
+		return 0;
+
+	uint32_t Sign = 0;
+	if (Value < 0.0f) {
+		Sign = 0x80000000u;
+		Value = -Value;
+	}
+	if (Value > 3.402823466e+38f)
+		return Sign | 0x7F800000u;
+
+	int Exponent = 0;
+	while (Value >= 2.0f) {
+		Value *= 0.5f;
+		++Exponent;
+	}
+	while (Value < 1.0f && Exponent > -126) {
+		Value *= 2.0f;
+		--Exponent;
+	}
+
+	// Denormals
+	if (Value < 1.0f)
+		return Sign | (uint32_t)(Value * 8388608.0f);
+	return Sign | ((uint32_t)(Exponent + 127) << 23) | (uint32_t)((Value - 1.0f) * 8388608.0f);
+}
+
+// 64 bit FNV-1a over words with a murmur finalizer, usable in constant expressions. Not the same function as
+// HashRange, so static and runtime descriptions never share cache keys.
+class ConstexprHash {
+public:
+	constexpr ConstexprHash() : m_Hash(0xCBF29CE484222325ull) {}
+
+	constexpr void Add(uint32_t Value) { m_Hash = (m_Hash ^ Value) * 0x100000001B3ull; }
+	constexpr void AddFloat(float Value) { Add(ConstexprFloatBits(Value)); }
+
+	constexpr void AddString(const char* String) {
+		uint32_t Length = 0;
+		for (; String[Length] != '\0'; ++Length)
+			Add((uint8_t)String[Length]);
+		Add(Length);
+	}
+
+	constexpr uint64_t Get() const {
+		uint64_t Hash = m_Hash;
+		Hash ^= Hash >> 33;
+		Hash *= 0xFF51AFD7ED558CCDull;
+		Hash ^= Hash >> 33;
+		Hash *= 0xC4CEB9FE1A85EC53ull;
+		Hash ^= Hash >> 33;
+		return Hash;
+	}
+
+private:
+	uint64_t m_Hash;
+};
+
+// Cache key of a static description. It points at the description instead of copying its words, so a lookup neither
+// allocates nor hashes them. Descriptions of different types never compare equal.
+class StaticStateKey {
+public:
+	template <typename DescType>
+	explicit StaticStateKey(const DescType& Desc) : m_Hash(Desc.GetHash()), m_Desc(&Desc), m_Context(nullptr), m_Equal(&EqualDescs<DescType>) {}
+
+	// Objects also depending on runtime state, like a PSO on its root signature, add it here.
+	void BindContext(const void* Context, uint64_t ContextHash) {
+		m_Context = Context;
+		m_Hash ^= ContextHash;
+	}
+
+	uint64_t GetHash() const { return m_Hash; }
+
+	bool operator==(const StaticStateKey& rhs) const {
+		return m_Hash == rhs.m_Hash && m_Context == rhs.m_Context && m_Equal == rhs.m_Equal &&
+			(m_Desc == rhs.m_Desc || m_Equal(m_Desc, rhs.m_Desc));
+	}
+
+private:
+	template <typename DescType> static bool EqualDescs(const void* a, const void* b) {
+		return *(const DescType*)a == *(const DescType*)b;
+	}
+
+	uint64_t m_Hash;
+	const void* m_Desc;
+	const void* m_Context;
+	bool (*m_Equal)(const void*, const void*);
+};
+
+struct StaticStateKeyHasher {
+	size_t operator()(const StaticStateKey& Key) const { return (size_t)Key.GetHash(); }
+};
+
+//
+// Root signatures
+//
+
+struct StaticRootParameter {
+	D3D12_ROOT_PARAMETER_TYPE Type;
+	D3D12_SHADER_VISIBILITY Visibility;
+	UINT Register;
+	UINT Count;			// 32 bit values of root constants, ranges of a table
+	UINT FirstRange;	// first range of a table in the description's range array
+};
+
+constexpr StaticRootParameter StaticRootConstants(UINT Register, UINT NumDwords, D3D12_SHADER_VISIBILITY Visibility = D3D12_SHADER_VISIBILITY_ALL) {
+	return { D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, Visibility, Register, NumDwords, 0 };
+}
+
+constexpr StaticRootParameter StaticRootConstantBuffer(UINT Register, D3D12_SHADER_VISIBILITY Visibility = D3D12_SHADER_VISIBILITY_ALL) {
+	return { D3D12_ROOT_PARAMETER_TYPE_CBV, Visibility, Register, 0, 0 };
+}
+
+constexpr StaticRootParameter StaticRootBufferSRV(UINT Register, D3D12_SHADER_VISIBILITY Visibility = D3D12_SHADER_VISIBILITY_ALL) {
+	return { D3D12_ROOT_PARAMETER_TYPE_SRV, Visibility, Register, 0, 0 };
+}
+
+constexpr StaticRootParameter StaticRootBufferUAV(UINT Register, D3D12_SHADER_VISIBILITY Visibility = D3D12_SHADER_VISIBILITY_ALL) {
+	return { D3D12_ROOT_PARAMETER_TYPE_UAV, Visibility, Register, 0, 0 };
+}
+
+constexpr StaticRootParameter StaticRootTable(UINT FirstRange, UINT RangeCount, D3D12_SHADER_VISIBILITY Visibility = D3D12_SHADER_VISIBILITY_ALL) {
+	return { D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE, Visibility, 0, RangeCount, FirstRange };
+}
+
+constexpr D3D12_DESCRIPTOR_RANGE StaticDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE Type, UINT Register, UINT Count, UINT Space = 0) {
+	return { Type, Count, Register, Space, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND };
+}
+
+// Same defaults as SamplerDesc.
+constexpr D3D12_STATIC_SAMPLER_DESC StaticSampler(UINT Register, D3D12_FILTER Filter = D3D12_FILTER_ANISOTROPIC,
+	D3D12_TEXTURE_ADDRESS_MODE AddressMode = D3D12_TEXTURE_ADDRESS_MODE_WRAP,
+	D3D12_SHADER_VISIBILITY Visibility = D3D12_SHADER_VISIBILITY_ALL,
+	D3D12_COMPARISON_FUNC ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL,
+	D3D12_STATIC_BORDER_COLOR BorderColor = D3D12_STATIC_BORDER_COLOR_OPAQUE_WHITE) {
+	return { Filter, AddressMode, AddressMode, AddressMode, 0.0f, 16, ComparisonFunc, BorderColor, 0.0f, D3D12_FLOAT32_MAX, Register, 0, Visibility };
+}
+
+// What RootSignature needs from a static description, without its template parameters.
+struct StaticRootSignatureView {
+	const StaticRootParameter* Parameters;
+	UINT NumParameters;
+	const D3D12_DESCRIPTOR_RANGE* Ranges;
+	const D3D12_STATIC_SAMPLER_DESC* Samplers;
+	UINT NumSamplers;
+	D3D12_ROOT_SIGNATURE_FLAGS Flags;
+	uint32_t DescriptorTableBitMap;
+	uint32_t SamplerTableBitMap;
+	const uint32_t* DescriptorTableSize;
+	uint64_t Hash;
+};
+
+// Declare as constexpr, then pass to RootSignature::Finalize. The table bitmaps and sizes RootSignature::Finalize
+// computes at runtime are computed here along with the hash.
+template <size_t NumParameters, size_t NumRanges = 0, size_t NumSamplers = 0>
+class StaticRootSignatureDesc {
+public:
+	static_assert(NumParameters <= 16, "RootSignature tracks at most 16 parameters");
+
+	constexpr StaticRootSignatureDesc(const std::array<StaticRootParameter, NumParameters>& Parameters,
+		const std::array<D3D12_DESCRIPTOR_RANGE, NumRanges>& Ranges = {},
+		const std::array<D3D12_STATIC_SAMPLER_DESC, NumSamplers>& Samplers = {},
+		D3D12_ROOT_SIGNATURE_FLAGS Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE)
+		: m_Parameters(Parameters), m_Ranges(Ranges), m_Samplers(Samplers), m_Flags(Flags),
+		m_DescriptorTableBitMap(0), m_SamplerTableBitMap(0), m_DescriptorTableSize{}, m_Hash(0) {
+		ConstexprHash Hash;
+		Hash.Add((uint32_t)NumParameters);
+		Hash.Add((uint32_t)NumSamplers);
+		Hash.Add((uint32_t)Flags);
+
+		for (size_t i = 0; i < NumSamplers; ++i) {
+			const D3D12_STATIC_SAMPLER_DESC& Sampler = Samplers[i];
+			Hash.Add(Sampler.Filter);
+			Hash.Add(Sampler.AddressU);
+			Hash.Add(Sampler.AddressV);
+			Hash.Add(Sampler.AddressW);
+			Hash.AddFloat(Sampler.MipLODBias);
+			Hash.Add(Sampler.MaxAnisotropy);
+			Hash.Add(Sampler.ComparisonFunc);
+			Hash.Add(Sampler.BorderColor);
+			Hash.AddFloat(Sampler.MinLOD);
+			Hash.AddFloat(Sampler.MaxLOD);
+			Hash.Add(Sampler.ShaderRegister);
+			Hash.Add(Sampler.RegisterSpace);
+			Hash.Add(Sampler.ShaderVisibility);
+		}
+
+		for (size_t Param = 0; Param < NumParameters; ++Param) {
+			const StaticRootParameter& Parameter = Parameters[Param];
+			Hash.Add(Parameter.Type);
+			Hash.Add(Parameter.Visibility);
+			Hash.Add(Parameter.Count);
+
+			if (Parameter.Type != D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE) {
+				Hash.Add(Parameter.Register);
+				continue;
+			}
+
+			// Same bookkeeping as RootSignature::Finalize. A table without ranges has no first range to look at, and counts
+			// as an empty CBV/SRV/UAV table.
+			if (Parameter.Count > 0 && Ranges[Parameter.FirstRange].RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
+				m_SamplerTableBitMap |= (1 << Param);
+			else
+				m_DescriptorTableBitMap |= (1 << Param);
+
+			for (size_t i = Parameter.FirstRange; i < Parameter.FirstRange + Parameter.Count; ++i) {
+				Hash.Add(Ranges[i].RangeType);
+				Hash.Add(Ranges[i].NumDescriptors);
+				Hash.Add(Ranges[i].BaseShaderRegister);
+				Hash.Add(Ranges[i].RegisterSpace);
+				Hash.Add(Ranges[i].OffsetInDescriptorsFromTableStart);
+				m_DescriptorTableSize[Param] += Ranges[i].NumDescriptors;
+			}
+		}
+		m_Hash = Hash.Get();
+	}
+
+	constexpr uint64_t GetHash() const { return m_Hash; }
+
+	StaticRootSignatureView GetView() const {
+		StaticRootSignatureView View = { m_Parameters.data(), (UINT)NumParameters, m_Ranges.data(), m_Samplers.data(),
+			(UINT)NumSamplers, m_Flags, m_DescriptorTableBitMap, m_SamplerTableBitMap, m_DescriptorTableSize, m_Hash };
+		return View;
+	}
+
+	bool operator==(const StaticRootSignatureDesc& rhs) const {
+		return m_Flags == rhs.m_Flags &&
+			memcmp(m_Parameters.data(), rhs.m_Parameters.data(), NumParameters * sizeof(StaticRootParameter)) == 0 &&
+			memcmp(m_Ranges.data(), rhs.m_Ranges.data(), NumRanges * sizeof(D3D12_DESCRIPTOR_RANGE)) == 0 &&
+			memcmp(m_Samplers.data(), rhs.m_Samplers.data(), NumSamplers * sizeof(D3D12_STATIC_SAMPLER_DESC)) == 0;
+	}
+
+private:
+	std::array<StaticRootParameter, NumParameters> m_Parameters;
+	std::array<D3D12_DESCRIPTOR_RANGE, NumRanges> m_Ranges;
+	std::array<D3D12_STATIC_SAMPLER_DESC, NumSamplers> m_Samplers;
+	D3D12_ROOT_SIGNATURE_FLAGS m_Flags;
+	uint32_t m_DescriptorTableBitMap;
+	uint32_t m_SamplerTableBitMap;
+	uint32_t m_DescriptorTableSize[16];
+	uint64_t m_Hash;
+};
+
+//
+// Graphics PSOs
+//
+
+// Everything in a graphics PSO description but the shaders, input layout and root signature.
+struct StaticGraphicsState {
+	D3D12_BLEND_DESC BlendState;
+	D3D12_RASTERIZER_DESC RasterizerState;
+	D3D12_DEPTH_STENCIL_DESC DepthStencilState;
+	D3D12_PRIMITIVE_TOPOLOGY_TYPE PrimitiveTopologyType;
+	UINT NumRenderTargets;
+	DXGI_FORMAT RTVFormats[8];
+	DXGI_FORMAT DSVFormat;
+	UINT SampleMask;
+	DXGI_SAMPLE_DESC SampleDesc;
+	D3D12_INDEX_BUFFER_STRIP_CUT_VALUE IBStripCutValue;
+};
+
+constexpr void HashStaticState(ConstexprHash& Hash, const D3D12_BLEND_DESC& Blend) {
+	Hash.Add(Blend.AlphaToCoverageEnable);
+	Hash.Add(Blend.IndependentBlendEnable);
+	for (const D3D12_RENDER_TARGET_BLEND_DESC& Target : Blend.RenderTarget) {
+		Hash.Add(Target.BlendEnable);
+		Hash.Add(Target.LogicOpEnable);
+		Hash.Add(Target.SrcBlend);
+		Hash.Add(Target.DestBlend);
+		Hash.Add(Target.BlendOp);
+		Hash.Add(Target.SrcBlendAlpha);
+		Hash.Add(Target.DestBlendAlpha);
+		Hash.Add(Target.BlendOpAlpha);
+		Hash.Add(Target.LogicOp);
+		Hash.Add(Target.RenderTargetWriteMask);
+	}
+}
+
+constexpr void HashStaticState(ConstexprHash& Hash, const D3D12_RASTERIZER_DESC& Rasterizer) {
+	Hash.Add(Rasterizer.FillMode);
+	Hash.Add(Rasterizer.CullMode);
+	Hash.Add(Rasterizer.FrontCounterClockwise);
+	Hash.Add((uint32_t)Rasterizer.DepthBias);
+	Hash.AddFloat(Rasterizer.DepthBiasClamp);
+	Hash.AddFloat(Rasterizer.SlopeScaledDepthBias);
+	Hash.Add(Rasterizer.DepthClipEnable);
+	Hash.Add(Rasterizer.MultisampleEnable);
+	Hash.Add(Rasterizer.AntialiasedLineEnable);
+	Hash.Add(Rasterizer.ForcedSampleCount);
+	Hash.Add(Rasterizer.ConservativeRaster);
+}
+
+constexpr void HashStaticState(ConstexprHash& Hash, const D3D12_DEPTH_STENCILOP_DESC& StencilOp) {
+	Hash.Add(StencilOp.StencilFailOp);
+	Hash.Add(StencilOp.StencilDepthFailOp);
+	Hash.Add(StencilOp.StencilPassOp);
+	Hash.Add(StencilOp.StencilFunc);
+}
+
+constexpr void HashStaticState(ConstexprHash& Hash, const D3D12_DEPTH_STENCIL_DESC& DepthStencil) {
+	Hash.Add(DepthStencil.DepthEnable);
+	Hash.Add(DepthStencil.DepthWriteMask);
+	Hash.Add(DepthStencil.DepthFunc);
+	Hash.Add(DepthStencil.StencilEnable);
+	Hash.Add(DepthStencil.StencilReadMask);
+	Hash.Add(DepthStencil.StencilWriteMask);
+	HashStaticState(Hash, DepthStencil.FrontFace);
+	HashStaticState(Hash, DepthStencil.BackFace);
+}
+
+constexpr void HashStaticState(ConstexprHash& Hash, const StaticGraphicsState& State) {
+	HashStaticState(Hash, State.BlendState);
+	HashStaticState(Hash, State.RasterizerState);
+	HashStaticState(Hash, State.DepthStencilState);
+	Hash.Add(State.PrimitiveTopologyType);
+	Hash.Add(State.NumRenderTargets);
+	for (DXGI_FORMAT Format : State.RTVFormats)
+		Hash.Add(Format);
+	Hash.Add(State.DSVFormat);
+	Hash.Add(State.SampleMask);
+	Hash.Add(State.SampleDesc.Count);
+	Hash.Add(State.SampleDesc.Quality);
+	Hash.Add(State.IBStripCutValue);
+}
+
+// Field by field, the fields HashStaticState reads, so padding and the sign of a zero float never make equal states
+// compare unequal.
+inline bool EqualStaticState(const D3D12_BLEND_DESC& a, const D3D12_BLEND_DESC& b) {
+	if (a.AlphaToCoverageEnable != b.AlphaToCoverageEnable || a.IndependentBlendEnable != b.IndependentBlendEnable)
+		return false;
+	for (size_t i = 0; i < _countof(a.RenderTarget); ++i) {
+		const D3D12_RENDER_TARGET_BLEND_DESC& x = a.RenderTarget[i];
+		const D3D12_RENDER_TARGET_BLEND_DESC& y = b.RenderTarget[i];
+		if (x.BlendEnable != y.BlendEnable || x.LogicOpEnable != y.LogicOpEnable || x.SrcBlend != y.SrcBlend ||
+			x.DestBlend != y.DestBlend || x.BlendOp != y.BlendOp || x.SrcBlendAlpha != y.SrcBlendAlpha ||
+			x.DestBlendAlpha != y.DestBlendAlpha || x.BlendOpAlpha != y.BlendOpAlpha || x.LogicOp != y.LogicOp ||
+			x.RenderTargetWriteMask != y.RenderTargetWriteMask)
+			return false;
+	}
+	return true;
+}
+
+inline bool EqualStaticState(const D3D12_RASTERIZER_DESC& a, const D3D12_RASTERIZER_DESC& b) {
+	return a.FillMode == b.FillMode && a.CullMode == b.CullMode && a.FrontCounterClockwise == b.FrontCounterClockwise &&
+		a.DepthBias == b.DepthBias && a.DepthBiasClamp == b.DepthBiasClamp && a.SlopeScaledDepthBias == b.SlopeScaledDepthBias &&
+		a.DepthClipEnable == b.DepthClipEnable && a.MultisampleEnable == b.MultisampleEnable &&
+		a.AntialiasedLineEnable == b.AntialiasedLineEnable && a.ForcedSampleCount == b.ForcedSampleCount &&
+		a.ConservativeRaster == b.ConservativeRaster;
+}
+
+inline bool EqualStaticState(const D3D12_DEPTH_STENCILOP_DESC& a, const D3D12_DEPTH_STENCILOP_DESC& b) {
+	return a.StencilFailOp == b.StencilFailOp && a.StencilDepthFailOp == b.StencilDepthFailOp &&
+		a.StencilPassOp == b.StencilPassOp && a.StencilFunc == b.StencilFunc;
+}
+
+inline bool EqualStaticState(const D3D12_DEPTH_STENCIL_DESC& a, const D3D12_DEPTH_STENCIL_DESC& b) {
+	return a.DepthEnable == b.DepthEnable && a.DepthWriteMask == b.DepthWriteMask && a.DepthFunc == b.DepthFunc &&
+		a.StencilEnable == b.StencilEnable && a.StencilReadMask == b.StencilReadMask &&
+		a.StencilWriteMask == b.StencilWriteMask && EqualStaticState(a.FrontFace, b.FrontFace) &&
+		EqualStaticState(a.BackFace, b.BackFace);
+}
+
+inline bool EqualStaticState(const StaticGraphicsState& a, const StaticGraphicsState& b) {
+	if (!EqualStaticState(a.BlendState, b.BlendState) || !EqualStaticState(a.RasterizerState, b.RasterizerState) ||
+		!EqualStaticState(a.DepthStencilState, b.DepthStencilState))
+		return false;
+	for (size_t i = 0; i < _countof(a.RTVFormats); ++i) {
+		if (a.RTVFormats[i] != b.RTVFormats[i])
+			return false;
+	}
+	return a.PrimitiveTopologyType == b.PrimitiveTopologyType && a.NumRenderTargets == b.NumRenderTargets &&
+		a.DSVFormat == b.DSVFormat && a.SampleMask == b.SampleMask && a.SampleDesc.Count == b.SampleDesc.Count &&
+		a.SampleDesc.Quality == b.SampleDesc.Quality && a.IBStripCutValue == b.IBStripCutValue;
+}
+
+template <size_t Size>
+constexpr D3D12_SHADER_BYTECODE StaticShader(const BYTE (&Bytecode)[Size]) {
+	return { Bytecode, Size };
+}
+
+// Declare as constexpr, then pass to GraphicsPSO::Finalize after setting the root signature. The input layout is
+// used in place instead of being copied.
+template <size_t NumElements>
+class StaticGraphicsPSODesc {
+public:
+	constexpr StaticGraphicsPSODesc(const StaticGraphicsState& State, const std::array<D3D12_INPUT_ELEMENT_DESC, NumElements>& InputLayout,
+		D3D12_SHADER_BYTECODE VS, D3D12_SHADER_BYTECODE PS, D3D12_SHADER_BYTECODE GS = {},
+		D3D12_SHADER_BYTECODE HS = {}, D3D12_SHADER_BYTECODE DS = {})
+		: m_State(State), m_InputLayout(InputLayout), m_VS(VS), m_PS(PS), m_GS(GS), m_HS(HS), m_DS(DS), m_Hash(0) {
+		ConstexprHash Hash;
+		HashStaticState(Hash, State);
+
+		Hash.Add((uint32_t)NumElements);
+		for (size_t i = 0; i < NumElements; ++i) {
+			const D3D12_INPUT_ELEMENT_DESC& Element = InputLayout[i];
+			Hash.AddString(Element.SemanticName);
+			Hash.Add(Element.SemanticIndex);
+			Hash.Add(Element.Format);
+			Hash.Add(Element.InputSlot);
+			Hash.Add(Element.AlignedByteOffset);
+			Hash.Add(Element.InputSlotClass);
+			Hash.Add(Element.InstanceDataStepRate);
+		}
+
+		// Bytecode can't be read in a constant expression. The sizes go in here, and GetHash adds the pointers.
+		Hash.Add((uint32_t)VS.BytecodeLength);
+		Hash.Add((uint32_t)PS.BytecodeLength);
+		Hash.Add((uint32_t)GS.BytecodeLength);
+		Hash.Add((uint32_t)HS.BytecodeLength);
+		Hash.Add((uint32_t)DS.BytecodeLength);
+		m_Hash = Hash.Get();
+	}
+
+	// Shaders are identified by their static blobs, the same way equality compares them, so descs that share every
+	// state but the shaders don't share a bucket. A pointer can't become an integer in a constant expression, so the
+	// pointers are mixed in here, five multiplies on top of the precomputed hash.
+	uint64_t GetHash() const {
+		uint64_t Hash = m_Hash;
+		const D3D12_SHADER_BYTECODE* Shaders[] = { &m_VS, &m_PS, &m_GS, &m_HS, &m_DS };
+		for (const D3D12_SHADER_BYTECODE* Shader : Shaders)
+			Hash = (Hash ^ (uint64_t)(uintptr_t)Shader->pShaderBytecode) * 0x100000001B3ull;
+		return Hash;
+	}
+
+	const D3D12_INPUT_ELEMENT_DESC* GetInputLayout() const { return m_InputLayout.data(); }
+
+	// Sets every field but the root signature. The ones a static description has no say in, stream output, the
+	// cached blob and the flags, are cleared, since they are not part of its key and whatever an earlier runtime
+	// description left there would otherwise end up in a PSO cached under it.
+	void FillDesc(D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc) const {
+		Desc.StreamOutput = {};
+		Desc.CachedPSO = {};
+		Desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		Desc.NodeMask = 1;
+		Desc.BlendState = m_State.BlendState;
+		Desc.RasterizerState = m_State.RasterizerState;
+		Desc.DepthStencilState = m_State.DepthStencilState;
+		Desc.PrimitiveTopologyType = m_State.PrimitiveTopologyType;
+		Desc.NumRenderTargets = m_State.NumRenderTargets;
+		memcpy(Desc.RTVFormats, m_State.RTVFormats, sizeof(Desc.RTVFormats));
+		Desc.DSVFormat = m_State.DSVFormat;
+		Desc.SampleMask = m_State.SampleMask;
+		Desc.SampleDesc = m_State.SampleDesc;
+		Desc.IBStripCutValue = m_State.IBStripCutValue;
+		Desc.InputLayout.pInputElementDescs = NumElements > 0 ? m_InputLayout.data() : nullptr;
+		Desc.InputLayout.NumElements = (UINT)NumElements;
+		Desc.VS = m_VS;
+		Desc.PS = m_PS;
+		Desc.GS = m_GS;
+		Desc.HS = m_HS;
+		Desc.DS = m_DS;
+	}
+
+	bool operator==(const StaticGraphicsPSODesc& rhs) const {
+		if (!EqualStaticState(m_State, rhs.m_State) || !EqualShader(m_VS, rhs.m_VS) || !EqualShader(m_PS, rhs.m_PS) ||
+			!EqualShader(m_GS, rhs.m_GS) || !EqualShader(m_HS, rhs.m_HS) || !EqualShader(m_DS, rhs.m_DS))
+			return false;
+
+		for (size_t i = 0; i < NumElements; ++i) {
+			const D3D12_INPUT_ELEMENT_DESC& a = m_InputLayout[i];
+			const D3D12_INPUT_ELEMENT_DESC& b = rhs.m_InputLayout[i];
+			if (strcmp(a.SemanticName, b.SemanticName) != 0 || a.SemanticIndex != b.SemanticIndex || a.Format != b.Format ||
+				a.InputSlot != b.InputSlot || a.AlignedByteOffset != b.AlignedByteOffset ||
+				a.InputSlotClass != b.InputSlotClass || a.InstanceDataStepRate != b.InstanceDataStepRate)
+				return false;
+		}
+		return true;
+	}
+
+private:
+	static bool EqualShader(const D3D12_SHADER_BYTECODE& a, const D3D12_SHADER_BYTECODE& b) {
+		return a.pShaderBytecode == b.pShaderBytecode && a.BytecodeLength == b.BytecodeLength;
+	}
+
+	StaticGraphicsState m_State;
+	std::array<D3D12_INPUT_ELEMENT_DESC, NumElements> m_InputLayout;
+	D3D12_SHADER_BYTECODE m_VS;
+	D3D12_SHADER_BYTECODE m_PS;
+	D3D12_SHADER_BYTECODE m_GS;
+	D3D12_SHADER_BYTECODE m_HS;
+	D3D12_SHADER_BYTECODE m_DS;
+	uint64_t m_Hash;
+};
+
+}	// namespace Graphics
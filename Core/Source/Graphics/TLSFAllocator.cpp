@@ -0,0 +1,297 @@
+//
+// Two-level segregated fit allocator of offsets in a range.
+//
+// This file doesn't use the precompiled header, so that it builds on its own with the tests.
+//
+
+#include "TLSFAllocator.h"
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Graphics {
+
+namespace {
+
+// Index of the highest and lowest set bit. Value must not be 0.
+inline uint32_t HighestBit(uint32_t Value) {
+#if defined(_MSC_VER)
+	unsigned long Bit;
+	_BitScanReverse(&Bit, Value);
+	return Bit;
+#else
+	return 31 - __builtin_clz(Value);
+#endif
+}
+
+inline uint32_t LowestBit(uint32_t Value) {
+#if defined(_MSC_VER)
+	unsigned long Bit;
+	_BitScanForward(&Bit, Value);
+	return Bit;
+#else
+	return __builtin_ctz(Value);
+#endif
+}
+
+}	// anonymous namespace
+
+void TLSFAllocator::Create(uint64_t Capacity, uint64_t Granularity) {
+	assert(Granularity != 0 && (Granularity & (Granularity - 1)) == 0);
+	assert(Capacity % Granularity == 0 && Capacity / Granularity <= 0xFFFFFFFF && Capacity != 0);
+
+	Destroy();
+	m_Granularity = Granularity;
+	m_Capacity = (uint32_t)(Capacity / Granularity);
+
+	const uint32_t Index = NewBlock(0, m_Capacity);
+	InsertFree(Index);
+}
+
+void TLSFAllocator::Destroy() {
+	m_Capacity = 0;
+	m_UsedGranules = 0;
+	m_FreeGranules = 0;
+	m_Allocations = 0;
+	m_FreeBlocks = 0;
+
+	m_FirstLevelMap = 0;
+	for (uint32_t i = 0; i < kFirstLevelCount; ++i) {
+		m_SecondLevelMaps[i] = 0;
+		for (uint32_t j = 0; j < kSecondLevelCount; ++j)
+			m_FreeHeads[i][j] = kInvalidBlock;
+	}
+
+	m_Blocks.clear();
+	m_UnusedBlocks.clear();
+}
+
+void TLSFAllocator::GetBin(uint32_t Size, uint32_t& FirstLevel, uint32_t& SecondLevel) {
+	// Small sizes are binned linearly in the first level.
+	if (Size < kSecondLevelCount) {
+		FirstLevel = 0;
+		SecondLevel = Size;
+		return;
+	}
+
+	const uint32_t HighBit = HighestBit(Size);
+	FirstLevel = HighBit - kSecondLevelBits + 1;
+	SecondLevel = (Size >> (HighBit - kSecondLevelBits)) - kSecondLevelCount;
+}
+
+uint32_t TLSFAllocator::NewBlock(uint32_t Offset, uint32_t Size) {
+	uint32_t Index;
+	if (!m_UnusedBlocks.empty()) {
+		Index = m_UnusedBlocks.back();
+		m_UnusedBlocks.pop_back();
+	} else {
+		Index = (uint32_t)m_Blocks.size();
+		m_Blocks.emplace_back();
+	}
+
+	Block& Created = m_Blocks[Index];
+	Created.Offset = Offset;
+	Created.Size = Size;
+	Created.PrevPhysical = kInvalidBlock;
+	Created.NextPhysical = kInvalidBlock;
+	Created.PrevFree = kInvalidBlock;
+	Created.NextFree = kInvalidBlock;
+	Created.IsFree = false;
+	return Index;
+}
+
+void TLSFAllocator::ReleaseBlock(uint32_t Index) {
+	m_UnusedBlocks.push_back(Index);
+}
+
+void TLSFAllocator::InsertFree(uint32_t Index) {
+	Block& FreeBlock = m_Blocks[Index];
+	uint32_t FirstLevel, SecondLevel;
+	GetBin(FreeBlock.Size, FirstLevel, SecondLevel);
+
+	const uint32_t Head = m_FreeHeads[FirstLevel][SecondLevel];
+	FreeBlock.IsFree = true;
+	FreeBlock.PrevFree = kInvalidBlock;
+	FreeBlock.NextFree = Head;
+	if (Head != kInvalidBlock)
+		m_Blocks[Head].PrevFree = Index;
+
+	m_FreeHeads[FirstLevel][SecondLevel] = Index;
+	m_SecondLevelMaps[FirstLevel] |= 1u << SecondLevel;
+	m_FirstLevelMap |= 1u << FirstLevel;
+
+	m_FreeGranules += FreeBlock.Size;
+	++m_FreeBlocks;
+}
+
+void TLSFAllocator::RemoveFree(uint32_t Index) {
+	Block& FreeBlock = m_Blocks[Index];
+	assert(FreeBlock.IsFree);
+
+	if (FreeBlock.PrevFree != kInvalidBlock) {
+		m_Blocks[FreeBlock.PrevFree].NextFree = FreeBlock.NextFree;
+	} else {
+		uint32_t FirstLevel, SecondLevel;
+		GetBin(FreeBlock.Size, FirstLevel, SecondLevel);
+		m_FreeHeads[FirstLevel][SecondLevel] = FreeBlock.NextFree;
+		if (FreeBlock.NextFree == kInvalidBlock) {
+			m_SecondLevelMaps[FirstLevel] &= ~(1u << SecondLevel);
+			if (m_SecondLevelMaps[FirstLevel] == 0)
+				m_FirstLevelMap &= ~(1u << FirstLevel);
+		}
+	}
+
+	if (FreeBlock.NextFree != kInvalidBlock)
+		m_Blocks[FreeBlock.NextFree].PrevFree = FreeBlock.PrevFree;
+
+	FreeBlock.IsFree = false;
+	FreeBlock.PrevFree = kInvalidBlock;
+	FreeBlock.NextFree = kInvalidBlock;
+
+	m_FreeGranules -= FreeBlock.Size;
+	--m_FreeBlocks;
+}
+
+uint32_t TLSFAllocator::FindFree(uint32_t Size) const {
+	// Round up to the next bin so that any block found fits.
+	uint64_t SearchSize = Size;
+	if (Size >= kSecondLevelCount) {
+		const uint32_t HighBit = HighestBit(Size);
+		SearchSize += (1ull << (HighBit - kSecondLevelBits)) - 1;
+		if (SearchSize > 0xFFFFFFFF)
+			return kInvalidBlock;
+	}
+
+	uint32_t FirstLevel, SecondLevel;
+	GetBin((uint32_t)SearchSize, FirstLevel, SecondLevel);
+
+	uint32_t SecondLevelMap = m_SecondLevelMaps[FirstLevel] & (~0u << SecondLevel);
+	if (SecondLevelMap == 0) {
+		const uint32_t FirstLevelMap = FirstLevel + 1 < 32 ? m_FirstLevelMap & (~0u << (FirstLevel + 1)) : 0;
+		if (FirstLevelMap == 0)
+			return kInvalidBlock;
+
+		FirstLevel = LowestBit(FirstLevelMap);
+		SecondLevelMap = m_SecondLevelMaps[FirstLevel];
+	}
+
+	return m_FreeHeads[FirstLevel][LowestBit(SecondLevelMap)];
+}
+
+void TLSFAllocator::Split(uint32_t Index, uint32_t Size) {
+	assert(m_Blocks[Index].Size > Size);
+
+	const uint32_t Rest = NewBlock(m_Blocks[Index].Offset + Size, m_Blocks[Index].Size - Size);
+	Block& Current = m_Blocks[Index];
+	Block& RestBlock = m_Blocks[Rest];
+
+	RestBlock.PrevPhysical = Index;
+	RestBlock.NextPhysical = Current.NextPhysical;
+	if (Current.NextPhysical != kInvalidBlock)
+		m_Blocks[Current.NextPhysical].PrevPhysical = Rest;
+	Current.NextPhysical = Rest;
+	Current.Size = Size;
+
+	InsertFree(Rest);
+}
+
+void TLSFAllocator::Merge(uint32_t Index, uint32_t Next) {
+	Block& Current = m_Blocks[Index];
+	const Block& NextBlock = m_Blocks[Next];
+	assert(Current.NextPhysical == Next && Current.Offset + Current.Size == NextBlock.Offset);
+
+	Current.Size += NextBlock.Size;
+	Current.NextPhysical = NextBlock.NextPhysical;
+	if (NextBlock.NextPhysical != kInvalidBlock)
+		m_Blocks[NextBlock.NextPhysical].PrevPhysical = Index;
+
+	ReleaseBlock(Next);
+}
+
+uint32_t TLSFAllocator::Allocate(uint64_t Size, uint64_t Alignment, uint64_t& Offset) {
+	assert(m_Capacity != 0 && "Allocating from a TLSFAllocator that wasn't created");
+	assert(Alignment != 0 && (Alignment & (Alignment - 1)) == 0);
+
+	const uint64_t Granules = (Size + m_Granularity - 1) / m_Granularity;
+	const uint64_t AlignGranules = Alignment > m_Granularity ? Alignment / m_Granularity : 1;
+
+	// Any block this big can be aligned by giving away its start.
+	const uint64_t SearchGranules = Granules + AlignGranules - 1;
+	if (Granules == 0 || SearchGranules > m_FreeGranules)
+		return kInvalidBlock;
+
+	const uint32_t Index = FindFree((uint32_t)SearchGranules);
+	if (Index == kInvalidBlock)
+		return kInvalidBlock;
+
+	RemoveFree(Index);
+
+	// The previous physical block is in use, otherwise the two would have been merged, so the padding stands alone.
+	const uint32_t Padding = (uint32_t)((AlignGranules - m_Blocks[Index].Offset % AlignGranules) % AlignGranules);
+	uint32_t Allocated = Index;
+	if (Padding != 0) {
+		Split(Index, Padding);
+		Allocated = m_Blocks[Index].NextPhysical;
+		RemoveFree(Allocated);
+		InsertFree(Index);
+	}
+
+	if (m_Blocks[Allocated].Size > Granules)
+		Split(Allocated, (uint32_t)Granules);
+
+	m_UsedGranules += (uint32_t)Granules;
+	++m_Allocations;
+
+	Offset = (uint64_t)m_Blocks[Allocated].Offset * m_Granularity;
+	return Allocated;
+}
+
+void TLSFAllocator::Free(uint32_t Index) {
+	assert(Index < m_Blocks.size() && !m_Blocks[Index].IsFree && "Freeing a TLSF block twice");
+
+	m_UsedGranules -= m_Blocks[Index].Size;
+	--m_Allocations;
+
+	const uint32_t Next = m_Blocks[Index].NextPhysical;
+	if (Next != kInvalidBlock && m_Blocks[Next].IsFree) {
+		RemoveFree(Next);
+		Merge(Index, Next);
+	}
+
+	const uint32_t Prev = m_Blocks[Index].PrevPhysical;
+	if (Prev != kInvalidBlock && m_Blocks[Prev].IsFree) {
+		RemoveFree(Prev);
+		Merge(Prev, Index);
+		InsertFree(Prev);
+	} else {
+		InsertFree(Index);
+	}
+}
+
+TLSFStats TLSFAllocator::GetStats() const {
+	TLSFStats Stats;
+	Stats.Capacity = GetCapacity();
+	Stats.UsedBytes = (uint64_t)m_UsedGranules * m_Granularity;
+	Stats.FreeBytes = (uint64_t)m_FreeGranules * m_Granularity;
+	Stats.Allocations = m_Allocations;
+	Stats.FreeBlocks = m_FreeBlocks;
+	Stats.LargestFreeBlock = 0;
+
+	// The largest block is in the highest non-empty bin, which isn't sorted.
+	if (m_FirstLevelMap != 0) {
+		const uint32_t FirstLevel = HighestBit(m_FirstLevelMap);
+		const uint32_t SecondLevel = HighestBit(m_SecondLevelMaps[FirstLevel]);
+
+		uint32_t Largest = 0;
+		for (uint32_t Index = m_FreeHeads[FirstLevel][SecondLevel]; Index != kInvalidBlock; Index = m_Blocks[Index].NextFree)
+			Largest = Largest > m_Blocks[Index].Size ? Largest : m_Blocks[Index].Size;
+		Stats.LargestFreeBlock = (uint64_t)Largest * m_Granularity;
+	}
+
+	Stats.Fragmentation = Stats.FreeBytes == 0 ? 0.0f : 1.0f - (float)((double)Stats.LargestFreeBlock / Stats.FreeBytes);
+	return Stats;
+}
+
+}	// namespace Graphics
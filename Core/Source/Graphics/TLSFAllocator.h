@@ -0,0 +1,93 @@
+//
+// Two-level segregated fit allocator of offsets in a range, used to place resources in heaps. It only hands out offsets
+// and never touches the memory it describes, so it doesn't depend on the device.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Graphics {
+
+struct TLSFStats {
+	uint64_t Capacity;
+	uint64_t UsedBytes;			// allocated sizes rounded up to the granularity, without alignment padding
+	uint64_t FreeBytes;
+	uint64_t LargestFreeBlock;
+	uint32_t Allocations;
+	uint32_t FreeBlocks;
+	float Fragmentation;		// 1 - LargestFreeBlock / FreeBytes, 0 when all the free space is a single block
+};
+
+// Free blocks are binned by the position of their highest bit, then by the kSecondLevelBits bits below it, with a
+// bitmap at each level. The search rounds the requested size up to the next bin, so the first block of any non-empty
+// bin at or above it fits and both allocation and release take constant time. Released blocks are merged with their
+// free neighbors. Sizes and offsets are counted in granules, which is what lets 32 bit fields cover large heaps.
+class TLSFAllocator {
+public:
+	static const uint32_t kInvalidBlock = ~0u;
+	static const uint32_t kSecondLevelBits = 5;
+
+	TLSFAllocator() : m_Granularity(0) { Destroy(); }
+
+	// Granularity must be a power of two, and Capacity a multiple of it.
+	void Create(uint64_t Capacity, uint64_t Granularity);
+	void Destroy();
+
+	// Returns kInvalidBlock when no free block can hold Size at Alignment, which must be a power of two.
+	uint32_t Allocate(uint64_t Size, uint64_t Alignment, uint64_t& Offset);
+	void Free(uint32_t Block);
+
+	uint64_t GetCapacity() const { return (uint64_t)m_Capacity * m_Granularity; }
+	uint64_t GetGranularity() const { return m_Granularity; }
+	bool IsEmpty() const { return m_Allocations == 0; }
+
+	TLSFStats GetStats() const;
+
+private:
+	static const uint32_t kSecondLevelCount = 1 << kSecondLevelBits;
+	static const uint32_t kFirstLevelCount = 32 - kSecondLevelBits + 1;
+
+	// Offsets and sizes in granules. Blocks are linked by index to their physical neighbors, and to the other blocks
+	// of their bin while free.
+	struct Block {
+		uint32_t Offset;
+		uint32_t Size;
+		uint32_t PrevPhysical;
+		uint32_t NextPhysical;
+		uint32_t PrevFree;
+		uint32_t NextFree;
+		bool IsFree;
+	};
+
+	static void GetBin(uint32_t Size, uint32_t& FirstLevel, uint32_t& SecondLevel);
+
+	uint32_t NewBlock(uint32_t Offset, uint32_t Size);
+	void ReleaseBlock(uint32_t Index);
+	void InsertFree(uint32_t Index);
+	void RemoveFree(uint32_t Index);
+	uint32_t FindFree(uint32_t Size) const;
+
+	// Splits the end of a block from Size on into a new free block.
+	void Split(uint32_t Index, uint32_t Size);
+
+	// Absorbs Next, its free physical successor, into Index.
+	void Merge(uint32_t Index, uint32_t Next);
+
+	uint64_t m_Granularity;
+	uint32_t m_Capacity;
+	uint32_t m_UsedGranules;
+	uint32_t m_FreeGranules;
+	uint32_t m_Allocations;
+	uint32_t m_FreeBlocks;
+
+	uint32_t m_FirstLevelMap;
+	uint32_t m_SecondLevelMaps[kFirstLevelCount];
+	uint32_t m_FreeHeads[kFirstLevelCount][kSecondLevelCount];
+
+	std::vector<Block> m_Blocks;
+	std::vector<uint32_t> m_UnusedBlocks;
+};
+
+}	// namespace Graphics
@@ -41,15 +41,11 @@ void Texture::Create(size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Form
 	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 	texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-	D3D12_HEAP_PROPERTIES HeapProps;
-	HeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-	HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	HeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	HeapProps.CreationNodeMask = 1;
-	HeapProps.VisibleNodeMask = 1;
-
-	ASSERT_SUCCEEDED(g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE, &texDesc,
-		m_UsageState, nullptr, MY_IID_PPV_ARGS(m_pResource.ReleaseAndGetAddressOf())));
+	m_pResource = nullptr;
+	GpuHeapAllocator::Free(m_HeapAllocation);
+
+	ASSERT_SUCCEEDED(GpuHeapAllocator::CreateResource(D3D12_HEAP_TYPE_DEFAULT, texDesc, m_UsageState, nullptr,
+		m_HeapAllocation, m_pResource.ReleaseAndGetAddressOf()));
 	m_pResource->SetName(L"Texture");
 
 	D3D12_SUBRESOURCE_DATA texResource;
@@ -0,0 +1,116 @@
+//
+// Copies interleaved vertices into a new layout while converting selected float attributes to half precision.
+//
+
+#include "pch.h"
+#include "VertexRepacking.h"
+#include "DDSTextureLoader.h"
+#include "../Math/HalfFloat.h"
+
+namespace Graphics {
+
+using namespace DirectX;
+
+// Bytes of repacked vertices assembled locally before each copy to Dest.
+static const size_t kRepackBlockSize = 16384;
+
+static uint32_t FloatComponentCount(DXGI_FORMAT Format) {
+	switch (Format) {
+	case DXGI_FORMAT_R32_FLOAT:				return 1;
+	case DXGI_FORMAT_R32G32_FLOAT:			return 2;
+	case DXGI_FORMAT_R32G32B32_FLOAT:		return 3;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:	return 4;
+	default:								return 0;
+	}
+}
+
+static uint32_t HalfComponentCount(DXGI_FORMAT Format) {
+	switch (Format) {
+	case DXGI_FORMAT_R16_FLOAT:				return 1;
+	case DXGI_FORMAT_R16G16_FLOAT:			return 2;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:	return 4;
+	default:								return 0;
+	}
+}
+
+// Three component sources are padded with w = 1.
+static INLINE void ConvertToHalf(const float* Source, uint32_t Components, uint16_t* Dest) {
+#if defined(MATH_BACKEND_AVX2)
+	__m128 Value;
+	switch (Components) {
+	case 1: Value = _mm_load_ss(Source); break;
+	case 2: Value = _mm_castpd_ps(_mm_load_sd((const double*)Source)); break;
+	case 3: Value = XMVectorSelect(g_XMOne, XMLoadFloat3((const XMFLOAT3*)Source), g_XMSelect1110); break;
+	default: Value = _mm_loadu_ps(Source); break;
+	}
+
+	const __m128i Half = _mm_cvtps_ph(Value, _MM_FROUND_TO_NEAREST_INT);
+	switch (Components) {
+	case 1: Dest[0] = (uint16_t)_mm_extract_epi16(Half, 0); break;
+	case 2: *(int32_t*)Dest = _mm_cvtsi128_si32(Half); break;
+	default: _mm_storel_epi64((__m128i*)Dest, Half); break;
+	}
+#else
+	for (uint32_t c = 0; c < Components; ++c)
+		Dest[c] = Math::FloatToHalf(Source[c]);
+	if (Components == 3)
+		Dest[3] = Math::FloatToHalf(1.0f);
+#endif
+}
+
+void RepackVertices(const void* Source, size_t SourceStride, size_t VertexCount, const VertexAttributeRepack* Attributes,
+	uint32_t AttributeCount, void* Dest, size_t DestStride) {
+	ASSERT(DestStride > 0 && DestStride <= D3D12_REQ_MULTI_ELEMENT_STRUCTURE_SIZE_IN_BYTES);
+	ASSERT(AttributeCount <= D3D12_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT);
+
+	// Components to convert, or zero to copy Size bytes.
+	struct AttributeCopy {
+		uint32_t SourceOffset;
+		uint32_t DestOffset;
+		uint32_t Components;
+		uint32_t Size;
+	} Copies[D3D12_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT];
+
+	for (uint32_t i = 0; i < AttributeCount; ++i) {
+		const VertexAttributeRepack& Attribute = Attributes[i];
+		AttributeCopy& Copy = Copies[i];
+		Copy.SourceOffset = Attribute.SourceOffset;
+		Copy.DestOffset = Attribute.DestOffset;
+		Copy.Size = (uint32_t)BitsPerPixel(Attribute.DestFormat) / 8;
+
+		if (Attribute.DestFormat == Attribute.SourceFormat) {
+			Copy.Components = 0;
+		} else {
+			Copy.Components = FloatComponentCount(Attribute.SourceFormat);
+			const uint32_t HalfComponents = HalfComponentCount(Attribute.DestFormat);
+			ASSERT(Copy.Components > 0 && HalfComponents > 0 && (HalfComponents == Copy.Components || Copy.Components == 3 && HalfComponents == 4),
+				"Vertex attributes can only be copied or converted from 32 bit to 16 bit floats");
+		}
+
+		ASSERT(Copy.Size > 0 && Copy.DestOffset + Copy.Size <= DestStride, "Vertex attribute exceeds the repacked stride");
+	}
+
+	uint8_t Block[kRepackBlockSize];
+	const size_t VerticesPerBlock = kRepackBlockSize / DestStride;
+
+	for (size_t First = 0; First < VertexCount; First += VerticesPerBlock) {
+		const size_t Count = VertexCount - First < VerticesPerBlock ? VertexCount - First : VerticesPerBlock;
+		memset(Block, 0, Count * DestStride);
+
+		const uint8_t* SourceVertex = (const uint8_t*)Source + First * SourceStride;
+		uint8_t* DestVertex = Block;
+		for (size_t v = 0; v < Count; ++v, SourceVertex += SourceStride, DestVertex += DestStride) {
+			for (uint32_t i = 0; i < AttributeCount; ++i) {
+				const AttributeCopy& Copy = Copies[i];
+				if (Copy.Components > 0)
+					ConvertToHalf((const float*)(SourceVertex + Copy.SourceOffset), Copy.Components, (uint16_t*)(DestVertex + Copy.DestOffset));
+				else
+					memcpy(DestVertex + Copy.DestOffset, SourceVertex + Copy.SourceOffset, Copy.Size);
+			}
+		}
+
+		memcpy((uint8_t*)Dest + First * DestStride, Block, Count * DestStride);
+	}
+}
+
+}	// namespace Graphics
@@ -0,0 +1,24 @@
+//
+// Copies interleaved vertices into a new layout while converting selected float attributes to half precision, e.g.
+// normals and UVs, so they can be written straight into upload memory before GpuBuffer::Create.
+//
+
+#pragma once
+
+namespace Graphics {
+
+struct VertexAttributeRepack {
+	uint32_t SourceOffset;		// bytes into the source vertex
+	uint32_t DestOffset;		// bytes into the repacked vertex
+	DXGI_FORMAT SourceFormat;
+	// SourceFormat to copy the attribute unchanged, or the 16 bit float format with as many components to convert a
+	// 32 bit float attribute. Three components become R16G16B16A16_FLOAT with w set to 1.
+	DXGI_FORMAT DestFormat;
+};
+
+// Bytes of Dest not covered by an attribute are zeroed. Every repacked vertex is assembled in a local buffer and written
+// in order, which keeps writes to write combined upload memory sequential.
+void RepackVertices(const void* Source, size_t SourceStride, size_t VertexCount, const VertexAttributeRepack* Attributes,
+	uint32_t AttributeCount, void* Dest, size_t DestStride);
+
+}	// namespace Graphics
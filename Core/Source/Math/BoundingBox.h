@@ -0,0 +1,67 @@
+//
+// Axis aligned bounding box operations.
+//
+
+#pragma once
+
+#include "VectorMath.h"
+#include "BoundingSphere.h"
+
+namespace Math {
+
+class BoundingBox {
+public:
+	BoundingBox() {}
+	BoundingBox(Vector3 minBound, Vector3 maxBound) : m_min(minBound), m_max(maxBound) {}
+
+	// An empty box has min > max, so that including any point or box yields that point or box.
+	static INLINE BoundingBox MakeEmpty() {
+		return BoundingBox(Vector3(Scalar(DirectX::g_XMFltMax)), Vector3(-Scalar(DirectX::g_XMFltMax)));
+	}
+
+	Vector3 GetMin(void) const { return m_min; }
+	Vector3 GetMax(void) const { return m_max; }
+	Vector3 GetCenter(void) const { return (m_min + m_max) * 0.5f; }
+	Vector3 GetExtent(void) const { return (m_max - m_min) * 0.5f; }
+	bool IsEmpty(void) const { return !DirectX::XMVector3LessOrEqual(m_min, m_max); }
+
+	void Include(Vector3 point) { m_min = Min(m_min, point); m_max = Max(m_max, point); }
+	void Include(const BoundingBox& box) { m_min = Min(m_min, box.m_min); m_max = Max(m_max, box.m_max); }
+
+	// The sphere circumscribing the box. Not the tightest sphere of the underlying points.
+	BoundingSphere GetCircumscribedSphere(void) const { return BoundingSphere(GetCenter(), Length(GetExtent())); }
+
+	// Transform the box and return the axis aligned box of the result. The extent is projected onto the absolute
+	// basis vectors (Arvo's method) instead of transforming the eight corners.
+	friend BoundingBox operator* (const AffineTransform& xform, const BoundingBox& box) {
+		Vector3 center = xform * box.GetCenter();
+		Vector3 extent = box.GetExtent();
+		Vector3 newExtent = Abs(xform.GetX()) * extent.GetX() + Abs(xform.GetY()) * extent.GetY() + Abs(xform.GetZ()) * extent.GetZ();
+		return BoundingBox(center - newExtent, center + newExtent);
+	}
+
+private:
+	Vector3 m_min;
+	Vector3 m_max;
+};
+
+// Inline methods.
+INLINE BoundingBox Union(const BoundingBox& a, const BoundingBox& b) {
+	return BoundingBox(Min(a.GetMin(), b.GetMin()), Max(a.GetMax(), b.GetMax()));
+}
+
+// The smallest sphere enclosing both spheres.
+INLINE BoundingSphere Union(BoundingSphere a, BoundingSphere b) {
+	Vector3 offset = b.GetCenter() - a.GetCenter();
+	float distance = Length(offset);
+	float ra = a.GetRadius();
+	float rb = b.GetRadius();
+	if (distance + rb <= ra)
+		return a;
+	if (distance + ra <= rb)
+		return b;
+	float radius = (distance + ra + rb) * 0.5f;
+	return BoundingSphere(a.GetCenter() + offset * ((radius - ra) / distance), radius);
+}
+
+}	// namespace Math
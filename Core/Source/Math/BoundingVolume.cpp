@@ -0,0 +1,229 @@
+//
+// Bounding volume construction from vertex position streams.
+//
+
+#include "pch.h"
+#include "BoundingVolume.h"
+#include "Parallel.h"
+
+using namespace DirectX;
+
+namespace Math {
+
+static INLINE XMVECTOR LoadPosition(const uint8_t* Base, size_t Index, size_t Stride) {
+	return XMLoadFloat3((const XMFLOAT3*)(Base + Index * Stride));
+}
+
+// Run Func(Begin, End, ChunkIndex) over the chunks of the stream, in parallel when there is more than one chunk.
+template <typename T>
+static void ForEachChunk(size_t Count, const T& Func) {
+	const size_t ChunkCount = DivideByMultiple(Count, kBoundingVolumeChunkSize);
+	auto Body = [&](size_t Chunk) {
+		const size_t Begin = Chunk * kBoundingVolumeChunkSize;
+		const size_t End = Begin + kBoundingVolumeChunkSize < Count ? Begin + kBoundingVolumeChunkSize : Count;
+		Func(Begin, End, Chunk);
+	};
+	if (ChunkCount > 1)
+		ParallelFor(size_t(0), ChunkCount, Body);
+	else if (ChunkCount == 1)
+		Body(0);
+}
+
+BoundingBox ComputeBoundingBox(const void* Positions, size_t Count, size_t Stride) {
+	const uint8_t* Base = (const uint8_t*)Positions;
+	std::vector<BoundingBox> ChunkBounds(DivideByMultiple(Count, kBoundingVolumeChunkSize));
+
+	ForEachChunk(Count, [&](size_t Begin, size_t End, size_t Chunk) {
+		// Two independent accumulators hide the latency of min/max.
+		XMVECTOR Min0 = g_XMFltMax, Min1 = g_XMFltMax;
+		XMVECTOR Max0 = XMVectorNegate(g_XMFltMax), Max1 = Max0;
+		size_t i = Begin;
+		for (; i + 1 < End; i += 2) {
+			XMVECTOR P0 = LoadPosition(Base, i, Stride);
+			XMVECTOR P1 = LoadPosition(Base, i + 1, Stride);
+			Min0 = XMVectorMin(Min0, P0); Max0 = XMVectorMax(Max0, P0);
+			Min1 = XMVectorMin(Min1, P1); Max1 = XMVectorMax(Max1, P1);
+		}
+		if (i < End) {
+			XMVECTOR P = LoadPosition(Base, i, Stride);
+			Min0 = XMVectorMin(Min0, P); Max0 = XMVectorMax(Max0, P);
+		}
+		ChunkBounds[Chunk] = BoundingBox(Vector3(XMVectorMin(Min0, Min1)), Vector3(XMVectorMax(Max0, Max1)));
+	});
+
+	return MergeBounds(ChunkBounds.data(), ChunkBounds.size());
+}
+
+namespace {
+
+// Extremal points along the 7 EPOS-14 directions. Lane group A holds the axes (x, y, z, x), lane group B the
+// diagonals (1,1,1), (1,1,-1), (1,-1,1), (1,-1,-1). For each lane, the coordinates of the extremal point are kept in
+// separate x/y/z vectors so no index bookkeeping is needed.
+struct ExtremalPoints {
+	XMVECTOR MinProj[2], MaxProj[2];
+	XMVECTOR MinX[2], MinY[2], MinZ[2];
+	XMVECTOR MaxX[2], MaxY[2], MaxZ[2];
+
+	void Reset() {
+		for (int g = 0; g < 2; ++g) {
+			MinProj[g] = g_XMFltMax;
+			MaxProj[g] = XMVectorNegate(g_XMFltMax);
+			MinX[g] = MinY[g] = MinZ[g] = MaxX[g] = MaxY[g] = MaxZ[g] = XMVectorZero();
+		}
+	}
+
+	INLINE void Add(FXMVECTOR P) {
+		const XMVECTOR X = XMVectorSplatX(P);
+		const XMVECTOR Y = XMVectorSplatY(P);
+		const XMVECTOR Z = XMVectorSplatZ(P);
+		static const XMVECTORF32 kSignY = { 1.0f, 1.0f, -1.0f, -1.0f };
+		static const XMVECTORF32 kSignZ = { 1.0f, -1.0f, 1.0f, -1.0f };
+
+		XMVECTOR Proj[2];
+		Proj[0] = XMVectorSwizzle<0, 1, 2, 0>(P);
+		Proj[1] = XMVectorMultiplyAdd(Z, kSignZ, XMVectorMultiplyAdd(Y, kSignY, X));
+
+		for (int g = 0; g < 2; ++g) {
+			XMVECTOR Less = XMVectorLess(Proj[g], MinProj[g]);
+			MinProj[g] = XMVectorSelect(MinProj[g], Proj[g], Less);
+			MinX[g] = XMVectorSelect(MinX[g], X, Less);
+			MinY[g] = XMVectorSelect(MinY[g], Y, Less);
+			MinZ[g] = XMVectorSelect(MinZ[g], Z, Less);
+
+			XMVECTOR Greater = XMVectorGreater(Proj[g], MaxProj[g]);
+			MaxProj[g] = XMVectorSelect(MaxProj[g], Proj[g], Greater);
+			MaxX[g] = XMVectorSelect(MaxX[g], X, Greater);
+			MaxY[g] = XMVectorSelect(MaxY[g], Y, Greater);
+			MaxZ[g] = XMVectorSelect(MaxZ[g], Z, Greater);
+		}
+	}
+
+	void Merge(const ExtremalPoints& Other) {
+		for (int g = 0; g < 2; ++g) {
+			XMVECTOR Less = XMVectorLess(Other.MinProj[g], MinProj[g]);
+			MinProj[g] = XMVectorSelect(MinProj[g], Other.MinProj[g], Less);
+			MinX[g] = XMVectorSelect(MinX[g], Other.MinX[g], Less);
+			MinY[g] = XMVectorSelect(MinY[g], Other.MinY[g], Less);
+			MinZ[g] = XMVectorSelect(MinZ[g], Other.MinZ[g], Less);
+
+			XMVECTOR Greater = XMVectorGreater(Other.MaxProj[g], MaxProj[g]);
+			MaxProj[g] = XMVectorSelect(MaxProj[g], Other.MaxProj[g], Greater);
+			MaxX[g] = XMVectorSelect(MaxX[g], Other.MaxX[g], Greater);
+			MaxY[g] = XMVectorSelect(MaxY[g], Other.MaxY[g], Greater);
+			MaxZ[g] = XMVectorSelect(MaxZ[g], Other.MaxZ[g], Greater);
+		}
+	}
+};
+
+}	// anonymous namespace
+
+BoundingSphere ComputeBoundingSphere(const void* Positions, size_t Count, size_t Stride) {
+	if (Count == 0)
+		return BoundingSphere(Vector4(EZeroTag::kZero));
+
+	const uint8_t* Base = (const uint8_t*)Positions;
+	const size_t ChunkCount = DivideByMultiple(Count, kBoundingVolumeChunkSize);
+
+	// Pass 1: extremal points.
+	std::vector<ExtremalPoints> ChunkExtremes(ChunkCount);
+	ForEachChunk(Count, [&](size_t Begin, size_t End, size_t Chunk) {
+		ExtremalPoints Extremes;
+		Extremes.Reset();
+		for (size_t i = Begin; i < End; ++i)
+			Extremes.Add(LoadPosition(Base, i, Stride));
+		ChunkExtremes[Chunk] = Extremes;
+	});
+	for (size_t c = 1; c < ChunkCount; ++c)
+		ChunkExtremes[0].Merge(ChunkExtremes[c]);
+
+	// The initial sphere spans the most distant pair. Lane 3 of the axis group duplicates x and is skipped.
+	const ExtremalPoints& E = ChunkExtremes[0];
+	float BestDistSq = -1.0f;
+	XMVECTOR BestMin = XMVectorZero(), BestMax = XMVectorZero();
+	for (int g = 0; g < 2; ++g) {
+		XMFLOAT4 MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+		XMStoreFloat4(&MinX, E.MinX[g]); XMStoreFloat4(&MinY, E.MinY[g]); XMStoreFloat4(&MinZ, E.MinZ[g]);
+		XMStoreFloat4(&MaxX, E.MaxX[g]); XMStoreFloat4(&MaxY, E.MaxY[g]); XMStoreFloat4(&MaxZ, E.MaxZ[g]);
+		const float* mx = &MinX.x; const float* my = &MinY.x; const float* mz = &MinZ.x;
+		const float* Mx = &MaxX.x; const float* My = &MaxY.x; const float* Mz = &MaxZ.x;
+		for (int l = 0; l < (g == 0 ? 3 : 4); ++l) {
+			XMVECTOR Lo = XMVectorSet(mx[l], my[l], mz[l], 0.0f);
+			XMVECTOR Hi = XMVectorSet(Mx[l], My[l], Mz[l], 0.0f);
+			float DistSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(Hi, Lo)));
+			if (DistSq > BestDistSq) {
+				BestDistSq = DistSq;
+				BestMin = Lo;
+				BestMax = Hi;
+			}
+		}
+	}
+
+	Vector3 Center = Vector3(XMVectorScale(XMVectorAdd(BestMin, BestMax), 0.5f));
+	float Radius = Sqrt(BestDistSq) * 0.5f;
+
+	// Pass 2..n: find the farthest point and grow the sphere just enough to contain it. Each pass is a parallel
+	// reduction and the sphere only ever grows, so this converges after a handful of passes.
+	static const int kMaxGrowPasses = 16;
+	std::vector<XMFLOAT4> ChunkFarthest(ChunkCount);
+	for (int Pass = 0; Pass <= kMaxGrowPasses; ++Pass) {
+		const XMVECTOR C = Center;
+		ForEachChunk(Count, [&](size_t Begin, size_t End, size_t Chunk) {
+			XMVECTOR FarDistSq = XMVectorReplicate(-1.0f);
+			XMVECTOR FarPoint = C;
+			for (size_t i = Begin; i < End; ++i) {
+				XMVECTOR P = LoadPosition(Base, i, Stride);
+				XMVECTOR DistSq = XMVector3LengthSq(XMVectorSubtract(P, C));
+				XMVECTOR Greater = XMVectorGreater(DistSq, FarDistSq);
+				FarDistSq = XMVectorSelect(FarDistSq, DistSq, Greater);
+				FarPoint = XMVectorSelect(FarPoint, P, Greater);
+			}
+			XMStoreFloat4(&ChunkFarthest[Chunk], XMVectorSelect(FarPoint, FarDistSq, g_XMSelect0001));
+		});
+
+		XMFLOAT4 Farthest = ChunkFarthest[0];
+		for (size_t c = 1; c < ChunkCount; ++c) {
+			if (ChunkFarthest[c].w > Farthest.w)
+				Farthest = ChunkFarthest[c];
+		}
+
+		// The tolerance avoids extra passes caused by rounding when the last outlier now sits on the surface.
+		const float Dist = Sqrt(Farthest.w);
+		if (Dist <= Radius * 1.00001f) {
+			Radius = Max(Radius, Dist);
+			break;
+		}
+
+		if (Pass == kMaxGrowPasses) {
+			// Still not converged. Keep the center and enclose everything.
+			Radius = Dist;
+			break;
+		}
+
+		// Move the center towards the outlier by half the overshoot.
+		const float NewRadius = (Radius + Dist) * 0.5f;
+		Vector3 Point(Farthest.x, Farthest.y, Farthest.z);
+		Center = Center + (Point - Center) * ((NewRadius - Radius) / Dist);
+		Radius = NewRadius;
+	}
+
+	return BoundingSphere(Center, Radius);
+}
+
+BoundingBox MergeBounds(const BoundingBox* Boxes, size_t Count) {
+	BoundingBox Result = BoundingBox::MakeEmpty();
+	for (size_t i = 0; i < Count; ++i)
+		Result.Include(Boxes[i]);
+	return Result;
+}
+
+BoundingSphere MergeBounds(const BoundingSphere* Spheres, size_t Count) {
+	if (Count == 0)
+		return BoundingSphere(Vector4(EZeroTag::kZero));
+
+	BoundingSphere Result = Spheres[0];
+	for (size_t i = 1; i < Count; ++i)
+		Result = Union(Result, Spheres[i]);
+	return Result;
+}
+
+}	// namespace Math
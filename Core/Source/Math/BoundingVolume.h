@@ -0,0 +1,27 @@
+//
+// Bounding volume construction from vertex position streams.
+//
+
+#pragma once
+
+#include "BoundingBox.h"
+#include "BoundingSphere.h"
+
+namespace Math {
+
+// Positions are read as three floats at the start of every vertex, so interleaved vertex buffers can be passed
+// directly. Large streams are split into chunks which are processed in parallel.
+static const size_t kBoundingVolumeChunkSize = 16384;
+
+// Exact axis aligned bounds of the points.
+BoundingBox ComputeBoundingBox(const void* Positions, size_t Count, size_t Stride = sizeof(float) * 3);
+
+// Near optimal bounding sphere. The initial sphere spans the most distant pair of extremal points along 7 directions
+// (EPOS-14), then is grown Ritter style towards the farthest outlying point until every point is enclosed.
+BoundingSphere ComputeBoundingSphere(const void* Positions, size_t Count, size_t Stride = sizeof(float) * 3);
+
+// Merge a set of child bounds into a single parent bound.
+BoundingBox MergeBounds(const BoundingBox* Boxes, size_t Count);
+BoundingSphere MergeBounds(const BoundingSphere* Spheres, size_t Count);
+
+}	// namespace Math
@@ -0,0 +1,136 @@
+//
+// Bounding volume hierarchy over primitive bounds, with single ray and ray packet traversal.
+//
+
+#include "pch.h"
+#include "BoundingVolumeHierarchy.h"
+#include "Parallel.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace Math {
+
+void BoundingVolumeHierarchy::Build(const BoundingBox* PrimitiveBounds, uint32_t Count) {
+	Clear();
+	if (Count == 0)
+		return;
+
+	m_PrimitiveBounds.assign(PrimitiveBounds, PrimitiveBounds + Count);
+	m_Primitives.resize(Count);
+	std::vector<Vector3> Centroids(Count);
+	for (uint32_t i = 0; i < Count; ++i) {
+		m_Primitives[i] = i;
+		Centroids[i] = PrimitiveBounds[i].GetCenter();
+	}
+
+	m_Nodes.reserve(2 * DivideByMultiple(Count, kMaxLeafSize));
+	BuildRecursive(0, Count, Centroids);
+}
+
+uint32_t BoundingVolumeHierarchy::BuildRecursive(uint32_t Begin, uint32_t End, const std::vector<Vector3>& Centroids) {
+	const uint32_t NodeIndex = (uint32_t)m_Nodes.size();
+	m_Nodes.emplace_back();
+
+	BoundingBox Bounds = BoundingBox::MakeEmpty();
+	BoundingBox CentroidBounds = BoundingBox::MakeEmpty();
+	for (uint32_t i = Begin; i < End; ++i) {
+		Bounds.Include(m_PrimitiveBounds[m_Primitives[i]]);
+		CentroidBounds.Include(Centroids[m_Primitives[i]]);
+	}
+	m_Nodes[NodeIndex].Bounds = Bounds;
+
+	if (End - Begin <= kMaxLeafSize) {
+		m_Nodes[NodeIndex].Offset = Begin;
+		m_Nodes[NodeIndex].Count = (uint16_t)(End - Begin);
+		m_Nodes[NodeIndex].Axis = 0;
+		return NodeIndex;
+	}
+
+	XMFLOAT3 Extent;
+	XMStoreFloat3(&Extent, CentroidBounds.GetExtent());
+	const uint16_t Axis = Extent.x > Extent.y ? (Extent.x > Extent.z ? 0 : 2) : (Extent.y > Extent.z ? 1 : 2);
+
+	const uint32_t Mid = Begin + (End - Begin) / 2;
+	std::nth_element(m_Primitives.begin() + Begin, m_Primitives.begin() + Mid, m_Primitives.begin() + End,
+		[&](uint32_t a, uint32_t b) {
+		return XMVectorGetByIndex(Centroids[a], Axis) < XMVectorGetByIndex(Centroids[b], Axis);
+	});
+
+	BuildRecursive(Begin, Mid, Centroids);
+	const uint32_t Right = BuildRecursive(Mid, End, Centroids);
+
+	// m_Nodes may have been reallocated by the recursion.
+	m_Nodes[NodeIndex].Offset = Right;
+	m_Nodes[NodeIndex].Count = 0;
+	m_Nodes[NodeIndex].Axis = Axis;
+	return NodeIndex;
+}
+
+bool BoundingVolumeHierarchy::IntersectBounds(const Ray& ray, RayHit& hit) const {
+	return Intersect(ray, hit, [this](uint32_t Primitive, const Ray& r, RayHit& h) {
+		float tNear;
+		if (!IntersectRayBox(r, m_PrimitiveBounds[Primitive], Min(h.T, r.GetMaxT()), tNear) || tNear >= h.T)
+			return false;
+		h.T = tNear;
+		h.U = h.V = 0.0f;
+		h.PrimitiveIndex = Primitive;
+		return true;
+	});
+}
+
+void TriangleMeshBVH::Build(const void* Positions, size_t Stride, const uint32_t* Indices, uint32_t TriangleCount) {
+	const uint8_t* Base = (const uint8_t*)Positions;
+	m_Vertices.resize(TriangleCount * 3);
+	std::vector<BoundingBox> TriangleBounds(TriangleCount);
+	for (uint32_t t = 0; t < TriangleCount; ++t) {
+		BoundingBox Bounds = BoundingBox::MakeEmpty();
+		for (uint32_t k = 0; k < 3; ++k) {
+			Vector3 v = Vector3(*(const XMFLOAT3*)(Base + Indices[t * 3 + k] * Stride));
+			m_Vertices[t * 3 + k] = v;
+			Bounds.Include(v);
+		}
+		TriangleBounds[t] = Bounds;
+	}
+	m_BVH.Build(TriangleBounds.data(), TriangleCount);
+}
+
+bool TriangleMeshBVH::Intersect(const Ray& ray, RayHit& hit) const {
+	return m_BVH.Intersect(ray, hit, [this](uint32_t Triangle, const Ray& r, RayHit& h) {
+		const Vector3* v = &m_Vertices[Triangle * 3];
+		float t, u, w;
+		if (!IntersectRayTriangle(r, v[0], v[1], v[2], Min(h.T, r.GetMaxT()), t, u, w))
+			return false;
+		h.T = t;
+		h.U = u;
+		h.V = w;
+		h.PrimitiveIndex = Triangle;
+		return true;
+	});
+}
+
+void TriangleMeshBVH::Intersect(const RayPacket& packet, RayPacketHit& hits) const {
+	m_BVH.Intersect(packet, hits, [this](uint32_t Triangle, const RayPacket& p, RayPacketHit& h) {
+		const Vector3* v = &m_Vertices[Triangle * 3];
+		IntersectRayPacketTriangle(p, v[0], v[1], v[2], Triangle, h);
+	});
+}
+
+void TriangleMeshBVH::Intersect(const Ray* Rays, size_t Count, RayHit* Hits) const {
+	const size_t PacketCount = DivideByMultiple(Count, (size_t)RayPacket::kSize);
+	ParallelFor(size_t(0), PacketCount, [&](size_t PacketIndex) {
+		const size_t First = PacketIndex * RayPacket::kSize;
+		const int Lanes = Count - First < RayPacket::kSize ? (int)(Count - First) : RayPacket::kSize;
+
+		RayPacket Packet;
+		for (int Lane = 0; Lane < Lanes; ++Lane)
+			Packet.SetRay(Lane, Rays[First + Lane]);
+
+		RayPacketHit PacketHits;
+		Intersect(Packet, PacketHits);
+		for (int Lane = 0; Lane < Lanes; ++Lane)
+			Hits[First + Lane] = PacketHits.GetHit(Lane);
+	});
+}
+
+}	// namespace Math
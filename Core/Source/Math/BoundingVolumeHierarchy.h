@@ -0,0 +1,158 @@
+//
+// Bounding volume hierarchy over primitive bounds, with single ray and ray packet traversal. Used for CPU picking and
+// line of sight queries against scene bounds or triangle meshes.
+//
+
+#pragma once
+
+#include "Ray.h"
+#include <vector>
+
+namespace Math {
+
+class BoundingVolumeHierarchy {
+public:
+	static const uint32_t kMaxLeafSize = 4;
+
+	// Builds with an object median split along the largest centroid axis.
+	void Build(const BoundingBox* PrimitiveBounds, uint32_t Count);
+	void Clear() { m_Nodes.clear(); m_Primitives.clear(); m_PrimitiveBounds.clear(); }
+	bool IsEmpty() const { return m_Nodes.empty(); }
+
+	// Visit the leaves hit by the ray, nearest first. Func(uint32_t Primitive, const Ray&, RayHit&) performs the exact
+	// primitive test and must update hit (including hit.T) when it finds a closer intersection.
+	template <typename IntersectFunc> bool Intersect(const Ray& ray, RayHit& hit, const IntersectFunc& Func) const;
+
+	// Packet traversal. A node is visited while any active ray hits it. Func(uint32_t Primitive, const RayPacket&,
+	// RayPacketHit&) updates the lanes which hit the primitive.
+	template <typename IntersectFunc> void Intersect(const RayPacket& packet, RayPacketHit& hits, const IntersectFunc& Func) const;
+
+	// Nearest primitive whose bounding box is hit by the ray. Suitable for picking against scene bounds.
+	bool IntersectBounds(const Ray& ray, RayHit& hit) const;
+
+private:
+	// Interior nodes have Count == 0, the left child immediately follows and Offset is the right child. Leaves
+	// reference m_Primitives[Offset, Offset + Count).
+	struct Node {
+		BoundingBox Bounds;
+		uint32_t Offset;
+		uint16_t Count;
+		uint16_t Axis;
+	};
+
+	static const int kStackSize = 64;
+
+	uint32_t BuildRecursive(uint32_t Begin, uint32_t End, const std::vector<Vector3>& Centroids);
+
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_Primitives;
+	std::vector<BoundingBox> m_PrimitiveBounds;
+};
+
+// Triangle mesh accelerator. Triangle vertices are copied, so the source buffers can be released after Build().
+class TriangleMeshBVH {
+public:
+	void Build(const void* Positions, size_t Stride, const uint32_t* Indices, uint32_t TriangleCount);
+
+	// PrimitiveIndex of the hit is the triangle index.
+	bool Intersect(const Ray& ray, RayHit& hit) const;
+	void Intersect(const RayPacket& packet, RayPacketHit& hits) const;
+
+	// Cast a batch of rays. Rays are grouped into packets of 4 and the packets are traced in parallel.
+	void Intersect(const Ray* Rays, size_t Count, RayHit* Hits) const;
+
+private:
+	BoundingVolumeHierarchy m_BVH;
+	std::vector<Vector3> m_Vertices;	// 3 per triangle
+};
+
+//
+// Inline methods.
+//
+
+template <typename IntersectFunc>
+bool BoundingVolumeHierarchy::Intersect(const Ray& ray, RayHit& hit, const IntersectFunc& Func) const {
+	if (m_Nodes.empty())
+		return false;
+
+	const uint32_t DirNegative[3] = {
+		DirectX::XMVectorGetX(ray.GetDirection()) < 0.0f,
+		DirectX::XMVectorGetY(ray.GetDirection()) < 0.0f,
+		DirectX::XMVectorGetZ(ray.GetDirection()) < 0.0f
+	};
+
+	bool Found = false;
+	uint32_t Stack[kStackSize];
+	int StackSize = 0;
+	uint32_t Current = 0;
+	for (;;) {
+		const Node& N = m_Nodes[Current];
+		float tNear;
+		if (IntersectRayBox(ray, N.Bounds, Min(hit.T, ray.GetMaxT()), tNear)) {
+			if (N.Count > 0) {
+				for (uint32_t i = N.Offset; i < N.Offset + N.Count; ++i)
+					Found |= Func(m_Primitives[i], ray, hit);
+			} else {
+				// Descend into the near child first, which tightens hit.T before the far child is tested.
+				ASSERT(StackSize < kStackSize);
+				if (DirNegative[N.Axis]) {
+					Stack[StackSize++] = Current + 1;
+					Current = N.Offset;
+				} else {
+					Stack[StackSize++] = N.Offset;
+					Current = Current + 1;
+				}
+				continue;
+			}
+		}
+		if (StackSize == 0)
+			break;
+		Current = Stack[--StackSize];
+	}
+	return Found;
+}
+
+template <typename IntersectFunc>
+void BoundingVolumeHierarchy::Intersect(const RayPacket& packet, RayPacketHit& hits, const IntersectFunc& Func) const {
+	using namespace DirectX;
+	if (m_Nodes.empty())
+		return;
+
+	// Order children by the direction of the packet. Coherent packets share the same signs.
+	const XMVECTOR DirSum = XMVectorSet(
+		XMVectorGetX(XMVector4Dot(packet.DirX, g_XMOne)),
+		XMVectorGetX(XMVector4Dot(packet.DirY, g_XMOne)),
+		XMVectorGetX(XMVector4Dot(packet.DirZ, g_XMOne)), 0.0f);
+	XMFLOAT4 Dir;
+	XMStoreFloat4(&Dir, DirSum);
+	const uint32_t DirNegative[3] = { Dir.x < 0.0f, Dir.y < 0.0f, Dir.z < 0.0f };
+
+	uint32_t Stack[kStackSize];
+	int StackSize = 0;
+	uint32_t Current = 0;
+	for (;;) {
+		const Node& N = m_Nodes[Current];
+		XMVECTOR Mask = IntersectRayPacketBox(packet, N.Bounds, XMVectorMin(hits.T, packet.TMax));
+		if (!XMVector4EqualInt(Mask, XMVectorZero())) {
+			if (N.Count > 0) {
+				for (uint32_t i = N.Offset; i < N.Offset + N.Count; ++i)
+					Func(m_Primitives[i], packet, hits);
+			} else {
+				ASSERT(StackSize < kStackSize);
+				if (DirNegative[N.Axis]) {
+					Stack[StackSize++] = Current + 1;
+					Current = N.Offset;
+				} else {
+					Stack[StackSize++] = N.Offset;
+					Current = Current + 1;
+				}
+				continue;
+			}
+		}
+		if (StackSize == 0)
+			break;
+		Current = Stack[--StackSize];
+	}
+}
+
+}	// namespace Math
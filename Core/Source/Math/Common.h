@@ -4,10 +4,49 @@
 
 #pragma once
 
+// DirectXMath intrinsic level. Define one of MATH_BACKEND_SCALAR, MATH_BACKEND_SSE2, MATH_BACKEND_SSE4 or
+// MATH_BACKEND_AVX2 project wide to pick it, otherwise the best one enabled by the compiler switches is used (/arch:AVX2
+// on MSVC, -mavx2 -mfma on GCC/Clang). These only map onto the _XM_*_INTRINSICS_ defines, the implementation is
+// DirectXMath's in every case. With AVX2 it also uses FMA3 and F16C, so multiply-add chains become fused instructions
+// and swizzles AVX permutes.
+#if !defined(MATH_BACKEND_SCALAR) && !defined(MATH_BACKEND_SSE2) && !defined(MATH_BACKEND_SSE4) && !defined(MATH_BACKEND_AVX2)
+#if defined(__AVX2__)
+#define MATH_BACKEND_AVX2
+#elif defined(__AVX__) || defined(__SSE4_1__)
+#define MATH_BACKEND_SSE4
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MATH_BACKEND_SSE2
+#else
+#define MATH_BACKEND_SCALAR
+#endif
+#endif
+
+#if defined(MATH_BACKEND_AVX2)
+#ifndef _XM_AVX2_INTRINSICS_
+#define _XM_AVX2_INTRINSICS_
+#endif
+#elif defined(MATH_BACKEND_SSE4)
+#ifndef _XM_SSE4_INTRINSICS_
+#define _XM_SSE4_INTRINSICS_
+#endif
+#elif defined(MATH_BACKEND_SCALAR)
+#ifndef _XM_NO_INTRINSICS_
+#define _XM_NO_INTRINSICS_
+#endif
+#endif
+
+#include <cstdint>
 #include <DirectXMath.h>
-#include <intrin.h>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
 #define INLINE __forceinline
+#else
+#if !defined(MATH_BACKEND_SCALAR)
+#include <x86intrin.h>
+#endif
+#define INLINE inline __attribute__((always_inline))
+#endif
 
 namespace Math {
 
@@ -49,10 +88,18 @@ INLINE uint8_t Log2(uint64_t value) {
 
 	// If perfect power of two (only one set bit), return index of bit.  Otherwise round up
 	// fractional log by adding 1 to most signicant set bit's index.
+#if defined(_MSC_VER)
 	if (_BitScanReverse64(&mssb, value) > 0 && _BitScanForward64(&lssb, value) > 0)
 		return uint8_t(mssb + (mssb == lssb ? 0 : 1));
 	else
 		return 0;
+#else
+	if (value == 0)
+		return 0;
+	mssb = 63 - __builtin_clzll(value);
+	lssb = __builtin_ctzll(value);
+	return uint8_t(mssb + (mssb == lssb ? 0 : 1));
+#endif
 }
 
 template <typename T> INLINE T AlignPowerOfTwo(T value) {
@@ -116,13 +163,13 @@ INLINE DirectX::XMVECTOR SetWToOne(DirectX::FXMVECTOR vec) {
 
 #else // !_XM_SSE_INTRINSICS_
 
-INLINE DirectX::XMVECTOR SplatOne() { return XMVectorSplatOne(); }
-INLINE DirectX::XMVECTOR CreateXUnitVector() { return g_XMIdentityR0; }
-INLINE DirectX::XMVECTOR CreateYUnitVector() { return g_XMIdentityR1; }
-INLINE DirectX::XMVECTOR CreateZUnitVector() { return g_XMIdentityR2; }
-INLINE DirectX::XMVECTOR CreateWUnitVector() { return g_XMIdentityR3; }
-INLINE DirectX::XMVECTOR SetWToZero(DirectX::FXMVECTOR vec) { return XMVectorAndInt(vec, g_XMMask3); }
-INLINE DirectX::XMVECTOR SetWToOne(DirectX::FXMVECTOR vec) { return XMVectorSelect(g_XMIdentityR3, vec, g_XMMask3); }
+INLINE DirectX::XMVECTOR SplatOne() { return DirectX::XMVectorSplatOne(); }
+INLINE DirectX::XMVECTOR CreateXUnitVector() { return DirectX::g_XMIdentityR0; }
+INLINE DirectX::XMVECTOR CreateYUnitVector() { return DirectX::g_XMIdentityR1; }
+INLINE DirectX::XMVECTOR CreateZUnitVector() { return DirectX::g_XMIdentityR2; }
+INLINE DirectX::XMVECTOR CreateWUnitVector() { return DirectX::g_XMIdentityR3; }
+INLINE DirectX::XMVECTOR SetWToZero(DirectX::FXMVECTOR vec) { return DirectX::XMVectorAndInt(vec, DirectX::g_XMMask3); }
+INLINE DirectX::XMVECTOR SetWToOne(DirectX::FXMVECTOR vec) { return DirectX::XMVectorSelect(DirectX::g_XMIdentityR3, vec, DirectX::g_XMMask3); }
 
 #endif
 
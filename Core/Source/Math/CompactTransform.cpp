@@ -0,0 +1,257 @@
+//
+// Compact storage formats for transforms, with batch decoders into Matrix4.
+//
+
+#include "pch.h"
+#include "CompactTransform.h"
+#include "Parallel.h"
+#include <DirectXPackedVector.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace Math {
+
+// The three smallest components of a unit quaternion lie in [-1/sqrt(2), 1/sqrt(2)].
+static const float kQuatRange = 0.707106781f;
+static const uint32_t kQuatMask = 0x7FFF;
+static const float kQuatSteps = 32767.0f;
+
+// Large batches are split into chunks of this many transforms.
+static const size_t kDecodeChunkSize = 4096;
+
+static INLINE uint64_t LoadQuaternionBits(const PackedQuaternion& packed) {
+	return (uint64_t)packed.Bits[0] | ((uint64_t)packed.Bits[1] << 16) | ((uint64_t)packed.Bits[2] << 32);
+}
+
+PackedQuaternion PackQuaternion(Quaternion q) {
+	XMFLOAT4 v;
+	XMStoreFloat4(&v, XMQuaternionNormalize(q));
+	const float c[4] = { v.x, v.y, v.z, v.w };
+
+	uint32_t Largest = 0;
+	for (uint32_t i = 1; i < 4; ++i) {
+		if (Abs(c[i]) > Abs(c[Largest]))
+			Largest = i;
+	}
+
+	// q and -q are the same rotation. Flip so that the dropped component is positive.
+	const float Sign = c[Largest] < 0.0f ? -1.0f : 1.0f;
+	uint64_t Bits = Largest;
+	uint32_t Shift = 2;
+	for (uint32_t i = 0; i < 4; ++i) {
+		if (i == Largest)
+			continue;
+		float n = Clamp(c[i] * Sign / kQuatRange, -1.0f, 1.0f);
+		uint64_t Quantized = (uint64_t)((n * 0.5f + 0.5f) * kQuatSteps + 0.5f);
+		Bits |= Quantized << Shift;
+		Shift += 15;
+	}
+
+	PackedQuaternion Packed;
+	Packed.Bits[0] = (uint16_t)Bits;
+	Packed.Bits[1] = (uint16_t)(Bits >> 16);
+	Packed.Bits[2] = (uint16_t)(Bits >> 32);
+	return Packed;
+}
+
+Quaternion UnpackQuaternion(const PackedQuaternion& packed) {
+	const uint64_t Bits = LoadQuaternionBits(packed);
+	const uint32_t Largest = (uint32_t)(Bits & 3);
+	float c[4];
+	float SumSq = 0.0f;
+	uint32_t Shift = 2;
+	for (uint32_t i = 0; i < 4; ++i) {
+		if (i == Largest)
+			continue;
+		c[i] = (((Bits >> Shift) & kQuatMask) / kQuatSteps * 2.0f - 1.0f) * kQuatRange;
+		SumSq += c[i] * c[i];
+		Shift += 15;
+	}
+	c[Largest] = Sqrt(Max(1.0f - SumSq, 0.0f));
+	return Quaternion(XMVectorSet(c[0], c[1], c[2], c[3]));
+}
+
+static INLINE void PackTranslation(Vector3 t, const TranslationRange* range, uint16_t Out[3]) {
+	XMFLOAT3 v;
+	if (range == nullptr) {
+		XMStoreFloat3(&v, t);
+		Out[0] = XMConvertFloatToHalf(v.x);
+		Out[1] = XMConvertFloatToHalf(v.y);
+		Out[2] = XMConvertFloatToHalf(v.z);
+	} else {
+		Vector3 Steps = Clamp((t - range->GetMin()) / range->GetScale(), Vector3(EZeroTag::kZero), Vector3(Scalar(65535.0f)));
+		XMStoreFloat3(&v, Round(Steps));
+		Out[0] = (uint16_t)v.x;
+		Out[1] = (uint16_t)v.y;
+		Out[2] = (uint16_t)v.z;
+	}
+}
+
+CompactTransform PackTransform(const OrthogonalTransform& xform, float scale, const TranslationRange* range) {
+	CompactTransform Packed;
+	Packed.Rotation = PackQuaternion(xform.GetRotation());
+	PackTranslation(xform.GetTranslation(), range, Packed.Translation);
+	Packed.Scale = XMConvertFloatToHalf(scale);
+	Packed.Padding = 0;
+	return Packed;
+}
+
+CompactTransform PackTransform(const AffineTransform& xform, const TranslationRange* range) {
+	const float Scale = Length(xform.GetX());
+	const Scalar InvScale = Recip(Scalar(Scale));
+	Matrix4 Rotation(Matrix3(xform.GetX() * InvScale, xform.GetY() * InvScale, xform.GetZ() * InvScale));
+	return PackTransform(OrthogonalTransform(Quaternion((XMMATRIX)Rotation), xform.GetTranslation()), Scale, range);
+}
+
+Float3x4 PackFloat3x4(const Matrix4& mat) {
+	XMMATRIX Columns = XMMatrixTranspose(mat);
+	Float3x4 Packed;
+	XMStoreFloat4((XMFLOAT4*)Packed.m[0], Columns.r[0]);
+	XMStoreFloat4((XMFLOAT4*)Packed.m[1], Columns.r[1]);
+	XMStoreFloat4((XMFLOAT4*)Packed.m[2], Columns.r[2]);
+	return Packed;
+}
+
+Matrix4 UnpackFloat3x4(const Float3x4& packed) {
+	XMMATRIX Columns;
+	Columns.r[0] = XMLoadFloat4((const XMFLOAT4*)packed.m[0]);
+	Columns.r[1] = XMLoadFloat4((const XMFLOAT4*)packed.m[1]);
+	Columns.r[2] = XMLoadFloat4((const XMFLOAT4*)packed.m[2]);
+	Columns.r[3] = g_XMIdentityR3;
+	return Matrix4(XMMatrixTranspose(Columns));
+}
+
+// Decode exactly four transforms. The quaternion to matrix conversion runs in SoA form, one transform per lane, and
+// the rows are transposed back to AoS at the end.
+static void DecodeTransforms4(const CompactTransform* Source, Matrix4* Dest, const TranslationRange* range) {
+	XMUINT4 Index, A, B, C, Tx, Ty, Tz;
+	XMFLOAT4 Scale;
+	uint32_t* Lanes[7] = { &Index.x, &A.x, &B.x, &C.x, &Tx.x, &Ty.x, &Tz.x };
+	for (int l = 0; l < 4; ++l) {
+		const uint64_t Bits = LoadQuaternionBits(Source[l].Rotation);
+		Lanes[0][l] = (uint32_t)(Bits & 3);
+		Lanes[1][l] = (uint32_t)(Bits >> 2) & kQuatMask;
+		Lanes[2][l] = (uint32_t)(Bits >> 17) & kQuatMask;
+		Lanes[3][l] = (uint32_t)(Bits >> 32) & kQuatMask;
+		Lanes[4][l] = Source[l].Translation[0];
+		Lanes[5][l] = Source[l].Translation[1];
+		Lanes[6][l] = Source[l].Translation[2];
+		(&Scale.x)[l] = XMConvertHalfToFloat(Source[l].Scale);
+	}
+
+	// Dequantize the three stored components and rebuild the dropped one.
+	const XMVECTOR QuatScale = XMVectorReplicate(2.0f * kQuatRange / kQuatSteps);
+	const XMVECTOR QuatBias = XMVectorReplicate(-kQuatRange);
+	XMVECTOR Qa = XMVectorMultiplyAdd(XMConvertVectorUIntToFloat(XMLoadUInt4(&A), 0), QuatScale, QuatBias);
+	XMVECTOR Qb = XMVectorMultiplyAdd(XMConvertVectorUIntToFloat(XMLoadUInt4(&B), 0), QuatScale, QuatBias);
+	XMVECTOR Qc = XMVectorMultiplyAdd(XMConvertVectorUIntToFloat(XMLoadUInt4(&C), 0), QuatScale, QuatBias);
+	XMVECTOR SumSq = XMVectorMultiplyAdd(Qc, Qc, XMVectorMultiplyAdd(Qb, Qb, XMVectorMultiply(Qa, Qa)));
+	XMVECTOR Qd = XMVectorSqrt(XMVectorMax(XMVectorSubtract(g_XMOne, SumSq), XMVectorZero()));
+
+	// The stored components fill the slots around the dropped one in order.
+	const XMVECTOR IndexVec = XMLoadUInt4(&Index);
+	const XMVECTOR Is0 = XMVectorEqualInt(IndexVec, XMVectorZero());
+	const XMVECTOR Is1 = XMVectorEqualInt(IndexVec, XMVectorSplatConstantInt(1));
+	const XMVECTOR Is2 = XMVectorEqualInt(IndexVec, XMVectorSplatConstantInt(2));
+	const XMVECTOR Is3 = XMVectorEqualInt(IndexVec, XMVectorSplatConstantInt(3));
+	const XMVECTOR Le1 = XMVectorOrInt(Is0, Is1);
+	XMVECTOR X = XMVectorSelect(Qa, Qd, Is0);
+	XMVECTOR Y = XMVectorSelect(XMVectorSelect(Qb, Qa, Is0), Qd, Is1);
+	XMVECTOR Z = XMVectorSelect(XMVectorSelect(Qc, Qb, Le1), Qd, Is2);
+	XMVECTOR W = XMVectorSelect(Qc, Qd, Is3);
+
+	// Rotation rows, scaled by the uniform scale. Same layout as XMMatrixRotationQuaternion.
+	const XMVECTOR S = XMLoadFloat4(&Scale);
+	const XMVECTOR S2 = XMVectorAdd(S, S);
+	const XMVECTOR xx = XMVectorMultiply(X, X), yy = XMVectorMultiply(Y, Y), zz = XMVectorMultiply(Z, Z);
+	const XMVECTOR xy = XMVectorMultiply(X, Y), xz = XMVectorMultiply(X, Z), yz = XMVectorMultiply(Y, Z);
+	const XMVECTOR wx = XMVectorMultiply(W, X), wy = XMVectorMultiply(W, Y), wz = XMVectorMultiply(W, Z);
+	XMMATRIX Row0, Row1, Row2, Row3;
+	Row0.r[0] = XMVectorNegativeMultiplySubtract(S2, XMVectorAdd(yy, zz), S);
+	Row0.r[1] = XMVectorMultiply(S2, XMVectorAdd(xy, wz));
+	Row0.r[2] = XMVectorMultiply(S2, XMVectorSubtract(xz, wy));
+	Row0.r[3] = XMVectorZero();
+	Row1.r[0] = XMVectorMultiply(S2, XMVectorSubtract(xy, wz));
+	Row1.r[1] = XMVectorNegativeMultiplySubtract(S2, XMVectorAdd(xx, zz), S);
+	Row1.r[2] = XMVectorMultiply(S2, XMVectorAdd(yz, wx));
+	Row1.r[3] = XMVectorZero();
+	Row2.r[0] = XMVectorMultiply(S2, XMVectorAdd(xz, wy));
+	Row2.r[1] = XMVectorMultiply(S2, XMVectorSubtract(yz, wx));
+	Row2.r[2] = XMVectorNegativeMultiplySubtract(S2, XMVectorAdd(xx, yy), S);
+	Row2.r[3] = XMVectorZero();
+
+	if (range == nullptr) {
+		XMFLOAT4 T[3];
+		for (int l = 0; l < 4; ++l) {
+			(&T[0].x)[l] = XMConvertHalfToFloat((HALF)(&Tx.x)[l]);
+			(&T[1].x)[l] = XMConvertHalfToFloat((HALF)(&Ty.x)[l]);
+			(&T[2].x)[l] = XMConvertHalfToFloat((HALF)(&Tz.x)[l]);
+		}
+		Row3.r[0] = XMLoadFloat4(&T[0]);
+		Row3.r[1] = XMLoadFloat4(&T[1]);
+		Row3.r[2] = XMLoadFloat4(&T[2]);
+	} else {
+		const Vector3 Min = range->GetMin();
+		const Vector3 Step = range->GetScale();
+		Row3.r[0] = XMVectorMultiplyAdd(XMConvertVectorUIntToFloat(XMLoadUInt4(&Tx), 0), Step.GetX(), Min.GetX());
+		Row3.r[1] = XMVectorMultiplyAdd(XMConvertVectorUIntToFloat(XMLoadUInt4(&Ty), 0), Step.GetY(), Min.GetY());
+		Row3.r[2] = XMVectorMultiplyAdd(XMConvertVectorUIntToFloat(XMLoadUInt4(&Tz), 0), Step.GetZ(), Min.GetZ());
+	}
+	Row3.r[3] = g_XMOne;
+
+	Row0 = XMMatrixTranspose(Row0);
+	Row1 = XMMatrixTranspose(Row1);
+	Row2 = XMMatrixTranspose(Row2);
+	Row3 = XMMatrixTranspose(Row3);
+	for (int l = 0; l < 4; ++l)
+		Dest[l] = Matrix4(Vector4(Row0.r[l]), Vector4(Row1.r[l]), Vector4(Row2.r[l]), Vector4(Row3.r[l]));
+}
+
+static void DecodeTransformRange(const CompactTransform* Source, size_t Count, Matrix4* Dest, const TranslationRange* range) {
+	size_t i = 0;
+	for (; i + 4 <= Count; i += 4)
+		DecodeTransforms4(Source + i, Dest + i, range);
+
+	if (i < Count) {
+		CompactTransform Tail[4] = {};
+		Matrix4 TailDest[4];
+		for (size_t j = i; j < Count; ++j)
+			Tail[j - i] = Source[j];
+		DecodeTransforms4(Tail, TailDest, range);
+		for (size_t j = i; j < Count; ++j)
+			Dest[j] = TailDest[j - i];
+	}
+}
+
+void DecodeTransforms(const CompactTransform* Source, size_t Count, Matrix4* Dest, const TranslationRange* range) {
+	if (Count <= kDecodeChunkSize) {
+		DecodeTransformRange(Source, Count, Dest, range);
+		return;
+	}
+
+	ParallelFor(size_t(0), DivideByMultiple(Count, kDecodeChunkSize), [&](size_t Chunk) {
+		const size_t Begin = Chunk * kDecodeChunkSize;
+		const size_t End = Begin + kDecodeChunkSize < Count ? Begin + kDecodeChunkSize : Count;
+		DecodeTransformRange(Source + Begin, End - Begin, Dest + Begin, range);
+	});
+}
+
+void DecodeTransforms(const Float3x4* Source, size_t Count, Matrix4* Dest) {
+	auto DecodeRange = [=](size_t Begin, size_t End) {
+		for (size_t i = Begin; i < End; ++i)
+			Dest[i] = UnpackFloat3x4(Source[i]);
+	};
+
+	if (Count <= kDecodeChunkSize) {
+		DecodeRange(0, Count);
+		return;
+	}
+
+	ParallelFor(size_t(0), DivideByMultiple(Count, kDecodeChunkSize), [&](size_t Chunk) {
+		const size_t Begin = Chunk * kDecodeChunkSize;
+		DecodeRange(Begin, Begin + kDecodeChunkSize < Count ? Begin + kDecodeChunkSize : Count);
+	});
+}
+
+}	// namespace Math
@@ -0,0 +1,62 @@
+//
+// Compact storage formats for transforms. Large instance arrays are usually bandwidth bound, so they can be kept in
+// these formats and decoded in batches straight into Matrix4 arrays right before use.
+//   PackedQuaternion:  6 bytes, smallest three encoding (2 bit index + 3 x 15 bit components).
+//   CompactTransform: 16 bytes, rotation + translation (half or 16 bit fixed point) + uniform scale (half).
+//   Float3x4:         48 bytes, unpadded affine matrix stored by columns, matching a float3x4 in HLSL.
+// Compare with 32 bytes for OrthogonalTransform, 64 bytes for AffineTransform and Matrix4.
+//
+
+#pragma once
+
+#include "VectorMath.h"
+#include "BoundingBox.h"
+
+namespace Math {
+
+struct PackedQuaternion {
+	uint16_t Bits[3];
+};
+
+struct CompactTransform {
+	PackedQuaternion Rotation;
+	uint16_t Translation[3];	// half floats, or fixed point within a TranslationRange
+	uint16_t Scale;				// half float
+	uint16_t Padding;
+};
+
+struct Float3x4 {
+	float m[3][4];
+};
+
+// Fixed point translations cover this box with 16 bits per axis. Defaults to half precision when no range is given.
+class TranslationRange {
+public:
+	TranslationRange() {}
+	explicit TranslationRange(const BoundingBox& bounds) : m_min(bounds.GetMin()) {
+		m_scale = Max(bounds.GetMax() - bounds.GetMin(), Vector3(Scalar(1e-6f))) / 65535.0f;
+	}
+
+	Vector3 GetMin(void) const { return m_min; }
+	Vector3 GetScale(void) const { return m_scale; }	// world units per step
+
+private:
+	Vector3 m_min;
+	Vector3 m_scale;
+};
+
+PackedQuaternion PackQuaternion(Quaternion q);
+Quaternion UnpackQuaternion(const PackedQuaternion& packed);
+
+// Only the rotation and uniform scale can be represented. The scale is taken from the length of the X basis.
+CompactTransform PackTransform(const OrthogonalTransform& xform, float scale = 1.0f, const TranslationRange* range = nullptr);
+CompactTransform PackTransform(const AffineTransform& xform, const TranslationRange* range = nullptr);
+
+Float3x4 PackFloat3x4(const Matrix4& mat);
+Matrix4 UnpackFloat3x4(const Float3x4& packed);
+
+// Batch decoders. Four transforms are decoded per iteration in SoA form, and large batches are split across threads.
+void DecodeTransforms(const CompactTransform* Source, size_t Count, Matrix4* Dest, const TranslationRange* range = nullptr);
+void DecodeTransforms(const Float3x4* Source, size_t Count, Matrix4* Dest);
+
+}	// namespace Math
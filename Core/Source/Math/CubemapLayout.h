@@ -0,0 +1,87 @@
+//
+// Face layout of D3D cubemaps, and the texel directions of a face 4 texels at a time.
+//
+
+#pragma once
+
+#include "Common.h"
+#include <cmath>
+
+namespace Math {
+
+// Direction of a face texel is s * S + t * T + N with s, t in [-1, 1], following the D3D cubemap layout.
+struct CubemapFaceBasis {
+	float S[3];
+	float T[3];
+	float N[3];
+};
+
+static const CubemapFaceBasis kCubemapFaces[6] = {
+	{ {  0,  0, -1 }, { 0, -1,  0 }, {  1,  0,  0 } },		// +X
+	{ {  0,  0,  1 }, { 0, -1,  0 }, { -1,  0,  0 } },		// -X
+	{ {  1,  0,  0 }, { 0,  0,  1 }, {  0,  1,  0 } },		// +Y
+	{ {  1,  0,  0 }, { 0,  0, -1 }, {  0, -1,  0 } },		// -Y
+	{ {  1,  0,  0 }, { 0, -1,  0 }, {  0,  0,  1 } },		// +Z
+	{ { -1,  0,  0 }, { 0, -1,  0 }, {  0,  0, -1 } },		// -Z
+};
+
+// Walks the texel centers of one face of a Size x Size cubemap, a row at a time and 4 columns at a time.
+class CubemapFaceWalk {
+public:
+	CubemapFaceWalk(uint32_t FaceIndex, uint32_t Size) : m_Face(kCubemapFaces[FaceIndex]), m_TexelSize(2.0f / Size) {
+		m_LaneOffset = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f),
+			DirectX::XMVectorReplicate(m_TexelSize), DirectX::g_XMNegativeOne);
+	}
+
+	// t of the texels in Row.
+	INLINE DirectX::XMVECTOR GetRowT(uint32_t Row) const {
+		return DirectX::XMVectorReplicate((Row + 0.5f) * m_TexelSize - 1.0f);
+	}
+
+	// s of the texels Column to Column + 3.
+	INLINE DirectX::XMVECTOR GetColumnS(uint32_t Column) const {
+		return DirectX::XMVectorAdd(m_LaneOffset, DirectX::XMVectorReplicate(Column * m_TexelSize));
+	}
+
+	// Unnormalized directions of 4 texels in SoA form. Their length is sqrt(1 + s^2 + t^2).
+	INLINE void GetDirections(DirectX::FXMVECTOR s, DirectX::FXMVECTOR t, DirectX::XMVECTOR& x, DirectX::XMVECTOR& y,
+		DirectX::XMVECTOR& z) const {
+		using namespace DirectX;
+		x = XMVectorMultiplyAdd(s, XMVectorReplicate(m_Face.S[0]), XMVectorMultiplyAdd(t, XMVectorReplicate(m_Face.T[0]), XMVectorReplicate(m_Face.N[0])));
+		y = XMVectorMultiplyAdd(s, XMVectorReplicate(m_Face.S[1]), XMVectorMultiplyAdd(t, XMVectorReplicate(m_Face.T[1]), XMVectorReplicate(m_Face.N[1])));
+		z = XMVectorMultiplyAdd(s, XMVectorReplicate(m_Face.S[2]), XMVectorMultiplyAdd(t, XMVectorReplicate(m_Face.T[2]), XMVectorReplicate(m_Face.N[2])));
+	}
+
+private:
+	const CubemapFaceBasis& m_Face;
+	float m_TexelSize;
+	DirectX::XMVECTOR m_LaneOffset;		// s of the first 4 texels of a row
+};
+
+// Face and s, t in [-1, 1] of a nonzero direction, the inverse of the face bases.
+INLINE uint32_t GetCubemapFaceCoords(float x, float y, float z, float& s, float& t) {
+	const float ax = fabsf(x), ay = fabsf(y), az = fabsf(z);
+	uint32_t Face;
+	float InvMajor;
+	if (ax >= ay && ax >= az) {
+		InvMajor = 1.0f / ax;
+		Face = x > 0.0f ? 0 : 1;
+		s = x > 0.0f ? -z : z;
+		t = -y;
+	} else if (ay >= az) {
+		InvMajor = 1.0f / ay;
+		Face = y > 0.0f ? 2 : 3;
+		s = x;
+		t = y > 0.0f ? z : -z;
+	} else {
+		InvMajor = 1.0f / az;
+		Face = z > 0.0f ? 4 : 5;
+		s = z > 0.0f ? x : -x;
+		t = -y;
+	}
+	s *= InvMajor;
+	t *= InvMajor;
+	return Face;
+}
+
+}	// namespace Math
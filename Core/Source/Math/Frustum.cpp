@@ -4,6 +4,7 @@
 
 #include "pch.h"
 #include "Frustum.h"
+#include "MatrixBatch.h"
 
 namespace Math {
 
@@ -96,4 +97,21 @@ Frustum::Frustum(const Matrix4& ProjMat) {
 	}
 }
 
+void TransformFrustums(const Matrix4* xforms, size_t count, const Frustum& frustum, Frustum* results) {
+	std::vector<Matrix4> inverses(count);
+	InvertMatrices(xforms, inverses.data(), count);
+
+	for (size_t n = 0; n < count; ++n) {
+		const Matrix4& mtx = xforms[n];
+		const Matrix4 XForm = Transpose(inverses[n]);
+		Frustum& result = results[n];
+
+		for (int i = 0; i < 8; ++i)
+			result.m_FrustumCorners[i] = Vector3(mtx * frustum.m_FrustumCorners[i]);
+
+		for (int i = 0; i < 6; ++i)
+			result.m_FrustumPlanes[i] = BoundingPlane(XForm * Vector4(frustum.m_FrustumPlanes[i]));
+	}
+}
+
 }	// namespace Math
\ No newline at end of file
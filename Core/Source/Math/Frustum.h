@@ -7,6 +7,7 @@
 
 #include "BoundingPlane.h"
 #include "BoundingSphere.h"
+#include "BoundingBox.h"
 
 namespace Math {
 
@@ -31,14 +32,18 @@ public:
 	// fully contained in the frustum, or by intersecting one or more of the planes.
 	bool IntersectSphere(BoundingSphere sphere) const;
 
-	// We don't officially have a BoundingBox class yet, but let's assume it's forthcoming. (There is a
-	// simple struct in the Model project.)
+	// Test whether the axis aligned box intersects the frustum. Conservative: boxes near a frustum corner may pass.
 	bool IntersectBoundingBox(const Vector3 minBound, const Vector3 maxBound) const;
+	bool IntersectBoundingBox(const BoundingBox& box) const { return IntersectBoundingBox(box.GetMin(), box.GetMax()); }
 
 	friend Frustum  operator* (const OrthogonalTransform& xform, const Frustum& frustum);	// Fast
 	friend Frustum  operator* (const AffineTransform& xform, const Frustum& frustum);		// Slow
 	friend Frustum  operator* (const Matrix4& xform, const Frustum& frustum);				// Slowest (and most general)
 
+	// Transform the frustum by many matrices at once, e.g. into the local space of many instances. The inverse
+	// transposes needed for the planes are computed with the batched inversion.
+	friend void TransformFrustums(const Matrix4* xforms, size_t count, const Frustum& frustum, Frustum* results);
+
 private:
 	// Perspective frustum constructor (for pyramid-shaped frusta). Note: HTan and VTan both are according to half angle.
 	void ConstructPerspectiveFrustum(float HTan, float VTan, float NearClip, float FarClip);
@@ -93,7 +98,7 @@ inline Frustum operator* (const AffineTransform& xform, const Frustum& frustum)
 	for (int i = 0; i < 8; ++i)
 		result.m_FrustumCorners[i] = xform * frustum.m_FrustumCorners[i];
 
-	Matrix4 XForm = Transpose(Invert(Matrix4(xform)));
+	Matrix4 XForm = Transpose(Matrix4(Invert(xform)));
 
 	for (int i = 0; i < 6; ++i)
 		result.m_FrustumPlanes[i] = BoundingPlane(XForm * Vector4(frustum.m_FrustumPlanes[i]));
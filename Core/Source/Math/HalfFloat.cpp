@@ -0,0 +1,56 @@
+//
+// Conversion between 32 bit and 16 bit IEEE floats.
+//
+
+#include "pch.h"
+#include "HalfFloat.h"
+#include "Parallel.h"
+
+namespace Math {
+
+// Values per task when converting large arrays.
+static const size_t kHalfFloatChunkSize = 65536;
+
+template <typename SourceType, typename DestType, typename RangeFunc>
+static void ForEachHalfFloatChunk(const SourceType* Source, size_t Count, DestType* Dest, RangeFunc Func) {
+	if (Count <= kHalfFloatChunkSize) {
+		Func(Source, Count, Dest);
+		return;
+	}
+
+	ParallelFor(size_t(0), DivideByMultiple(Count, kHalfFloatChunkSize), [&](size_t Chunk) {
+		const size_t Begin = Chunk * kHalfFloatChunkSize;
+		const size_t End = Begin + kHalfFloatChunkSize < Count ? Begin + kHalfFloatChunkSize : Count;
+		Func(Source + Begin, End - Begin, Dest + Begin);
+	});
+}
+
+static void FloatToHalfRange(const float* Source, size_t Count, uint16_t* Dest) {
+	size_t i = 0;
+#if defined(MATH_BACKEND_AVX2)
+	for (; i + 8 <= Count; i += 8)
+		_mm_storeu_si128((__m128i*)(Dest + i), _mm256_cvtps_ph(_mm256_loadu_ps(Source + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+	for (; i < Count; ++i)
+		Dest[i] = FloatToHalf(Source[i]);
+}
+
+static void HalfToFloatRange(const uint16_t* Source, size_t Count, float* Dest) {
+	size_t i = 0;
+#if defined(MATH_BACKEND_AVX2)
+	for (; i + 8 <= Count; i += 8)
+		_mm256_storeu_ps(Dest + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(Source + i))));
+#endif
+	for (; i < Count; ++i)
+		Dest[i] = HalfToFloat(Source[i]);
+}
+
+void FloatToHalf(const float* Source, size_t Count, uint16_t* Dest) {
+	ForEachHalfFloatChunk(Source, Count, Dest, FloatToHalfRange);
+}
+
+void HalfToFloat(const uint16_t* Source, size_t Count, float* Dest) {
+	ForEachHalfFloatChunk(Source, Count, Dest, HalfToFloatRange);
+}
+
+}	// namespace Math
@@ -0,0 +1,62 @@
+//
+// Conversion between 32 bit and 16 bit IEEE floats. Rounding is to nearest even, overflow becomes infinity and NaNs
+// stay quiet NaNs, so the scalar functions are bit exact with the F16C instructions the batch functions use with the
+// AVX2 backend.
+//
+
+#pragma once
+
+#include "Common.h"
+
+namespace Math {
+
+INLINE uint16_t FloatToHalf(float Value) {
+	union { float f; uint32_t u; } Bits;
+	Bits.f = Value;
+	const uint32_t Sign = (Bits.u >> 16) & 0x8000;
+	Bits.u &= 0x7FFFFFFF;
+
+	uint32_t Result;
+	if (Bits.u >= 0x47800000) {
+		// Too large for a half, or infinity and NaN.
+		Result = Bits.u > 0x7F800000 ? 0x7E00 | ((Bits.u >> 13) & 0x3FF) : 0x7C00;
+	} else if (Bits.u < 0x38800000) {
+		// Denormal or zero. Adding 0.5 aligns the mantissa so that the float adder rounds it.
+		union { uint32_t u; float f; } Magic;
+		Magic.u = 0x3F000000;
+		Bits.f += Magic.f;
+		Result = Bits.u - Magic.u;
+	} else {
+		// Rebias the exponent and round the 13 dropped mantissa bits.
+		Bits.u += 0xC8000FFF + ((Bits.u >> 13) & 1);
+		Result = Bits.u >> 13;
+	}
+	return uint16_t(Result | Sign);
+}
+
+INLINE float HalfToFloat(uint16_t Value) {
+	union { uint32_t u; float f; } Bits, Magic;
+	Bits.u = uint32_t(Value & 0x7FFF) << 13;
+	const uint32_t Exponent = Bits.u & 0x0F800000;
+	Bits.u += 0x38000000;
+
+	if (Exponent == 0x0F800000) {
+		// Infinity or NaN, which is made quiet.
+		Bits.u += 0x38000000;
+		if (Bits.u != 0x7F800000)
+			Bits.u |= 0x00400000;
+	} else if (Exponent == 0) {
+		// Denormal, renormalized by the float unit.
+		Magic.u = 0x38800000;
+		Bits.u += 0x00800000;
+		Bits.f -= Magic.f;
+	}
+	Bits.u |= uint32_t(Value & 0x8000) << 16;
+	return Bits.f;
+}
+
+// Batch conversions, large arrays are split across threads.
+void FloatToHalf(const float* Source, size_t Count, uint16_t* Dest);
+void HalfToFloat(const uint16_t* Source, size_t Count, float* Dest);
+
+}	// namespace Math
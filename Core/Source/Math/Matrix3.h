@@ -8,7 +8,7 @@
 
 namespace Math {
 
-__declspec(align(16)) class Matrix3 {
+class alignas(16) Matrix3 {
 public:
 	INLINE Matrix3() {}
 	INLINE Matrix3(Vector3 x, Vector3 y, Vector3 z) { m_mat[0] = x; m_mat[1] = y; m_mat[2] = z; }
@@ -44,6 +44,14 @@ private:
 
 // Inline methods.
 INLINE Matrix3 Transpose(const Matrix3& mat) { return Matrix3(DirectX::XMMatrixTranspose(mat)); }
-// inline Matrix3 Inverse( const Matrix3& mat ) { TBD }
+// The rows of the inverse transpose are the cross products of the basis vectors divided by the determinant. This is
+// also the matrix to transform normals with.
+INLINE Matrix3 InverseTranspose(const Matrix3& mat) {
+	Vector3 x = mat.GetX(), y = mat.GetY(), z = mat.GetZ();
+	Vector3 cx = Cross(y, z), cy = Cross(z, x), cz = Cross(x, y);
+	Scalar invDet = Scalar(DirectX::XMVectorReciprocal(Dot(x, cx)));
+	return Matrix3(cx * invDet, cy * invDet, cz * invDet);
+}
+INLINE Matrix3 Invert(const Matrix3& mat) { return Transpose(InverseTranspose(mat)); }
 
 }	// namespace Math
\ No newline at end of file
@@ -8,7 +8,7 @@
 
 namespace Math {
 
-__declspec(align(16)) class Matrix4 {
+class alignas(16) Matrix4 {
 public:
 	INLINE Matrix4() {}
 	INLINE Matrix4(Vector3 x, Vector3 y, Vector3 z, Vector3 w) {
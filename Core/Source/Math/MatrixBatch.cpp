@@ -0,0 +1,180 @@
+//
+// Batch matrix inversion with SoA transposition.
+//
+
+#include "pch.h"
+#include "MatrixBatch.h"
+#include "Parallel.h"
+
+using namespace DirectX;
+
+namespace Math {
+
+// Large batches are split into chunks of this many matrices.
+static const size_t kBatchChunkSize = 4096;
+
+// Lane k of Out[i][j] receives element (i, j) of matrix k.
+static INLINE void LoadSoA(const Matrix4* Source, XMVECTOR Out[4][4]) {
+	const XMMATRIX m0 = Source[0], m1 = Source[1], m2 = Source[2], m3 = Source[3];
+	for (int i = 0; i < 4; ++i) {
+		XMMATRIX Row = XMMatrixTranspose(XMMATRIX(m0.r[i], m1.r[i], m2.r[i], m3.r[i]));
+		Out[i][0] = Row.r[0];
+		Out[i][1] = Row.r[1];
+		Out[i][2] = Row.r[2];
+		Out[i][3] = Row.r[3];
+	}
+}
+
+static INLINE void StoreSoA(const XMVECTOR In[4][4], Matrix4* Dest) {
+	XMMATRIX Rows[4];
+	for (int i = 0; i < 4; ++i)
+		Rows[i] = XMMatrixTranspose(XMMATRIX(In[i][0], In[i][1], In[i][2], In[i][3]));
+	for (int k = 0; k < 4; ++k)
+		Dest[k] = Matrix4(Vector4(Rows[0].r[k]), Vector4(Rows[1].r[k]), Vector4(Rows[2].r[k]), Vector4(Rows[3].r[k]));
+}
+
+// 4x4 inverse through 2x2 sub-determinants, evaluated on four matrices at once.
+static INLINE void InvertSoA(const XMVECTOR a[4][4], XMVECTOR b[4][4]) {
+	const XMVECTOR s0 = a[0][0] * a[1][1] - a[0][1] * a[1][0];
+	const XMVECTOR s1 = a[0][0] * a[1][2] - a[0][2] * a[1][0];
+	const XMVECTOR s2 = a[0][0] * a[1][3] - a[0][3] * a[1][0];
+	const XMVECTOR s3 = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+	const XMVECTOR s4 = a[0][1] * a[1][3] - a[0][3] * a[1][1];
+	const XMVECTOR s5 = a[0][2] * a[1][3] - a[0][3] * a[1][2];
+	const XMVECTOR c0 = a[2][0] * a[3][1] - a[2][1] * a[3][0];
+	const XMVECTOR c1 = a[2][0] * a[3][2] - a[2][2] * a[3][0];
+	const XMVECTOR c2 = a[2][0] * a[3][3] - a[2][3] * a[3][0];
+	const XMVECTOR c3 = a[2][1] * a[3][2] - a[2][2] * a[3][1];
+	const XMVECTOR c4 = a[2][1] * a[3][3] - a[2][3] * a[3][1];
+	const XMVECTOR c5 = a[2][2] * a[3][3] - a[2][3] * a[3][2];
+
+	const XMVECTOR det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	const XMVECTOR invDet = XMVectorReciprocal(det);
+
+	b[0][0] = (a[1][1] * c5 - a[1][2] * c4 + a[1][3] * c3) * invDet;
+	b[0][1] = (a[0][2] * c4 - a[0][1] * c5 - a[0][3] * c3) * invDet;
+	b[0][2] = (a[3][1] * s5 - a[3][2] * s4 + a[3][3] * s3) * invDet;
+	b[0][3] = (a[2][2] * s4 - a[2][1] * s5 - a[2][3] * s3) * invDet;
+	b[1][0] = (a[1][2] * c2 - a[1][0] * c5 - a[1][3] * c1) * invDet;
+	b[1][1] = (a[0][0] * c5 - a[0][2] * c2 + a[0][3] * c1) * invDet;
+	b[1][2] = (a[3][2] * s2 - a[3][0] * s5 - a[3][3] * s1) * invDet;
+	b[1][3] = (a[2][0] * s5 - a[2][2] * s2 + a[2][3] * s1) * invDet;
+	b[2][0] = (a[1][0] * c4 - a[1][1] * c2 + a[1][3] * c0) * invDet;
+	b[2][1] = (a[0][1] * c2 - a[0][0] * c4 - a[0][3] * c0) * invDet;
+	b[2][2] = (a[3][0] * s4 - a[3][1] * s2 + a[3][3] * s0) * invDet;
+	b[2][3] = (a[2][1] * s2 - a[2][0] * s4 - a[2][3] * s0) * invDet;
+	b[3][0] = (a[1][1] * c1 - a[1][0] * c3 - a[1][2] * c0) * invDet;
+	b[3][1] = (a[0][0] * c3 - a[0][1] * c1 + a[0][2] * c0) * invDet;
+	b[3][2] = (a[3][1] * s1 - a[3][0] * s3 - a[3][2] * s0) * invDet;
+	b[3][3] = (a[2][0] * s3 - a[2][1] * s1 + a[2][2] * s0) * invDet;
+}
+
+// Inverse transpose of the upper 3x3 (rows are the cross products of the other two rows), on four matrices at once.
+static INLINE void InverseTransposeSoA(const XMVECTOR a[4][4], XMVECTOR n[3][3]) {
+	n[0][0] = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+	n[0][1] = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+	n[0][2] = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+	n[1][0] = a[2][1] * a[0][2] - a[2][2] * a[0][1];
+	n[1][1] = a[2][2] * a[0][0] - a[2][0] * a[0][2];
+	n[1][2] = a[2][0] * a[0][1] - a[2][1] * a[0][0];
+	n[2][0] = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+	n[2][1] = a[0][2] * a[1][0] - a[0][0] * a[1][2];
+	n[2][2] = a[0][0] * a[1][1] - a[0][1] * a[1][0];
+
+	const XMVECTOR invDet = XMVectorReciprocal(a[0][0] * n[0][0] + a[0][1] * n[0][1] + a[0][2] * n[0][2]);
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j)
+			n[i][j] *= invDet;
+	}
+}
+
+static void InvertRange(const Matrix4* Source, Matrix4* Dest, size_t Count) {
+	XMVECTOR a[4][4], b[4][4];
+	size_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		LoadSoA(Source + i, a);
+		InvertSoA(a, b);
+		StoreSoA(b, Dest + i);
+	}
+	for (; i < Count; ++i)
+		Dest[i] = Invert(Source[i]);
+}
+
+static void InvertAffineRange(const Matrix4* Source, Matrix4* Dest, size_t Count) {
+	XMVECTOR a[4][4], b[4][4], n[3][3];
+	size_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		LoadSoA(Source + i, a);
+		InverseTransposeSoA(a, n);
+
+		// The inverse of the 3x3 is the transpose of n. The translation is -t * inverse.
+		for (int r = 0; r < 3; ++r) {
+			for (int c = 0; c < 3; ++c)
+				b[r][c] = n[c][r];
+			b[r][3] = XMVectorZero();
+		}
+		for (int c = 0; c < 3; ++c)
+			b[3][c] = XMVectorNegate(a[3][0] * n[c][0] + a[3][1] * n[c][1] + a[3][2] * n[c][2]);
+		b[3][3] = g_XMOne;
+
+		StoreSoA(b, Dest + i);
+	}
+	for (; i < Count; ++i) {
+		AffineTransform xform(Source[i].Get3x3(), Vector3(XMVECTOR(Source[i].GetW())));
+		Dest[i] = Matrix4(Invert(xform));
+	}
+}
+
+static void InvertOrthonormalRange(const Matrix4* Source, Matrix4* Dest, size_t Count) {
+	for (size_t i = 0; i < Count; ++i)
+		Dest[i] = OrthoInvert(Source[i]);
+}
+
+static void NormalMatrixRange(const Matrix4* Source, Matrix3* Dest, size_t Count) {
+	XMVECTOR a[4][4], n[3][3];
+	size_t i = 0;
+	for (; i + 4 <= Count; i += 4) {
+		LoadSoA(Source + i, a);
+		InverseTransposeSoA(a, n);
+
+		XMMATRIX Rows[3];
+		for (int r = 0; r < 3; ++r)
+			Rows[r] = XMMatrixTranspose(XMMATRIX(n[r][0], n[r][1], n[r][2], XMVectorZero()));
+		for (int k = 0; k < 4; ++k)
+			Dest[i + k] = Matrix3(Vector3(Rows[0].r[k]), Vector3(Rows[1].r[k]), Vector3(Rows[2].r[k]));
+	}
+	for (; i < Count; ++i)
+		Dest[i] = InverseTranspose(Source[i].Get3x3());
+}
+
+template <typename DestType, typename RangeFunc>
+static void ForEachBatch(const Matrix4* Source, DestType* Dest, size_t Count, RangeFunc Func) {
+	if (Count <= kBatchChunkSize) {
+		Func(Source, Dest, Count);
+		return;
+	}
+
+	ParallelFor(size_t(0), DivideByMultiple(Count, kBatchChunkSize), [&](size_t Chunk) {
+		const size_t Begin = Chunk * kBatchChunkSize;
+		const size_t End = Begin + kBatchChunkSize < Count ? Begin + kBatchChunkSize : Count;
+		Func(Source + Begin, Dest + Begin, End - Begin);
+	});
+}
+
+void InvertMatrices(const Matrix4* Source, Matrix4* Dest, size_t Count) {
+	ForEachBatch(Source, Dest, Count, InvertRange);
+}
+
+void InvertAffineMatrices(const Matrix4* Source, Matrix4* Dest, size_t Count) {
+	ForEachBatch(Source, Dest, Count, InvertAffineRange);
+}
+
+void InvertOrthonormalMatrices(const Matrix4* Source, Matrix4* Dest, size_t Count) {
+	ForEachBatch(Source, Dest, Count, InvertOrthonormalRange);
+}
+
+void ComputeNormalMatrices(const Matrix4* Source, Matrix3* Dest, size_t Count) {
+	ForEachBatch(Source, Dest, Count, NormalMatrixRange);
+}
+
+}	// namespace Math
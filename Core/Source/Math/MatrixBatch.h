@@ -0,0 +1,24 @@
+//
+// Batch matrix inversion. Four matrices are transposed into SoA form and inverted together, one matrix per SIMD lane.
+// Large batches are split across threads. Input and output arrays may alias.
+//
+
+#pragma once
+
+#include "VectorMath.h"
+
+namespace Math {
+
+// General 4x4 inverse (cofactor expansion).
+void InvertMatrices(const Matrix4* Source, Matrix4* Dest, size_t Count);
+
+// Fast path for affine matrices, the 4th column is assumed to be [0,0,0,1].
+void InvertAffineMatrices(const Matrix4* Source, Matrix4* Dest, size_t Count);
+
+// Fast path for rigid transforms with an orthonormal 3x3 part.
+void InvertOrthonormalMatrices(const Matrix4* Source, Matrix4* Dest, size_t Count);
+
+// Inverse transpose of the upper 3x3, used to transform normals.
+void ComputeNormalMatrices(const Matrix4* Source, Matrix3* Dest, size_t Count);
+
+}	// namespace Math
@@ -0,0 +1,330 @@
+//
+// Procedural noise evaluated on 4 positions at once.
+//
+
+#include "pch.h"
+#include "Noise.h"
+#include "Parallel.h"
+#include "Random.h"
+
+using namespace DirectX;
+
+namespace Math {
+
+// Positions per task when evaluating streams.
+static const size_t kNoiseChunkSize = 4096;
+
+// Rescale each kernel to about [-1, 1].
+static const float kGradientNoise2DScale = 1.41421356f;
+static const float kSimplexNoise2DScale = 99.0f;
+static const float kSimplexNoise3DScale = 32.0f;
+
+// Decorrelates the octaves of a fractal sum.
+static const uint32_t kOctaveSeedStep = 0x9E3779B9u;
+
+// Quintic interpolant 6t^5 - 15t^4 + 10t^3, with zero first and second derivatives at the lattice points.
+static INLINE XMVECTOR Fade(FXMVECTOR t) {
+	const XMVECTOR Inner = XMVectorMultiplyAdd(t, XMVectorMultiplyAdd(t, XMVectorReplicate(6.0f), XMVectorReplicate(-15.0f)), XMVectorReplicate(10.0f));
+	return t * t * t * Inner;
+}
+
+static INLINE XMVECTOR ToInt(FXMVECTOR FloorValue) {
+	return XMConvertVectorFloatToInt(FloorValue, 0);
+}
+
+// The top 24 bits of a hash mapped to [-1, 1).
+static INLINE XMVECTOR HashToFloat(FXMVECTOR h) {
+	return XMConvertVectorUIntToFloat(VectorShiftRightInt(h, 8), 23) - g_XMOne;
+}
+
+// All bits set in the lanes where h has any of the bits.
+static INLINE XMVECTOR TestBits(FXMVECTOR h, uint32_t Bits) {
+	return XMVectorNotEqualInt(XMVectorAndInt(h, XMVectorReplicateInt(Bits)), XMVectorZero());
+}
+
+static INLINE XMVECTOR TestBitsEqual(FXMVECTOR h, uint32_t Bits, uint32_t Value) {
+	return XMVectorEqualInt(XMVectorAndInt(h, XMVectorReplicateInt(Bits)), XMVectorReplicateInt(Value));
+}
+
+// Dot product with one of 8 unit gradients, spaced every 45 degrees. Bit 0 picks a diagonal or an axis, bits 1 and 2
+// the signs or the axis.
+static INLINE XMVECTOR Gradient2D(FXMVECTOR h, FXMVECTOR x, FXMVECTOR y) {
+	const XMVECTOR Diagonal = TestBits(h, 1), Bit1 = TestBits(h, 2), Bit2 = TestBits(h, 4);
+	const XMVECTOR a = XMVectorReplicate(0.70710678f);
+	const XMVECTOR Sign2 = XMVectorSelect(g_XMOne, g_XMNegativeOne, Bit2);
+
+	const XMVECTOR DiagonalX = XMVectorSelect(a, XMVectorNegate(a), Bit1);
+	const XMVECTOR DiagonalY = a * Sign2;
+	const XMVECTOR AxisX = XMVectorSelect(Sign2, XMVectorZero(), Bit1);
+	const XMVECTOR AxisY = XMVectorSelect(XMVectorZero(), Sign2, Bit1);
+
+	const XMVECTOR gx = XMVectorSelect(AxisX, DiagonalX, Diagonal);
+	const XMVECTOR gy = XMVectorSelect(AxisY, DiagonalY, Diagonal);
+	return XMVectorMultiplyAdd(gx, x, gy * y);
+}
+
+// Dot product with one of the 12 cube edge directions (improved Perlin noise, 4 of them repeated).
+static INLINE XMVECTOR Gradient3D(FXMVECTOR h, FXMVECTOR x, FXMVECTOR y, GXMVECTOR z) {
+	const XMVECTOR u = XMVectorSelect(y, x, TestBitsEqual(h, 8, 0));
+	const XMVECTOR v = XMVectorSelect(XMVectorSelect(z, x, TestBitsEqual(h, 13, 12)), y, TestBitsEqual(h, 12, 0));
+	return XMVectorSelect(u, XMVectorNegate(u), TestBits(h, 1)) + XMVectorSelect(v, XMVectorNegate(v), TestBits(h, 2));
+}
+
+XMVECTOR ValueNoise(FXMVECTOR x, FXMVECTOR y, uint32_t seed) {
+	const XMVECTOR x0 = XMVectorFloor(x), y0 = XMVectorFloor(y);
+	const XMVECTOR u = Fade(x - x0), v = Fade(y - y0);
+	const XMVECTOR ix0 = ToInt(x0), ix1 = ToInt(x0 + g_XMOne);
+	const XMVECTOR iy0 = ToInt(y0), iy1 = ToInt(y0 + g_XMOne);
+
+	const XMVECTOR v00 = HashToFloat(HashCoordinates(ix0, iy0, seed));
+	const XMVECTOR v10 = HashToFloat(HashCoordinates(ix1, iy0, seed));
+	const XMVECTOR v01 = HashToFloat(HashCoordinates(ix0, iy1, seed));
+	const XMVECTOR v11 = HashToFloat(HashCoordinates(ix1, iy1, seed));
+	return XMVectorLerpV(XMVectorLerpV(v00, v10, u), XMVectorLerpV(v01, v11, u), v);
+}
+
+XMVECTOR ValueNoise(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, uint32_t seed) {
+	const XMVECTOR x0 = XMVectorFloor(x), y0 = XMVectorFloor(y), z0 = XMVectorFloor(z);
+	const XMVECTOR u = Fade(x - x0), v = Fade(y - y0), w = Fade(z - z0);
+	const XMVECTOR ix0 = ToInt(x0), ix1 = ToInt(x0 + g_XMOne);
+	const XMVECTOR iy0 = ToInt(y0), iy1 = ToInt(y0 + g_XMOne);
+	const XMVECTOR iz0 = ToInt(z0), iz1 = ToInt(z0 + g_XMOne);
+
+	const XMVECTOR Near = XMVectorLerpV(
+		XMVectorLerpV(HashToFloat(HashCoordinates(ix0, iy0, iz0, seed)), HashToFloat(HashCoordinates(ix1, iy0, iz0, seed)), u),
+		XMVectorLerpV(HashToFloat(HashCoordinates(ix0, iy1, iz0, seed)), HashToFloat(HashCoordinates(ix1, iy1, iz0, seed)), u), v);
+	const XMVECTOR Far = XMVectorLerpV(
+		XMVectorLerpV(HashToFloat(HashCoordinates(ix0, iy0, iz1, seed)), HashToFloat(HashCoordinates(ix1, iy0, iz1, seed)), u),
+		XMVectorLerpV(HashToFloat(HashCoordinates(ix0, iy1, iz1, seed)), HashToFloat(HashCoordinates(ix1, iy1, iz1, seed)), u), v);
+	return XMVectorLerpV(Near, Far, w);
+}
+
+XMVECTOR GradientNoise(FXMVECTOR x, FXMVECTOR y, uint32_t seed) {
+	const XMVECTOR x0 = XMVectorFloor(x), y0 = XMVectorFloor(y);
+	const XMVECTOR fx0 = x - x0, fy0 = y - y0;
+	const XMVECTOR fx1 = fx0 - g_XMOne, fy1 = fy0 - g_XMOne;
+	const XMVECTOR u = Fade(fx0), v = Fade(fy0);
+	const XMVECTOR ix0 = ToInt(x0), ix1 = ToInt(x0 + g_XMOne);
+	const XMVECTOR iy0 = ToInt(y0), iy1 = ToInt(y0 + g_XMOne);
+
+	const XMVECTOR n00 = Gradient2D(HashCoordinates(ix0, iy0, seed), fx0, fy0);
+	const XMVECTOR n10 = Gradient2D(HashCoordinates(ix1, iy0, seed), fx1, fy0);
+	const XMVECTOR n01 = Gradient2D(HashCoordinates(ix0, iy1, seed), fx0, fy1);
+	const XMVECTOR n11 = Gradient2D(HashCoordinates(ix1, iy1, seed), fx1, fy1);
+	return XMVectorLerpV(XMVectorLerpV(n00, n10, u), XMVectorLerpV(n01, n11, u), v) * kGradientNoise2DScale;
+}
+
+XMVECTOR GradientNoise(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, uint32_t seed) {
+	const XMVECTOR x0 = XMVectorFloor(x), y0 = XMVectorFloor(y), z0 = XMVectorFloor(z);
+	const XMVECTOR fx0 = x - x0, fy0 = y - y0, fz0 = z - z0;
+	const XMVECTOR fx1 = fx0 - g_XMOne, fy1 = fy0 - g_XMOne, fz1 = fz0 - g_XMOne;
+	const XMVECTOR u = Fade(fx0), v = Fade(fy0), w = Fade(fz0);
+	const XMVECTOR ix0 = ToInt(x0), ix1 = ToInt(x0 + g_XMOne);
+	const XMVECTOR iy0 = ToInt(y0), iy1 = ToInt(y0 + g_XMOne);
+	const XMVECTOR iz0 = ToInt(z0), iz1 = ToInt(z0 + g_XMOne);
+
+	const XMVECTOR Near = XMVectorLerpV(
+		XMVectorLerpV(Gradient3D(HashCoordinates(ix0, iy0, iz0, seed), fx0, fy0, fz0), Gradient3D(HashCoordinates(ix1, iy0, iz0, seed), fx1, fy0, fz0), u),
+		XMVectorLerpV(Gradient3D(HashCoordinates(ix0, iy1, iz0, seed), fx0, fy1, fz0), Gradient3D(HashCoordinates(ix1, iy1, iz0, seed), fx1, fy1, fz0), u), v);
+	const XMVECTOR Far = XMVectorLerpV(
+		XMVectorLerpV(Gradient3D(HashCoordinates(ix0, iy0, iz1, seed), fx0, fy0, fz1), Gradient3D(HashCoordinates(ix1, iy0, iz1, seed), fx1, fy0, fz1), u),
+		XMVectorLerpV(Gradient3D(HashCoordinates(ix0, iy1, iz1, seed), fx0, fy1, fz1), Gradient3D(HashCoordinates(ix1, iy1, iz1, seed), fx1, fy1, fz1), u), v);
+	return XMVectorLerpV(Near, Far, w);
+}
+
+// Contribution of a simplex corner, max(r^2 - d^2, 0)^4 * dot(gradient, d).
+static INLINE XMVECTOR SimplexCorner2D(FXMVECTOR h, FXMVECTOR x, FXMVECTOR y) {
+	XMVECTOR t = XMVectorMax(XMVectorReplicate(0.5f) - x * x - y * y, XMVectorZero());
+	t *= t;
+	return t * t * Gradient2D(h, x, y);
+}
+
+static INLINE XMVECTOR SimplexCorner3D(FXMVECTOR h, FXMVECTOR x, FXMVECTOR y, GXMVECTOR z) {
+	XMVECTOR t = XMVectorMax(XMVectorReplicate(0.6f) - x * x - y * y - z * z, XMVectorZero());
+	t *= t;
+	return t * t * Gradient3D(h, x, y, z);
+}
+
+XMVECTOR SimplexNoise(FXMVECTOR x, FXMVECTOR y, uint32_t seed) {
+	const float F2 = 0.366025404f;	// (sqrt(3) - 1) / 2
+	const float G2 = 0.211324865f;	// (3 - sqrt(3)) / 6
+
+	// Skew to find the simplex cell, then unskew the cell origin back.
+	const XMVECTOR s = (x + y) * F2;
+	const XMVECTOR i = XMVectorFloor(x + s), j = XMVectorFloor(y + s);
+	const XMVECTOR t = (i + j) * G2;
+	const XMVECTOR x0 = x - (i - t), y0 = y - (j - t);
+
+	// The middle corner is along x first when x0 > y0.
+	const XMVECTOR i1 = XMVectorSelect(XMVectorZero(), g_XMOne, XMVectorGreater(x0, y0));
+	const XMVECTOR j1 = g_XMOne - i1;
+	const XMVECTOR G = XMVectorReplicate(G2);
+	const XMVECTOR x1 = x0 - i1 + G, y1 = y0 - j1 + G;
+	const XMVECTOR x2 = x0 - g_XMOne + G + G, y2 = y0 - g_XMOne + G + G;
+
+	const XMVECTOR n0 = SimplexCorner2D(HashCoordinates(ToInt(i), ToInt(j), seed), x0, y0);
+	const XMVECTOR n1 = SimplexCorner2D(HashCoordinates(ToInt(i + i1), ToInt(j + j1), seed), x1, y1);
+	const XMVECTOR n2 = SimplexCorner2D(HashCoordinates(ToInt(i + g_XMOne), ToInt(j + g_XMOne), seed), x2, y2);
+	return (n0 + n1 + n2) * kSimplexNoise2DScale;
+}
+
+XMVECTOR SimplexNoise(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, uint32_t seed) {
+	const float F3 = 1.0f / 3.0f;
+	const float G3 = 1.0f / 6.0f;
+
+	const XMVECTOR s = (x + y + z) * F3;
+	const XMVECTOR i = XMVectorFloor(x + s), j = XMVectorFloor(y + s), k = XMVectorFloor(z + s);
+	const XMVECTOR t = (i + j + k) * G3;
+	const XMVECTOR x0 = x - (i - t), y0 = y - (j - t), z0 = z - (k - t);
+
+	// Rank the offsets to find the simplex, the second and third corners step along the largest axes first.
+	const XMVECTOR xy = XMVectorGreaterOrEqual(x0, y0);
+	const XMVECTOR xz = XMVectorGreaterOrEqual(x0, z0);
+	const XMVECTOR yz = XMVectorGreaterOrEqual(y0, z0);
+	const XMVECTOR Zero = XMVectorZero();
+	const XMVECTOR i1 = XMVectorSelect(Zero, g_XMOne, XMVectorAndInt(xy, xz));
+	const XMVECTOR j1 = XMVectorSelect(Zero, g_XMOne, XMVectorAndCInt(yz, xy));
+	const XMVECTOR k1 = XMVectorSelect(g_XMOne, Zero, XMVectorOrInt(xz, yz));
+	const XMVECTOR i2 = XMVectorSelect(Zero, g_XMOne, XMVectorOrInt(xy, xz));
+	const XMVECTOR j2 = XMVectorSelect(g_XMOne, Zero, XMVectorAndCInt(xy, yz));
+	const XMVECTOR k2 = XMVectorSelect(g_XMOne, Zero, XMVectorAndInt(xz, yz));
+
+	const XMVECTOR G = XMVectorReplicate(G3);
+	const XMVECTOR x1 = x0 - i1 + G, y1 = y0 - j1 + G, z1 = z0 - k1 + G;
+	const XMVECTOR x2 = x0 - i2 + G + G, y2 = y0 - j2 + G + G, z2 = z0 - k2 + G + G;
+	const XMVECTOR Offset3 = XMVectorReplicate(3.0f * G3 - 1.0f);
+	const XMVECTOR x3 = x0 + Offset3, y3 = y0 + Offset3, z3 = z0 + Offset3;
+
+	const XMVECTOR n0 = SimplexCorner3D(HashCoordinates(ToInt(i), ToInt(j), ToInt(k), seed), x0, y0, z0);
+	const XMVECTOR n1 = SimplexCorner3D(HashCoordinates(ToInt(i + i1), ToInt(j + j1), ToInt(k + k1), seed), x1, y1, z1);
+	const XMVECTOR n2 = SimplexCorner3D(HashCoordinates(ToInt(i + i2), ToInt(j + j2), ToInt(k + k2), seed), x2, y2, z2);
+	const XMVECTOR n3 = SimplexCorner3D(HashCoordinates(ToInt(i + g_XMOne), ToInt(j + g_XMOne), ToInt(k + g_XMOne), seed), x3, y3, z3);
+	return (n0 + n1 + n2 + n3) * kSimplexNoise3DScale;
+}
+
+static INLINE XMVECTOR EvaluateOctave(NoiseType Type, FXMVECTOR x, FXMVECTOR y, uint32_t seed) {
+	switch (Type) {
+	case NoiseType::kValue: return ValueNoise(x, y, seed);
+	case NoiseType::kGradient: return GradientNoise(x, y, seed);
+	default: return SimplexNoise(x, y, seed);
+	}
+}
+
+static INLINE XMVECTOR EvaluateOctave(NoiseType Type, FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, uint32_t seed) {
+	switch (Type) {
+	case NoiseType::kValue: return ValueNoise(x, y, z, seed);
+	case NoiseType::kGradient: return GradientNoise(x, y, z, seed);
+	default: return SimplexNoise(x, y, z, seed);
+	}
+}
+
+XMVECTOR FractalNoise(const FractalNoiseDesc& desc, FXMVECTOR x, FXMVECTOR y) {
+	XMVECTOR Sum = XMVectorZero();
+	float Amplitude = 1.0f, Frequency = desc.Frequency, TotalAmplitude = 0.0f;
+	for (uint32_t Octave = 0; Octave < desc.Octaves; ++Octave) {
+		const XMVECTOR n = EvaluateOctave(desc.Type, x * Frequency, y * Frequency, desc.Seed + Octave * kOctaveSeedStep);
+		Sum = XMVectorMultiplyAdd(n, XMVectorReplicate(Amplitude), Sum);
+		TotalAmplitude += Amplitude;
+		Amplitude *= desc.Gain;
+		Frequency *= desc.Lacunarity;
+	}
+	return TotalAmplitude > 0.0f ? Sum * (1.0f / TotalAmplitude) : Sum;
+}
+
+XMVECTOR FractalNoise(const FractalNoiseDesc& desc, FXMVECTOR x, FXMVECTOR y, FXMVECTOR z) {
+	XMVECTOR Sum = XMVectorZero();
+	float Amplitude = 1.0f, Frequency = desc.Frequency, TotalAmplitude = 0.0f;
+	for (uint32_t Octave = 0; Octave < desc.Octaves; ++Octave) {
+		const XMVECTOR n = EvaluateOctave(desc.Type, x * Frequency, y * Frequency, z * Frequency, desc.Seed + Octave * kOctaveSeedStep);
+		Sum = XMVectorMultiplyAdd(n, XMVectorReplicate(Amplitude), Sum);
+		TotalAmplitude += Amplitude;
+		Amplitude *= desc.Gain;
+		Frequency *= desc.Lacunarity;
+	}
+	return TotalAmplitude > 0.0f ? Sum * (1.0f / TotalAmplitude) : Sum;
+}
+
+// Stores the first Count lanes.
+static INLINE void StoreLanes(float* Dest, FXMVECTOR Values, size_t Count) {
+	if (Count >= 4) {
+		XMStoreFloat4((XMFLOAT4*)Dest, Values);
+		return;
+	}
+	XMFLOAT4 Lanes;
+	XMStoreFloat4(&Lanes, Values);
+	for (size_t l = 0; l < Count; ++l)
+		Dest[l] = (&Lanes.x)[l];
+}
+
+template <typename RangeFunc>
+static void ForEachNoiseChunk(size_t Count, RangeFunc Func) {
+	if (Count <= kNoiseChunkSize) {
+		Func(size_t(0), Count);
+		return;
+	}
+
+	ParallelFor(size_t(0), DivideByMultiple(Count, kNoiseChunkSize), [&](size_t Chunk) {
+		const size_t Begin = Chunk * kNoiseChunkSize;
+		const size_t End = Begin + kNoiseChunkSize < Count ? Begin + kNoiseChunkSize : Count;
+		Func(Begin, End);
+	});
+}
+
+void EvaluateNoise(const FractalNoiseDesc& desc, const XMFLOAT2* Positions, size_t Count, float* Dest) {
+	ForEachNoiseChunk(Count, [&](size_t Begin, size_t End) {
+		for (size_t i = Begin; i < End; i += 4) {
+			// Lanes past the end repeat the last position.
+			const XMFLOAT2& p0 = Positions[i];
+			const XMFLOAT2& p1 = Positions[i + 1 < End ? i + 1 : End - 1];
+			const XMFLOAT2& p2 = Positions[i + 2 < End ? i + 2 : End - 1];
+			const XMFLOAT2& p3 = Positions[i + 3 < End ? i + 3 : End - 1];
+			const XMVECTOR x = XMVectorSet(p0.x, p1.x, p2.x, p3.x);
+			const XMVECTOR y = XMVectorSet(p0.y, p1.y, p2.y, p3.y);
+			StoreLanes(Dest + i, FractalNoise(desc, x, y), End - i);
+		}
+	});
+}
+
+void EvaluateNoise(const FractalNoiseDesc& desc, const XMFLOAT3* Positions, size_t Count, float* Dest) {
+	ForEachNoiseChunk(Count, [&](size_t Begin, size_t End) {
+		for (size_t i = Begin; i < End; i += 4) {
+			const XMFLOAT3& p0 = Positions[i];
+			const XMFLOAT3& p1 = Positions[i + 1 < End ? i + 1 : End - 1];
+			const XMFLOAT3& p2 = Positions[i + 2 < End ? i + 2 : End - 1];
+			const XMFLOAT3& p3 = Positions[i + 3 < End ? i + 3 : End - 1];
+			const XMVECTOR x = XMVectorSet(p0.x, p1.x, p2.x, p3.x);
+			const XMVECTOR y = XMVectorSet(p0.y, p1.y, p2.y, p3.y);
+			const XMVECTOR z = XMVectorSet(p0.z, p1.z, p2.z, p3.z);
+			StoreLanes(Dest + i, FractalNoise(desc, x, y, z), End - i);
+		}
+	});
+}
+
+// Positions are computed from the integer sample index rather than accumulated, so they do not depend on where a row
+// or chunk starts.
+static INLINE XMVECTOR GridLanes(float Origin, uint32_t Index, float Spacing) {
+	const XMVECTOR Indices = XMVectorAdd(XMVectorReplicate(float(Index)), XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f));
+	return XMVectorMultiplyAdd(Indices, XMVectorReplicate(Spacing), XMVectorReplicate(Origin));
+}
+
+void FillNoiseGrid(const FractalNoiseDesc& desc, uint32_t Width, uint32_t Height, XMFLOAT2 Origin, float Spacing, float* Dest) {
+	ParallelFor(0u, Height, [&](uint32_t Row) {
+		const XMVECTOR y = XMVectorReplicate(Origin.y + Row * Spacing);
+		float* RowDest = Dest + size_t(Row) * Width;
+		for (uint32_t Column = 0; Column < Width; Column += 4)
+			StoreLanes(RowDest + Column, FractalNoise(desc, GridLanes(Origin.x, Column, Spacing), y), Width - Column);
+	});
+}
+
+void FillNoiseGrid(const FractalNoiseDesc& desc, uint32_t Width, uint32_t Height, uint32_t Depth, XMFLOAT3 Origin, float Spacing, float* Dest) {
+	ParallelFor(0u, Height * Depth, [&](uint32_t Row) {
+		const uint32_t Slice = Row / Height;
+		const XMVECTOR y = XMVectorReplicate(Origin.y + (Row % Height) * Spacing);
+		const XMVECTOR z = XMVectorReplicate(Origin.z + Slice * Spacing);
+		float* RowDest = Dest + size_t(Row) * Width;
+		for (uint32_t Column = 0; Column < Width; Column += 4)
+			StoreLanes(RowDest + Column, FractalNoise(desc, GridLanes(Origin.x, Column, Spacing), y, z), Width - Column);
+	});
+}
+
+}	// namespace Math
@@ -0,0 +1,52 @@
+//
+// Procedural noise evaluated on 4 positions at once. Lattice values and gradients come from the stateless hashes in
+// Random.h, so a sample only depends on its position and seed: results are identical whatever order or thread the
+// samples are evaluated on, which makes grids deterministic across thread counts. All functions return values in
+// about [-1, 1].
+//
+
+#pragma once
+
+#include "VectorMath.h"
+
+namespace Math {
+
+enum class NoiseType {
+	kValue,		// interpolated random lattice values
+	kGradient,	// Perlin style gradient noise
+	kSimplex,	// gradient noise on a simplex lattice, fewer lattice points per sample
+};
+
+struct FractalNoiseDesc {
+	FractalNoiseDesc() : Type(NoiseType::kSimplex), Octaves(4), Frequency(1.0f), Lacunarity(2.0f), Gain(0.5f), Seed(0) {}
+
+	NoiseType Type;
+	uint32_t Octaves;
+	float Frequency;	// of the first octave
+	float Lacunarity;	// frequency multiplier between octaves
+	float Gain;			// amplitude multiplier between octaves
+	uint32_t Seed;
+};
+
+// Single octave kernels, one position per lane.
+DirectX::XMVECTOR ValueNoise(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, uint32_t seed);
+DirectX::XMVECTOR ValueNoise(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, DirectX::FXMVECTOR z, uint32_t seed);
+DirectX::XMVECTOR GradientNoise(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, uint32_t seed);
+DirectX::XMVECTOR GradientNoise(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, DirectX::FXMVECTOR z, uint32_t seed);
+DirectX::XMVECTOR SimplexNoise(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, uint32_t seed);
+DirectX::XMVECTOR SimplexNoise(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, DirectX::FXMVECTOR z, uint32_t seed);
+
+// Fractal Brownian motion, the sum of octaves normalized by the sum of their amplitudes.
+DirectX::XMVECTOR FractalNoise(const FractalNoiseDesc& desc, DirectX::FXMVECTOR x, DirectX::FXMVECTOR y);
+DirectX::XMVECTOR FractalNoise(const FractalNoiseDesc& desc, DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, DirectX::FXMVECTOR z);
+
+// Evaluates a stream of positions. Large streams are split across threads.
+void EvaluateNoise(const FractalNoiseDesc& desc, const DirectX::XMFLOAT2* Positions, size_t Count, float* Dest);
+void EvaluateNoise(const FractalNoiseDesc& desc, const DirectX::XMFLOAT3* Positions, size_t Count, float* Dest);
+
+// Fills a row major grid, sample (x, y[, z]) is taken at Origin + (x, y[, z]) * Spacing. Rows are processed in parallel.
+void FillNoiseGrid(const FractalNoiseDesc& desc, uint32_t Width, uint32_t Height, DirectX::XMFLOAT2 Origin, float Spacing, float* Dest);
+void FillNoiseGrid(const FractalNoiseDesc& desc, uint32_t Width, uint32_t Height, uint32_t Depth, DirectX::XMFLOAT3 Origin,
+	float Spacing, float* Dest);
+
+}	// namespace Math
@@ -0,0 +1,69 @@
+//
+// Parallel loops for the Math batch functions. MSVC builds use the Concurrency Runtime, other compilers a pool of
+// std::threads, so no Math file depends on PPL directly.
+//
+
+#pragma once
+
+#include "Common.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#if defined(_MSC_VER)
+#include <ppl.h>
+#else
+#include <atomic>
+#include <thread>
+#include <vector>
+#endif
+
+namespace Math {
+
+// Calls Func(i) for every i in [Begin, End), in no particular order and possibly from several threads at once.
+template <typename IndexType, typename FuncType>
+void ParallelFor(IndexType Begin, IndexType End, const FuncType& Func) {
+	if (End <= Begin)
+		return;
+	if (End - Begin == 1) {
+		Func(Begin);
+		return;
+	}
+
+#if defined(_MSC_VER)
+	Concurrency::parallel_for(Begin, End, Func);
+#else
+	// The calling thread works too, and every thread takes the next index until none are left.
+	const size_t Count = size_t(End - Begin);
+	const size_t ThreadCount = std::min<size_t>(Count, std::max(1u, std::thread::hardware_concurrency()));
+	std::atomic<size_t> Next(0);
+	auto Worker = [&]() {
+		for (size_t i = Next++; i < Count; i = Next++)
+			Func(IndexType(Begin + i));
+	};
+
+	std::vector<std::thread> Threads;
+	Threads.reserve(ThreadCount - 1);
+	for (size_t t = 1; t < ThreadCount; ++t)
+		Threads.emplace_back(Worker);
+	Worker();
+	for (std::thread& Thread : Threads)
+		Thread.join();
+#endif
+}
+
+template <typename IteratorType, typename CompareType>
+void ParallelSort(IteratorType First, IteratorType Last, const CompareType& Compare) {
+#if defined(_MSC_VER)
+	Concurrency::parallel_sort(First, Last, Compare);
+#else
+	std::sort(First, Last, Compare);
+#endif
+}
+
+template <typename IteratorType>
+void ParallelSort(IteratorType First, IteratorType Last) {
+	ParallelSort(First, Last, std::less<typename std::iterator_traits<IteratorType>::value_type>());
+}
+
+}	// namespace Math
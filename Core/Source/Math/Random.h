@@ -47,4 +47,74 @@ private:
 // Global random generator.
 extern RandomNumberGenerator g_RNG;
 
+// Stateless integer hash (lowbias32). Unlike the generator above, the result only depends on the input, so values for
+// any index or coordinate can be computed independently and in any order, which procedural generation relies on.
+INLINE uint32_t Hash32(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7FEB352Du;
+	x ^= x >> 15;
+	x *= 0x846CA68Bu;
+	x ^= x >> 16;
+	return x;
+}
+
+INLINE uint32_t HashCoordinates(int32_t x, int32_t y, uint32_t seed) {
+	return Hash32(((uint32_t)x * 0x8DA6B343u) ^ ((uint32_t)y * 0xD8163841u) ^ seed);
+}
+
+INLINE uint32_t HashCoordinates(int32_t x, int32_t y, int32_t z, uint32_t seed) {
+	return Hash32(((uint32_t)x * 0x8DA6B343u) ^ ((uint32_t)y * 0xD8163841u) ^ ((uint32_t)z * 0xCB1AB31Fu) ^ seed);
+}
+
+// Lane wise 32 bit integer operations on vectors, which DirectXMath does not provide.
+INLINE DirectX::XMVECTOR VectorMultiplyInt(DirectX::FXMVECTOR v, uint32_t c) {
+#if defined(_XM_SSE4_INTRINSICS_)
+	return _mm_castsi128_ps(_mm_mullo_epi32(_mm_castps_si128(v), _mm_set1_epi32((int)c)));
+#elif defined(_XM_SSE_INTRINSICS_)
+	// Multiply the even and odd lanes to 64 bits and keep the low halves.
+	const __m128i a = _mm_castps_si128(v);
+	const __m128i b = _mm_set1_epi32((int)c);
+	const __m128i Even = _mm_mul_epu32(a, b);
+	const __m128i Odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), b);
+	return _mm_castsi128_ps(_mm_unpacklo_epi32(_mm_shuffle_epi32(Even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(Odd, _MM_SHUFFLE(0, 0, 2, 0))));
+#else
+	DirectX::XMUINT4 Lanes;
+	DirectX::XMStoreUInt4(&Lanes, v);
+	Lanes.x *= c; Lanes.y *= c; Lanes.z *= c; Lanes.w *= c;
+	return DirectX::XMLoadUInt4(&Lanes);
+#endif
+}
+
+INLINE DirectX::XMVECTOR VectorShiftRightInt(DirectX::FXMVECTOR v, int count) {
+#if defined(_XM_SSE_INTRINSICS_)
+	return _mm_castsi128_ps(_mm_srli_epi32(_mm_castps_si128(v), count));
+#else
+	DirectX::XMUINT4 Lanes;
+	DirectX::XMStoreUInt4(&Lanes, v);
+	Lanes.x >>= count; Lanes.y >>= count; Lanes.z >>= count; Lanes.w >>= count;
+	return DirectX::XMLoadUInt4(&Lanes);
+#endif
+}
+
+// Hash32 on 4 integer lanes, bit exact with the scalar version.
+INLINE DirectX::XMVECTOR Hash32(DirectX::FXMVECTOR v) {
+	DirectX::XMVECTOR x = DirectX::XMVectorXorInt(v, VectorShiftRightInt(v, 16));
+	x = VectorMultiplyInt(x, 0x7FEB352Du);
+	x = DirectX::XMVectorXorInt(x, VectorShiftRightInt(x, 15));
+	x = VectorMultiplyInt(x, 0x846CA68Bu);
+	return DirectX::XMVectorXorInt(x, VectorShiftRightInt(x, 16));
+}
+
+// HashCoordinates on 4 lanes of integer coordinates.
+INLINE DirectX::XMVECTOR HashCoordinates(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, uint32_t seed) {
+	DirectX::XMVECTOR h = DirectX::XMVectorXorInt(VectorMultiplyInt(x, 0x8DA6B343u), VectorMultiplyInt(y, 0xD8163841u));
+	return Hash32(DirectX::XMVectorXorInt(h, DirectX::XMVectorReplicateInt(seed)));
+}
+
+INLINE DirectX::XMVECTOR HashCoordinates(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y, DirectX::FXMVECTOR z, uint32_t seed) {
+	DirectX::XMVECTOR h = DirectX::XMVectorXorInt(VectorMultiplyInt(x, 0x8DA6B343u), VectorMultiplyInt(y, 0xD8163841u));
+	h = DirectX::XMVectorXorInt(h, VectorMultiplyInt(z, 0xCB1AB31Fu));
+	return Hash32(DirectX::XMVectorXorInt(h, DirectX::XMVectorReplicateInt(seed)));
+}
+
 }	// namespace Math
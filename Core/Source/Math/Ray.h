@@ -0,0 +1,217 @@
+//
+// Ray and ray packet intersection kernels. Packets hold 4 rays in SoA layout so that one SIMD lane processes one ray.
+//
+
+#pragma once
+
+#include "VectorMath.h"
+#include "BoundingBox.h"
+#include <cfloat>
+
+namespace Math {
+
+class Ray {
+public:
+	Ray() {}
+	Ray(Vector3 origin, Vector3 direction, float tMax = FLT_MAX) :
+		m_origin(origin), m_direction(direction), m_invDirection(Recip(direction)), m_tMax(tMax) {}
+
+	Vector3 GetOrigin(void) const { return m_origin; }
+	Vector3 GetDirection(void) const { return m_direction; }
+	Vector3 GetInvDirection(void) const { return m_invDirection; }
+	float GetMaxT(void) const { return m_tMax; }
+	void SetMaxT(float tMax) { m_tMax = tMax; }
+
+	Vector3 GetPoint(float t) const { return m_origin + m_direction * t; }
+
+private:
+	Vector3 m_origin;
+	Vector3 m_direction;
+	Vector3 m_invDirection;
+	float m_tMax;
+};
+
+// Nearest hit along a ray. PrimitiveIndex is kInvalidPrimitive on a miss. U and V are the barycentric coordinates
+// of v1 and v2 for triangle hits.
+struct RayHit {
+	static const uint32_t kInvalidPrimitive = 0xFFFFFFFF;
+
+	RayHit() : T(FLT_MAX), U(0.0f), V(0.0f), PrimitiveIndex(kInvalidPrimitive) {}
+	bool IsHit(void) const { return PrimitiveIndex != kInvalidPrimitive; }
+
+	float T;
+	float U;
+	float V;
+	uint32_t PrimitiveIndex;
+};
+
+// Four rays in SoA layout. Inactive lanes should have TMax set to a negative value so they never report hits.
+struct RayPacket {
+	static const int kSize = 4;
+
+	// All lanes start inactive.
+	RayPacket() {
+		OriginX = OriginY = OriginZ = DirX = DirY = DirZ = InvDirX = InvDirY = InvDirZ = DirectX::XMVectorZero();
+		TMax = DirectX::g_XMNegativeOne;
+	}
+
+	void SetRay(int Lane, const Ray& ray);
+
+	DirectX::XMVECTOR OriginX, OriginY, OriginZ;
+	DirectX::XMVECTOR DirX, DirY, DirZ;
+	DirectX::XMVECTOR InvDirX, InvDirY, InvDirZ;
+	DirectX::XMVECTOR TMax;
+};
+
+struct RayPacketHit {
+	RayPacketHit() : T(DirectX::g_XMFltMax), U(DirectX::XMVectorZero()), V(DirectX::XMVectorZero()) {
+		PrimitiveIndex[0] = PrimitiveIndex[1] = PrimitiveIndex[2] = PrimitiveIndex[3] = RayHit::kInvalidPrimitive;
+	}
+	RayHit GetHit(int Lane) const;
+
+	DirectX::XMVECTOR T, U, V;
+	uint32_t PrimitiveIndex[RayPacket::kSize];
+};
+
+//
+// Single ray kernels.
+//
+
+// Slab test. On a hit, tNear receives the entry distance (clamped to 0 when the origin is inside the box).
+inline bool IntersectRayBox(const Ray& ray, const BoundingBox& box, float tMax, float& tNear) {
+	using namespace DirectX;
+	XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(box.GetMin(), ray.GetOrigin()), ray.GetInvDirection());
+	XMVECTOR t2 = XMVectorMultiply(XMVectorSubtract(box.GetMax(), ray.GetOrigin()), ray.GetInvDirection());
+	XMVECTOR tMin3 = XMVectorMin(t1, t2);
+	XMVECTOR tMax3 = XMVectorMax(t1, t2);
+	float entry = Max(Max(XMVectorGetX(tMin3), XMVectorGetY(tMin3)), Max(XMVectorGetZ(tMin3), 0.0f));
+	float exit = Min(Min(XMVectorGetX(tMax3), XMVectorGetY(tMax3)), Min(XMVectorGetZ(tMax3), tMax));
+	tNear = entry;
+	return entry <= exit;
+}
+
+// Moller-Trumbore. Back faces are not culled. On a hit, t, u and v are written and true is returned.
+inline bool IntersectRayTriangle(const Ray& ray, Vector3 v0, Vector3 v1, Vector3 v2, float tMax, float& t, float& u, float& v) {
+	const float kEpsilon = 1e-8f;
+	Vector3 e1 = v1 - v0;
+	Vector3 e2 = v2 - v0;
+	Vector3 p = Cross(ray.GetDirection(), e2);
+	float det = Dot(e1, p);
+	if (Abs(det) < kEpsilon)
+		return false;
+	float invDet = 1.0f / det;
+	Vector3 s = ray.GetOrigin() - v0;
+	float uu = Dot(s, p) * invDet;
+	if (uu < 0.0f || uu > 1.0f)
+		return false;
+	Vector3 q = Cross(s, e1);
+	float vv = Dot(ray.GetDirection(), q) * invDet;
+	if (vv < 0.0f || uu + vv > 1.0f)
+		return false;
+	float tt = Dot(e2, q) * invDet;
+	if (tt <= 0.0f || tt >= tMax)
+		return false;
+	t = tt;
+	u = uu;
+	v = vv;
+	return true;
+}
+
+//
+// Packet kernels. Return a lane mask of the rays which hit.
+//
+
+inline DirectX::XMVECTOR IntersectRayPacketBox(const RayPacket& packet, const BoundingBox& box, DirectX::FXMVECTOR tMax) {
+	using namespace DirectX;
+	const XMVECTOR bmin = box.GetMin();
+	const XMVECTOR bmax = box.GetMax();
+
+	XMVECTOR tx1 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatX(bmin), packet.OriginX), packet.InvDirX);
+	XMVECTOR tx2 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatX(bmax), packet.OriginX), packet.InvDirX);
+	XMVECTOR ty1 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatY(bmin), packet.OriginY), packet.InvDirY);
+	XMVECTOR ty2 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatY(bmax), packet.OriginY), packet.InvDirY);
+	XMVECTOR tz1 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatZ(bmin), packet.OriginZ), packet.InvDirZ);
+	XMVECTOR tz2 = XMVectorMultiply(XMVectorSubtract(XMVectorSplatZ(bmax), packet.OriginZ), packet.InvDirZ);
+
+	XMVECTOR entry = XMVectorMax(XMVectorMax(XMVectorMin(tx1, tx2), XMVectorMin(ty1, ty2)), XMVectorMax(XMVectorMin(tz1, tz2), XMVectorZero()));
+	XMVECTOR exit = XMVectorMin(XMVectorMin(XMVectorMax(tx1, tx2), XMVectorMax(ty1, ty2)), XMVectorMin(XMVectorMax(tz1, tz2), tMax));
+	return XMVectorLessOrEqual(entry, exit);
+}
+
+// Moller-Trumbore on 4 rays against one triangle. Lanes with a closer hit than hits.T are updated in place.
+inline DirectX::XMVECTOR IntersectRayPacketTriangle(const RayPacket& packet, Vector3 v0, Vector3 v1, Vector3 v2, uint32_t primitiveIndex, RayPacketHit& hits) {
+	using namespace DirectX;
+	const XMVECTOR e1 = XMVectorSubtract(v1, v0);
+	const XMVECTOR e2 = XMVectorSubtract(v2, v0);
+	const XMVECTOR e1x = XMVectorSplatX(e1), e1y = XMVectorSplatY(e1), e1z = XMVectorSplatZ(e1);
+	const XMVECTOR e2x = XMVectorSplatX(e2), e2y = XMVectorSplatY(e2), e2z = XMVectorSplatZ(e2);
+
+	// p = d x e2
+	XMVECTOR px = XMVectorNegativeMultiplySubtract(packet.DirZ, e2y, XMVectorMultiply(packet.DirY, e2z));
+	XMVECTOR py = XMVectorNegativeMultiplySubtract(packet.DirX, e2z, XMVectorMultiply(packet.DirZ, e2x));
+	XMVECTOR pz = XMVectorNegativeMultiplySubtract(packet.DirY, e2x, XMVectorMultiply(packet.DirX, e2y));
+	XMVECTOR det = XMVectorMultiplyAdd(e1z, pz, XMVectorMultiplyAdd(e1y, py, XMVectorMultiply(e1x, px)));
+	XMVECTOR invDet = XMVectorReciprocal(det);
+
+	// s = o - v0
+	XMVECTOR sx = XMVectorSubtract(packet.OriginX, XMVectorSplatX(v0));
+	XMVECTOR sy = XMVectorSubtract(packet.OriginY, XMVectorSplatY(v0));
+	XMVECTOR sz = XMVectorSubtract(packet.OriginZ, XMVectorSplatZ(v0));
+	XMVECTOR u = XMVectorMultiply(XMVectorMultiplyAdd(sz, pz, XMVectorMultiplyAdd(sy, py, XMVectorMultiply(sx, px))), invDet);
+
+	// q = s x e1
+	XMVECTOR qx = XMVectorNegativeMultiplySubtract(sz, e1y, XMVectorMultiply(sy, e1z));
+	XMVECTOR qy = XMVectorNegativeMultiplySubtract(sx, e1z, XMVectorMultiply(sz, e1x));
+	XMVECTOR qz = XMVectorNegativeMultiplySubtract(sy, e1x, XMVectorMultiply(sx, e1y));
+	XMVECTOR v = XMVectorMultiply(XMVectorMultiplyAdd(packet.DirZ, qz, XMVectorMultiplyAdd(packet.DirY, qy, XMVectorMultiply(packet.DirX, qx))), invDet);
+	XMVECTOR t = XMVectorMultiply(XMVectorMultiplyAdd(e2z, qz, XMVectorMultiplyAdd(e2y, qy, XMVectorMultiply(e2x, qx))), invDet);
+
+	const XMVECTOR zero = XMVectorZero();
+	XMVECTOR mask = XMVectorGreater(XMVectorAbs(det), XMVectorReplicate(1e-8f));
+	mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(u, zero));
+	mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(v, zero));
+	mask = XMVectorAndInt(mask, XMVectorLessOrEqual(XMVectorAdd(u, v), g_XMOne));
+	mask = XMVectorAndInt(mask, XMVectorGreater(t, zero));
+	mask = XMVectorAndInt(mask, XMVectorLess(t, XMVectorMin(hits.T, packet.TMax)));
+
+	hits.T = XMVectorSelect(hits.T, t, mask);
+	hits.U = XMVectorSelect(hits.U, u, mask);
+	hits.V = XMVectorSelect(hits.V, v, mask);
+
+	XMUINT4 laneMask;
+	XMStoreUInt4(&laneMask, mask);
+	if (laneMask.x) hits.PrimitiveIndex[0] = primitiveIndex;
+	if (laneMask.y) hits.PrimitiveIndex[1] = primitiveIndex;
+	if (laneMask.z) hits.PrimitiveIndex[2] = primitiveIndex;
+	if (laneMask.w) hits.PrimitiveIndex[3] = primitiveIndex;
+	return mask;
+}
+
+// Inline methods.
+inline void RayPacket::SetRay(int Lane, const Ray& ray) {
+	using namespace DirectX;
+	Vector3 o = ray.GetOrigin(), d = ray.GetDirection(), id = ray.GetInvDirection();
+	OriginX = XMVectorSetByIndex(OriginX, XMVectorGetX(o), Lane);
+	OriginY = XMVectorSetByIndex(OriginY, XMVectorGetY(o), Lane);
+	OriginZ = XMVectorSetByIndex(OriginZ, XMVectorGetZ(o), Lane);
+	DirX = XMVectorSetByIndex(DirX, XMVectorGetX(d), Lane);
+	DirY = XMVectorSetByIndex(DirY, XMVectorGetY(d), Lane);
+	DirZ = XMVectorSetByIndex(DirZ, XMVectorGetZ(d), Lane);
+	InvDirX = XMVectorSetByIndex(InvDirX, XMVectorGetX(id), Lane);
+	InvDirY = XMVectorSetByIndex(InvDirY, XMVectorGetY(id), Lane);
+	InvDirZ = XMVectorSetByIndex(InvDirZ, XMVectorGetZ(id), Lane);
+	TMax = XMVectorSetByIndex(TMax, ray.GetMaxT(), Lane);
+}
+
+inline RayHit RayPacketHit::GetHit(int Lane) const {
+	RayHit hit;
+	hit.PrimitiveIndex = PrimitiveIndex[Lane];
+	if (hit.IsHit()) {
+		hit.T = DirectX::XMVectorGetByIndex(T, Lane);
+		hit.U = DirectX::XMVectorGetByIndex(U, Lane);
+		hit.V = DirectX::XMVectorGetByIndex(V, Lane);
+	}
+	return hit;
+}
+
+}	// namespace Math
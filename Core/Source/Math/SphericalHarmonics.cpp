@@ -0,0 +1,297 @@
+//
+// Spherical harmonics evaluation, rotation and cubemap projection.
+//
+
+#include "pch.h"
+#include "SphericalHarmonics.h"
+#include "CubemapLayout.h"
+#include "Parallel.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace Math {
+
+// Normalization constants of the real SH basis.
+static const float kSHBand0 = 0.282094792f;		// 1 / (2 sqrt(pi))
+static const float kSHBand1 = 0.488602512f;		// sqrt(3 / (4 pi))
+static const float kSHBand2 = 1.092548431f;		// sqrt(15 / (4 pi))
+static const float kSHBand2Zonal = 0.315391565f;	// sqrt(5 / (16 pi))
+static const float kSHBand2Sector = 0.546274215f;	// sqrt(15 / (16 pi))
+
+// Clamped cosine convolution factors per band.
+static const float kIrradianceBand0 = XM_PI;
+static const float kIrradianceBand1 = XM_2PI / 3.0f;
+static const float kIrradianceBand2 = XM_PIDIV4;
+
+void SHCoefficients::Clear(void) {
+	for (uint32_t i = 0; i < kCoefficientCount; ++i)
+		m_Coeffs[i] = Vector3(EZeroTag::kZero);
+}
+
+void SHCoefficients::TruncateToL1(void) {
+	for (uint32_t i = kL1CoefficientCount; i < kCoefficientCount; ++i)
+		m_Coeffs[i] = Vector3(EZeroTag::kZero);
+}
+
+SHCoefficients& SHCoefficients::operator+= (const SHCoefficients& rhs) {
+	for (uint32_t i = 0; i < kCoefficientCount; ++i)
+		m_Coeffs[i] += rhs.m_Coeffs[i];
+	return *this;
+}
+
+SHCoefficients& SHCoefficients::operator*= (float scale) {
+	for (uint32_t i = 0; i < kCoefficientCount; ++i)
+		m_Coeffs[i] = m_Coeffs[i] * scale;
+	return *this;
+}
+
+// Band 2 of the basis, shared by the scalar evaluation and the rotation.
+static INLINE void EvaluateBand2(float x, float y, float z, float Basis[5]) {
+	Basis[0] = kSHBand2 * x * y;
+	Basis[1] = kSHBand2 * y * z;
+	Basis[2] = kSHBand2Zonal * (3.0f * z * z - 1.0f);
+	Basis[3] = kSHBand2 * x * z;
+	Basis[4] = kSHBand2Sector * (x * x - y * y);
+}
+
+void SHCoefficients::EvaluateBasis(Vector3 dir, float Basis[kCoefficientCount]) {
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, dir);
+	Basis[0] = kSHBand0;
+	Basis[1] = kSHBand1 * d.y;
+	Basis[2] = kSHBand1 * d.z;
+	Basis[3] = kSHBand1 * d.x;
+	EvaluateBand2(d.x, d.y, d.z, Basis + 4);
+}
+
+Vector3 SHCoefficients::Evaluate(Vector3 dir) const {
+	float Basis[kCoefficientCount];
+	EvaluateBasis(dir, Basis);
+
+	Vector3 Result(EZeroTag::kZero);
+	for (uint32_t i = 0; i < kCoefficientCount; ++i)
+		Result += m_Coeffs[i] * Basis[i];
+	return Result;
+}
+
+Vector3 SHCoefficients::EvaluateIrradiance(Vector3 normal) const {
+	float Basis[kCoefficientCount];
+	EvaluateBasis(normal, Basis);
+
+	Vector3 Result = m_Coeffs[0] * (Basis[0] * kIrradianceBand0);
+	for (uint32_t i = 1; i < kL1CoefficientCount; ++i)
+		Result += m_Coeffs[i] * (Basis[i] * kIrradianceBand1);
+	for (uint32_t i = kL1CoefficientCount; i < kCoefficientCount; ++i)
+		Result += m_Coeffs[i] * (Basis[i] * kIrradianceBand2);
+	return Result;
+}
+
+// Band 2 is rotated by sampling the rotated basis in 5 fixed directions and solving for the coefficients that
+// reproduce those samples, c' = inverse(A) * B * c, where A[k][m] = Y2m(N_k) and B[k][m] = Y2m(inverse(R) * N_k).
+// The directions are chosen so A is invertible, its inverse only depends on them and is computed once.
+struct SHBand2Rotation {
+	float Directions[5][3];
+	float InverseA[5][5];
+
+	SHBand2Rotation() {
+		const float s = 0.707106781f;
+		const float N[5][3] = { { 1, 0, 0 }, { 0, 0, 1 }, { s, s, 0 }, { s, 0, s }, { 0, s, s } };
+
+		// Gauss-Jordan elimination with partial pivoting on [A | I].
+		float M[5][10];
+		for (int k = 0; k < 5; ++k) {
+			for (int i = 0; i < 3; ++i)
+				Directions[k][i] = N[k][i];
+			EvaluateBand2(N[k][0], N[k][1], N[k][2], M[k]);
+			for (int j = 0; j < 5; ++j)
+				M[k][5 + j] = k == j ? 1.0f : 0.0f;
+		}
+		for (int c = 0; c < 5; ++c) {
+			int Pivot = c;
+			for (int r = c + 1; r < 5; ++r) {
+				if (fabsf(M[r][c]) > fabsf(M[Pivot][c]))
+					Pivot = r;
+			}
+			for (int j = 0; j < 10; ++j)
+				std::swap(M[c][j], M[Pivot][j]);
+
+			const float InvPivot = 1.0f / M[c][c];
+			for (int j = 0; j < 10; ++j)
+				M[c][j] *= InvPivot;
+			for (int r = 0; r < 5; ++r) {
+				if (r == c)
+					continue;
+				const float Factor = M[r][c];
+				for (int j = 0; j < 10; ++j)
+					M[r][j] -= Factor * M[c][j];
+			}
+		}
+		for (int i = 0; i < 5; ++i) {
+			for (int j = 0; j < 5; ++j)
+				InverseA[i][j] = M[i][5 + j];
+		}
+	}
+};
+
+SHCoefficients SHCoefficients::Rotate(const Matrix3& rotation) const {
+	static const SHBand2Rotation kBand2;
+
+	SHCoefficients Result;
+	Result.m_Coeffs[0] = m_Coeffs[0];
+
+	// Band 1 is a linear function a.d with a = (c3, c1, c2), which rotates as a vector.
+	XMFLOAT3X3 R;
+	XMStoreFloat3x3(&R, rotation);
+	const Vector3 a[3] = { m_Coeffs[3], m_Coeffs[1], m_Coeffs[2] };
+	Vector3 Rotated[3];
+	for (int j = 0; j < 3; ++j)
+		Rotated[j] = a[0] * R.m[0][j] + a[1] * R.m[1][j] + a[2] * R.m[2][j];
+	Result.m_Coeffs[1] = Rotated[1];
+	Result.m_Coeffs[2] = Rotated[2];
+	Result.m_Coeffs[3] = Rotated[0];
+
+	const Matrix3 InverseRotation = Transpose(rotation);
+	float B[5][5];
+	for (int k = 0; k < 5; ++k) {
+		const Vector3 N(kBand2.Directions[k][0], kBand2.Directions[k][1], kBand2.Directions[k][2]);
+		XMFLOAT3 d;
+		XMStoreFloat3(&d, InverseRotation * N);
+		EvaluateBand2(d.x, d.y, d.z, B[k]);
+	}
+	for (int i = 0; i < 5; ++i) {
+		Vector3 Sum(EZeroTag::kZero);
+		for (int m = 0; m < 5; ++m) {
+			float Weight = 0.0f;
+			for (int k = 0; k < 5; ++k)
+				Weight += kBand2.InverseA[i][k] * B[k][m];
+			Sum += m_Coeffs[4 + m] * Weight;
+		}
+		Result.m_Coeffs[4 + i] = Sum;
+	}
+	return Result;
+}
+
+// Per lane sums of weighted radiance times basis, for each coefficient and color channel.
+struct SHAccumulator {
+	XMVECTOR Sum[SHCoefficients::kCoefficientCount][3];
+	XMVECTOR Weight;
+};
+
+struct SHFaceResult {
+	SHCoefficients Coeffs;
+	float Weight;
+};
+
+// Accumulates 4 texels of a row. Lanes outside of Mask do not contribute.
+static INLINE void Accumulate4(SHAccumulator& Acc, const CubemapFaceWalk& Walk, XMVECTOR s, XMVECTOR t, XMVECTOR Mask,
+	const XMFLOAT4* Texels) {
+	XMVECTOR x, y, z;
+	Walk.GetDirections(s, t, x, y, z);
+
+	// The solid angle of a texel is proportional to 1 / (1 + s^2 + t^2)^(3/2), one over the length of the unnormalized
+	// direction cubed. The constant factor cancels out in the final normalization.
+	const XMVECTOR InvLength = XMVectorReciprocalSqrt(x * x + y * y + z * z);
+	x *= InvLength;
+	y *= InvLength;
+	z *= InvLength;
+	const XMVECTOR Weight = XMVectorAndInt(InvLength * InvLength * InvLength, Mask);
+
+	const XMMATRIX Color = XMMatrixTranspose(XMMATRIX(XMLoadFloat4(&Texels[0]), XMLoadFloat4(&Texels[1]),
+		XMLoadFloat4(&Texels[2]), XMLoadFloat4(&Texels[3])));
+	const XMVECTOR Weighted[3] = { Color.r[0] * Weight, Color.r[1] * Weight, Color.r[2] * Weight };
+
+	XMVECTOR Basis[SHCoefficients::kCoefficientCount];
+	Basis[0] = XMVectorReplicate(kSHBand0);
+	Basis[1] = y * kSHBand1;
+	Basis[2] = z * kSHBand1;
+	Basis[3] = x * kSHBand1;
+	Basis[4] = x * y * kSHBand2;
+	Basis[5] = y * z * kSHBand2;
+	Basis[6] = XMVectorMultiplyAdd(z * z, XMVectorReplicate(3.0f * kSHBand2Zonal), XMVectorReplicate(-kSHBand2Zonal));
+	Basis[7] = x * z * kSHBand2;
+	Basis[8] = (x * x - y * y) * kSHBand2Sector;
+
+	for (uint32_t i = 0; i < SHCoefficients::kCoefficientCount; ++i) {
+		for (int c = 0; c < 3; ++c)
+			Acc.Sum[i][c] = XMVectorMultiplyAdd(Basis[i], Weighted[c], Acc.Sum[i][c]);
+	}
+	Acc.Weight += Weight;
+}
+
+static INLINE float SumLanes(FXMVECTOR v) {
+	return XMVectorGetX(XMVector4Dot(v, g_XMOne));
+}
+
+static void ProjectFace(const CubemapData& Cubemap, uint32_t FaceIndex, SHFaceResult& Result) {
+	const uint32_t Size = Cubemap.Size;
+	const CubemapFaceWalk Walk(FaceIndex, Size);
+
+	SHAccumulator Acc;
+	for (uint32_t i = 0; i < SHCoefficients::kCoefficientCount; ++i)
+		Acc.Sum[i][0] = Acc.Sum[i][1] = Acc.Sum[i][2] = XMVectorZero();
+	Acc.Weight = XMVectorZero();
+
+	std::vector<XMFLOAT4> ConvertedRow;
+	if (Cubemap.Format == CubemapTexelFormat::kRGBA16F)
+		ConvertedRow.resize(Size);
+
+	for (uint32_t Row = 0; Row < Size; ++Row) {
+		const uint8_t* RowData = (const uint8_t*)Cubemap.Faces[FaceIndex] + Row * Cubemap.RowPitch;
+		const XMFLOAT4* Texels = (const XMFLOAT4*)RowData;
+		if (Cubemap.Format == CubemapTexelFormat::kRGBA16F) {
+			XMConvertHalfToFloatStream(&ConvertedRow[0].x, sizeof(float), (const HALF*)RowData, sizeof(HALF), Size * 4);
+			Texels = ConvertedRow.data();
+		}
+
+		const XMVECTOR t = Walk.GetRowT(Row);
+		uint32_t Column = 0;
+		for (; Column + 4 <= Size; Column += 4)
+			Accumulate4(Acc, Walk, Walk.GetColumnS(Column), t, XMVectorTrueInt(), Texels + Column);
+
+		if (Column < Size) {
+			XMFLOAT4 Tail[4] = {};
+			for (uint32_t l = 0; Column + l < Size; ++l)
+				Tail[l] = Texels[Column + l];
+			const XMVECTOR Mask = XMVectorLess(XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f), XMVectorReplicate(float(Size - Column)));
+			Accumulate4(Acc, Walk, Walk.GetColumnS(Column), t, Mask, Tail);
+		}
+	}
+
+	for (uint32_t i = 0; i < SHCoefficients::kCoefficientCount; ++i)
+		Result.Coeffs[i] = Vector3(SumLanes(Acc.Sum[i][0]), SumLanes(Acc.Sum[i][1]), SumLanes(Acc.Sum[i][2]));
+	Result.Weight = SumLanes(Acc.Weight);
+}
+
+SHCoefficients ProjectCubemap(const CubemapData& Cubemap) {
+	SHCoefficients Result;
+	ProjectCubemaps(&Cubemap, 1, &Result);
+	return Result;
+}
+
+void ProjectCubemaps(const CubemapData* Cubemaps, size_t Count, SHCoefficients* Dest) {
+	std::vector<SHFaceResult> Faces(Count * 6);
+
+	ParallelFor(size_t(0), Count * 6, [&](size_t i) {
+		const CubemapData& Cubemap = Cubemaps[i / 6];
+		ASSERT(Cubemap.Size > 0 && Cubemap.Faces[i % 6] != nullptr, "Incomplete cubemap");
+		ProjectFace(Cubemap, uint32_t(i % 6), Faces[i]);
+	});
+
+	// The weights add up to the discrete solid angle of the sphere, rescale them to exactly 4 pi.
+	for (size_t i = 0; i < Count; ++i) {
+		SHCoefficients Sum;
+		float Weight = 0.0f;
+		for (uint32_t f = 0; f < 6; ++f) {
+			Sum += Faces[i * 6 + f].Coeffs;
+			Weight += Faces[i * 6 + f].Weight;
+		}
+		Sum *= 4.0f * XM_PI / Weight;
+		Dest[i] = Sum;
+	}
+}
+
+}	// namespace Math
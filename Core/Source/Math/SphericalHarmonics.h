@@ -0,0 +1,69 @@
+//
+// Third order (L2, 9 coefficients) spherical harmonics for RGB lighting, with cubemap projection for baking light
+// probes. L1 lighting uses the first 4 coefficients. The basis is the real, orthonormal SH basis in the engine's
+// coordinate frame.
+//
+
+#pragma once
+
+#include "VectorMath.h"
+
+namespace Math {
+
+class SHCoefficients {
+public:
+	static const uint32_t kCoefficientCount = 9;
+	static const uint32_t kL1CoefficientCount = 4;
+
+	SHCoefficients() { Clear(); }
+
+	void Clear(void);
+
+	// Keep the constant and linear bands only.
+	void TruncateToL1(void);
+
+	Vector3& operator[] (uint32_t i) { return m_Coeffs[i]; }
+	const Vector3& operator[] (uint32_t i) const { return m_Coeffs[i]; }
+
+	SHCoefficients& operator+= (const SHCoefficients& rhs);
+	SHCoefficients& operator*= (float scale);
+
+	// Value of the projected function in a normalized direction.
+	Vector3 Evaluate(Vector3 dir) const;
+
+	// Irradiance for a surface with the given normal, by convolving with the clamped cosine lobe. Divide by pi for the
+	// exitant radiance of a white lambertian surface.
+	Vector3 EvaluateIrradiance(Vector3 normal) const;
+
+	// Coefficients of the function rotated by an orthonormal matrix, f'(rotation * d) = f(d).
+	SHCoefficients Rotate(const Matrix3& rotation) const;
+
+	// The 9 basis functions in a normalized direction.
+	static void EvaluateBasis(Vector3 dir, float Basis[kCoefficientCount]);
+
+private:
+	Vector3 m_Coeffs[kCoefficientCount];
+};
+
+enum class CubemapTexelFormat {
+	kRGBA32F,
+	kRGBA16F,
+};
+
+// Texel data of a cubemap in CPU memory, for instance the top mip of a DDS file or a readback of a rendered probe.
+// Faces are in D3D order: +X, -X, +Y, -Y, +Z, -Z.
+struct CubemapData {
+	const void* Faces[6];
+	uint32_t Size;			// width and height of a face in texels
+	size_t RowPitch;		// bytes between rows
+	CubemapTexelFormat Format;
+};
+
+// Projects the radiance of a cubemap. Every texel is weighted by the solid angle it subtends, 4 texels of a row are
+// accumulated per iteration and the faces are processed in parallel.
+SHCoefficients ProjectCubemap(const CubemapData& Cubemap);
+
+// Bakes a set of probes, with all faces of all probes processed in parallel.
+void ProjectCubemaps(const CubemapData* Cubemaps, size_t Count, SHCoefficients* Dest);
+
+}	// namespace Math
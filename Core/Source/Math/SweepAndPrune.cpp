@@ -0,0 +1,323 @@
+//
+// Broadphase overlap detection with incremental sweep and prune.
+//
+
+#include "pch.h"
+#include "SweepAndPrune.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cfloat>
+#include <iterator>
+
+using namespace DirectX;
+
+namespace Math {
+
+// Padding after the sorted arrays, so the sweep can always load 4 lanes.
+static const uint32_t kSweepPadding = 4;
+
+SweepAndPrune::ProxyID SweepAndPrune::AddProxy(const BoundingBox& Bounds) {
+	ProxyID Proxy;
+	if (!m_FreeProxies.empty()) {
+		Proxy = m_FreeProxies.back();
+		m_FreeProxies.pop_back();
+	} else {
+		Proxy = (ProxyID)m_Bounds.size();
+		m_Bounds.emplace_back();
+		m_PairCounts.push_back(0);
+		m_Alive.push_back(0);
+	}
+
+	XMStoreFloat3(&m_Bounds[Proxy].Min, Bounds.GetMin());
+	XMStoreFloat3(&m_Bounds[Proxy].Max, Bounds.GetMax());
+	m_Alive[Proxy] = 1;
+	++m_AddedCount;
+
+	// Appended after every other endpoint, so the next sort swaps the new min past the max of every proxy it overlaps.
+	for (uint32_t Axis = 0; Axis < 3; ++Axis) {
+		Endpoint Min = { 0.0f, Proxy << 1 };
+		Endpoint Max = { 0.0f, Proxy << 1 | 1 };
+		m_Endpoints[Axis].push_back(Min);
+		m_Endpoints[Axis].push_back(Max);
+	}
+	return Proxy;
+}
+
+void SweepAndPrune::UpdateProxy(ProxyID Proxy, const BoundingBox& Bounds) {
+	ASSERT(Proxy < m_Alive.size() && m_Alive[Proxy], "Invalid proxy");
+	XMStoreFloat3(&m_Bounds[Proxy].Min, Bounds.GetMin());
+	XMStoreFloat3(&m_Bounds[Proxy].Max, Bounds.GetMax());
+}
+
+void SweepAndPrune::RemoveProxy(ProxyID Proxy) {
+	ASSERT(Proxy < m_Alive.size() && m_Alive[Proxy], "Invalid proxy");
+	m_Alive[Proxy] = 0;
+	m_RemovedProxies.push_back(Proxy);
+}
+
+bool SweepAndPrune::Overlaps(ProxyID a, ProxyID b) const {
+	const XMFLOAT3& MinA = m_Bounds[a].Min;
+	const XMFLOAT3& MaxA = m_Bounds[a].Max;
+	const XMFLOAT3& MinB = m_Bounds[b].Min;
+	const XMFLOAT3& MaxB = m_Bounds[b].Max;
+	return MinA.x <= MaxB.x && MinB.x <= MaxA.x && MinA.y <= MaxB.y && MinB.y <= MaxA.y && MinA.z <= MaxB.z && MinB.z <= MaxA.z;
+}
+
+void SweepAndPrune::RemoveDeadProxies() {
+	if (m_RemovedProxies.empty())
+		return;
+
+	for (uint32_t Axis = 0; Axis < 3; ++Axis) {
+		std::vector<Endpoint>& Endpoints = m_Endpoints[Axis];
+		Endpoints.erase(std::remove_if(Endpoints.begin(), Endpoints.end(), [this](const Endpoint& e) { return !m_Alive[e.GetProxy()]; }),
+			Endpoints.end());
+	}
+
+	auto IsDead = [this](const OverlapPair& Pair) { return !m_Alive[Pair.A] || !m_Alive[Pair.B]; };
+	for (const OverlapPair& Pair : m_Pairs) {
+		if (IsDead(Pair)) {
+			m_RemovedPairs.push_back(Pair);
+			m_PairSet.erase(PairKey(Pair));
+			--m_PairCounts[Pair.A];
+			--m_PairCounts[Pair.B];
+		}
+	}
+	m_Pairs.erase(std::remove_if(m_Pairs.begin(), m_Pairs.end(), IsDead), m_Pairs.end());
+
+	// Removed IDs only become reusable once they are out of the sorted endpoints.
+	m_FreeProxies.insert(m_FreeProxies.end(), m_RemovedProxies.begin(), m_RemovedProxies.end());
+	m_RemovedProxies.clear();
+}
+
+void SweepAndPrune::RefreshEndpoints(uint32_t Axis) {
+	for (Endpoint& e : m_Endpoints[Axis]) {
+		const XMFLOAT3& Bound = e.IsMax() ? m_Bounds[e.GetProxy()].Max : m_Bounds[e.GetProxy()].Min;
+		e.Value = (&Bound.x)[Axis];
+	}
+}
+
+void SweepAndPrune::SortAxis(uint32_t Axis, SwapEvents& Events) {
+	std::vector<Endpoint>& Endpoints = m_Endpoints[Axis];
+	const size_t Count = Endpoints.size();
+	size_t SwapBudget = Count * kMaxSwapsPerEndpoint;
+	Events.Overflowed = false;
+
+	// The endpoints are still sorted by their previous values, so the insertion sort swaps every two endpoints whose
+	// order changed exactly once, and they end up in their new order. A min and a max of two proxies changing order is all
+	// that can change their overlap: a max moving before the other min separates them for good, a min moving before the
+	// other max makes them overlap if the other axes do. The pair set is only read here, so the axes sort in parallel.
+	for (size_t i = 1; i < Count; ++i) {
+		const Endpoint Moving = Endpoints[i];
+		size_t j = i;
+		while (j > 0 && Moving < Endpoints[j - 1]) {
+			if (SwapBudget == 0) {
+				Endpoints[j] = Moving;
+				std::sort(Endpoints.begin(), Endpoints.end());
+				Events.Began.clear();
+				Events.Ended.clear();
+				Events.Overflowed = true;
+				return;
+			}
+			--SwapBudget;
+
+			const Endpoint& Passed = Endpoints[j - 1];
+			if (Moving.IsMax() != Passed.IsMax() && Moving.GetProxy() != Passed.GetProxy()) {
+				const OverlapPair Pair = MakePair(Moving.GetProxy(), Passed.GetProxy());
+				if (!Moving.IsMax()) {
+					if (Overlaps(Pair.A, Pair.B))
+						Events.Began.push_back(Pair);
+				} else if (m_PairCounts[Pair.A] != 0 && m_PairCounts[Pair.B] != 0 && m_PairSet.count(PairKey(Pair)) != 0) {
+					Events.Ended.push_back(Pair);
+				}
+			}
+			Endpoints[j] = Passed;
+			--j;
+		}
+		Endpoints[j] = Moving;
+	}
+}
+
+void SweepAndPrune::ApplySwapEvents(const SwapEvents* Events) {
+	// The events already account for the final bounds, the set only drops a pair reported by several axes.
+	const size_t FirstRemoved = m_RemovedPairs.size();
+	for (uint32_t Axis = 0; Axis < 3; ++Axis) {
+		for (const OverlapPair& Pair : Events[Axis].Began) {
+			if (m_PairSet.insert(PairKey(Pair)).second) {
+				m_AddedPairs.push_back(Pair);
+				++m_PairCounts[Pair.A];
+				++m_PairCounts[Pair.B];
+			}
+		}
+		for (const OverlapPair& Pair : Events[Axis].Ended) {
+			if (m_PairSet.erase(PairKey(Pair)) != 0) {
+				m_RemovedPairs.push_back(Pair);
+				--m_PairCounts[Pair.A];
+				--m_PairCounts[Pair.B];
+			}
+		}
+	}
+
+	if (m_AddedPairs.empty() && m_RemovedPairs.size() == FirstRemoved)
+		return;
+
+	// Splice the changes into the sorted list in one pass.
+	std::sort(m_AddedPairs.begin(), m_AddedPairs.end());
+	std::sort(m_RemovedPairs.begin() + FirstRemoved, m_RemovedPairs.end());
+
+	std::vector<OverlapPair> Kept;
+	Kept.reserve(m_Pairs.size());
+	std::set_difference(m_Pairs.begin(), m_Pairs.end(), m_RemovedPairs.begin() + FirstRemoved, m_RemovedPairs.end(),
+		std::back_inserter(Kept));
+
+	m_Pairs.clear();
+	m_Pairs.reserve(Kept.size() + m_AddedPairs.size());
+	std::merge(Kept.begin(), Kept.end(), m_AddedPairs.begin(), m_AddedPairs.end(), std::back_inserter(m_Pairs));
+}
+
+void SweepAndPrune::RebuildPairs() {
+	m_Order.clear();
+	m_Order.reserve(m_Endpoints[0].size() / 2);
+	for (const Endpoint& e : m_Endpoints[0]) {
+		if (!e.IsMax())
+			m_Order.push_back(e.GetProxy());
+	}
+	GatherSortedBounds();
+
+	std::vector<OverlapPair> NewPairs;
+	FindPairs(NewPairs);
+
+	std::set_difference(NewPairs.begin(), NewPairs.end(), m_Pairs.begin(), m_Pairs.end(), std::back_inserter(m_AddedPairs));
+	std::set_difference(m_Pairs.begin(), m_Pairs.end(), NewPairs.begin(), NewPairs.end(), std::back_inserter(m_RemovedPairs));
+	m_Pairs.swap(NewPairs);
+
+	m_PairSet.clear();
+	m_PairSet.reserve(m_Pairs.size());
+	std::fill(m_PairCounts.begin(), m_PairCounts.end(), 0);
+	for (const OverlapPair& Pair : m_Pairs) {
+		m_PairSet.insert(PairKey(Pair));
+		++m_PairCounts[Pair.A];
+		++m_PairCounts[Pair.B];
+	}
+}
+
+void SweepAndPrune::GatherSortedBounds() {
+	const size_t Count = m_Order.size();
+	const size_t PaddedCount = Count + kSweepPadding;
+	m_SortedMinX.resize(PaddedCount);
+	m_SortedMaxX.resize(PaddedCount);
+	m_SortedMinY.resize(PaddedCount);
+	m_SortedMaxY.resize(PaddedCount);
+	m_SortedMinZ.resize(PaddedCount);
+	m_SortedMaxZ.resize(PaddedCount);
+
+	for (size_t i = 0; i < Count; ++i) {
+		const ProxyBounds& Bounds = m_Bounds[m_Order[i]];
+		m_SortedMinX[i] = Bounds.Min.x;
+		m_SortedMaxX[i] = Bounds.Max.x;
+		m_SortedMinY[i] = Bounds.Min.y;
+		m_SortedMaxY[i] = Bounds.Max.y;
+		m_SortedMinZ[i] = Bounds.Min.z;
+		m_SortedMaxZ[i] = Bounds.Max.z;
+	}
+
+	// Sentinels start past any finite interval, which ends every sweep.
+	for (size_t i = Count; i < PaddedCount; ++i) {
+		m_SortedMinX[i] = m_SortedMinY[i] = m_SortedMinZ[i] = FLT_MAX;
+		m_SortedMaxX[i] = m_SortedMaxY[i] = m_SortedMaxZ[i] = -FLT_MAX;
+	}
+}
+
+void SweepAndPrune::FindPairs(std::vector<OverlapPair>& Pairs) const {
+	const uint32_t Count = (uint32_t)m_Order.size();
+	const uint32_t ChunkCount = DivideByMultiple(Count, kSweepChunkSize);
+	std::vector<std::vector<OverlapPair>> ChunkPairs(ChunkCount);
+
+	// Every proxy sweeps forward over the proxies starting within its x interval. Chunks of the sorted range are
+	// independent and run in parallel, 4 candidates are tested per iteration.
+	ParallelFor(uint32_t(0), ChunkCount, [&](uint32_t Chunk) {
+		std::vector<OverlapPair>& Out = ChunkPairs[Chunk];
+		const uint32_t Begin = Chunk * kSweepChunkSize;
+		const uint32_t End = Begin + kSweepChunkSize < Count ? Begin + kSweepChunkSize : Count;
+
+		for (uint32_t i = Begin; i < End; ++i) {
+			const XMVECTOR MaxXi = XMVectorReplicate(m_SortedMaxX[i]);
+			const XMVECTOR MinYi = XMVectorReplicate(m_SortedMinY[i]);
+			const XMVECTOR MaxYi = XMVectorReplicate(m_SortedMaxY[i]);
+			const XMVECTOR MinZi = XMVectorReplicate(m_SortedMinZ[i]);
+			const XMVECTOR MaxZi = XMVectorReplicate(m_SortedMaxZ[i]);
+			const ProxyID ProxyA = m_Order[i];
+
+			for (uint32_t j = i + 1; j < Count; j += 4) {
+				// Candidates are sorted by min x, so the lanes still inside the interval form a prefix.
+				XMVECTOR InX = XMVectorLessOrEqual(XMLoadFloat4((const XMFLOAT4*)&m_SortedMinX[j]), MaxXi);
+				if (XMVector4EqualInt(InX, XMVectorFalseInt()))
+					break;
+
+				XMVECTOR Overlap = XMVectorAndInt(InX, XMVectorLessOrEqual(XMLoadFloat4((const XMFLOAT4*)&m_SortedMinY[j]), MaxYi));
+				Overlap = XMVectorAndInt(Overlap, XMVectorGreaterOrEqual(XMLoadFloat4((const XMFLOAT4*)&m_SortedMaxY[j]), MinYi));
+				Overlap = XMVectorAndInt(Overlap, XMVectorLessOrEqual(XMLoadFloat4((const XMFLOAT4*)&m_SortedMinZ[j]), MaxZi));
+				Overlap = XMVectorAndInt(Overlap, XMVectorGreaterOrEqual(XMLoadFloat4((const XMFLOAT4*)&m_SortedMaxZ[j]), MinZi));
+
+				if (!XMVector4EqualInt(Overlap, XMVectorFalseInt())) {
+					XMUINT4 Lanes;
+					XMStoreUInt4(&Lanes, Overlap);
+					const uint32_t* LaneBits = &Lanes.x;
+					for (uint32_t l = 0; l < 4 && j + l < Count; ++l) {
+						if (LaneBits[l]) {
+							const ProxyID ProxyB = m_Order[j + l];
+							OverlapPair Pair = { ProxyA < ProxyB ? ProxyA : ProxyB, ProxyA < ProxyB ? ProxyB : ProxyA };
+							Out.push_back(Pair);
+						}
+					}
+				}
+
+				if (!XMVector4EqualInt(InX, XMVectorTrueInt()))
+					break;
+			}
+		}
+	});
+
+	size_t Total = 0;
+	for (const std::vector<OverlapPair>& Chunk : ChunkPairs)
+		Total += Chunk.size();
+	Pairs.clear();
+	Pairs.reserve(Total);
+	for (const std::vector<OverlapPair>& Chunk : ChunkPairs)
+		Pairs.insert(Pairs.end(), Chunk.begin(), Chunk.end());
+	ParallelSort(Pairs.begin(), Pairs.end());
+}
+
+void SweepAndPrune::UpdatePairs() {
+	m_AddedPairs.clear();
+	m_RemovedPairs.clear();
+	RemoveDeadProxies();
+
+	const size_t Count = m_Endpoints[0].size() / 2;
+	m_UsedFullSort = m_AddedCount > 64 && m_AddedCount * 16 > Count;
+	m_AddedCount = 0;
+
+	if (m_UsedFullSort) {
+		ParallelFor(0u, 3u, [this](uint32_t Axis) {
+			RefreshEndpoints(Axis);
+			std::sort(m_Endpoints[Axis].begin(), m_Endpoints[Axis].end());
+		});
+	} else {
+		SwapEvents Events[3];
+		ParallelFor(0u, 3u, [&](uint32_t Axis) {
+			RefreshEndpoints(Axis);
+			SortAxis(Axis, Events[Axis]);
+		});
+
+		m_UsedFullSort = Events[0].Overflowed || Events[1].Overflowed || Events[2].Overflowed;
+		if (!m_UsedFullSort)
+			ApplySwapEvents(Events);
+	}
+
+	if (m_UsedFullSort)
+		RebuildPairs();
+
+	// Pairs of removed proxies and pairs that stopped overlapping are each sorted, but not together.
+	std::sort(m_RemovedPairs.begin(), m_RemovedPairs.end());
+}
+
+}	// namespace Math
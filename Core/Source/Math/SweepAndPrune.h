@@ -0,0 +1,128 @@
+//
+// Broadphase overlap detection with incremental sweep and prune. The interval endpoints of every proxy are kept sorted
+// on each axis. Frame to frame coherence keeps them nearly sorted, so most updates only need an insertion sort pass, and
+// the swaps it makes are exactly the places where two intervals started or stopped overlapping, which updates the pairs
+// without a sweep. Overlapping pairs are reported as a full set as well as the pairs added and removed since the previous
+// update.
+//
+
+#pragma once
+
+#include "BoundingBox.h"
+#include <unordered_set>
+#include <vector>
+
+namespace Math {
+
+struct OverlapPair {
+	uint32_t A;		// always less than B
+	uint32_t B;
+
+	bool operator< (const OverlapPair& rhs) const { return A < rhs.A || (A == rhs.A && B < rhs.B); }
+	bool operator== (const OverlapPair& rhs) const { return A == rhs.A && B == rhs.B; }
+};
+
+class SweepAndPrune {
+public:
+	typedef uint32_t ProxyID;
+	static const ProxyID kInvalidProxy = 0xFFFFFFFF;
+
+	// Sorted ranges are swept in parallel chunks of this many proxies.
+	static const uint32_t kSweepChunkSize = 1024;
+
+	// Once an axis needs more than this many swaps per endpoint, motion is too incoherent for the insertion sort and the
+	// update sorts every axis and sweeps for all pairs instead.
+	static const uint32_t kMaxSwapsPerEndpoint = 16;
+
+	SweepAndPrune() : m_AddedCount(0), m_UsedFullSort(false) {}
+
+	ProxyID AddProxy(const BoundingBox& Bounds);
+	ProxyID AddProxy(BoundingSphere Bounds) { return AddProxy(ToBox(Bounds)); }
+	void UpdateProxy(ProxyID Proxy, const BoundingBox& Bounds);
+	void UpdateProxy(ProxyID Proxy, BoundingSphere Bounds) { UpdateProxy(Proxy, ToBox(Bounds)); }
+	void RemoveProxy(ProxyID Proxy);
+	size_t GetProxyCount() const { return m_Bounds.size() - m_FreeProxies.size() - m_RemovedProxies.size(); }
+
+	// Re-sort the endpoints and update the overlapping pairs, along with the pairs added and removed.
+	void UpdatePairs();
+
+	// Whether the last update had to fall back to sorting and sweeping everything.
+	bool UsedFullSort() const { return m_UsedFullSort; }
+
+	const std::vector<OverlapPair>& GetPairs() const { return m_Pairs; }
+	const std::vector<OverlapPair>& GetAddedPairs() const { return m_AddedPairs; }
+	const std::vector<OverlapPair>& GetRemovedPairs() const { return m_RemovedPairs; }
+
+private:
+	static BoundingBox ToBox(BoundingSphere Sphere) {
+		Vector3 r = Vector3(Sphere.GetRadius());
+		return BoundingBox(Sphere.GetCenter() - r, Sphere.GetCenter() + r);
+	}
+
+	// Value is the min or max bound of the proxy on the axis. At equal values a min sorts before a max, so two intervals
+	// overlap exactly when each min is before the other max.
+	struct Endpoint {
+		float Value;
+		uint32_t Data;		// proxy << 1 | 1 for a max
+
+		ProxyID GetProxy() const { return Data >> 1; }
+		bool IsMax() const { return (Data & 1) != 0; }
+		bool operator< (const Endpoint& rhs) const { return Value < rhs.Value || (Value == rhs.Value && !IsMax() && rhs.IsMax()); }
+	};
+
+	// Intervals of two proxies that started (min moved before the other max) or stopped (max moved before the other min)
+	// overlapping on one axis.
+	struct SwapEvents {
+		std::vector<OverlapPair> Began;
+		std::vector<OverlapPair> Ended;
+		bool Overflowed;
+	};
+
+	static OverlapPair MakePair(ProxyID a, ProxyID b) {
+		OverlapPair Pair = { a < b ? a : b, a < b ? b : a };
+		return Pair;
+	}
+	static uint64_t PairKey(const OverlapPair& Pair) { return (uint64_t)Pair.A << 32 | Pair.B; }
+	bool Overlaps(ProxyID a, ProxyID b) const;
+
+	void RemoveDeadProxies();
+	void RefreshEndpoints(uint32_t Axis);
+	void SortAxis(uint32_t Axis, SwapEvents& Events);
+	void ApplySwapEvents(const SwapEvents* Events);
+	void RebuildPairs();
+	void GatherSortedBounds();
+	void FindPairs(std::vector<OverlapPair>& Pairs) const;
+
+	// Per proxy data.
+	struct ProxyBounds {
+		DirectX::XMFLOAT3 Min;
+		DirectX::XMFLOAT3 Max;
+	};
+	std::vector<ProxyBounds> m_Bounds;
+	std::vector<uint32_t> m_PairCounts;		// pairs each proxy is in, to skip the pair set for most separations
+	std::vector<uint8_t> m_Alive;
+	std::vector<ProxyID> m_FreeProxies;
+	std::vector<ProxyID> m_RemovedProxies;
+
+	// Endpoints of the proxies on x, y and z, sorted by value.
+	std::vector<Endpoint> m_Endpoints[3];
+
+	// Proxies sorted by min x, and their bounds in the same order (SoA) for the full sweep.
+	std::vector<ProxyID> m_Order;
+	std::vector<float> m_SortedMinX, m_SortedMaxX;
+	std::vector<float> m_SortedMinY, m_SortedMaxY;
+	std::vector<float> m_SortedMinZ, m_SortedMaxZ;
+
+	// Proxies added since the last update are appended unsorted and may need to travel far, so many additions switch
+	// from the insertion sorts to a full sort. Moved proxies rely on frame coherence and stay cheap to re-sort.
+	size_t m_AddedCount;
+	bool m_UsedFullSort;
+
+	// The pairs both as a sorted list and a set, so swaps can find a pair without searching the list.
+	std::unordered_set<uint64_t> m_PairSet;
+	std::vector<OverlapPair> m_Pairs;
+	std::vector<OverlapPair> m_AddedPairs;
+	std::vector<OverlapPair> m_RemovedPairs;
+};
+
+}	// namespace Math
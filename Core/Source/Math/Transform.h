@@ -9,7 +9,7 @@
 namespace Math {
 
 // This transform strictly prohibits non-uniform scale. Scale itself is barely tolerated.
-__declspec(align(16)) class OrthogonalTransform {
+class alignas(16) OrthogonalTransform {
 public:
 	INLINE OrthogonalTransform() : m_rotation(EIdentityTag::kIdentity), m_translation(EZeroTag::kZero) {}
 	INLINE OrthogonalTransform(Quaternion rotate) : m_rotation(rotate), m_translation(EZeroTag::kZero) {}
@@ -53,7 +53,7 @@ private:
 
 // A AffineTransform is a 3x4 matrix with an implicit 4th row = [0,0,0,1]. This is used to perform a change of
 // basis on 3D points. An affine transformation does not have to have orthonormal basis vectors.
-__declspec(align(64)) class AffineTransform {
+class alignas(64) AffineTransform {
 public:
 	INLINE AffineTransform() {}
 	INLINE AffineTransform(Vector3 x, Vector3 y, Vector3 z, Vector3 w) : m_basis(x, y, z), m_translation(w) {}
@@ -101,6 +101,10 @@ INLINE AffineTransform OrthoInvert(const AffineTransform& xform) {
 	Matrix3 basis = Transpose(xform.GetBasis());
 	return AffineTransform(basis, basis * -xform.GetTranslation());
 }
-// inline Transform Inverse( const Transform& mat ) { TBD }
+// General affine inverse. Handles scale and shear, but cheaper than inverting the full 4x4 matrix.
+INLINE AffineTransform Invert(const AffineTransform& xform) {
+	Matrix3 basis = Invert(xform.GetBasis());
+	return AffineTransform(basis, basis * -xform.GetTranslation());
+}
 
 }	// namespace Math
@@ -0,0 +1,322 @@
+//
+// Transform hierarchy. Local transforms are stored in flat arrays where every root's subtree is contiguous and sorted
+// by depth, so a parent is always visited before its children.
+//
+
+#include "pch.h"
+#include "TransformHierarchy.h"
+#include "Parallel.h"
+#include "BoundingBox.h"
+#include "MatrixBatch.h"
+
+using namespace DirectX;
+
+namespace Math {
+
+// World = Parent * Local, where Local is affine (implicit [0,0,0,1] column). The zero w terms of the basis rows are
+// skipped, which takes 9 multiply-adds instead of the 16 of a general matrix multiply.
+static INLINE Matrix4 ConcatAffine(const Matrix4& Parent, const Matrix3& LocalBasis, Vector3 LocalTranslation) {
+	const XMVECTOR P0 = Parent.GetX();
+	const XMVECTOR P1 = Parent.GetY();
+	const XMVECTOR P2 = Parent.GetZ();
+	const XMVECTOR P3 = Parent.GetW();
+
+	XMVECTOR Rows[4] = { LocalBasis.GetX(), LocalBasis.GetY(), LocalBasis.GetZ(), LocalTranslation };
+	for (int i = 0; i < 4; ++i) {
+		XMVECTOR v = Rows[i];
+		XMVECTOR r = XMVectorMultiply(XMVectorSplatX(v), P0);
+		r = XMVectorMultiplyAdd(XMVectorSplatY(v), P1, r);
+		Rows[i] = XMVectorMultiplyAdd(XMVectorSplatZ(v), P2, r);
+	}
+	return Matrix4(Vector4(Rows[0]), Vector4(Rows[1]), Vector4(Rows[2]), Vector4(XMVectorAdd(Rows[3], P3)));
+}
+
+// ConcatAffine on four nodes at once, one per SIMD lane, with the operands transposed into SoA form the way MatrixBatch
+// does. The twelve splats per node go away, and since every element goes through the same multiply-adds in the same
+// order, the result is bit identical to four calls of ConcatAffine.
+static INLINE void ConcatAffine4(const Matrix4* const Parents[4], const Matrix3* LocalBasis, const Vector3* LocalTranslation,
+	Matrix4 World[4]) {
+	// P[i][j] and L[i][j] hold element (i, j) of the four matrices.
+	const XMMATRIX p0 = *Parents[0], p1 = *Parents[1], p2 = *Parents[2], p3 = *Parents[3];
+	XMVECTOR P[4][4], L[4][3];
+	for (int i = 0; i < 4; ++i) {
+		const XMMATRIX Row = XMMatrixTranspose(XMMATRIX(p0.r[i], p1.r[i], p2.r[i], p3.r[i]));
+		P[i][0] = Row.r[0];
+		P[i][1] = Row.r[1];
+		P[i][2] = Row.r[2];
+		P[i][3] = Row.r[3];
+	}
+	const XMMATRIX LocalRows[4] = {
+		XMMATRIX(LocalBasis[0].GetX(), LocalBasis[1].GetX(), LocalBasis[2].GetX(), LocalBasis[3].GetX()),
+		XMMATRIX(LocalBasis[0].GetY(), LocalBasis[1].GetY(), LocalBasis[2].GetY(), LocalBasis[3].GetY()),
+		XMMATRIX(LocalBasis[0].GetZ(), LocalBasis[1].GetZ(), LocalBasis[2].GetZ(), LocalBasis[3].GetZ()),
+		XMMATRIX(LocalTranslation[0], LocalTranslation[1], LocalTranslation[2], LocalTranslation[3])
+	};
+	for (int i = 0; i < 4; ++i) {
+		const XMMATRIX Row = XMMatrixTranspose(LocalRows[i]);
+		L[i][0] = Row.r[0];
+		L[i][1] = Row.r[1];
+		L[i][2] = Row.r[2];
+	}
+
+	XMMATRIX Rows[4];
+	for (int i = 0; i < 4; ++i) {
+		XMVECTOR w[4];
+		for (int j = 0; j < 4; ++j) {
+			XMVECTOR r = XMVectorMultiply(L[i][0], P[0][j]);
+			r = XMVectorMultiplyAdd(L[i][1], P[1][j], r);
+			w[j] = XMVectorMultiplyAdd(L[i][2], P[2][j], r);
+		}
+		if (i == 3) {
+			for (int j = 0; j < 4; ++j)
+				w[j] = XMVectorAdd(w[j], P[3][j]);
+		}
+		Rows[i] = XMMatrixTranspose(XMMATRIX(w[0], w[1], w[2], w[3]));
+	}
+	for (int k = 0; k < 4; ++k)
+		World[k] = Matrix4(Vector4(Rows[0].r[k]), Vector4(Rows[1].r[k]), Vector4(Rows[2].r[k]), Vector4(Rows[3].r[k]));
+}
+
+// Conservative world bounds: transform the center and scale the radius by the longest basis vector.
+static INLINE BoundingSphere TransformBounds(const Matrix4& World, BoundingSphere LocalBounds) {
+	XMVECTOR Center = XMVector3Transform(LocalBounds.GetCenter(), World);
+	XMVECTOR ScaleSq = XMVectorMax(XMVector3LengthSq(World.GetX()),
+		XMVectorMax(XMVector3LengthSq(World.GetY()), XMVector3LengthSq(World.GetZ())));
+	Scalar Radius = Scalar(XMVectorSqrt(ScaleSq)) * LocalBounds.GetRadius();
+	return BoundingSphere(Vector3(Center), Radius);
+}
+
+TransformHierarchy::NodeHandle TransformHierarchy::AddNode(NodeHandle Parent, const AffineTransform& Local, BoundingSphere LocalBounds) {
+	ASSERT(Parent == kInvalidNode || Parent < m_HandleToSlot.size(), "Invalid parent node");
+
+	// New nodes are appended, which keeps parents in front of their children. The per root contiguity is restored
+	// by RebuildLayout() on the next update.
+	const NodeHandle Handle = (NodeHandle)m_HandleToSlot.size();
+	const uint32_t Slot = (uint32_t)m_Parent.size();
+	m_HandleToSlot.push_back(Slot);
+	m_SlotToHandle.push_back(Handle);
+
+	m_Parent.push_back(Parent == kInvalidNode ? kInvalidNode : m_HandleToSlot[Parent]);
+	m_RootOfSlot.push_back(kInvalidNode);
+	m_Dirty.push_back(1);
+	m_LocalBasis.push_back(Local.GetBasis());
+	m_LocalTranslation.push_back(Local.GetTranslation());
+	m_LocalBounds.push_back(LocalBounds);
+	m_WorldMatrix.push_back(Matrix4(EIdentityTag::kIdentity));
+	m_NormalMatrix.push_back(Matrix3(EIdentityTag::kIdentity));
+	m_WorldBounds.push_back(LocalBounds);
+
+	m_LayoutDirty = true;
+	return Handle;
+}
+
+void TransformHierarchy::Clear() {
+	m_Parent.clear();
+	m_RootOfSlot.clear();
+	m_Dirty.clear();
+	m_LocalBasis.clear();
+	m_LocalTranslation.clear();
+	m_LocalBounds.clear();
+	m_WorldMatrix.clear();
+	m_NormalMatrix.clear();
+	m_WorldBounds.clear();
+	m_HandleToSlot.clear();
+	m_SlotToHandle.clear();
+	m_Roots.clear();
+	m_LayoutDirty = false;
+}
+
+void TransformHierarchy::SetLocalTransform(NodeHandle Node, const AffineTransform& Local) {
+	const uint32_t Slot = m_HandleToSlot[Node];
+	m_LocalBasis[Slot] = Local.GetBasis();
+	m_LocalTranslation[Slot] = Local.GetTranslation();
+	MarkDirty(Slot);
+}
+
+void TransformHierarchy::SetLocalBounds(NodeHandle Node, BoundingSphere LocalBounds) {
+	const uint32_t Slot = m_HandleToSlot[Node];
+	m_LocalBounds[Slot] = LocalBounds;
+	MarkDirty(Slot);
+}
+
+AffineTransform TransformHierarchy::GetLocalTransform(NodeHandle Node) const {
+	const uint32_t Slot = m_HandleToSlot[Node];
+	return AffineTransform(m_LocalBasis[Slot], m_LocalTranslation[Slot]);
+}
+
+TransformHierarchy::NodeHandle TransformHierarchy::GetParent(NodeHandle Node) const {
+	const uint32_t ParentSlot = m_Parent[m_HandleToSlot[Node]];
+	return ParentSlot == kInvalidNode ? kInvalidNode : m_SlotToHandle[ParentSlot];
+}
+
+void TransformHierarchy::ComputeSubtreeBounds(std::vector<BoundingSphere>& SubtreeBounds) const {
+	ASSERT(!m_LayoutDirty, "Update() must be called before computing subtree bounds");
+	SubtreeBounds.assign(m_WorldBounds.begin(), m_WorldBounds.end());
+	for (size_t i = SubtreeBounds.size(); i-- > 0;) {
+		const uint32_t Parent = m_Parent[i];
+		if (Parent != kInvalidNode)
+			SubtreeBounds[Parent] = Union(SubtreeBounds[Parent], SubtreeBounds[i]);
+	}
+}
+
+void TransformHierarchy::MarkDirty(uint32_t Slot) {
+	m_Dirty[Slot] = 1;
+	const uint32_t Root = m_RootOfSlot[Slot];
+	if (Root != kInvalidNode)
+		m_Roots[Root].Dirty = true;
+}
+
+void TransformHierarchy::RebuildLayout() {
+	const uint32_t Count = (uint32_t)m_Parent.size();
+
+	// Build child lists. Walking backwards keeps siblings in insertion order.
+	std::vector<uint32_t> FirstChild(Count, kInvalidNode);
+	std::vector<uint32_t> NextSibling(Count, kInvalidNode);
+	for (uint32_t i = Count; i-- > 0;) {
+		const uint32_t Parent = m_Parent[i];
+		if (Parent != kInvalidNode) {
+			NextSibling[i] = FirstChild[Parent];
+			FirstChild[Parent] = i;
+		}
+	}
+
+	// Breadth first walk of every root gives a contiguous, depth sorted range per root.
+	std::vector<uint32_t> Order;
+	Order.reserve(Count);
+	m_Roots.clear();
+	for (uint32_t i = 0; i < Count; ++i) {
+		if (m_Parent[i] != kInvalidNode)
+			continue;
+		RootRange Range;
+		Range.Begin = (uint32_t)Order.size();
+		Range.Dirty = false;
+		Order.push_back(i);
+		for (size_t Head = Range.Begin; Head < Order.size(); ++Head) {
+			for (uint32_t Child = FirstChild[Order[Head]]; Child != kInvalidNode; Child = NextSibling[Child])
+				Order.push_back(Child);
+		}
+		Range.End = (uint32_t)Order.size();
+		m_Roots.push_back(Range);
+	}
+	ASSERT(Order.size() == Count);
+
+	std::vector<uint32_t> OldToNew(Count);
+	for (uint32_t n = 0; n < Count; ++n)
+		OldToNew[Order[n]] = n;
+
+	std::vector<uint32_t> Parent(Count);
+	std::vector<uint8_t> Dirty(Count);
+	std::vector<Matrix3> LocalBasis(Count);
+	std::vector<Vector3> LocalTranslation(Count);
+	std::vector<BoundingSphere> LocalBounds(Count);
+	std::vector<Matrix4> WorldMatrix(Count);
+	std::vector<Matrix3> NormalMatrix(Count);
+	std::vector<BoundingSphere> WorldBounds(Count);
+	std::vector<NodeHandle> SlotToHandle(Count);
+	for (uint32_t n = 0; n < Count; ++n) {
+		const uint32_t Old = Order[n];
+		Parent[n] = m_Parent[Old] == kInvalidNode ? kInvalidNode : OldToNew[m_Parent[Old]];
+		Dirty[n] = m_Dirty[Old];
+		LocalBasis[n] = m_LocalBasis[Old];
+		LocalTranslation[n] = m_LocalTranslation[Old];
+		LocalBounds[n] = m_LocalBounds[Old];
+		WorldMatrix[n] = m_WorldMatrix[Old];
+		NormalMatrix[n] = m_NormalMatrix[Old];
+		WorldBounds[n] = m_WorldBounds[Old];
+		SlotToHandle[n] = m_SlotToHandle[Old];
+		m_HandleToSlot[SlotToHandle[n]] = n;
+	}
+	m_Parent.swap(Parent);
+	m_Dirty.swap(Dirty);
+	m_LocalBasis.swap(LocalBasis);
+	m_LocalTranslation.swap(LocalTranslation);
+	m_LocalBounds.swap(LocalBounds);
+	m_WorldMatrix.swap(WorldMatrix);
+	m_NormalMatrix.swap(NormalMatrix);
+	m_WorldBounds.swap(WorldBounds);
+	m_SlotToHandle.swap(SlotToHandle);
+
+	for (uint32_t r = 0; r < (uint32_t)m_Roots.size(); ++r) {
+		RootRange& Range = m_Roots[r];
+		for (uint32_t n = Range.Begin; n < Range.End; ++n) {
+			m_RootOfSlot[n] = r;
+			Range.Dirty |= m_Dirty[n] != 0;
+		}
+	}
+
+	m_LayoutDirty = false;
+}
+
+void TransformHierarchy::UpdateRoot(RootRange& Root) {
+	if (!Root.Dirty)
+		return;
+
+	// Skip the clean prefix of the range. Nothing before the first dirty node can be affected.
+	uint32_t First = Root.Begin;
+	while (First < Root.End && !m_Dirty[First])
+		++First;
+
+	for (uint32_t i = First; i < Root.End;) {
+		// Parent slots never decrease along the breadth first order, so when the fourth node from here has its parent
+		// in front of this one, so do the other three. None of the four is then a parent of another, which is always
+		// the case inside one level of the tree, and they are computed together.
+		if (i + 4 <= Root.End && m_Parent[i + 3] < i) {
+			uint8_t AnyDirty = 0;
+			for (uint32_t k = i; k < i + 4; ++k) {
+				m_Dirty[k] |= m_Dirty[m_Parent[k]];
+				AnyDirty |= m_Dirty[k];
+			}
+			if (AnyDirty) {
+				const Matrix4* const Parents[4] = { &m_WorldMatrix[m_Parent[i]], &m_WorldMatrix[m_Parent[i + 1]],
+					&m_WorldMatrix[m_Parent[i + 2]], &m_WorldMatrix[m_Parent[i + 3]] };
+				Matrix4 World[4];
+				ConcatAffine4(Parents, &m_LocalBasis[i], &m_LocalTranslation[i], World);
+				for (uint32_t k = 0; k < 4; ++k) {
+					if (!m_Dirty[i + k])
+						continue;
+					m_WorldMatrix[i + k] = World[k];
+					m_WorldBounds[i + k] = TransformBounds(World[k], m_LocalBounds[i + k]);
+				}
+			}
+			i += 4;
+			continue;
+		}
+
+		const uint32_t Parent = m_Parent[i];
+		if (Parent != kInvalidNode)
+			m_Dirty[i] |= m_Dirty[Parent];
+		if (m_Dirty[i]) {
+			if (Parent == kInvalidNode)
+				m_WorldMatrix[i] = Matrix4(m_LocalBasis[i], m_LocalTranslation[i]);
+			else
+				m_WorldMatrix[i] = ConcatAffine(m_WorldMatrix[Parent], m_LocalBasis[i], m_LocalTranslation[i]);
+			m_WorldBounds[i] = TransformBounds(m_WorldMatrix[i], m_LocalBounds[i]);
+		}
+		++i;
+	}
+
+	// Normal matrices are produced for the whole dirty tail of the range in one batch, which is cheaper than
+	// inverting them one by one even if a few clean nodes are recomputed.
+	ComputeNormalMatrices(m_WorldMatrix.data() + First, m_NormalMatrix.data() + First, Root.End - First);
+
+	// Children read the dirty flag of their parent during the pass above, so clear them afterwards.
+	memset(m_Dirty.data() + First, 0, Root.End - First);
+	Root.Dirty = false;
+}
+
+void TransformHierarchy::Update() {
+	if (m_LayoutDirty)
+		RebuildLayout();
+
+	// Every root owns a disjoint slot range, so roots can be processed without synchronization.
+	if (m_Roots.size() >= kParallelRootThreshold) {
+		ParallelFor(size_t(0), m_Roots.size(), [this](size_t r) {
+			UpdateRoot(m_Roots[r]);
+		});
+	} else {
+		for (RootRange& Root : m_Roots)
+			UpdateRoot(Root);
+	}
+}
+
+}	// namespace Math
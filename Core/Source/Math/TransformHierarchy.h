@@ -0,0 +1,83 @@
+//
+// Transform hierarchy. Local transforms are stored in flat arrays where every root's subtree is contiguous and sorted
+// by depth, so a parent is always visited before its children. Only dirty subtrees are recomputed, nodes on the same
+// level four at a time, and independent roots are propagated in parallel. World matrices, normal matrices and world bounds are emitted in contiguous arrays
+// which can be copied into constant buffers directly (no transpose needed, see VectorMath.h).
+//
+
+#pragma once
+
+#include "VectorMath.h"
+#include "BoundingSphere.h"
+#include <vector>
+
+namespace Math {
+
+class TransformHierarchy {
+public:
+	// Handles are stable for the lifetime of the hierarchy. Slots are the positions in the output arrays, and may change
+	// whenever new nodes are added.
+	typedef uint32_t NodeHandle;
+	static const uint32_t kInvalidNode = 0xFFFFFFFF;
+
+	// Roots are propagated in parallel when there are at least this many of them.
+	static const size_t kParallelRootThreshold = 16;
+
+	TransformHierarchy() : m_LayoutDirty(false) {}
+
+	// The parent must already exist. Pass kInvalidNode to create a new root.
+	NodeHandle AddNode(NodeHandle Parent, const AffineTransform& Local, BoundingSphere LocalBounds = BoundingSphere(Vector4(EZeroTag::kZero)));
+	void Clear();
+
+	void SetLocalTransform(NodeHandle Node, const AffineTransform& Local);
+	void SetLocalBounds(NodeHandle Node, BoundingSphere LocalBounds);
+	AffineTransform GetLocalTransform(NodeHandle Node) const;
+	NodeHandle GetParent(NodeHandle Node) const;
+
+	// Recompute world matrices and world bounds of dirty nodes and all of their descendants.
+	void Update();
+
+	// Contiguous outputs indexed by slot. Only valid after Update().
+	size_t GetNodeCount() const { return m_Parent.size(); }
+	uint32_t GetSlot(NodeHandle Node) const { return m_HandleToSlot[Node]; }
+	const Matrix4* GetWorldMatrices() const { return m_WorldMatrix.data(); }
+	const BoundingSphere* GetWorldBounds() const { return m_WorldBounds.data(); }
+	const Matrix3* GetNormalMatrices() const { return m_NormalMatrix.data(); }
+	const Matrix4& GetWorldMatrix(NodeHandle Node) const { return m_WorldMatrix[m_HandleToSlot[Node]]; }
+	BoundingSphere GetWorldBounds(NodeHandle Node) const { return m_WorldBounds[m_HandleToSlot[Node]]; }
+
+	// Merge the world bounds of every subtree into its root node, indexed by slot. Children are merged in reverse
+	// slot order, which visits every child before its parent. Only valid after Update().
+	void ComputeSubtreeBounds(std::vector<BoundingSphere>& SubtreeBounds) const;
+
+private:
+	struct RootRange {
+		uint32_t Begin;
+		uint32_t End;
+		bool Dirty;
+	};
+
+	void MarkDirty(uint32_t Slot);
+	void RebuildLayout();
+	void UpdateRoot(RootRange& Root);
+
+	// Per slot data (SoA). Parent slots always precede their children.
+	std::vector<uint32_t> m_Parent;
+	std::vector<uint32_t> m_RootOfSlot;
+	std::vector<uint8_t> m_Dirty;
+	std::vector<Matrix3> m_LocalBasis;
+	std::vector<Vector3> m_LocalTranslation;
+	std::vector<BoundingSphere> m_LocalBounds;
+	std::vector<Matrix4> m_WorldMatrix;
+	std::vector<Matrix3> m_NormalMatrix;
+	std::vector<BoundingSphere> m_WorldBounds;
+
+	// Handle indirection.
+	std::vector<uint32_t> m_HandleToSlot;
+	std::vector<NodeHandle> m_SlotToHandle;
+
+	std::vector<RootRange> m_Roots;
+	bool m_LayoutDirty;
+};
+
+}	// namespace Math
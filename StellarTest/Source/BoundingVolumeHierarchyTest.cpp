@@ -0,0 +1,210 @@
+//
+// BoundingVolumeHierarchy and TriangleMeshBVH: single rays, packets and batches checked against testing every
+// primitive, then rays per second as the mesh grows and as the rays are spread over more threads.
+//
+
+#include "pch.h"
+#include "Math/BoundingVolumeHierarchy.h"
+#include "TestCommon.h"
+#include <chrono>
+#include <random>
+
+using namespace DirectX;
+using namespace Math;
+using namespace std;
+
+namespace {
+
+// Small triangles scattered through the cube [-1, 1].
+struct TriangleSoup {
+	vector<XMFLOAT3> Positions;
+	vector<uint32_t> Indices;
+
+	TriangleSoup(uint32_t TriangleCount, uint32_t Seed) {
+		mt19937 Random(Seed);
+		uniform_real_distribution<float> Center(-1.0f, 1.0f);
+		uniform_real_distribution<float> Offset(-0.05f, 0.05f);
+		for (uint32_t t = 0; t < TriangleCount; ++t) {
+			const XMFLOAT3 c(Center(Random), Center(Random), Center(Random));
+			for (uint32_t k = 0; k < 3; ++k) {
+				Indices.push_back((uint32_t)Positions.size());
+				Positions.push_back(XMFLOAT3(c.x + Offset(Random), c.y + Offset(Random), c.z + Offset(Random)));
+			}
+		}
+	}
+
+	uint32_t GetTriangleCount() const { return (uint32_t)Indices.size() / 3; }
+
+	Vector3 GetVertex(uint32_t Triangle, uint32_t k) const { return Vector3(Positions[Indices[Triangle * 3 + k]]); }
+};
+
+// Rays from a sphere of radius 3 aimed at points inside the soup.
+vector<Ray> MakeRays(uint32_t Count, uint32_t Seed) {
+	mt19937 Random(Seed);
+	normal_distribution<float> Normal;
+	uniform_real_distribution<float> Target(-0.8f, 0.8f);
+	vector<Ray> Rays;
+	Rays.reserve(Count);
+	for (uint32_t i = 0; i < Count; ++i) {
+		const Vector3 Origin = Normalize(Vector3(Normal(Random), Normal(Random), Normal(Random))) * 3.0f;
+		const Vector3 Direction = Normalize(Vector3(Target(Random), Target(Random), Target(Random)) - Origin);
+		Rays.push_back(Ray(Origin, Direction));
+	}
+	return Rays;
+}
+
+RayHit IntersectEveryTriangle(const TriangleSoup& Soup, const Ray& ray) {
+	RayHit Hit;
+	for (uint32_t t = 0; t < Soup.GetTriangleCount(); ++t) {
+		float T, U, V;
+		if (IntersectRayTriangle(ray, Soup.GetVertex(t, 0), Soup.GetVertex(t, 1), Soup.GetVertex(t, 2), Hit.T, T, U, V)) {
+			Hit.T = T;
+			Hit.U = U;
+			Hit.V = V;
+			Hit.PrimitiveIndex = t;
+		}
+	}
+	return Hit;
+}
+
+// Same primitive at the same distance. The packet kernel multiplies by a reciprocal where the single ray one divides,
+// so distances only agree to rounding.
+bool IsSameHit(const RayHit& a, const RayHit& b) {
+	if (a.IsHit() != b.IsHit())
+		return false;
+	return !a.IsHit() || (a.PrimitiveIndex == b.PrimitiveIndex && fabs(a.T - b.T) <= 1e-4f * max(1.0f, b.T));
+}
+
+void TestTriangleMesh() {
+	const TriangleSoup Soup(2000, 29);
+	TriangleMeshBVH Mesh;
+	Mesh.Build(Soup.Positions.data(), sizeof(XMFLOAT3), Soup.Indices.data(), Soup.GetTriangleCount());
+
+	const vector<Ray> Rays = MakeRays(1000, 30);
+	vector<RayHit> Batch(Rays.size());
+	Mesh.Intersect(Rays.data(), Rays.size(), Batch.data());
+
+	uint32_t Hits = 0, SingleMismatches = 0, PacketMismatches = 0;
+	for (size_t i = 0; i < Rays.size(); ++i) {
+		const RayHit Expected = IntersectEveryTriangle(Soup, Rays[i]);
+		RayHit Single;
+		Mesh.Intersect(Rays[i], Single);
+		if (Expected.IsHit())
+			++Hits;
+		if (!IsSameHit(Single, Expected))
+			++SingleMismatches;
+		if (!IsSameHit(Batch[i], Expected))
+			++PacketMismatches;
+	}
+	TEST_CHECK(SingleMismatches == 0);
+	TEST_CHECK(PacketMismatches == 0);
+
+	// Enough of both to mean something.
+	TEST_CHECK(Hits > Rays.size() / 10 && Hits < Rays.size());
+
+	// A ray cut short before the soup misses, and a batch that does not fill its last packet leaves no lane behind.
+	Ray Short = Rays[0];
+	Short.SetMaxT(0.5f);
+	RayHit ShortHit;
+	TEST_CHECK(!Mesh.Intersect(Short, ShortHit) && !ShortHit.IsHit());
+
+	RayHit Three[3];
+	Mesh.Intersect(Rays.data(), 3, Three);
+	for (int i = 0; i < 3; ++i)
+		TEST_CHECK(IsSameHit(Three[i], Batch[i]));
+}
+
+void TestBounds() {
+	mt19937 Random(31);
+	uniform_real_distribution<float> Center(-1.0f, 1.0f);
+	uniform_real_distribution<float> Size(0.01f, 0.1f);
+	vector<BoundingBox> Boxes(500);
+	for (BoundingBox& Box : Boxes) {
+		const Vector3 c(Center(Random), Center(Random), Center(Random));
+		const Vector3 e(Size(Random), Size(Random), Size(Random));
+		Box = BoundingBox(c - e, c + e);
+	}
+
+	BoundingVolumeHierarchy BVH;
+	TEST_CHECK(BVH.IsEmpty());
+	BVH.Build(Boxes.data(), (uint32_t)Boxes.size());
+	TEST_CHECK(!BVH.IsEmpty());
+
+	uint32_t Mismatches = 0;
+	for (const Ray& ray : MakeRays(1000, 32)) {
+		float Nearest = FLT_MAX;
+		for (const BoundingBox& Box : Boxes) {
+			float tNear;
+			if (IntersectRayBox(ray, Box, ray.GetMaxT(), tNear))
+				Nearest = min(Nearest, tNear);
+		}
+
+		RayHit Hit;
+		BVH.IntersectBounds(ray, Hit);
+		if (Hit.IsHit() != (Nearest != FLT_MAX) || (Hit.IsHit() && fabs(Hit.T - Nearest) > 1e-5f))
+			++Mismatches;
+	}
+	TEST_CHECK(Mismatches == 0);
+
+	BVH.Clear();
+	RayHit Hit;
+	TEST_CHECK(BVH.IsEmpty() && !BVH.IntersectBounds(MakeRays(1, 33)[0], Hit));
+}
+
+double RaysPerSecond(size_t Count, chrono::steady_clock::time_point Start) {
+	return Count / chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+}
+
+// Rays per second one at a time, in packets of four on one thread, and batched over every thread, for meshes ten
+// times larger each step. Testing every triangle is only timed on the smallest mesh.
+void RunBenchmark(uint32_t RayCount) {
+	const vector<Ray> Rays = MakeRays(RayCount, 34);
+	vector<RayHit> Hits(RayCount);
+
+	for (uint32_t TriangleCount = 1000; TriangleCount <= 1000000; TriangleCount *= 10) {
+		const TriangleSoup Soup(TriangleCount, 35);
+		TriangleMeshBVH Mesh;
+		Mesh.Build(Soup.Positions.data(), sizeof(XMFLOAT3), Soup.Indices.data(), TriangleCount);
+
+		auto Start = chrono::steady_clock::now();
+		for (uint32_t i = 0; i < RayCount; ++i) {
+			Hits[i] = RayHit();
+			Mesh.Intersect(Rays[i], Hits[i]);
+		}
+		const double SingleRate = RaysPerSecond(RayCount, Start);
+
+		Start = chrono::steady_clock::now();
+		for (uint32_t i = 0; i + RayPacket::kSize <= RayCount; i += RayPacket::kSize) {
+			RayPacket Packet;
+			for (int Lane = 0; Lane < RayPacket::kSize; ++Lane)
+				Packet.SetRay(Lane, Rays[i + Lane]);
+			RayPacketHit PacketHits;
+			Mesh.Intersect(Packet, PacketHits);
+			Hits[i] = PacketHits.GetHit(0);
+		}
+		const double PacketRate = RaysPerSecond(RayCount, Start);
+
+		Start = chrono::steady_clock::now();
+		Mesh.Intersect(Rays.data(), Rays.size(), Hits.data());
+		const double BatchRate = RaysPerSecond(RayCount, Start);
+
+		printf("BVH, %u triangles: %.2f M rays/s single, %.2f M rays/s packets, %.2f M rays/s batched on every thread",
+			TriangleCount, SingleRate * 1e-6, PacketRate * 1e-6, BatchRate * 1e-6);
+		if (TriangleCount == 1000) {
+			const uint32_t BruteCount = RayCount / 100;
+			Start = chrono::steady_clock::now();
+			for (uint32_t i = 0; i < BruteCount; ++i)
+				Hits[i] = IntersectEveryTriangle(Soup, Rays[i]);
+			printf(" (every triangle: %.2f M rays/s)", RaysPerSecond(BruteCount, Start) * 1e-6);
+		}
+		printf("\n");
+	}
+}
+
+}	// anonymous namespace
+
+void RunBoundingVolumeHierarchyTests() {
+	TestTriangleMesh();
+	TestBounds();
+	RunBenchmark(100000);
+}
@@ -0,0 +1,228 @@
+//
+// ColorPacking: batch packing bit exact with the Color methods, unpacking as their inverse, and the transfer function
+// tables against the exact curves, then texels per second against packing one Color at a time.
+//
+
+#include "pch.h"
+#include "Graphics/ColorPacking.h"
+#include "TestCommon.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+using namespace Graphics;
+using namespace std;
+
+namespace {
+
+// Crosses the size split across threads, and ends on a partial group of eight.
+const size_t kTexelCount = 40003;
+
+vector<XMFLOAT4> MakeLowRange(uint32_t Seed, size_t Count) {
+	mt19937 Random(Seed);
+	uniform_real_distribution<float> Channel(-0.2f, 1.2f);
+	uniform_real_distribution<float> Alpha(0.0f, 1.0f);
+	vector<XMFLOAT4> Texels(Count);
+	for (XMFLOAT4& Texel : Texels)
+		Texel = XMFLOAT4(Channel(Random), Channel(Random), Channel(Random), Alpha(Random));
+	return Texels;
+}
+
+// Spans the exponent range of the small float formats, with some zeros and negatives, which clamp to zero.
+vector<XMFLOAT4> MakeHighRange(uint32_t Seed, size_t Count) {
+	mt19937 Random(Seed);
+	uniform_real_distribution<float> Exponent(-20.0f, 17.0f);
+	auto Channel = [&]() {
+		const uint32_t Kind = Random() % 16;
+		if (Kind == 0)
+			return 0.0f;
+		const float Value = exp2(Exponent(Random));
+		return Kind == 1 ? -Value : Value;
+	};
+	vector<XMFLOAT4> Texels(Count);
+	for (XMFLOAT4& Texel : Texels)
+		Texel = XMFLOAT4(Channel(), Channel(), Channel(), 1.0f);
+	return Texels;
+}
+
+typedef void (*PackFunc)(const XMFLOAT4*, size_t, uint32_t*);
+typedef void (*UnpackFunc)(const uint32_t*, size_t, XMFLOAT4*);
+typedef uint32_t (*ColorPackFunc)(const Color&);
+
+// Packs like the Color method, and packing what was unpacked gives the same bits back.
+void CheckFormat(const vector<XMFLOAT4>& Texels, PackFunc Pack, UnpackFunc Unpack, ColorPackFunc Reference) {
+	vector<uint32_t> Packed(Texels.size()), Repacked(Texels.size());
+	vector<XMFLOAT4> Unpacked(Texels.size());
+	Pack(Texels.data(), Texels.size(), Packed.data());
+	Unpack(Packed.data(), Packed.size(), Unpacked.data());
+	Pack(Unpacked.data(), Unpacked.size(), Repacked.data());
+
+	uint32_t Mismatches = 0, Unstable = 0;
+	for (size_t i = 0; i < Texels.size(); ++i) {
+		if (Packed[i] != Reference(Color(XMLoadFloat4(&Texels[i]))))
+			++Mismatches;
+		if (Repacked[i] != Packed[i])
+			++Unstable;
+	}
+	TEST_CHECK(Mismatches == 0);
+	TEST_CHECK(Unstable == 0);
+}
+
+void TestPacking() {
+	const vector<XMFLOAT4> Low = MakeLowRange(36, kTexelCount);
+	const vector<XMFLOAT4> High = MakeHighRange(37, kTexelCount);
+
+	CheckFormat(Low, PackR8G8B8A8, UnpackR8G8B8A8, [](const Color& c) { return c.R8G8B8A8(); });
+	CheckFormat(Low, PackR10G10B10A2, UnpackR10G10B10A2, [](const Color& c) { return c.R10G10B10A2(); });
+	CheckFormat(High, [](const XMFLOAT4* s, size_t n, uint32_t* d) { PackR11G11B10F(s, n, d); }, UnpackR11G11B10F,
+		[](const Color& c) { return c.R11G11B10F(); });
+	CheckFormat(High, [](const XMFLOAT4* s, size_t n, uint32_t* d) { PackR11G11B10F(s, n, d, true); }, UnpackR11G11B10F,
+		[](const Color& c) { return c.R11G11B10F(true); });
+	CheckFormat(High, PackR9G9B9E5, UnpackR9G9B9E5, [](const Color& c) { return c.R9G9B9E5(); });
+
+	// Unpacking 8 bit texels matches the Color constructor.
+	vector<uint32_t> Packed(kTexelCount);
+	mt19937 Random(38);
+	for (uint32_t& Texel : Packed)
+		Texel = Random();
+	vector<XMFLOAT4> Unpacked(kTexelCount);
+	UnpackR8G8B8A8(Packed.data(), kTexelCount, Unpacked.data());
+	uint32_t Mismatches = 0;
+	for (size_t i = 0; i < kTexelCount; ++i) {
+		if (!XMVector4Equal(XMLoadFloat4(&Unpacked[i]), Color(Packed[i])))
+			++Mismatches;
+	}
+	TEST_CHECK(Mismatches == 0);
+}
+
+double DecodeSRGB(double c) {
+	return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+double EncodeSRGB(double c) {
+	c = min(max(c, 0.0), 1.0);
+	return c < 0.0031308 ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055;
+}
+
+uint32_t GetChannel(uint32_t Texel, int Channel) {
+	return (Texel >> (8 * Channel)) & 0xFF;
+}
+
+bool IsWithinOneStep(uint32_t a, uint32_t b) {
+	for (int Channel = 0; Channel < 4; ++Channel) {
+		const int Difference = (int)GetChannel(a, Channel) - (int)GetChannel(b, Channel);
+		if (Difference < -1 || Difference > 1)
+			return false;
+	}
+	return true;
+}
+
+void TestTransferFunctions() {
+	// Decoding every value is exact.
+	vector<uint32_t> Gray(256);
+	for (uint32_t i = 0; i < 256; ++i)
+		Gray[i] = i | i << 8 | i << 16 | i << 24;
+	vector<XMFLOAT4> Linear(256);
+	DecodeR8G8B8A8(TransferFunction::kSRGB, Gray.data(), Gray.size(), Linear.data());
+	uint32_t Inexact = 0;
+	for (uint32_t i = 0; i < 256; ++i) {
+		if (Linear[i].x != (float)DecodeSRGB(i / 255.0) || Linear[i].w != i / 255.0f)
+			++Inexact;
+	}
+	TEST_CHECK(Inexact == 0);
+
+	// Encoding is within a step of the exact curve and of Color::ToSRGB.
+	const vector<XMFLOAT4> Texels = MakeLowRange(39, kTexelCount);
+	vector<uint32_t> Encoded(kTexelCount);
+	EncodeR8G8B8A8(TransferFunction::kSRGB, Texels.data(), kTexelCount, Encoded.data());
+	uint32_t FarFromCurve = 0, FarFromColor = 0;
+	for (size_t i = 0; i < kTexelCount; ++i) {
+		const XMFLOAT4& t = Texels[i];
+		const uint32_t Exact = (uint32_t)(EncodeSRGB(t.x) * 255.0 + 0.5) | (uint32_t)(EncodeSRGB(t.y) * 255.0 + 0.5) << 8 |
+			(uint32_t)(EncodeSRGB(t.z) * 255.0 + 0.5) << 16 | (uint32_t)(min(max(t.w, 0.0f), 1.0f) * 255.0f + 0.5f) << 24;
+		if (!IsWithinOneStep(Encoded[i], Exact))
+			++FarFromCurve;
+		if (!IsWithinOneStep(Encoded[i], Color(XMLoadFloat4(&t)).ToSRGB().R8G8B8A8()))
+			++FarFromColor;
+	}
+	TEST_CHECK(FarFromCurve == 0);
+	TEST_CHECK(FarFromColor == 0);
+
+	// Premultiplying in linear space: opaque texels stay within a step, transparent ones go black.
+	vector<uint32_t> Pixels(kTexelCount);
+	mt19937 Random(40);
+	for (uint32_t& Pixel : Pixels)
+		Pixel = Random();
+	Pixels[0] = 0xFF336699;
+	Pixels[1] = 0x00336699;
+	const vector<uint32_t> Original = Pixels;
+	PremultiplyAlphaR8G8B8A8(TransferFunction::kSRGB, Pixels.data(), Pixels.size());
+	TEST_CHECK(IsWithinOneStep(Pixels[0], Original[0]));
+	TEST_CHECK(Pixels[1] == 0);
+
+	uint32_t Wrong = 0;
+	for (size_t i = 0; i < kTexelCount; ++i) {
+		const double Alpha = GetChannel(Original[i], 3) / 255.0;
+		uint32_t Expected = GetChannel(Original[i], 3) << 24;
+		for (int Channel = 0; Channel < 3; ++Channel)
+			Expected |= (uint32_t)(EncodeSRGB(DecodeSRGB(GetChannel(Original[i], Channel) / 255.0) * Alpha) * 255.0 + 0.5) << (8 * Channel);
+		if (!IsWithinOneStep(Pixels[i], Expected))
+			++Wrong;
+	}
+	TEST_CHECK(Wrong == 0);
+}
+
+double Seconds(chrono::steady_clock::time_point Start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+}
+
+// Texels per second for each format, packed a Color at a time, in batches on one thread, and in one batch split
+// across threads.
+void RunBenchmark(size_t Count, uint32_t Passes) {
+	const vector<XMFLOAT4> Low = MakeLowRange(41, Count);
+	const vector<XMFLOAT4> High = MakeHighRange(42, Count);
+	vector<uint32_t> Packed(Count);
+
+	// Below the size that gets split across threads.
+	const size_t Piece = 8192;
+	auto Report = [&](const char* Name, const vector<XMFLOAT4>& Texels, PackFunc Pack, ColorPackFunc Reference) {
+		auto Start = chrono::steady_clock::now();
+		for (uint32_t Pass = 0; Pass < Passes; ++Pass) {
+			for (size_t i = 0; i < Count; ++i)
+				Packed[i] = Reference(Color(XMLoadFloat4(&Texels[i])));
+		}
+		const double PerColor = Count * Passes / Seconds(Start);
+
+		Start = chrono::steady_clock::now();
+		for (uint32_t Pass = 0; Pass < Passes; ++Pass) {
+			for (size_t i = 0; i < Count; i += Piece)
+				Pack(&Texels[i], min(Piece, Count - i), &Packed[i]);
+		}
+		const double Batched = Count * Passes / Seconds(Start);
+
+		Start = chrono::steady_clock::now();
+		for (uint32_t Pass = 0; Pass < Passes; ++Pass)
+			Pack(Texels.data(), Count, Packed.data());
+		const double Threaded = Count * Passes / Seconds(Start);
+
+		printf("%s: %.1f M texels/s per Color, %.1f M texels/s batched, %.1f M texels/s threaded\n", Name,
+			PerColor * 1e-6, Batched * 1e-6, Threaded * 1e-6);
+	};
+
+	Report("R8G8B8A8", Low, PackR8G8B8A8, [](const Color& c) { return c.R8G8B8A8(); });
+	Report("R10G10B10A2", Low, PackR10G10B10A2, [](const Color& c) { return c.R10G10B10A2(); });
+	Report("R11G11B10F", High, [](const XMFLOAT4* s, size_t n, uint32_t* d) { PackR11G11B10F(s, n, d); },
+		[](const Color& c) { return c.R11G11B10F(); });
+	Report("R9G9B9E5", High, PackR9G9B9E5, [](const Color& c) { return c.R9G9B9E5(); });
+	Report("sRGB R8G8B8A8", Low, [](const XMFLOAT4* s, size_t n, uint32_t* d) { EncodeR8G8B8A8(TransferFunction::kSRGB, s, n, d); },
+		[](const Color& c) { return c.ToSRGB().R8G8B8A8(); });
+}
+
+}	// anonymous namespace
+
+void RunColorPackingTests() {
+	TestPacking();
+	TestTransferFunctions();
+	RunBenchmark(1 << 20, 20);
+}
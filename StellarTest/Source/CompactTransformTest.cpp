@@ -0,0 +1,179 @@
+//
+// CompactTransform: quaternion and transform round trips within their quantization error, batch decoding against one
+// transform at a time, then decode throughput and the bandwidth it saves over copying whole Matrix4 arrays.
+//
+
+#include "pch.h"
+#include "Math/CompactTransform.h"
+#include "Math/Parallel.h"
+#include "TestCommon.h"
+#include <chrono>
+#include <cstring>
+#include <random>
+
+using namespace Math;
+using namespace std;
+
+namespace {
+
+Quaternion RandomRotation(mt19937& Random) {
+	normal_distribution<float> Normal;
+	return Normalize(Quaternion(DirectX::XMVectorSet(Normal(Random), Normal(Random), Normal(Random), Normal(Random))));
+}
+
+Vector3 RandomVector(mt19937& Random, float Extent) {
+	uniform_real_distribution<float> Distribution(-Extent, Extent);
+	return Vector3(Distribution(Random), Distribution(Random), Distribution(Random));
+}
+
+float Distance(Vector3 a, Vector3 b) {
+	return Length(a - b);
+}
+
+void TestQuaternions() {
+	mt19937 Random(31);
+	float WorstDot = 1.0f;
+	for (uint32_t i = 0; i < 10000; ++i) {
+		const Quaternion q = RandomRotation(Random);
+		const Quaternion Unpacked = UnpackQuaternion(PackQuaternion(q));
+		WorstDot = min(WorstDot, fabs((float)Dot(Vector4(DirectX::XMVECTOR(q)), Vector4(DirectX::XMVECTOR(Unpacked)))));
+	}
+	// 15 bits per component keep every rotation within a few thousandths of a degree.
+	TEST_CHECK(WorstDot > 0.99999f);
+
+	// q and -q pack the same.
+	const Quaternion q = RandomRotation(Random);
+	const PackedQuaternion Positive = PackQuaternion(q), Negative = PackQuaternion(-q);
+	TEST_CHECK(memcmp(&Positive, &Negative, sizeof(Positive)) == 0);
+}
+
+// Decoded matrices move points where the original transform does, to within the translation precision.
+void TestTransforms(const TranslationRange* Range, float Extent, float Tolerance) {
+	mt19937 Random(32);
+	uniform_real_distribution<float> ScaleDistribution(0.5f, 2.0f);
+	const uint32_t Count = 10003;
+	vector<CompactTransform> Packed(Count);
+	vector<OrthogonalTransform> Transforms(Count);
+	vector<float> Scales(Count);
+	for (uint32_t i = 0; i < Count; ++i) {
+		Transforms[i] = OrthogonalTransform(RandomRotation(Random), RandomVector(Random, Extent));
+		Scales[i] = ScaleDistribution(Random);
+		Packed[i] = PackTransform(Transforms[i], Scales[i], Range);
+	}
+
+	// Crosses the threaded chunk size and ends on a partial group of four.
+	vector<Matrix4> Decoded(Count);
+	DecodeTransforms(Packed.data(), Count, Decoded.data(), Range);
+
+	uint32_t Misplaced = 0, Inconsistent = 0;
+	for (uint32_t i = 0; i < Count; ++i) {
+		const Vector3 Point = RandomVector(Random, 1.0f);
+		const Vector3 Expected = Transforms[i].GetRotation() * (Point * Scales[i]) + Transforms[i].GetTranslation();
+		if (Distance(Vector3(Decoded[i] * Point), Expected) > Tolerance)
+			++Misplaced;
+
+		Matrix4 Single;
+		DecodeTransforms(&Packed[i], 1, &Single, Range);
+		if (memcmp(&Single, &Decoded[i], sizeof(Single)) != 0)
+			++Inconsistent;
+	}
+	TEST_CHECK(Misplaced == 0);
+	TEST_CHECK(Inconsistent == 0);
+}
+
+void TestAffine() {
+	mt19937 Random(33);
+	const TranslationRange Range(BoundingBox(Vector3(-10.0f, -10.0f, -10.0f), Vector3(10.0f, 10.0f, 10.0f)));
+	uint32_t Misplaced = 0, Changed = 0;
+	for (uint32_t i = 0; i < 1000; ++i) {
+		const Matrix3 Basis = Matrix3(RandomRotation(Random)) * Matrix3::MakeScale(1.5f);
+		const AffineTransform Affine(Basis, RandomVector(Random, 10.0f));
+
+		Matrix4 Decoded;
+		const CompactTransform Packed = PackTransform(Affine, &Range);
+		DecodeTransforms(&Packed, 1, &Decoded, &Range);
+		const Vector3 Point = RandomVector(Random, 1.0f);
+		if (Distance(Vector3(Decoded * Point), Affine * Point) > 0.005f)
+			++Misplaced;
+
+		// Float3x4 drops only the constant column.
+		const Matrix4 Full(Affine);
+		const Matrix4 Unpacked = UnpackFloat3x4(PackFloat3x4(Full));
+		if (memcmp(&Unpacked, &Full, sizeof(Full)) != 0)
+			++Changed;
+	}
+	TEST_CHECK(Misplaced == 0);
+	TEST_CHECK(Changed == 0);
+}
+
+double Seconds(chrono::steady_clock::time_point Start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+}
+
+// Transforms per second decoded into Matrix4 from each format, on one thread and over every thread, next to copying
+// the Matrix4 array itself. GB/s counts the bytes read and written.
+void RunBenchmark(size_t Count, uint32_t Passes) {
+	mt19937 Random(34);
+	const TranslationRange Range(BoundingBox(Vector3(-100.0f, -100.0f, -100.0f), Vector3(100.0f, 100.0f, 100.0f)));
+	vector<CompactTransform> Compact(Count);
+	vector<Float3x4> Unpadded(Count);
+	vector<Matrix4> Source(Count), Dest(Count);
+	for (size_t i = 0; i < Count; ++i) {
+		const OrthogonalTransform Transform(RandomRotation(Random), RandomVector(Random, 100.0f));
+		Compact[i] = PackTransform(Transform, 1.0f, &Range);
+		Source[i] = Matrix4(Transform);
+		Unpadded[i] = PackFloat3x4(Source[i]);
+	}
+
+	// One thread decodes in pieces below the size that gets split across threads.
+	const size_t Piece = 4096;
+	auto Report = [&](const char* Name, size_t SourceBytes, auto Decode) {
+		auto Start = chrono::steady_clock::now();
+		for (uint32_t Pass = 0; Pass < Passes; ++Pass) {
+			for (size_t i = 0; i < Count; i += Piece)
+				Decode(i, min(Piece, Count - i));
+		}
+		const double Single = Count * Passes / Seconds(Start);
+
+		Start = chrono::steady_clock::now();
+		for (uint32_t Pass = 0; Pass < Passes; ++Pass)
+			Decode(0, Count);
+		const double Threaded = Count * Passes / Seconds(Start);
+
+		const double Bytes = (double)(SourceBytes + sizeof(Matrix4));
+		printf("%s (%zu bytes): %.1f M/s, %.2f GB/s on one thread, %.1f M/s, %.2f GB/s threaded\n", Name, SourceBytes,
+			Single * 1e-6, Single * Bytes * 1e-9, Threaded * 1e-6, Threaded * Bytes * 1e-9);
+	};
+
+	Report("CompactTransform", sizeof(CompactTransform), [&](size_t Begin, size_t Size) {
+		DecodeTransforms(&Compact[Begin], Size, &Dest[Begin], &Range);
+	});
+	Report("Float3x4", sizeof(Float3x4), [&](size_t Begin, size_t Size) {
+		DecodeTransforms(&Unpadded[Begin], Size, &Dest[Begin]);
+	});
+
+	// A copy is what every decoder saves on: its source alone is four times the CompactTransform.
+	Report("Matrix4 copy", sizeof(Matrix4), [&](size_t Begin, size_t Size) {
+		if (Size <= Piece) {
+			memcpy(&Dest[Begin], &Source[Begin], Size * sizeof(Matrix4));
+			return;
+		}
+		ParallelFor(size_t(0), DivideByMultiple(Size, Piece), [&](size_t Chunk) {
+			const size_t First = Begin + Chunk * Piece;
+			memcpy(&Dest[First], &Source[First], min(Piece, Begin + Size - First) * sizeof(Matrix4));
+		});
+	});
+}
+
+}	// anonymous namespace
+
+void RunCompactTransformTests() {
+	const TranslationRange Range(BoundingBox(Vector3(-100.0f, -100.0f, -100.0f), Vector3(100.0f, 100.0f, 100.0f)));
+
+	TestQuaternions();
+	// Half floats keep 11 bits of the translation, fixed point 16 bits of the range.
+	TestTransforms(nullptr, 100.0f, 0.1f);
+	TestTransforms(&Range, 100.0f, 0.01f);
+	TestAffine();
+	RunBenchmark(1 << 20, 20);
+}
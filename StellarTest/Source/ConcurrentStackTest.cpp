@@ -0,0 +1,233 @@
+//
+// ConcurrentStack: stack semantics, and batch pops under contention. Pops must never come back short while enough
+// nodes are in the stack, which is what keeps a page pool from growing when recording threads refill at once.
+// Builds without the engine: g++ -std=c++14 -O2 -DSTELLAR_TEST_STANDALONE -I../../Core/Source ConcurrentStackTest.cpp
+//
+
+#include "Graphics/ConcurrentStack.h"
+#include "TestCommon.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace Graphics;
+using namespace std;
+
+namespace {
+
+struct TestNode {
+	TestNode() : m_Next(nullptr), Value(0), Owner(-1) {}
+
+	TestNode* m_Next;
+	uint32_t Value;
+	atomic<int> Owner;
+};
+
+typedef ConcurrentStack<TestNode, &TestNode::m_Next> TestStack;
+
+uint32_t CountChain(const TestNode* Node) {
+	uint32_t Count = 0;
+	for (; Node != nullptr; Node = Node->m_Next)
+		++Count;
+	return Count;
+}
+
+void TestSemantics() {
+	TestNode Nodes[8];
+	TestStack Stack;
+	TEST_CHECK(Stack.IsEmpty());
+	TEST_CHECK(Stack.Pop() == nullptr);
+
+	for (uint32_t i = 0; i < 8; ++i) {
+		Nodes[i].Value = i;
+		Stack.Push(&Nodes[i]);
+	}
+
+	// Most recently pushed first, and only as many as asked for.
+	TestNode* Popped[4];
+	TEST_CHECK(Stack.Pop(Popped, 3) == 3);
+	TEST_CHECK(Popped[0]->Value == 7 && Popped[1]->Value == 6 && Popped[2]->Value == 5);
+
+	// A chain goes on top in order.
+	Popped[0]->m_Next = Popped[1];
+	Popped[1]->m_Next = Popped[2];
+	Stack.Push(Popped[0], Popped[2]);
+
+	// Odd values out, the head among them, chained in reverse; the rest stays in order.
+	TestNode* Removed = Stack.RemoveIf([](const TestNode* Node) { return (Node->Value & 1) != 0; });
+	TEST_CHECK(CountChain(Removed) == 4);
+	const uint32_t ExpectedRemoved[] = { 1, 3, 5, 7 };
+	for (uint32_t i = 0; Removed != nullptr; Removed = Removed->m_Next, ++i)
+		TEST_CHECK(Removed->Value == ExpectedRemoved[i]);
+
+	TestNode* Rest = Stack.PopAll();
+	TEST_CHECK(Stack.IsEmpty());
+	TEST_CHECK(CountChain(Rest) == 4);
+	const uint32_t Expected[] = { 6, 4, 2, 0 };
+	for (uint32_t i = 0; Rest != nullptr; Rest = Rest->m_Next, ++i)
+		TEST_CHECK(Rest->Value == Expected[i]);
+}
+
+// Every thread pops a batch, checks it owns every node of it alone, and pushes it back. With more nodes than all
+// threads can hold at once, no pop may come back short.
+void TestContention(uint32_t ThreadCount, uint32_t BatchSize, uint32_t Iterations) {
+	const uint32_t NodeCount = ThreadCount * BatchSize * 2;
+	vector<TestNode> Nodes(NodeCount);
+	TestStack Stack;
+	for (TestNode& Node : Nodes)
+		Stack.Push(&Node);
+
+	atomic<uint32_t> ShortPops(0);
+	atomic<uint32_t> SharedNodes(0);
+	vector<thread> Threads;
+	for (uint32_t t = 0; t < ThreadCount; ++t) {
+		Threads.emplace_back([&, t]() {
+			vector<TestNode*> Batch(BatchSize);
+			for (uint32_t i = 0; i < Iterations; ++i) {
+				const uint32_t Count = Stack.Pop(Batch.data(), BatchSize);
+				if (Count != BatchSize)
+					++ShortPops;
+				for (uint32_t n = 0; n < Count; ++n) {
+					if (Batch[n]->Owner.exchange((int)t) != -1)
+						++SharedNodes;
+				}
+				for (uint32_t n = 0; n < Count; ++n) {
+					Batch[n]->Owner = -1;
+					Batch[n]->m_Next = n + 1 < Count ? Batch[n + 1] : nullptr;
+				}
+				if (Count != 0)
+					Stack.Push(Batch[0], Batch[Count - 1]);
+			}
+		});
+	}
+	for (thread& Thread : Threads)
+		Thread.join();
+
+	TEST_CHECK(ShortPops == 0);
+	TEST_CHECK(SharedNodes == 0);
+	TEST_CHECK(CountChain(Stack.PopAll()) == NodeCount);
+}
+
+// Trimming must not hide the nodes it keeps from concurrent pops, nor lose any.
+void TestRemoveWhilePopping(uint32_t ThreadCount, uint32_t Iterations) {
+	const uint32_t NodeCount = ThreadCount * 8;
+	vector<TestNode> Nodes(NodeCount);
+	TestStack Stack;
+	for (uint32_t i = 0; i < NodeCount; ++i) {
+		Nodes[i].Value = i;
+		Stack.Push(&Nodes[i]);
+	}
+
+	atomic<bool> Done(false);
+	atomic<uint32_t> EmptyPops(0);
+	vector<thread> Threads;
+	for (uint32_t t = 0; t < ThreadCount; ++t) {
+		Threads.emplace_back([&]() {
+			for (uint32_t i = 0; i < Iterations; ++i) {
+				TestNode* Node = Stack.Pop();
+				if (Node == nullptr) {
+					++EmptyPops;
+					continue;
+				}
+				Stack.Push(Node);
+			}
+		});
+	}
+
+	// Takes a quarter of the nodes out from between the others and puts them back, over and over.
+	thread Trimmer([&]() {
+		while (!Done) {
+			TestNode* Chain = Stack.RemoveIf([](const TestNode* Node) { return (Node->Value & 3) == 0; });
+			if (Chain == nullptr)
+				continue;
+			TestNode* Last = Chain;
+			while (Last->m_Next != nullptr)
+				Last = Last->m_Next;
+			Stack.Push(Chain, Last);
+		}
+	});
+
+	for (thread& Thread : Threads)
+		Thread.join();
+	Done = true;
+	Trimmer.join();
+
+	TEST_CHECK(EmptyPops == 0);
+	TEST_CHECK(CountChain(Stack.PopAll()) == NodeCount);
+}
+
+// Batch pops and pushes per second, against a vector under a mutex.
+void RunBenchmark(uint32_t ThreadCount, uint32_t BatchSize, uint32_t Iterations) {
+	const uint32_t NodeCount = ThreadCount * BatchSize * 2;
+	vector<TestNode> Nodes(NodeCount);
+
+	TestStack Stack;
+	for (TestNode& Node : Nodes)
+		Stack.Push(&Node);
+
+	mutex VectorMutex;
+	vector<TestNode*> Vector;
+	for (TestNode& Node : Nodes)
+		Vector.push_back(&Node);
+
+	auto Time = [&](bool UseStack) {
+		const auto Start = chrono::steady_clock::now();
+		vector<thread> Threads;
+		for (uint32_t t = 0; t < ThreadCount; ++t) {
+			Threads.emplace_back([&]() {
+				vector<TestNode*> Batch(BatchSize);
+				for (uint32_t i = 0; i < Iterations; ++i) {
+					uint32_t Count = 0;
+					if (UseStack) {
+						Count = Stack.Pop(Batch.data(), BatchSize);
+						for (uint32_t n = 0; n < Count; ++n)
+							Batch[n]->m_Next = n + 1 < Count ? Batch[n + 1] : nullptr;
+						if (Count != 0)
+							Stack.Push(Batch[0], Batch[Count - 1]);
+					} else {
+						lock_guard<mutex> CS(VectorMutex);
+						for (; Count < BatchSize && !Vector.empty(); ++Count) {
+							Batch[Count] = Vector.back();
+							Vector.pop_back();
+						}
+					}
+					if (!UseStack) {
+						lock_guard<mutex> CS(VectorMutex);
+						Vector.insert(Vector.end(), Batch.begin(), Batch.begin() + Count);
+					}
+				}
+			});
+		}
+		for (thread& Thread : Threads)
+			Thread.join();
+		const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+		return ThreadCount * Iterations / Seconds;
+	};
+
+	const double StackRate = Time(true);
+	const double VectorRate = Time(false);
+	printf("ConcurrentStack, %u threads, batches of %u: %.2f M batches/s (mutex and vector: %.2f M), %llu CAS retries, "
+		"%llu pop lock waits\n", ThreadCount, BatchSize, StackRate * 1e-6, VectorRate * 1e-6,
+		(unsigned long long)Stack.GetCasRetries(), (unsigned long long)Stack.GetPopLockWaits());
+}
+
+}	// anonymous namespace
+
+void RunConcurrentStackTests() {
+	const uint32_t ThreadCount = max(4u, thread::hardware_concurrency());
+
+	TestSemantics();
+	TestContention(ThreadCount, 4, 20000);
+	TestContention(ThreadCount, 1, 20000);
+	TestRemoveWhilePopping(ThreadCount, 20000);
+	RunBenchmark(ThreadCount, 4, 100000);
+}
+
+#ifdef STELLAR_TEST_STANDALONE
+int main() {
+	RunConcurrentStackTests();
+	printf("%d check(s) failed\n", StellarTest::FailureCount());
+	return StellarTest::FailureCount() == 0 ? 0 : 1;
+}
+#endif
@@ -0,0 +1,215 @@
+//
+// Hash: HashRange, HashBytes and StateKey agreeing with each other, a corpus of sequential keys and of near identical
+// state descs checked for 64 bit collisions, bit avalanche and the spread of the low 32 bits, then hash throughput
+// across key sizes.
+// Builds without the engine: g++ -std=c++14 -O2 -DSTELLAR_TEST_STANDALONE -I../../Core/Source -I<DirectXMath>/Inc
+// -I<DirectX-Headers>/include/wsl/stubs HashTest.cpp
+//
+
+#include "Graphics/Hash.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Graphics;
+using namespace std;
+
+namespace {
+
+// The size of a graphics PSO desc, the largest key the state caches hash.
+const uint32_t kDescWords = 162;
+
+struct FakeDesc {
+	uint32_t Words[kDescWords];
+};
+
+FakeDesc MakeDesc(uint32_t Seed) {
+	mt19937 Random(Seed);
+	FakeDesc Desc;
+	for (uint32_t& Word : Desc.Words)
+		Word = Random() % 4 == 0 ? Random() : 0;
+	return Desc;
+}
+
+uint32_t CountBits(uint64_t Value) {
+	uint32_t Count = 0;
+	for (; Value != 0; Value &= Value - 1)
+		++Count;
+	return Count;
+}
+
+// Duplicates in a sorted copy, counted on all 64 bits and on the low 32.
+void CountCollisions(vector<uint64_t> Hashes, size_t& Collisions64, size_t& Collisions32) {
+	sort(Hashes.begin(), Hashes.end());
+	Collisions64 = Hashes.size() - (unique(Hashes.begin(), Hashes.end()) - Hashes.begin());
+	for (uint64_t& Hash : Hashes)
+		Hash = (uint32_t)Hash;
+	sort(Hashes.begin(), Hashes.end());
+	Collisions32 = Hashes.size() - (unique(Hashes.begin(), Hashes.end()) - Hashes.begin());
+}
+
+// No 64 bit collision at all, and about as many 32 bit ones as random values would have.
+void CheckCorpus(const vector<uint64_t>& Hashes) {
+	size_t Collisions64, Collisions32;
+	CountCollisions(Hashes, Collisions64, Collisions32);
+	const double Expected32 = (double)Hashes.size() * Hashes.size() / 8589934592.0;
+	TEST_CHECK(Collisions64 == 0);
+	TEST_CHECK(fabs(Collisions32 - Expected32) < 6.0 * sqrt(Expected32) + 2.0);
+}
+
+void TestConsistency() {
+	const FakeDesc Desc = MakeDesc(39);
+	const uint64_t Hash = HashState(&Desc);
+	TEST_CHECK(Hash == HashRange(Desc.Words, Desc.Words + kDescWords, 2166136261U));
+
+	// Each Append carries on from the hash so far, and keys match only when every word does.
+	FakeDesc Pair[2] = { Desc, MakeDesc(40) };
+	StateKey Whole, Pieces;
+	Whole.Append(Pair, 2);
+	Pieces.Append(&Pair[0]);
+	Pieces.Append(&Pair[1]);
+	TEST_CHECK(Whole.GetHash() == HashState(Pair, 2));
+	TEST_CHECK(Pieces.GetHash() == HashState(&Pair[1], 1, Hash));
+	StateKey Again;
+	Again.Append(&Pair[0]);
+	Again.Append(&Pair[1]);
+	TEST_CHECK(Again == Pieces);
+	Pair[1].Words[kDescWords - 1] ^= 1;
+	StateKey Changed;
+	Changed.Append(&Pair[0]);
+	Changed.Append(&Pair[1]);
+	TEST_CHECK(!(Changed == Pieces));
+
+	// HashBytes doesn't care where the bytes sit, and the size counts, so trailing zeros are not ignored.
+	vector<uint8_t> Bytes(sizeof(Desc) + 3);
+	memcpy(&Bytes[3], &Desc, sizeof(Desc));
+	TEST_CHECK(HashBytes(&Desc, sizeof(Desc)) == HashBytes(&Bytes[3], sizeof(Desc)));
+	const uint8_t Zeros[16] = {};
+	vector<uint64_t> BySize;
+	for (size_t Size = 0; Size <= sizeof(Zeros); ++Size)
+		BySize.push_back(HashBytes(Zeros, Size));
+	sort(BySize.begin(), BySize.end());
+	TEST_CHECK(unique(BySize.begin(), BySize.end()) == BySize.end());
+
+	// Every word count through the two lane loop, the one lane loop and the tail.
+	vector<uint64_t> ByLength;
+	for (uint32_t Count = 0; Count <= kDescWords; ++Count)
+		ByLength.push_back(HashRange(Desc.Words, Desc.Words + Count, 0));
+	sort(ByLength.begin(), ByLength.end());
+	TEST_CHECK(unique(ByLength.begin(), ByLength.end()) == ByLength.end());
+}
+
+// Sequential integers, descs that differ from a common one in a few fields by small values, the way one PSO differs
+// from the next by a format or a blend state, and pairs of sequential 64 bit keys.
+void TestCollisions() {
+	const uint32_t Count = 1 << 21;
+	vector<uint64_t> Hashes(Count);
+	for (uint32_t i = 0; i < Count; ++i)
+		Hashes[i] = HashState(&i);
+	CheckCorpus(Hashes);
+
+	// Each i changes three fields by its own small values, so every desc in the corpus is distinct.
+	const FakeDesc Base = MakeDesc(41);
+	for (uint32_t i = 0; i < Count; ++i) {
+		FakeDesc Desc = Base;
+		Desc.Words[10] = i & 0xFF;
+		Desc.Words[40] += (i >> 8) & 0xFF;
+		Desc.Words[100 + (i >> 16)] ^= 1;
+		Hashes[i] = HashState(&Desc);
+	}
+	CheckCorpus(Hashes);
+
+	// Two sequential 64 bit keys, the layout of a pipeline cache identity.
+	for (uint32_t i = 0; i < Count; ++i) {
+		const uint64_t Key[2] = { i >> 10, i & 1023 };
+		Hashes[i] = HashState(Key, 2);
+	}
+	CheckCorpus(Hashes);
+}
+
+// Flipping one input bit flips each output bit half of the time.
+void TestAvalanche() {
+	const uint32_t Samples = 2000;
+	mt19937 Random(42);
+	uint32_t OutputFlips[64] = {};
+	uint64_t TotalFlips = 0;
+	uint32_t Trials = 0;
+	for (uint32_t Sample = 0; Sample < Samples; ++Sample) {
+		FakeDesc Desc = MakeDesc(Random());
+		const uint64_t Hash = HashState(&Desc);
+		for (uint32_t k = 0; k < 8; ++k) {
+			const uint32_t Bit = Random() % (kDescWords * 32);
+			Desc.Words[Bit / 32] ^= 1u << (Bit % 32);
+			const uint64_t Flipped = Hash ^ HashState(&Desc);
+			Desc.Words[Bit / 32] ^= 1u << (Bit % 32);
+			TotalFlips += CountBits(Flipped);
+			for (uint32_t Out = 0; Out < 64; ++Out)
+				OutputFlips[Out] += (Flipped >> Out) & 1;
+			++Trials;
+		}
+	}
+	const double MeanFlips = (double)TotalFlips / Trials;
+	TEST_CHECK(MeanFlips > 31.5 && MeanFlips < 32.5);
+	uint32_t Biased = 0;
+	for (uint32_t Out = 0; Out < 64; ++Out) {
+		const double Rate = (double)OutputFlips[Out] / Trials;
+		if (Rate < 0.47 || Rate > 0.53)
+			++Biased;
+	}
+	TEST_CHECK(Biased == 0);
+}
+
+volatile uint64_t s_Sink;
+
+// GB/s hashing one key over and over, for sizes from a sampler desc up to a large blob, and building the StateKey a
+// PSO cache lookup needs.
+void RunBenchmark() {
+	vector<uint32_t> Data(1 << 18);
+	mt19937 Random(43);
+	for (uint32_t& Word : Data)
+		Word = Random();
+
+	const size_t Sizes[] = { 16, 52, 256, kDescWords * 4, 4096, 65536, Data.size() * 4 };
+	printf("Hash:");
+	for (size_t Size : Sizes) {
+		const size_t Passes = max<size_t>(1, (size_t(1) << 30) / Size / 4);
+		uint64_t Hash = 0;
+		const auto Start = chrono::steady_clock::now();
+		for (size_t Pass = 0; Pass < Passes; ++Pass)
+			Hash = HashBytes(Data.data(), Size, Hash);
+		const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+		s_Sink = Hash;
+		printf(" %zu bytes %.2f GB/s (%.1f ns),", Size, Passes * Size / Seconds * 1e-9, Seconds / Passes * 1e9);
+	}
+
+	const FakeDesc Desc = MakeDesc(44);
+	const uint32_t Keys = 1000000;
+	const auto Start = chrono::steady_clock::now();
+	for (uint32_t i = 0; i < Keys; ++i) {
+		StateKey Key;
+		Key.Append(&Desc);
+		s_Sink = Key.GetHash();
+	}
+	const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+	printf(" StateKey of %u bytes %.1f ns\n", kDescWords * 4, Seconds / Keys * 1e9);
+}
+
+}	// anonymous namespace
+
+void RunHashTests() {
+	TestConsistency();
+	TestCollisions();
+	TestAvalanche();
+	RunBenchmark();
+}
+
+#ifdef STELLAR_TEST_STANDALONE
+int main() {
+	RunHashTests();
+	printf("%d check(s) failed\n", StellarTest::FailureCount());
+	return StellarTest::FailureCount() == 0 ? 0 : 1;
+}
+#endif
@@ -0,0 +1,257 @@
+//
+// Math backend: which DirectXMath intrinsic level Common.h picked, the alignment helpers, and vector and matrix
+// products checked against plain scalar code, then their speed against that scalar code.
+// Builds without the engine, once per backend to compare them, e.g. for AVX2 with FMA3:
+// g++ -std=c++14 -O2 -mavx2 -mfma -mf16c -DSTELLAR_TEST_STANDALONE -I../../Core/Source -I<DirectXMath>/Inc
+// -I<DirectX-Headers>/include/wsl/stubs MathBackendTest.cpp
+// and with -DMATH_BACKEND_SCALAR, -DMATH_BACKEND_SSE2 or -msse4.1 for the others.
+//
+
+#include "Math/VectorMath.h"
+#include "TestCommon.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Math;
+using namespace std;
+
+namespace {
+
+const char* GetBackendName() {
+#if defined(MATH_BACKEND_AVX2)
+	return "AVX2";
+#elif defined(MATH_BACKEND_SSE4)
+	return "SSE4";
+#elif defined(MATH_BACKEND_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+// Row-major like XMMATRIX: Rows[i] is r[i].
+struct ScalarMatrix {
+	float Rows[4][4];
+};
+
+struct ScalarVector {
+	float v[4];
+};
+
+// Matrix4 * Vector4 in this library's convention, which is DirectXMath's row vector times the matrix.
+ScalarVector Transform(const ScalarMatrix& Mat, const ScalarVector& Vec) {
+	ScalarVector Result;
+	for (int Column = 0; Column < 4; ++Column) {
+		float Sum = 0.0f;
+		for (int Row = 0; Row < 4; ++Row)
+			Sum += Vec.v[Row] * Mat.Rows[Row][Column];
+		Result.v[Column] = Sum;
+	}
+	return Result;
+}
+
+// Lhs * Rhs in this library's convention, which is XMMatrixMultiply(Rhs, Lhs).
+ScalarMatrix Multiply(const ScalarMatrix& Lhs, const ScalarMatrix& Rhs) {
+	ScalarMatrix Result;
+	for (int Row = 0; Row < 4; ++Row) {
+		for (int Column = 0; Column < 4; ++Column) {
+			float Sum = 0.0f;
+			for (int k = 0; k < 4; ++k)
+				Sum += Rhs.Rows[Row][k] * Lhs.Rows[k][Column];
+			Result.Rows[Row][Column] = Sum;
+		}
+	}
+	return Result;
+}
+
+Matrix4 ToMatrix4(const ScalarMatrix& Mat) {
+	DirectX::XMFLOAT4X4 Stored;
+	for (int Row = 0; Row < 4; ++Row) {
+		for (int Column = 0; Column < 4; ++Column)
+			Stored.m[Row][Column] = Mat.Rows[Row][Column];
+	}
+	return Matrix4(DirectX::XMLoadFloat4x4(&Stored));
+}
+
+ScalarVector ToScalar(Vector4 Vec) {
+	ScalarVector Result;
+	DirectX::XMFLOAT4 Stored;
+	DirectX::XMStoreFloat4(&Stored, Vec);
+	Result.v[0] = Stored.x;
+	Result.v[1] = Stored.y;
+	Result.v[2] = Stored.z;
+	Result.v[3] = Stored.w;
+	return Result;
+}
+
+// Fused multiply-adds round once instead of twice, so the backends agree to a few ulps of the operands, not exactly.
+bool IsNear(float a, float b) {
+	return fabs(a - b) <= 1e-5f * max(1.0f, fabs(b));
+}
+
+ScalarMatrix RandomMatrix(mt19937& Random) {
+	uniform_real_distribution<float> Distribution(-2.0f, 2.0f);
+	ScalarMatrix Mat;
+	for (int Row = 0; Row < 4; ++Row) {
+		for (int Column = 0; Column < 4; ++Column)
+			Mat.Rows[Row][Column] = Distribution(Random);
+	}
+	return Mat;
+}
+
+ScalarVector RandomVector(mt19937& Random) {
+	uniform_real_distribution<float> Distribution(-10.0f, 10.0f);
+	ScalarVector Vec;
+	for (float& Component : Vec.v)
+		Component = Distribution(Random);
+	return Vec;
+}
+
+void TestBackendDefines() {
+	// Exactly one backend, and the DirectXMath switches it stands for.
+	const int Backends = 0
+#ifdef MATH_BACKEND_SCALAR
+		+ 1
+#endif
+#ifdef MATH_BACKEND_SSE2
+		+ 1
+#endif
+#ifdef MATH_BACKEND_SSE4
+		+ 1
+#endif
+#ifdef MATH_BACKEND_AVX2
+		+ 1
+#endif
+		;
+	TEST_CHECK(Backends == 1);
+
+#if defined(MATH_BACKEND_AVX2)
+	bool FusedAndHalf = false;
+#if defined(_XM_AVX2_INTRINSICS_) && defined(_XM_FMA3_INTRINSICS_) && defined(_XM_F16C_INTRINSICS_)
+	FusedAndHalf = true;
+#endif
+	TEST_CHECK(FusedAndHalf);
+#elif defined(MATH_BACKEND_SCALAR)
+	bool NoIntrinsics = false;
+#if defined(_XM_NO_INTRINSICS_)
+	NoIntrinsics = true;
+#endif
+	TEST_CHECK(NoIntrinsics);
+#endif
+}
+
+void TestAlignment() {
+	TEST_CHECK(AlignUp(100u, 64) == 128u);
+	TEST_CHECK(AlignUp(128u, 64) == 128u);
+	TEST_CHECK(AlignDown(127u, 64) == 64u);
+	TEST_CHECK(IsAligned(256u, 256) && !IsAligned(257u, 256));
+	TEST_CHECK(DivideByMultiple(129u, 64) == 3u);
+	TEST_CHECK(IsPowerOfTwo(64u) && !IsPowerOfTwo(96u));
+
+	// Rounds up between powers of two.
+	TEST_CHECK(Log2(1) == 0 && Log2(64) == 6 && Log2(65) == 7 && Log2(1ull << 40) == 40);
+	TEST_CHECK(AlignPowerOfTwo(33u) == 64u);
+}
+
+void TestProducts() {
+	mt19937 Random(27);
+	uint32_t Mismatches = 0;
+	for (uint32_t i = 0; i < 1000; ++i) {
+		const ScalarMatrix A = RandomMatrix(Random);
+		const ScalarMatrix B = RandomMatrix(Random);
+		const ScalarVector V = RandomVector(Random);
+
+		const ScalarVector Expected = Transform(A, V);
+		const ScalarVector Actual = ToScalar(ToMatrix4(A) * Vector4(V.v[0], V.v[1], V.v[2], V.v[3]));
+		for (int k = 0; k < 4; ++k) {
+			if (!IsNear(Actual.v[k], Expected.v[k]))
+				++Mismatches;
+		}
+
+		// (A * B) * V == A * (B * V) holds for the library's column vectors.
+		const ScalarVector Chained = Transform(Multiply(A, B), V);
+		const ScalarVector Nested = Transform(A, Transform(B, V));
+		const ScalarVector Product = ToScalar((ToMatrix4(A) * ToMatrix4(B)) * Vector4(V.v[0], V.v[1], V.v[2], V.v[3]));
+		for (int k = 0; k < 4; ++k) {
+			if (!IsNear(Chained.v[k], Nested.v[k]) || !IsNear(Product.v[k], Chained.v[k]))
+				++Mismatches;
+		}
+	}
+	TEST_CHECK(Mismatches == 0);
+}
+
+volatile float s_Sink;
+
+// Vectors transformed and matrices multiplied per second by the compiled backend, and by the scalar reference built
+// with the same switches.
+void RunBenchmark(uint32_t Count, uint32_t Passes) {
+	mt19937 Random(7);
+	const ScalarMatrix Mat = RandomMatrix(Random);
+	vector<ScalarVector> Scalars(Count);
+	vector<Vector4> Vectors(Count);
+	vector<ScalarMatrix> ScalarMatrices(Count);
+	vector<Matrix4> Matrices(Count);
+	for (uint32_t i = 0; i < Count; ++i) {
+		Scalars[i] = RandomVector(Random);
+		Vectors[i] = Vector4(Scalars[i].v[0], Scalars[i].v[1], Scalars[i].v[2], Scalars[i].v[3]);
+		ScalarMatrices[i] = RandomMatrix(Random);
+		Matrices[i] = ToMatrix4(ScalarMatrices[i]);
+	}
+
+	// Every pass sums its results into the sink, so none of the work can be optimized away.
+	auto Time = [&](auto Work) {
+		const auto Start = chrono::steady_clock::now();
+		for (uint32_t Pass = 0; Pass < Passes; ++Pass)
+			s_Sink = Work();
+		const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+		return (double)Count * Passes / Seconds;
+	};
+
+	const Matrix4 Transform4 = ToMatrix4(Mat);
+	const double VectorRate = Time([&]() {
+		Vector4 Sum(EZeroTag::kZero);
+		for (const Vector4& Vec : Vectors)
+			Sum = Sum + Transform4 * Vec;
+		return (float)Sum.GetX();
+	});
+	const double ScalarVectorRate = Time([&]() {
+		float Sum = 0.0f;
+		for (const ScalarVector& Vec : Scalars)
+			Sum += Transform(Mat, Vec).v[0];
+		return Sum;
+	});
+	const double MatrixRate = Time([&]() {
+		Vector4 Sum(EZeroTag::kZero);
+		for (const Matrix4& Next : Matrices)
+			Sum = Sum + (Next * Transform4).GetX();
+		return (float)Sum.GetX();
+	});
+	const double ScalarMatrixRate = Time([&]() {
+		float Sum = 0.0f;
+		for (const ScalarMatrix& Next : ScalarMatrices)
+			Sum += Multiply(Next, Mat).Rows[0][0];
+		return Sum;
+	});
+
+	printf("Math backend %s: %.1f M transforms/s, %.1f M matrix products/s (scalar: %.1f M/s, %.1f M/s)\n",
+		GetBackendName(), VectorRate * 1e-6, MatrixRate * 1e-6, ScalarVectorRate * 1e-6, ScalarMatrixRate * 1e-6);
+}
+
+}	// anonymous namespace
+
+void RunMathBackendTests() {
+	TestBackendDefines();
+	TestAlignment();
+	TestProducts();
+	RunBenchmark(4096, 2000);
+}
+
+#ifdef STELLAR_TEST_STANDALONE
+int main() {
+	RunMathBackendTests();
+	printf("%d check(s) failed\n", StellarTest::FailureCount());
+	return StellarTest::FailureCount() == 0 ? 0 : 1;
+}
+#endif
@@ -0,0 +1,413 @@
+//
+// PipelineCache against a stand-in device: hit and miss accounting, the save/load round trip, key stability and the
+// handling of mismatched or damaged cache files. Needs no GPU.
+//
+
+#include "pch.h"
+#include "Graphics/PipelineCache.h"
+#include "TestCommon.h"
+#include <fstream>
+
+using namespace Graphics;
+using namespace std;
+
+namespace {
+
+const wchar_t* kCachePath = L"PipelineCacheTest.bin";
+const uint64_t kFingerprint = 0x5354454C4C4152ull;
+
+// Blob whose contents are the identity of the pipeline it was taken from.
+class FakeBlob : public ID3DBlob {
+public:
+	FakeBlob(uint64_t Identity) : m_RefCount(1), m_Identity(Identity) {}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID Riid, void** Object) override {
+		if (Riid != __uuidof(IUnknown) && Riid != __uuidof(ID3DBlob)) {
+			*Object = nullptr;
+			return E_NOINTERFACE;
+		}
+		AddRef();
+		*Object = this;
+		return S_OK;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++m_RefCount; }
+	ULONG STDMETHODCALLTYPE Release() override {
+		const ULONG RefCount = --m_RefCount;
+		if (RefCount == 0)
+			delete this;
+		return RefCount;
+	}
+
+	LPVOID STDMETHODCALLTYPE GetBufferPointer() override { return &m_Identity; }
+	SIZE_T STDMETHODCALLTYPE GetBufferSize() override { return sizeof(m_Identity); }
+
+private:
+	ULONG m_RefCount;
+	uint64_t m_Identity;
+};
+
+class FakePipelineState : public ID3D12PipelineState {
+public:
+	FakePipelineState(uint64_t Identity) : m_RefCount(1), m_Identity(Identity) {}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** Object) override {
+		*Object = nullptr;
+		return E_NOINTERFACE;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++m_RefCount; }
+	ULONG STDMETHODCALLTYPE Release() override {
+		const ULONG RefCount = --m_RefCount;
+		if (RefCount == 0)
+			delete this;
+		return RefCount;
+	}
+
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE SetName(LPCWSTR) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE GetDevice(REFIID, void** Device) override {
+		*Device = nullptr;
+		return E_NOTIMPL;
+	}
+
+	HRESULT STDMETHODCALLTYPE GetCachedBlob(ID3DBlob** Blob) override {
+		*Blob = new FakeBlob(m_Identity);
+		return S_OK;
+	}
+
+	uint64_t GetIdentity() const { return m_Identity; }
+
+private:
+	ULONG m_RefCount;
+	uint64_t m_Identity;
+};
+
+// Compiles by numbering the pipelines, and creates from a cached blob by reading the number back, so a hit can be
+// told apart from a compile and checked against the pipeline it was saved from.
+class FakeDevice : public PipelineStateDevice {
+public:
+	FakeDevice() : Compiles(0), RejectCachedBlobs(false), m_NextIdentity(1) {}
+
+	HRESULT CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PipelineState) override {
+		return Create(Desc.CachedPSO, PipelineState);
+	}
+
+	HRESULT CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** PipelineState) override {
+		return Create(Desc.CachedPSO, PipelineState);
+	}
+
+	HRESULT CreateRootSignature(const void*, size_t, ID3D12RootSignature** Signature) override {
+		*Signature = nullptr;
+		return E_NOTIMPL;
+	}
+
+	uint32_t Compiles;
+	bool RejectCachedBlobs;
+
+private:
+	HRESULT Create(const D3D12_CACHED_PIPELINE_STATE& CachedPSO, ID3D12PipelineState** PipelineState) {
+		*PipelineState = nullptr;
+		if (CachedPSO.pCachedBlob == nullptr) {
+			++Compiles;
+			*PipelineState = new FakePipelineState(m_NextIdentity++);
+			return S_OK;
+		}
+		if (RejectCachedBlobs || CachedPSO.CachedBlobSizeInBytes != sizeof(uint64_t))
+			return E_INVALIDARG;
+		*PipelineState = new FakePipelineState(*(const uint64_t*)CachedPSO.pCachedBlob);
+		return S_OK;
+	}
+
+	uint64_t m_NextIdentity;
+};
+
+const uint8_t kVertexShader[] = { 0x44, 0x58, 0x42, 0x43, 1, 2, 3, 4 };
+const uint8_t kPixelShader[] = { 0x44, 0x58, 0x42, 0x43, 5, 6, 7, 8 };
+const uint8_t kComputeShader[] = { 0x44, 0x58, 0x42, 0x43, 9, 10, 11, 12 };
+const D3D12_INPUT_ELEMENT_DESC kInputLayout[] = {
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+};
+
+D3D12_GRAPHICS_PIPELINE_STATE_DESC MakeGraphicsDesc() {
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = {};
+	Desc.VS = { kVertexShader, sizeof(kVertexShader) };
+	Desc.PS = { kPixelShader, sizeof(kPixelShader) };
+	Desc.InputLayout = { kInputLayout, _countof(kInputLayout) };
+	Desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	Desc.NumRenderTargets = 1;
+	Desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+	Desc.SampleDesc.Count = 1;
+	Desc.SampleMask = 0xFFFFFFFF;
+	return Desc;
+}
+
+D3D12_COMPUTE_PIPELINE_STATE_DESC MakeComputeDesc() {
+	D3D12_COMPUTE_PIPELINE_STATE_DESC Desc = {};
+	Desc.CS = { kComputeShader, sizeof(kComputeShader) };
+	return Desc;
+}
+
+uint64_t CreateAndRelease(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc) {
+	FakePipelineState* PipelineState = (FakePipelineState*)PipelineCache::CreateGraphicsPipelineState(Desc, 0);
+	const uint64_t Identity = PipelineState->GetIdentity();
+	PipelineState->Release();
+	return Identity;
+}
+
+uint64_t CreateAndRelease(const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc) {
+	FakePipelineState* PipelineState = (FakePipelineState*)PipelineCache::CreateComputePipelineState(Desc, 0);
+	const uint64_t Identity = PipelineState->GetIdentity();
+	PipelineState->Release();
+	return Identity;
+}
+
+void TestKeys() {
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC Base = MakeGraphicsDesc();
+	const uint64_t BaseKey = PipelineCache::GetGraphicsPipelineKey(Base, 0);
+
+	// Same contents behind different pointers.
+	vector<uint8_t> VertexShaderCopy(kVertexShader, kVertexShader + sizeof(kVertexShader));
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Moved = Base;
+	Moved.VS.pShaderBytecode = VertexShaderCopy.data();
+	TEST_CHECK(PipelineCache::GetGraphicsPipelineKey(Moved, 0) == BaseKey);
+
+	TEST_CHECK(PipelineCache::GetGraphicsPipelineKey(Base, 1) != BaseKey);
+
+	// Pipelines that differ only in their stream output.
+	const UINT Strides[] = { 16 };
+	const D3D12_SO_DECLARATION_ENTRY PositionEntry[] = { { 0, "POSITION", 0, 0, 4, 0 } };
+	const D3D12_SO_DECLARATION_ENTRY TexcoordEntry[] = { { 0, "TEXCOORD", 0, 0, 4, 0 } };
+	string PositionName = "POSITION";
+	const D3D12_SO_DECLARATION_ENTRY PositionEntryCopy[] = { { 0, PositionName.c_str(), 0, 0, 4, 0 } };
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Position = Base;
+	Position.StreamOutput = { PositionEntry, 1, Strides, 1, 0 };
+	const uint64_t PositionKey = PipelineCache::GetGraphicsPipelineKey(Position, 0);
+	TEST_CHECK(PositionKey != BaseKey);
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Texcoord = Position;
+	Texcoord.StreamOutput.pSODeclaration = TexcoordEntry;
+	TEST_CHECK(PipelineCache::GetGraphicsPipelineKey(Texcoord, 0) != PositionKey);
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC PositionCopy = Position;
+	PositionCopy.StreamOutput.pSODeclaration = PositionEntryCopy;
+	TEST_CHECK(PipelineCache::GetGraphicsPipelineKey(PositionCopy, 0) == PositionKey);
+
+	const UINT WideStrides[] = { 32 };
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Wide = Position;
+	Wide.StreamOutput.pBufferStrides = WideStrides;
+	TEST_CHECK(PipelineCache::GetGraphicsPipelineKey(Wide, 0) != PositionKey);
+}
+
+// Copies Source member by member into a description whose padding holds garbage, like one built on the stack.
+D3D12_GRAPHICS_PIPELINE_STATE_DESC CopyOverGarbage(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Source) {
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc;
+	memset(&Desc, 0xCD, sizeof(Desc));
+
+	Desc.pRootSignature = Source.pRootSignature;
+	Desc.VS = Source.VS;
+	Desc.PS = Source.PS;
+	Desc.DS = Source.DS;
+	Desc.HS = Source.HS;
+	Desc.GS = Source.GS;
+	Desc.StreamOutput.pSODeclaration = Source.StreamOutput.pSODeclaration;
+	Desc.StreamOutput.NumEntries = Source.StreamOutput.NumEntries;
+	Desc.StreamOutput.pBufferStrides = Source.StreamOutput.pBufferStrides;
+	Desc.StreamOutput.NumStrides = Source.StreamOutput.NumStrides;
+	Desc.StreamOutput.RasterizedStream = Source.StreamOutput.RasterizedStream;
+	Desc.BlendState.AlphaToCoverageEnable = Source.BlendState.AlphaToCoverageEnable;
+	Desc.BlendState.IndependentBlendEnable = Source.BlendState.IndependentBlendEnable;
+	for (uint32_t i = 0; i < 8; ++i) {
+		const D3D12_RENDER_TARGET_BLEND_DESC& From = Source.BlendState.RenderTarget[i];
+		D3D12_RENDER_TARGET_BLEND_DESC& To = Desc.BlendState.RenderTarget[i];
+		To.BlendEnable = From.BlendEnable;
+		To.LogicOpEnable = From.LogicOpEnable;
+		To.SrcBlend = From.SrcBlend;
+		To.DestBlend = From.DestBlend;
+		To.BlendOp = From.BlendOp;
+		To.SrcBlendAlpha = From.SrcBlendAlpha;
+		To.DestBlendAlpha = From.DestBlendAlpha;
+		To.BlendOpAlpha = From.BlendOpAlpha;
+		To.LogicOp = From.LogicOp;
+		To.RenderTargetWriteMask = From.RenderTargetWriteMask;
+	}
+	Desc.SampleMask = Source.SampleMask;
+	Desc.RasterizerState = Source.RasterizerState;
+	Desc.DepthStencilState.DepthEnable = Source.DepthStencilState.DepthEnable;
+	Desc.DepthStencilState.DepthWriteMask = Source.DepthStencilState.DepthWriteMask;
+	Desc.DepthStencilState.DepthFunc = Source.DepthStencilState.DepthFunc;
+	Desc.DepthStencilState.StencilEnable = Source.DepthStencilState.StencilEnable;
+	Desc.DepthStencilState.StencilReadMask = Source.DepthStencilState.StencilReadMask;
+	Desc.DepthStencilState.StencilWriteMask = Source.DepthStencilState.StencilWriteMask;
+	Desc.DepthStencilState.FrontFace = Source.DepthStencilState.FrontFace;
+	Desc.DepthStencilState.BackFace = Source.DepthStencilState.BackFace;
+	Desc.InputLayout.pInputElementDescs = Source.InputLayout.pInputElementDescs;
+	Desc.InputLayout.NumElements = Source.InputLayout.NumElements;
+	Desc.IBStripCutValue = Source.IBStripCutValue;
+	Desc.PrimitiveTopologyType = Source.PrimitiveTopologyType;
+	Desc.NumRenderTargets = Source.NumRenderTargets;
+	for (uint32_t i = 0; i < 8; ++i)
+		Desc.RTVFormats[i] = Source.RTVFormats[i];
+	Desc.DSVFormat = Source.DSVFormat;
+	Desc.SampleDesc = Source.SampleDesc;
+	Desc.NodeMask = Source.NodeMask;
+	Desc.CachedPSO.pCachedBlob = Source.CachedPSO.pCachedBlob;
+	Desc.CachedPSO.CachedBlobSizeInBytes = Source.CachedPSO.CachedBlobSizeInBytes;
+	Desc.Flags = Source.Flags;
+	return Desc;
+}
+
+// Descriptions that differ only in their padding, down to that of the input elements, share a key.
+void TestPaddingIgnored() {
+	const UINT Strides[] = { 16 };
+	const D3D12_SO_DECLARATION_ENTRY Entry[] = { { 0, "POSITION", 0, 0, 4, 0 } };
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Base = MakeGraphicsDesc();
+	Base.StreamOutput = { Entry, 1, Strides, 1, 0 };
+	Base.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+	Base.DepthStencilState.StencilReadMask = D3D12_DEFAULT_STENCIL_READ_MASK;
+	const uint64_t BaseKey = PipelineCache::GetGraphicsPipelineKey(Base, 0);
+
+	D3D12_INPUT_ELEMENT_DESC Element;
+	memset(&Element, 0xCD, sizeof(Element));
+	Element.SemanticName = kInputLayout[0].SemanticName;
+	Element.SemanticIndex = kInputLayout[0].SemanticIndex;
+	Element.Format = kInputLayout[0].Format;
+	Element.InputSlot = kInputLayout[0].InputSlot;
+	Element.AlignedByteOffset = kInputLayout[0].AlignedByteOffset;
+	Element.InputSlotClass = kInputLayout[0].InputSlotClass;
+	Element.InstanceDataStepRate = kInputLayout[0].InstanceDataStepRate;
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Dirty = CopyOverGarbage(Base);
+	Dirty.InputLayout.pInputElementDescs = &Element;
+	TEST_CHECK(PipelineCache::GetGraphicsPipelineKey(Dirty, 0) == BaseKey);
+
+	// A member next to the padding still counts.
+	Dirty.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_RED;
+	TEST_CHECK(PipelineCache::GetGraphicsPipelineKey(Dirty, 0) != BaseKey);
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC Compute;
+	memset(&Compute, 0xCD, sizeof(Compute));
+	Compute.pRootSignature = nullptr;
+	Compute.CS = MakeComputeDesc().CS;
+	Compute.NodeMask = 0;
+	Compute.CachedPSO.pCachedBlob = nullptr;
+	Compute.CachedPSO.CachedBlobSizeInBytes = 0;
+	Compute.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+	TEST_CHECK(PipelineCache::GetComputePipelineKey(Compute, 0) == PipelineCache::GetComputePipelineKey(MakeComputeDesc(), 0));
+}
+
+void TestHitsAndMisses(FakeDevice& Device) {
+	// Caching is off until Load, and a missing file starts it empty.
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC Graphics = MakeGraphicsDesc();
+	CreateAndRelease(Graphics);
+	TEST_CHECK(PipelineCache::GetStats().Misses == 0);
+
+	_wremove(kCachePath);
+	PipelineCache::Load(kCachePath, kFingerprint);
+	TEST_CHECK(PipelineCache::GetStats().LoadedEntries == 0);
+
+	const uint32_t CompilesBefore = Device.Compiles;
+	const uint64_t GraphicsIdentity = CreateAndRelease(Graphics);
+	TEST_CHECK(Device.Compiles == CompilesBefore + 1);
+	TEST_CHECK(CreateAndRelease(Graphics) == GraphicsIdentity);
+	TEST_CHECK(Device.Compiles == CompilesBefore + 1);
+
+	const uint64_t ComputeIdentity = CreateAndRelease(MakeComputeDesc());
+	TEST_CHECK(CreateAndRelease(MakeComputeDesc()) == ComputeIdentity);
+
+	PipelineCacheStats Stats = PipelineCache::GetStats();
+	TEST_CHECK(Stats.Hits == 2);
+	TEST_CHECK(Stats.Misses == 2);
+
+	// A blob the driver refuses is dropped and the pipeline compiled again.
+	Device.RejectCachedBlobs = true;
+	TEST_CHECK(CreateAndRelease(Graphics) != GraphicsIdentity);
+	Device.RejectCachedBlobs = false;
+	Stats = PipelineCache::GetStats();
+	TEST_CHECK(Stats.DiscardedEntries == 1);
+	TEST_CHECK(Stats.Misses == 3);
+}
+
+void TestSaveAndLoad(FakeDevice& Device) {
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC Graphics = MakeGraphicsDesc();
+	_wremove(kCachePath);
+	PipelineCache::Load(kCachePath, kFingerprint);
+	const uint64_t GraphicsIdentity = CreateAndRelease(Graphics);
+	const uint64_t ComputeIdentity = CreateAndRelease(MakeComputeDesc());
+	TEST_CHECK(PipelineCache::Save(kCachePath));
+
+	// The next launch creates both from the file without compiling.
+	PipelineCache::Clear();
+	PipelineCache::Load(kCachePath, kFingerprint);
+	TEST_CHECK(PipelineCache::GetStats().LoadedEntries == 2);
+	const uint32_t CompilesBefore = Device.Compiles;
+	TEST_CHECK(CreateAndRelease(Graphics) == GraphicsIdentity);
+	TEST_CHECK(CreateAndRelease(MakeComputeDesc()) == ComputeIdentity);
+	TEST_CHECK(Device.Compiles == CompilesBefore);
+	TEST_CHECK(PipelineCache::GetStats().Hits == 2);
+
+	// A different adapter or driver discards the whole file.
+	PipelineCache::Load(kCachePath, kFingerprint + 1);
+	PipelineCacheStats Stats = PipelineCache::GetStats();
+	TEST_CHECK(Stats.LoadedEntries == 0);
+	TEST_CHECK(Stats.DiscardedEntries == 2);
+	CreateAndRelease(Graphics);
+	TEST_CHECK(Device.Compiles == CompilesBefore + 1);
+}
+
+void TestDamagedFile() {
+	_wremove(kCachePath);
+	PipelineCache::Load(kCachePath, kFingerprint);
+	CreateAndRelease(MakeGraphicsDesc());
+	TEST_CHECK(PipelineCache::Save(kCachePath));
+
+	// Claim four billion entries. Only the one actually in the file is read, without reserving for the rest.
+	{
+		fstream File(kCachePath, ios::in | ios::out | ios::binary);
+		const uint32_t EntryCount = 0xFFFFFFFF;
+		File.seekp(16);
+		File.write((const char*)&EntryCount, sizeof(EntryCount));
+	}
+	PipelineCache::Load(kCachePath, kFingerprint);
+	TEST_CHECK(PipelineCache::GetStats().LoadedEntries == 1);
+
+	// Flip a byte of the blob; the checksum rejects the entry.
+	{
+		fstream File(kCachePath, ios::in | ios::out | ios::binary | ios::ate);
+		const streamoff Size = File.tellg();
+		File.seekg(Size - 8);
+		char Byte;
+		File.read(&Byte, 1);
+		Byte ^= 0xFF;
+		File.seekp(Size - 8);
+		File.write(&Byte, 1);
+	}
+	PipelineCache::Load(kCachePath, kFingerprint);
+	TEST_CHECK(PipelineCache::GetStats().LoadedEntries == 0);
+
+	// Shorter than the header.
+	{
+		ofstream File(kCachePath, ios::out | ios::binary | ios::trunc);
+		File.write("SPSC", 4);
+	}
+	PipelineCache::Load(kCachePath, kFingerprint);
+	TEST_CHECK(PipelineCache::GetStats().LoadedEntries == 0);
+}
+
+}	// anonymous namespace
+
+void RunPipelineCacheTests() {
+	FakeDevice Device;
+	PipelineCache::SetDevice(&Device);
+
+	TestKeys();
+	TestPaddingIgnored();
+	TestHitsAndMisses(Device);
+	TestSaveAndLoad(Device);
+	TestDamagedFile();
+
+	PipelineCache::Clear();
+	PipelineCache::SetDevice(nullptr);
+	_wremove(kCachePath);
+}
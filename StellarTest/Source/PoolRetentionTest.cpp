@@ -0,0 +1,97 @@
+//
+// PoolHighWaterMark: how the mark decays and how much of a pool it releases, sample by sample.
+// Builds without the engine: g++ -std=c++14 -DSTELLAR_TEST_STANDALONE -I../../Core/Source PoolRetentionTest.cpp
+//
+
+#include "Graphics/PoolRetention.h"
+#include "TestCommon.h"
+
+using namespace Graphics;
+
+namespace {
+
+bool IsNear(float a, float b) {
+	return std::fabs(a - b) <= 1e-4f * std::max(1.0f, std::fabs(b));
+}
+
+void TestDecay() {
+	// Halves every half-life, and never drops below the current use.
+	TEST_CHECK(IsNear(PoolHighWaterMark::DecayHighWaterMark(100.0f, 0.0, 10.0f, 0), 100.0f));
+	TEST_CHECK(IsNear(PoolHighWaterMark::DecayHighWaterMark(100.0f, 10.0, 10.0f, 0), 50.0f));
+	TEST_CHECK(IsNear(PoolHighWaterMark::DecayHighWaterMark(100.0f, 20.0, 10.0f, 0), 25.0f));
+	TEST_CHECK(IsNear(PoolHighWaterMark::DecayHighWaterMark(100.0f, 10.0, 10.0f, 60), 60.0f));
+
+	// A higher use raises it at once.
+	TEST_CHECK(IsNear(PoolHighWaterMark::DecayHighWaterMark(10.0f, 0.5, 10.0f, 80), 80.0f));
+
+	// Sampling more often decays the same in total.
+	float Mark = 100.0f;
+	for (int i = 0; i < 20; ++i)
+		Mark = PoolHighWaterMark::DecayHighWaterMark(Mark, 0.5, 10.0f, 0);
+	TEST_CHECK(IsNear(Mark, 50.0f));
+}
+
+void TestReleaseCount() {
+	PoolRetentionPolicy Policy;
+	Policy.Headroom = 0.25f;
+	Policy.MinRetained = 4;
+
+	// A mark of 40 keeps 50 with the headroom.
+	TEST_CHECK(PoolHighWaterMark::GetReleaseCount(Policy, 40.0f, 10, 80) == 30);
+	TEST_CHECK(PoolHighWaterMark::GetReleaseCount(Policy, 40.0f, 10, 50) == 0);
+	TEST_CHECK(PoolHighWaterMark::GetReleaseCount(Policy, 40.0f, 10, 20) == 0);
+
+	// Partial objects of headroom round up.
+	TEST_CHECK(PoolHighWaterMark::GetReleaseCount(Policy, 41.0f, 0, 80) == 28);
+
+	// Never below the minimum, and never what is in use.
+	TEST_CHECK(PoolHighWaterMark::GetReleaseCount(Policy, 0.0f, 0, 10) == 6);
+	TEST_CHECK(PoolHighWaterMark::GetReleaseCount(Policy, 0.0f, 0, 3) == 0);
+	TEST_CHECK(PoolHighWaterMark::GetReleaseCount(Policy, 10.0f, 20, 30) == 10);
+	TEST_CHECK(PoolHighWaterMark::GetReleaseCount(Policy, 10.0f, 30, 30) == 0);
+}
+
+// One spike to 100, then a steady use of 10, sampled every half second like the page pools do.
+void TestSpikeIsForgotten() {
+	PoolRetentionPolicy Policy;
+	Policy.SampleSeconds = 0.5f;
+	Policy.HalfLifeSeconds = 10.0f;
+	Policy.Headroom = 0.25f;
+	Policy.MinRetained = 4;
+
+	const uint32_t InUse = 10;
+	float Mark = 100.0f;
+	uint32_t Pooled = 100;
+	bool Shrinking = true;
+	for (int Sample = 1; Sample <= 120; ++Sample) {
+		Mark = PoolHighWaterMark::DecayHighWaterMark(Mark, Policy.SampleSeconds, Policy.HalfLifeSeconds, InUse);
+		const uint32_t Release = PoolHighWaterMark::GetReleaseCount(Policy, Mark, InUse, Pooled);
+		Shrinking = Shrinking && Release <= Pooled - InUse;
+		Pooled -= Release;
+
+		// After one half-life, half the spike and its headroom are kept.
+		if (Sample == 20)
+			TEST_CHECK(Pooled == 63);
+	}
+
+	// A minute later the spike is gone: the steady use and its headroom remain.
+	TEST_CHECK(Shrinking);
+	TEST_CHECK(IsNear(Mark, 10.0f));
+	TEST_CHECK(Pooled == 13);
+}
+
+}	// anonymous namespace
+
+void RunPoolRetentionTests() {
+	TestDecay();
+	TestReleaseCount();
+	TestSpikeIsForgotten();
+}
+
+#ifdef STELLAR_TEST_STANDALONE
+int main() {
+	RunPoolRetentionTests();
+	printf("%d check(s) failed\n", StellarTest::FailureCount());
+	return StellarTest::FailureCount() == 0 ? 0 : 1;
+}
+#endif
@@ -0,0 +1,96 @@
+//
+// Sampler cache on the WARP device: deduplication, stable indices, and what happens once every slot of the shader
+// visible sampler heap is taken. Skipped when no D3D12 device can be created.
+//
+
+#include "pch.h"
+#include "Graphics/DescriptorHeap.h"
+#include "Graphics/SamplerManager.h"
+#include "TestCommon.h"
+#include <dxgi1_4.h>
+
+using namespace Graphics;
+using Microsoft::WRL::ComPtr;
+
+namespace Graphics {
+extern ID3D12Device* g_Device;
+}
+
+namespace {
+
+ComPtr<ID3D12Device> CreateWarpDevice() {
+	ComPtr<IDXGIFactory4> Factory;
+	ComPtr<IDXGIAdapter> Adapter;
+	ComPtr<ID3D12Device> Device;
+	if (FAILED(CreateDXGIFactory1(MY_IID_PPV_ARGS(&Factory))) || FAILED(Factory->EnumWarpAdapter(MY_IID_PPV_ARGS(&Adapter))))
+		return nullptr;
+	if (FAILED(D3D12CreateDevice(Adapter.Get(), D3D_FEATURE_LEVEL_11_0, MY_IID_PPV_ARGS(&Device))))
+		return nullptr;
+	return Device;
+}
+
+// A distinct description per Seed.
+SamplerDesc MakeSampler(uint32_t Seed) {
+	SamplerDesc Desc;
+	Desc.MipLODBias = (float)Seed;
+	return Desc;
+}
+
+void TestUserDescriptorHeap() {
+	UserDescriptorHeap Heap(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 4);
+	Heap.Create(L"UserDescriptorHeap Test");
+
+	TEST_CHECK(Heap.HasAvailableSpace(4));
+	const DescriptorHandle First = Heap.Alloc(3);
+	TEST_CHECK(Heap.ValidateHandle(First));
+	TEST_CHECK(Heap.HasAvailableSpace(1) && !Heap.HasAvailableSpace(2));
+	Heap.Alloc(1);
+	TEST_CHECK(!Heap.HasAvailableSpace(1));
+}
+
+void TestFillIndexSpace() {
+	SamplerDesc::DestroyAll();
+
+	// Every slot gets the next index, and asking again hits the cache.
+	uint32_t Misplaced = 0;
+	for (uint32_t i = 0; i < D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE; ++i) {
+		if (MakeSampler(i).GetIndex() != i)
+			++Misplaced;
+	}
+	TEST_CHECK(Misplaced == 0);
+	TEST_CHECK(MakeSampler(7).GetIndex() == 7);
+
+	// Past the end there is no slot, but the CPU descriptor still works and the old indices stay put.
+	SamplerDesc Extra = MakeSampler(D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE);
+	TEST_CHECK(Extra.GetIndex() == SamplerDesc::kInvalidIndex);
+	TEST_CHECK(Extra.CreateDescriptor().ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
+	TEST_CHECK(MakeSampler(D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE - 1).GetIndex() ==
+		D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE - 1);
+
+	const SamplerCacheStats Stats = SamplerDesc::GetCacheStats();
+	TEST_CHECK(Stats.UniqueSamplers == D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE + 1);
+	TEST_CHECK(Stats.Overflows == 1);
+	TEST_CHECK(Stats.Misses == D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE + 1);
+
+	// Starting over frees every slot.
+	SamplerDesc::DestroyAll();
+	TEST_CHECK(MakeSampler(D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE).GetIndex() == 0);
+	SamplerDesc::DestroyAll();
+}
+
+}	// anonymous namespace
+
+void RunSamplerManagerTests() {
+	ComPtr<ID3D12Device> Device = CreateWarpDevice();
+	if (Device == nullptr) {
+		printf("SamplerManager tests skipped: no D3D12 device\n");
+		return;
+	}
+
+	ID3D12Device* PreviousDevice = g_Device;
+	g_Device = Device.Get();
+	TestUserDescriptorHeap();
+	TestFillIndexSpace();
+	DescriptorAllocator::DestroyAll();
+	g_Device = PreviousDevice;
+}
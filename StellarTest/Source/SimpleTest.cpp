@@ -1,10 +1,42 @@
 #include "Graphics/Color.h"
+#include "TestCommon.h"
 
 using namespace Graphics;
 
-void main()
+void RunBoundingVolumeHierarchyTests();
+void RunColorPackingTests();
+void RunCompactTransformTests();
+void RunConcurrentStackTests();
+void RunHashTests();
+void RunMathBackendTests();
+void RunPipelineCacheTests();
+void RunPoolRetentionTests();
+void RunSamplerManagerTests();
+void RunSphericalHarmonicsTests();
+void RunSweepAndPruneTests();
+void RunTLSFAllocatorTests();
+void RunTransformHierarchyTests();
+
+int main()
 {
 	Color a(0.5f, 0.5f, 0.5f);
 	auto b = a.R11G11B10F(false);
 	auto c = b;
+
+	RunBoundingVolumeHierarchyTests();
+	RunColorPackingTests();
+	RunCompactTransformTests();
+	RunConcurrentStackTests();
+	RunHashTests();
+	RunMathBackendTests();
+	RunPipelineCacheTests();
+	RunPoolRetentionTests();
+	RunSamplerManagerTests();
+	RunSphericalHarmonicsTests();
+	RunSweepAndPruneTests();
+	RunTLSFAllocatorTests();
+	RunTransformHierarchyTests();
+
+	printf("%d check(s) failed\n", StellarTest::FailureCount());
+	return StellarTest::FailureCount() == 0 ? 0 : 1;
 }
\ No newline at end of file
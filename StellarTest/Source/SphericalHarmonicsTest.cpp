@@ -0,0 +1,243 @@
+//
+// SphericalHarmonics: cubemap projection against a texel by texel reference, functions within the L2 bands coming back
+// out of Evaluate, rotation, and half float input, then projection throughput against the reference.
+//
+
+#include "pch.h"
+#include "Math/SphericalHarmonics.h"
+#include "Math/CubemapLayout.h"
+#include "TestCommon.h"
+#include <DirectXPackedVector.h>
+#include <chrono>
+#include <functional>
+#include <random>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+using namespace Math;
+using namespace std;
+
+namespace {
+
+typedef function<XMFLOAT4(float x, float y, float z)> RadianceFunc;
+
+// A function within the first three bands, so the projection reproduces it up to the discretization.
+XMFLOAT4 BandLimited(float x, float y, float z) {
+	return XMFLOAT4(1.0f + 0.5f * x, 0.3f + y * z, 2.0f * z * z, 1.0f);
+}
+
+class TestCubemap {
+public:
+	TestCubemap(uint32_t Size, const RadianceFunc& Radiance) : m_Size(Size) {
+		for (uint32_t Face = 0; Face < 6; ++Face) {
+			const CubemapFaceBasis& Basis = kCubemapFaces[Face];
+			m_Texels[Face].resize(Size * Size);
+			m_HalfTexels[Face].resize(Size * Size * 4);
+			for (uint32_t Row = 0; Row < Size; ++Row) {
+				for (uint32_t Column = 0; Column < Size; ++Column) {
+					float d[3];
+					GetDirection(Basis, Row, Column, d);
+					const XMFLOAT4 Value = Radiance(d[0], d[1], d[2]);
+					m_Texels[Face][Row * Size + Column] = Value;
+					for (uint32_t c = 0; c < 4; ++c)
+						m_HalfTexels[Face][(Row * Size + Column) * 4 + c] = XMConvertFloatToHalf((&Value.x)[c]);
+				}
+			}
+		}
+	}
+
+	CubemapData GetData(CubemapTexelFormat Format) const {
+		CubemapData Data;
+		for (uint32_t Face = 0; Face < 6; ++Face) {
+			Data.Faces[Face] = Format == CubemapTexelFormat::kRGBA32F ? (const void*)m_Texels[Face].data() :
+				(const void*)m_HalfTexels[Face].data();
+		}
+		Data.Size = m_Size;
+		Data.RowPitch = m_Size * (Format == CubemapTexelFormat::kRGBA32F ? sizeof(XMFLOAT4) : 4 * sizeof(HALF));
+		Data.Format = Format;
+		return Data;
+	}
+
+	// Normalized direction of a texel center, and the solid angle weight the projection gives it.
+	float GetDirection(const CubemapFaceBasis& Basis, uint32_t Row, uint32_t Column, float d[3]) const {
+		const float s = (Column + 0.5f) * 2.0f / m_Size - 1.0f;
+		const float t = (Row + 0.5f) * 2.0f / m_Size - 1.0f;
+		float Length = 0.0f;
+		for (int k = 0; k < 3; ++k) {
+			d[k] = s * Basis.S[k] + t * Basis.T[k] + Basis.N[k];
+			Length += d[k] * d[k];
+		}
+		Length = sqrt(Length);
+		for (int k = 0; k < 3; ++k)
+			d[k] /= Length;
+		return 1.0f / (Length * Length * Length);
+	}
+
+	// One texel at a time, in double precision.
+	SHCoefficients ProjectReference() const {
+		double Sum[SHCoefficients::kCoefficientCount][3] = {};
+		double Weight = 0.0;
+		for (uint32_t Face = 0; Face < 6; ++Face) {
+			for (uint32_t Row = 0; Row < m_Size; ++Row) {
+				for (uint32_t Column = 0; Column < m_Size; ++Column) {
+					float d[3], Basis[SHCoefficients::kCoefficientCount];
+					const float w = GetDirection(kCubemapFaces[Face], Row, Column, d);
+					SHCoefficients::EvaluateBasis(Vector3(d[0], d[1], d[2]), Basis);
+					const XMFLOAT4& Value = m_Texels[Face][Row * m_Size + Column];
+					for (uint32_t i = 0; i < SHCoefficients::kCoefficientCount; ++i) {
+						Sum[i][0] += (double)w * Basis[i] * Value.x;
+						Sum[i][1] += (double)w * Basis[i] * Value.y;
+						Sum[i][2] += (double)w * Basis[i] * Value.z;
+					}
+					Weight += w;
+				}
+			}
+		}
+
+		SHCoefficients Result;
+		const double Scale = 4.0 * XM_PI / Weight;
+		for (uint32_t i = 0; i < SHCoefficients::kCoefficientCount; ++i)
+			Result[i] = Vector3(float(Sum[i][0] * Scale), float(Sum[i][1] * Scale), float(Sum[i][2] * Scale));
+		return Result;
+	}
+
+private:
+	uint32_t m_Size;
+	vector<XMFLOAT4> m_Texels[6];
+	vector<HALF> m_HalfTexels[6];
+};
+
+float MaxDifference(Vector3 a, Vector3 b) {
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, Abs(a - b));
+	return max(d.x, max(d.y, d.z));
+}
+
+float MaxDifference(const SHCoefficients& a, const SHCoefficients& b) {
+	float Result = 0.0f;
+	for (uint32_t i = 0; i < SHCoefficients::kCoefficientCount; ++i)
+		Result = max(Result, MaxDifference(a[i], b[i]));
+	return Result;
+}
+
+vector<Vector3> RandomDirections(uint32_t Count, uint32_t Seed) {
+	mt19937 Random(Seed);
+	normal_distribution<float> Normal;
+	vector<Vector3> Directions(Count);
+	for (Vector3& Direction : Directions)
+		Direction = Normalize(Vector3(Normal(Random), Normal(Random), Normal(Random)));
+	return Directions;
+}
+
+void TestProjection() {
+	// Sizes that fill whole groups of four and ones that leave a partial group.
+	const uint32_t Sizes[] = { 16, 17, 30 };
+	for (uint32_t Size : Sizes) {
+		const TestCubemap Cubemap(Size, BandLimited);
+		const SHCoefficients Projected = ProjectCubemap(Cubemap.GetData(CubemapTexelFormat::kRGBA32F));
+		TEST_CHECK(MaxDifference(Projected, Cubemap.ProjectReference()) < 1e-4f);
+	}
+
+	// A constant keeps only the first coefficient, 4 pi * Y0.
+	const TestCubemap White(8, [](float, float, float) { return XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f); });
+	const SHCoefficients Constant = ProjectCubemap(White.GetData(CubemapTexelFormat::kRGBA32F));
+	TEST_CHECK(MaxDifference(Constant[0], Vector3(3.5449077f, 3.5449077f, 3.5449077f)) < 1e-4f);
+	for (uint32_t i = 1; i < SHCoefficients::kCoefficientCount; ++i)
+		TEST_CHECK(MaxDifference(Constant[i], Vector3(EZeroTag::kZero)) < 1e-4f);
+}
+
+void TestEvaluate() {
+	const TestCubemap Cubemap(64, BandLimited);
+	const SHCoefficients Projected = ProjectCubemap(Cubemap.GetData(CubemapTexelFormat::kRGBA32F));
+
+	float Worst = 0.0f;
+	for (Vector3 Direction : RandomDirections(1000, 33)) {
+		XMFLOAT3 d;
+		XMStoreFloat3(&d, Direction);
+		const XMFLOAT4 Expected = BandLimited(d.x, d.y, d.z);
+		Worst = max(Worst, MaxDifference(Projected.Evaluate(Direction), Vector3(Expected.x, Expected.y, Expected.z)));
+	}
+	TEST_CHECK(Worst < 0.01f);
+
+	// Half float texels lose about three decimal digits.
+	const SHCoefficients FromHalf = ProjectCubemap(Cubemap.GetData(CubemapTexelFormat::kRGBA16F));
+	TEST_CHECK(MaxDifference(FromHalf, Projected) < 5e-3f);
+
+	// Several probes at once match one at a time.
+	const TestCubemap Other(20, [](float x, float, float) { return XMFLOAT4(x * x, 0.0f, 1.0f, 1.0f); });
+	const CubemapData Probes[2] = { Cubemap.GetData(CubemapTexelFormat::kRGBA32F), Other.GetData(CubemapTexelFormat::kRGBA32F) };
+	SHCoefficients Batch[2];
+	ProjectCubemaps(Probes, 2, Batch);
+	TEST_CHECK(MaxDifference(Batch[0], Projected) == 0.0f);
+	TEST_CHECK(MaxDifference(Batch[1], ProjectCubemap(Probes[1])) == 0.0f);
+
+	// Irradiance of a constant radiance of 1 is pi in every direction.
+	SHCoefficients Constant;
+	Constant[0] = Vector3(3.5449077f, 3.5449077f, 3.5449077f);
+	TEST_CHECK(MaxDifference(Constant.EvaluateIrradiance(Vector3(0.0f, 1.0f, 0.0f)), Vector3(XM_PI, XM_PI, XM_PI)) < 1e-4f);
+}
+
+void TestRotate() {
+	const TestCubemap Cubemap(32, BandLimited);
+	const SHCoefficients Projected = ProjectCubemap(Cubemap.GetData(CubemapTexelFormat::kRGBA32F));
+
+	mt19937 Random(34);
+	normal_distribution<float> Normal;
+	float Worst = 0.0f;
+	for (uint32_t i = 0; i < 20; ++i) {
+		const Quaternion q = Normalize(Quaternion(XMVectorSet(Normal(Random), Normal(Random), Normal(Random), Normal(Random))));
+		const Matrix3 Rotation(q);
+		const SHCoefficients Rotated = Projected.Rotate(Rotation);
+		for (Vector3 Direction : RandomDirections(50, 35 + i))
+			Worst = max(Worst, MaxDifference(Rotated.Evaluate(Rotation * Direction), Projected.Evaluate(Direction)));
+	}
+	TEST_CHECK(Worst < 1e-3f);
+}
+
+double Seconds(chrono::steady_clock::time_point Start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+}
+
+// Texels projected per second for one large probe (its six faces in parallel), for a batch of small probes, and for
+// the texel by texel reference on one thread.
+void RunBenchmark() {
+	const TestCubemap Large(256, BandLimited);
+	const CubemapData LargeData = Large.GetData(CubemapTexelFormat::kRGBA32F);
+	const double LargeTexels = 6.0 * 256 * 256;
+
+	auto Start = chrono::steady_clock::now();
+	const uint32_t Passes = 20;
+	for (uint32_t Pass = 0; Pass < Passes; ++Pass)
+		ProjectCubemap(LargeData);
+	const double LargeRate = LargeTexels * Passes / Seconds(Start);
+
+	Start = chrono::steady_clock::now();
+	for (uint32_t Pass = 0; Pass < Passes; ++Pass)
+		ProjectCubemap(Large.GetData(CubemapTexelFormat::kRGBA16F));
+	const double HalfRate = LargeTexels * Passes / Seconds(Start);
+
+	const TestCubemap Small(32, BandLimited);
+	const uint32_t ProbeCount = 256;
+	vector<CubemapData> Probes(ProbeCount, Small.GetData(CubemapTexelFormat::kRGBA32F));
+	vector<SHCoefficients> Baked(ProbeCount);
+	Start = chrono::steady_clock::now();
+	ProjectCubemaps(Probes.data(), ProbeCount, Baked.data());
+	const double BatchRate = 6.0 * 32 * 32 * ProbeCount / Seconds(Start);
+
+	Start = chrono::steady_clock::now();
+	Large.ProjectReference();
+	const double ReferenceRate = LargeTexels / Seconds(Start);
+
+	printf("SH projection: %.1f M texels/s for a 256 probe (%.1f M/s from half floats), %.1f M texels/s for %u 32 probes "
+		"(reference: %.1f M texels/s)\n", LargeRate * 1e-6, HalfRate * 1e-6, BatchRate * 1e-6, ProbeCount,
+		ReferenceRate * 1e-6);
+}
+
+}	// anonymous namespace
+
+void RunSphericalHarmonicsTests() {
+	TestProjection();
+	TestEvaluate();
+	TestRotate();
+	RunBenchmark();
+}
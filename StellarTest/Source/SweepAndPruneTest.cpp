@@ -0,0 +1,236 @@
+//
+// SweepAndPrune: pairs, and the pairs added and removed, checked against testing every two proxies while boxes move,
+// appear and disappear, then the cost of an update for 10k and 100k proxies in coherent and incoherent motion.
+//
+
+#include "pch.h"
+#include "Math/SweepAndPrune.h"
+#include "TestCommon.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <random>
+
+using namespace Math;
+using namespace std;
+
+namespace {
+
+struct Box {
+	float Min[3];
+	float Max[3];
+
+	BoundingBox ToBoundingBox() const {
+		return BoundingBox(Vector3(Min[0], Min[1], Min[2]), Vector3(Max[0], Max[1], Max[2]));
+	}
+};
+
+// Boxes of half size up to 0.5 in a cube sized for a few overlaps per box.
+class World {
+public:
+	World(uint32_t Seed, uint32_t Count) : m_Random(Seed), m_Size(1.5f * cbrt((float)Count)) {}
+
+	Box MakeBox() {
+		uniform_real_distribution<float> Center(0.0f, m_Size);
+		uniform_real_distribution<float> HalfSize(0.1f, 0.5f);
+		Box Result;
+		for (int Axis = 0; Axis < 3; ++Axis) {
+			const float c = Center(m_Random), h = HalfSize(m_Random);
+			Result.Min[Axis] = c - h;
+			Result.Max[Axis] = c + h;
+		}
+		return Result;
+	}
+
+	void Move(Box& Moved, float Distance) {
+		uniform_real_distribution<float> Offset(-Distance, Distance);
+		for (int Axis = 0; Axis < 3; ++Axis) {
+			const float d = Offset(m_Random);
+			Moved.Min[Axis] += d;
+			Moved.Max[Axis] += d;
+		}
+	}
+
+	mt19937& GetRandom() { return m_Random; }
+
+private:
+	mt19937 m_Random;
+	float m_Size;
+};
+
+bool Overlaps(const Box& a, const Box& b) {
+	for (int Axis = 0; Axis < 3; ++Axis) {
+		if (a.Min[Axis] > b.Max[Axis] || b.Min[Axis] > a.Max[Axis])
+			return false;
+	}
+	return true;
+}
+
+vector<OverlapPair> FindEveryPair(const map<uint32_t, Box>& Boxes) {
+	vector<OverlapPair> Pairs;
+	for (auto a = Boxes.begin(); a != Boxes.end(); ++a) {
+		for (auto b = next(a); b != Boxes.end(); ++b) {
+			if (Overlaps(a->second, b->second)) {
+				const OverlapPair Pair = { a->first, b->first };
+				Pairs.push_back(Pair);
+			}
+		}
+	}
+	return Pairs;
+}
+
+// The pairs match testing every two proxies, and the added and removed pairs are what changed since Previous.
+bool CheckPairs(const SweepAndPrune& Broadphase, const map<uint32_t, Box>& Boxes, const vector<OverlapPair>& Previous) {
+	const vector<OverlapPair> Expected = FindEveryPair(Boxes);
+	vector<OverlapPair> Added, Removed;
+	set_difference(Expected.begin(), Expected.end(), Previous.begin(), Previous.end(), back_inserter(Added));
+	set_difference(Previous.begin(), Previous.end(), Expected.begin(), Expected.end(), back_inserter(Removed));
+	return Broadphase.GetPairs() == Expected && Broadphase.GetAddedPairs() == Added && Broadphase.GetRemovedPairs() == Removed;
+}
+
+void TestMotion(float Distance, uint32_t Frames) {
+	World Scene(30, 500);
+	SweepAndPrune Broadphase;
+	map<uint32_t, Box> Boxes;
+	for (uint32_t i = 0; i < 500; ++i) {
+		const Box Added = Scene.MakeBox();
+		Boxes[Broadphase.AddProxy(Added.ToBoundingBox())] = Added;
+	}
+	Broadphase.UpdatePairs();
+	TEST_CHECK(Broadphase.UsedFullSort());
+	TEST_CHECK(CheckPairs(Broadphase, Boxes, vector<OverlapPair>()));
+	TEST_CHECK(!Broadphase.GetPairs().empty());
+
+	uint32_t Mismatches = 0, FullSorts = 0;
+	for (uint32_t Frame = 0; Frame < Frames; ++Frame) {
+		const vector<OverlapPair> Previous = Broadphase.GetPairs();
+		for (auto& Proxy : Boxes) {
+			Scene.Move(Proxy.second, Distance);
+			Broadphase.UpdateProxy(Proxy.first, Proxy.second.ToBoundingBox());
+		}
+
+		// Some boxes leave and others arrive, reusing their IDs.
+		for (uint32_t i = 0; i < 5; ++i) {
+			auto Removed = Boxes.begin();
+			advance(Removed, Scene.GetRandom()() % Boxes.size());
+			Broadphase.RemoveProxy(Removed->first);
+			Boxes.erase(Removed);
+		}
+		Broadphase.UpdatePairs();
+		if (!CheckPairs(Broadphase, Boxes, Previous))
+			++Mismatches;
+		if (Broadphase.UsedFullSort())
+			++FullSorts;
+
+		const vector<OverlapPair> BeforeAdding = Broadphase.GetPairs();
+		for (uint32_t i = 0; i < 5; ++i) {
+			const Box Added = Scene.MakeBox();
+			Boxes[Broadphase.AddProxy(Added.ToBoundingBox())] = Added;
+		}
+		Broadphase.UpdatePairs();
+		if (!CheckPairs(Broadphase, Boxes, BeforeAdding))
+			++Mismatches;
+	}
+	TEST_CHECK(Mismatches == 0);
+	TEST_CHECK(Broadphase.GetProxyCount() == Boxes.size());
+
+	// Small steps stay on the insertion sort, large ones make it fall back to sorting everything.
+	if (Distance < 0.1f)
+		TEST_CHECK(FullSorts == 0);
+	else
+		TEST_CHECK(FullSorts > 0);
+}
+
+void TestEdgeCases() {
+	SweepAndPrune Broadphase;
+	Broadphase.UpdatePairs();
+	TEST_CHECK(Broadphase.GetPairs().empty() && Broadphase.GetProxyCount() == 0);
+
+	// Touching faces overlap, and a sphere is tested by its box.
+	const SweepAndPrune::ProxyID a = Broadphase.AddProxy(BoundingBox(Vector3(0.0f, 0.0f, 0.0f), Vector3(1.0f, 1.0f, 1.0f)));
+	const SweepAndPrune::ProxyID b = Broadphase.AddProxy(BoundingBox(Vector3(1.0f, 0.0f, 0.0f), Vector3(2.0f, 1.0f, 1.0f)));
+	const SweepAndPrune::ProxyID c = Broadphase.AddProxy(BoundingSphere(Vector3(3.0f, 0.5f, 0.5f), 0.5f));
+	Broadphase.UpdatePairs();
+	TEST_CHECK(Broadphase.GetPairs().size() == 1 && Broadphase.GetPairs()[0].A == a && Broadphase.GetPairs()[0].B == b);
+
+	Broadphase.UpdateProxy(c, BoundingSphere(Vector3(2.4f, 0.5f, 0.5f), 0.5f));
+	Broadphase.UpdatePairs();
+	TEST_CHECK(Broadphase.GetAddedPairs().size() == 1 && Broadphase.GetAddedPairs()[0].A == b && Broadphase.GetAddedPairs()[0].B == c);
+	TEST_CHECK(Broadphase.GetPairs().size() == 2 && Broadphase.GetRemovedPairs().empty());
+
+	// Removing a proxy removes its pairs, and the ID comes back for the next proxy.
+	Broadphase.RemoveProxy(b);
+	Broadphase.UpdatePairs();
+	TEST_CHECK(Broadphase.GetPairs().empty() && Broadphase.GetRemovedPairs().size() == 2);
+	TEST_CHECK(Broadphase.AddProxy(BoundingBox(Vector3(5.0f, 5.0f, 5.0f), Vector3(6.0f, 6.0f, 6.0f))) == b);
+}
+
+double Milliseconds(chrono::steady_clock::time_point Start) {
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - Start).count();
+}
+
+// The first update, then the average update while every box moves a little (coherent) or a lot (incoherent) per
+// frame. At 10k proxies, testing every two proxies is timed for comparison.
+void RunBenchmark(uint32_t Count, uint32_t Frames) {
+	World Scene(31, Count);
+	SweepAndPrune Broadphase;
+	vector<Box> Boxes(Count);
+	vector<SweepAndPrune::ProxyID> Proxies(Count);
+	for (uint32_t i = 0; i < Count; ++i) {
+		Boxes[i] = Scene.MakeBox();
+		Proxies[i] = Broadphase.AddProxy(Boxes[i].ToBoundingBox());
+	}
+
+	auto Start = chrono::steady_clock::now();
+	Broadphase.UpdatePairs();
+	const double FirstUpdate = Milliseconds(Start);
+	const size_t PairCount = Broadphase.GetPairs().size();
+
+	auto TimeFrames = [&](float Distance, uint32_t& FullSorts) {
+		double Total = 0.0;
+		FullSorts = 0;
+		for (uint32_t Frame = 0; Frame < Frames; ++Frame) {
+			for (uint32_t i = 0; i < Count; ++i) {
+				Scene.Move(Boxes[i], Distance);
+				Broadphase.UpdateProxy(Proxies[i], Boxes[i].ToBoundingBox());
+			}
+			Start = chrono::steady_clock::now();
+			Broadphase.UpdatePairs();
+			Total += Milliseconds(Start);
+			if (Broadphase.UsedFullSort())
+				++FullSorts;
+		}
+		return Total / Frames;
+	};
+
+	uint32_t CoherentFullSorts, IncoherentFullSorts;
+	const double Coherent = TimeFrames(0.02f, CoherentFullSorts);
+	const double Incoherent = TimeFrames(2.0f, IncoherentFullSorts);
+
+	printf("SweepAndPrune, %u proxies, %zu pairs: first update %.2f ms, coherent %.3f ms/update (%u full sorts), "
+		"incoherent %.2f ms/update (%u full sorts)", Count, PairCount, FirstUpdate, Coherent, CoherentFullSorts,
+		Incoherent, IncoherentFullSorts);
+	if (Count <= 10000) {
+		uint32_t Found = 0;
+		Start = chrono::steady_clock::now();
+		for (uint32_t i = 0; i < Count; ++i) {
+			for (uint32_t j = i + 1; j < Count; ++j)
+				Found += Overlaps(Boxes[i], Boxes[j]) ? 1 : 0;
+		}
+		printf(" (every pair: %.2f ms)", Milliseconds(Start));
+		TEST_CHECK(Found == Broadphase.GetPairs().size());
+	}
+	printf("\n");
+}
+
+}	// anonymous namespace
+
+void RunSweepAndPruneTests() {
+	TestEdgeCases();
+	TestMotion(0.02f, 50);
+	TestMotion(2.0f, 10);
+	RunBenchmark(10000, 20);
+	RunBenchmark(100000, 10);
+}
@@ -0,0 +1,267 @@
+//
+// TLSFAllocator: placement, alignment, merging and stats, a randomized run checked against the live ranges, and the
+// speed of allocation against a first-fit free list.
+// Builds without the engine: g++ -std=c++14 -O2 -DSTELLAR_TEST_STANDALONE -I../../Core/Source TLSFAllocatorTest.cpp
+// ../../Core/Source/Graphics/TLSFAllocator.cpp
+//
+
+#include "Graphics/TLSFAllocator.h"
+#include "TestCommon.h"
+#include <chrono>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace Graphics;
+using namespace std;
+
+namespace {
+
+const uint64_t kKB = 1024;
+const uint64_t kMB = 1024 * kKB;
+
+void TestPlacement() {
+	TLSFAllocator Allocator;
+	Allocator.Create(1 * kMB, 64 * kKB);
+	TEST_CHECK(Allocator.IsEmpty());
+	TEST_CHECK(Allocator.GetCapacity() == 1 * kMB);
+
+	// Sizes round up to the granularity, and blocks are placed back to back.
+	uint64_t First, Second;
+	const uint32_t A = Allocator.Allocate(100, 64 * kKB, First);
+	const uint32_t B = Allocator.Allocate(64 * kKB + 1, 64 * kKB, Second);
+	TEST_CHECK(A != TLSFAllocator::kInvalidBlock && B != TLSFAllocator::kInvalidBlock);
+	TEST_CHECK(First == 0 && Second == 64 * kKB);
+
+	TLSFStats Stats = Allocator.GetStats();
+	TEST_CHECK(Stats.UsedBytes == 192 * kKB);
+	TEST_CHECK(Stats.FreeBytes == 832 * kKB);
+	TEST_CHECK(Stats.Allocations == 2 && Stats.FreeBlocks == 1);
+	TEST_CHECK(Stats.Fragmentation == 0.0f);
+
+	// An alignment above the granularity skips to the next aligned offset, and the padding stays free.
+	uint64_t Aligned;
+	const uint32_t C = Allocator.Allocate(64 * kKB, 256 * kKB, Aligned);
+	TEST_CHECK(C != TLSFAllocator::kInvalidBlock && Aligned == 256 * kKB);
+	TEST_CHECK(Allocator.GetStats().FreeBlocks == 2);
+
+	// Nothing is left that fits a whole megabyte, nor a zero size.
+	uint64_t Offset;
+	TEST_CHECK(Allocator.Allocate(1 * kMB, 64 * kKB, Offset) == TLSFAllocator::kInvalidBlock);
+	TEST_CHECK(Allocator.Allocate(0, 64 * kKB, Offset) == TLSFAllocator::kInvalidBlock);
+
+	// Freed neighbors merge back into a single block.
+	Allocator.Free(B);
+	Allocator.Free(A);
+	Allocator.Free(C);
+	Stats = Allocator.GetStats();
+	TEST_CHECK(Allocator.IsEmpty());
+	TEST_CHECK(Stats.FreeBlocks == 1 && Stats.FreeBytes == 1 * kMB && Stats.LargestFreeBlock == 1 * kMB);
+
+	TEST_CHECK(Allocator.Allocate(1 * kMB, 64 * kKB, Offset) != TLSFAllocator::kInvalidBlock && Offset == 0);
+}
+
+void TestFragmentation() {
+	TLSFAllocator Allocator;
+	Allocator.Create(16 * kKB, 1 * kKB);
+
+	uint32_t Blocks[16];
+	uint64_t Offset;
+	for (uint32_t i = 0; i < 16; ++i)
+		Blocks[i] = Allocator.Allocate(1 * kKB, 1 * kKB, Offset);
+	TEST_CHECK(Allocator.GetStats().FreeBytes == 0);
+
+	// Every other block freed: eight single free blocks, so a two block request fails despite the free space.
+	for (uint32_t i = 0; i < 16; i += 2)
+		Allocator.Free(Blocks[i]);
+	TLSFStats Stats = Allocator.GetStats();
+	TEST_CHECK(Stats.FreeBlocks == 8 && Stats.LargestFreeBlock == 1 * kKB);
+	TEST_CHECK(Stats.Fragmentation > 0.87f && Stats.Fragmentation < 0.88f);
+	TEST_CHECK(Allocator.Allocate(2 * kKB, 1 * kKB, Offset) == TLSFAllocator::kInvalidBlock);
+
+	// Freeing one between two free blocks joins all three.
+	Allocator.Free(Blocks[1]);
+	Stats = Allocator.GetStats();
+	TEST_CHECK(Stats.FreeBlocks == 7 && Stats.LargestFreeBlock == 3 * kKB);
+	TEST_CHECK(Allocator.Allocate(3 * kKB, 1 * kKB, Offset) != TLSFAllocator::kInvalidBlock && Offset == 0);
+}
+
+// Random sizes and alignments, checking every placement against the live ranges, then everything freed must merge
+// back into one block.
+void TestRandom(uint32_t Seed, uint32_t Iterations) {
+	mt19937_64 Random(Seed);
+	for (uint32_t Trial = 0; Trial < 20; ++Trial) {
+		const uint64_t Granularity = 1ull << (Random() % 13);
+		const uint64_t Capacity = Granularity * (1 + Random() % 100000);
+		TLSFAllocator Allocator;
+		Allocator.Create(Capacity, Granularity);
+
+		map<uint64_t, pair<uint64_t, uint32_t>> Live;
+		uint32_t Misplaced = 0;
+		for (uint32_t i = 0; i < Iterations; ++i) {
+			if (Live.empty() || Random() % 2 != 0) {
+				const uint64_t Size = 1 + Random() % (Capacity / (1 + Random() % 64));
+				const uint64_t Alignment = 1ull << (Random() % 17);
+				uint64_t Offset;
+				const uint32_t Block = Allocator.Allocate(Size, Alignment, Offset);
+				if (Block == TLSFAllocator::kInvalidBlock)
+					continue;
+
+				auto Next = Live.lower_bound(Offset);
+				bool Overlaps = Next != Live.end() && Next->first < Offset + Size;
+				if (Next != Live.begin()) {
+					auto Prev = prev(Next);
+					Overlaps = Overlaps || Prev->first + Prev->second.first > Offset;
+				}
+				if (Offset % Alignment != 0 || Offset + Size > Capacity || Overlaps)
+					++Misplaced;
+				Live[Offset] = make_pair(Size, Block);
+			} else {
+				auto Freed = Live.begin();
+				advance(Freed, Random() % Live.size());
+				Allocator.Free(Freed->second.second);
+				Live.erase(Freed);
+			}
+		}
+		TEST_CHECK(Misplaced == 0);
+		TEST_CHECK(Allocator.GetStats().Allocations == Live.size());
+
+		for (auto& Range : Live)
+			Allocator.Free(Range.second.second);
+		const TLSFStats Stats = Allocator.GetStats();
+		TEST_CHECK(Allocator.IsEmpty());
+		TEST_CHECK(Stats.FreeBlocks == 1 && Stats.FreeBytes == Capacity && Stats.LargestFreeBlock == Capacity);
+	}
+}
+
+// Free ranges kept sorted by offset and searched from the start, which is what the heaps did before.
+class FirstFitAllocator {
+public:
+	explicit FirstFitAllocator(uint64_t Capacity) { m_Free[0] = Capacity; }
+
+	bool Allocate(uint64_t Size, uint64_t Alignment, uint64_t& Offset) {
+		for (auto Range = m_Free.begin(); Range != m_Free.end(); ++Range) {
+			const uint64_t Start = (Range->first + Alignment - 1) & ~(Alignment - 1);
+			const uint64_t End = Range->first + Range->second;
+			if (Start + Size > End)
+				continue;
+
+			const uint64_t RangeStart = Range->first;
+			m_Free.erase(Range);
+			if (Start > RangeStart)
+				m_Free[RangeStart] = Start - RangeStart;
+			if (Start + Size < End)
+				m_Free[Start + Size] = End - Start - Size;
+			Offset = Start;
+			return true;
+		}
+		return false;
+	}
+
+	void Free(uint64_t Offset, uint64_t Size) {
+		auto Next = m_Free.lower_bound(Offset);
+		if (Next != m_Free.end() && Offset + Size == Next->first) {
+			Size += Next->second;
+			Next = m_Free.erase(Next);
+		}
+		if (Next != m_Free.begin()) {
+			auto Prev = prev(Next);
+			if (Prev->first + Prev->second == Offset) {
+				Prev->second += Size;
+				return;
+			}
+		}
+		m_Free[Offset] = Size;
+	}
+
+private:
+	map<uint64_t, uint64_t> m_Free;
+};
+
+// Allocations and frees per second in a 1 GB heap holding a few thousand resources of mixed sizes, a slot at a time.
+void RunBenchmark(uint32_t Iterations) {
+	const uint64_t Capacity = 1024 * kMB;
+	const uint64_t Granularity = 64 * kKB;
+	const uint32_t LiveCount = 2048;
+
+	struct Request {
+		uint64_t Size;
+		uint64_t Alignment;
+	};
+
+	struct Slot {
+		uint64_t Offset;
+		uint64_t Size;
+		uint32_t Block;
+	};
+
+	mt19937 Random(7);
+	vector<Request> Requests(Iterations);
+	for (Request& Next : Requests) {
+		Next.Size = Granularity * (1 + Random() % 8);
+		Next.Alignment = Random() % 16 == 0 ? 4 * kMB : Granularity;
+	}
+
+	TLSFAllocator Allocator;
+	Allocator.Create(Capacity, Granularity);
+	FirstFitAllocator FirstFit(Capacity);
+
+	auto Time = [&](bool UseTLSF, uint32_t& Failures) {
+		const Slot Empty = { 0, 0, TLSFAllocator::kInvalidBlock };
+		vector<Slot> Live(LiveCount, Empty);
+		auto Release = [&](Slot& Used) {
+			if (Used.Block == TLSFAllocator::kInvalidBlock)
+				return;
+			if (UseTLSF)
+				Allocator.Free(Used.Block);
+			else
+				FirstFit.Free(Used.Offset, Used.Size);
+			Used = Empty;
+		};
+
+		Failures = 0;
+		const auto Start = chrono::steady_clock::now();
+		for (uint32_t i = 0; i < Iterations; ++i) {
+			Slot& Used = Live[i % LiveCount];
+			Release(Used);
+
+			const Request& Next = Requests[i];
+			Used.Size = Next.Size;
+			if (UseTLSF)
+				Used.Block = Allocator.Allocate(Next.Size, Next.Alignment, Used.Offset);
+			else if (FirstFit.Allocate(Next.Size, Next.Alignment, Used.Offset))
+				Used.Block = 0;
+			if (Used.Block == TLSFAllocator::kInvalidBlock)
+				++Failures;
+		}
+		const double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+
+		for (Slot& Used : Live)
+			Release(Used);
+		return Iterations / Seconds;
+	};
+
+	uint32_t TLSFFailures, FirstFitFailures;
+	const double TLSFRate = Time(true, TLSFFailures);
+	const double FirstFitRate = Time(false, FirstFitFailures);
+	TEST_CHECK(Allocator.IsEmpty());
+	printf("TLSFAllocator, %u live: %.2f M allocations/s, %u failed (first fit: %.2f M/s, %u failed)\n", LiveCount,
+		TLSFRate * 1e-6, TLSFFailures, FirstFitRate * 1e-6, FirstFitFailures);
+}
+
+}	// anonymous namespace
+
+void RunTLSFAllocatorTests() {
+	TestPlacement();
+	TestFragmentation();
+	TestRandom(1, 20000);
+	RunBenchmark(1000000);
+}
+
+#ifdef STELLAR_TEST_STANDALONE
+int main() {
+	RunTLSFAllocatorTests();
+	printf("%d check(s) failed\n", StellarTest::FailureCount());
+	return StellarTest::FailureCount() == 0 ? 0 : 1;
+}
+#endif
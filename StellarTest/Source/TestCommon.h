@@ -0,0 +1,24 @@
+//
+// Checks shared by the StellarTest suites. A failed check prints its location and is counted; main reports the total.
+//
+
+#pragma once
+
+#include <cstdio>
+
+namespace StellarTest {
+
+	inline int& FailureCount() {
+		static int Count = 0;
+		return Count;
+	}
+
+}	// namespace StellarTest
+
+#define TEST_CHECK( isTrue ) \
+	do { \
+		if (!(isTrue)) { \
+			printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #isTrue); \
+			++StellarTest::FailureCount(); \
+		} \
+	} while (0)
@@ -0,0 +1,196 @@
+//
+// TransformHierarchy: world matrices and bounds of wide, deep and random forests checked against composing the local
+// transforms node by node, incremental updates bit identical to updating everything, then the cost of an update per
+// node for levels wide enough to batch and for a chain that never is.
+//
+
+#include "pch.h"
+#include "Math/TransformHierarchy.h"
+#include "TestCommon.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace Math;
+using namespace std;
+
+namespace {
+
+typedef TransformHierarchy::NodeHandle NodeHandle;
+
+AffineTransform RandomLocal(mt19937& Random) {
+	normal_distribution<float> Normal;
+	uniform_real_distribution<float> Scale(0.8f, 1.25f);
+	uniform_real_distribution<float> Offset(-2.0f, 2.0f);
+	const Quaternion q = Normalize(Quaternion(DirectX::XMVectorSet(Normal(Random), Normal(Random), Normal(Random), Normal(Random))));
+	const Matrix3 Basis = Matrix3(q) * Matrix3::MakeScale(Scale(Random), Scale(Random), Scale(Random));
+	return AffineTransform(Basis, Vector3(Offset(Random), Offset(Random), Offset(Random)));
+}
+
+// Parents of every node in creation order, kInvalidNode for roots.
+vector<NodeHandle> MakeWide(uint32_t Children) {
+	vector<NodeHandle> Parents(1, TransformHierarchy::kInvalidNode);
+	for (uint32_t i = 0; i < Children; ++i) {
+		Parents.push_back(0);
+		for (uint32_t k = 0; k < i % 4; ++k)
+			Parents.push_back((NodeHandle)Parents.size() - 1 - k);
+	}
+	return Parents;
+}
+
+vector<NodeHandle> MakeChain(uint32_t Length) {
+	vector<NodeHandle> Parents(1, TransformHierarchy::kInvalidNode);
+	for (uint32_t i = 1; i < Length; ++i)
+		Parents.push_back(i - 1);
+	return Parents;
+}
+
+// Mostly small subtrees, with enough roots to be updated in parallel.
+vector<NodeHandle> MakeForest(uint32_t Count, uint32_t Seed) {
+	mt19937 Random(Seed);
+	vector<NodeHandle> Parents;
+	for (uint32_t i = 0; i < Count; ++i)
+		Parents.push_back(i == 0 || Random() % 50 == 0 ? TransformHierarchy::kInvalidNode : Random() % i);
+	return Parents;
+}
+
+struct Scene {
+	vector<NodeHandle> Parents;
+	vector<AffineTransform> Locals;
+	vector<BoundingSphere> Bounds;
+	TransformHierarchy Hierarchy;
+
+	Scene(const vector<NodeHandle>& NodeParents, uint32_t Seed) : Parents(NodeParents) {
+		mt19937 Random(Seed);
+		uniform_real_distribution<float> Offset(-1.0f, 1.0f);
+		for (NodeHandle Parent : Parents) {
+			Locals.push_back(RandomLocal(Random));
+			Bounds.push_back(BoundingSphere(Vector3(Offset(Random), Offset(Random), Offset(Random)), 0.5f));
+			Hierarchy.AddNode(Parent, Locals.back(), Bounds.back());
+		}
+	}
+
+	// World transforms composed one node at a time. Parents are created before their children.
+	vector<AffineTransform> ComposeReference() const {
+		vector<AffineTransform> World(Locals.size());
+		for (size_t i = 0; i < Locals.size(); ++i)
+			World[i] = Parents[i] == TransformHierarchy::kInvalidNode ? Locals[i] : World[Parents[i]] * Locals[i];
+		return World;
+	}
+};
+
+float MaxRelativeDifference(const Matrix4& a, const Matrix4& b) {
+	float Result = 0.0f;
+	const float* x = (const float*)&a;
+	const float* y = (const float*)&b;
+	for (int i = 0; i < 16; ++i)
+		Result = max(Result, fabs(x[i] - y[i]) / max(1.0f, fabs(y[i])));
+	return Result;
+}
+
+void CheckAgainstReference(const vector<NodeHandle>& Parents, uint32_t Seed) {
+	Scene Test(Parents, Seed);
+	Test.Hierarchy.Update();
+	const vector<AffineTransform> Reference = Test.ComposeReference();
+
+	uint32_t WrongMatrices = 0, WrongBounds = 0, WrongParents = 0;
+	for (NodeHandle Node = 0; Node < (NodeHandle)Parents.size(); ++Node) {
+		const Matrix4 Expected(Reference[Node]);
+		if (MaxRelativeDifference(Test.Hierarchy.GetWorldMatrix(Node), Expected) > 1e-4f)
+			++WrongMatrices;
+
+		// The world sphere holds the transformed local center.
+		const BoundingSphere World = Test.Hierarchy.GetWorldBounds(Node);
+		const Vector3 Center = Reference[Node] * Test.Bounds[Node].GetCenter();
+		if ((float)Length(World.GetCenter() - Center) > 1e-3f * max(1.0f, (float)Length(Center)))
+			++WrongBounds;
+
+		if (Test.Hierarchy.GetParent(Node) != Parents[Node])
+			++WrongParents;
+	}
+	TEST_CHECK(WrongMatrices == 0);
+	TEST_CHECK(WrongBounds == 0);
+	TEST_CHECK(WrongParents == 0);
+}
+
+// Changing some locals and updating only what they dirty gives the same bits as building the hierarchy from the final
+// locals. The first dirty node moves where groups of four start, so nodes the full update batches are computed one
+// by one here and the other way around.
+void CheckIncremental(const vector<NodeHandle>& Parents, uint32_t Seed) {
+	Scene Incremental(Parents, Seed);
+	Incremental.Hierarchy.Update();
+
+	mt19937 Random(Seed + 1);
+	vector<AffineTransform> Locals = Incremental.Locals;
+	for (uint32_t Round = 0; Round < 4; ++Round) {
+		for (uint32_t k = 0; k < 1 + (uint32_t)Parents.size() / 100; ++k) {
+			const NodeHandle Node = Random() % Parents.size();
+			Locals[Node] = RandomLocal(Random);
+			Incremental.Hierarchy.SetLocalTransform(Node, Locals[Node]);
+		}
+		Incremental.Hierarchy.Update();
+	}
+
+	TransformHierarchy Full;
+	for (size_t i = 0; i < Parents.size(); ++i)
+		Full.AddNode(Parents[i], Locals[i], Incremental.Bounds[i]);
+	Full.Update();
+
+	uint32_t Different = 0;
+	for (NodeHandle Node = 0; Node < (NodeHandle)Parents.size(); ++Node) {
+		if (memcmp(&Full.GetWorldMatrix(Node), &Incremental.Hierarchy.GetWorldMatrix(Node), sizeof(Matrix4)) != 0)
+			++Different;
+	}
+	TEST_CHECK(Different == 0);
+}
+
+void TestHierarchy() {
+	const vector<NodeHandle> Shapes[] = { MakeWide(1001), MakeChain(200), MakeForest(5003, 26) };
+	for (const vector<NodeHandle>& Parents : Shapes) {
+		CheckAgainstReference(Parents, 27);
+		CheckIncremental(Parents, 28);
+	}
+
+	// A single node, and a root with fewer children than a group.
+	CheckAgainstReference(MakeChain(1), 29);
+	CheckAgainstReference(MakeWide(3), 30);
+}
+
+// Nanoseconds per node to update everything, and to update after 1% of the locals change.
+void RunBenchmark(const char* Name, const vector<NodeHandle>& Parents, uint32_t Passes) {
+	Scene Test(Parents, 31);
+	Test.Hierarchy.Update();
+	const uint32_t Count = (uint32_t)Parents.size();
+
+	double Full = 0.0, Partial = 0.0;
+	for (uint32_t Pass = 0; Pass < Passes; ++Pass) {
+		for (NodeHandle Root = 0; Root < Count; ++Root) {
+			if (Parents[Root] == TransformHierarchy::kInvalidNode)
+				Test.Hierarchy.SetLocalTransform(Root, Test.Locals[Root]);
+		}
+		auto Start = chrono::steady_clock::now();
+		Test.Hierarchy.Update();
+		Full += chrono::duration<double, nano>(chrono::steady_clock::now() - Start).count();
+
+		for (uint32_t k = 0; k < Count / 100; ++k) {
+			const NodeHandle Node = (NodeHandle)((k * 2654435761u + Pass) % Count);
+			Test.Hierarchy.SetLocalTransform(Node, Test.Locals[Node]);
+		}
+		Start = chrono::steady_clock::now();
+		Test.Hierarchy.Update();
+		Partial += chrono::duration<double, nano>(chrono::steady_clock::now() - Start).count();
+	}
+	printf("TransformHierarchy, %s, %u nodes: %.1f ns/node for everything, %.1f ns/node with 1%% changed\n", Name, Count,
+		Full / Passes / Count, Partial / Passes / Count);
+}
+
+}	// anonymous namespace
+
+void RunTransformHierarchyTests() {
+	TestHierarchy();
+	// A chain has one node per level, so it always takes the one node at a time path.
+	RunBenchmark("wide", MakeWide(40000), 20);
+	RunBenchmark("chain", MakeChain(100000), 20);
+	RunBenchmark("forest", MakeForest(100000, 32), 20);
+}